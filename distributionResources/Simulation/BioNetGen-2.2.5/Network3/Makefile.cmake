@@ -37,7 +37,7 @@ MUPARSER_LIB = ${LIBDIR}/libmuparser.a
 -include makeincl
 
 # recipes that do not create files
-.PHONY: clean distclean
+.PHONY: check clean distclean
 
 # run_network executable
 #run_network: $(MATHUTILS_LIB) $(CVODE_LIB) $(GSL_LIB) $(MUPARSER_LIB)
@@ -45,14 +45,18 @@ run_network: $(MATHUTILS_LIB) $(CVODE_LIB) $(MUPARSER_LIB)
 	mkdir -p $(NETWORK_BINDIR)
 	cd $(NETWORK_BINDIR); cmake $(CMAKELISTS_DIR); make;
 	mkdir -p $(BNG_BINDIR)
-	cp -f $(NETWORK_BINDIR)/run_network $(BNG_BINDIR)
+	cp -f $(NETWORK_BINDIR)/run_network $(NETWORK_BINDIR)/libnetwork3.so $(BNG_BINDIR)
+
+# unit checks (the statistical check of the rand2 samplers)
+check: run_network
+	cd $(NETWORK_BINDIR); ctest --output-on-failure
 
 # libraries
 $(CVODE_LIB):  $(LIBSOURCE)/$(CVODE).tar.gz
 	mkdir -p $(LIBDIR) $(INCDIR)
 	rm -rf $(CVODE)
 	tar -xzf $(LIBSOURCE)/$(CVODE).tar.gz
-	cd $(CVODE);  ./configure --prefix=$(CURDIR) --disable-shared;  make;  make install
+	cd $(CVODE);  ./configure --prefix=$(CURDIR) --disable-shared --with-pic;  make;  make install
 
 #$(GSL_LIB):  $(LIBSOURCE)/$(GSL).tar.gz
 #	mkdir -p $(LIBDIR) $(INCDIR)
@@ -64,18 +68,18 @@ $(MUPARSER_LIB):  $(LIBSOURCE)/$(MUPARSER).zip
 	mkdir -p $(LIBDIR) $(INCDIR)
 	rm -rf $(MUPARSER)
 	unzip $(LIBSOURCE)/$(MUPARSER).zip
-	cd $(MUPARSER); ./configure --prefix=$(CURDIR) --disable-shared;  make;  make install
+	cd $(MUPARSER); ./configure --prefix=$(CURDIR) --disable-shared CXXFLAGS="-O2 -fPIC";  make;  make install
 
 $(MATHUTILS_LIB):  $(LIBSOURCE)/$(MATHUTILS).tar.gz
 	mkdir -p $(LIBDIR) $(INCDIR)
 	rm -rf $(MATHUTILS)
 	tar -xzf $(LIBSOURCE)/$(MATHUTILS).tar.gz
-	cd $(MATHUTILS); make
+	cd $(MATHUTILS); make CFLAGS="-O2 -fPIC"
 
 # clean scripts
 clean:
 	rm -f *.o *.a ;
-	rm $(NETWORK_BINDIR)/run_network $(NETWORK_BINDIR)/CMakeCache.txt $(NETWORK_BINDIR)/cmake_install.cmake $(NETWORK_BINDIR)/Makefile ;
+	rm $(NETWORK_BINDIR)/run_network $(NETWORK_BINDIR)/libnetwork3.so $(NETWORK_BINDIR)/CMakeCache.txt $(NETWORK_BINDIR)/cmake_install.cmake $(NETWORK_BINDIR)/Makefile ;
 	rm -r $(NETWORK_BINDIR)/CMakeFiles ;
 	if test -d ${CVODE} ; then \
 	    cd ${CVODE} ;          \
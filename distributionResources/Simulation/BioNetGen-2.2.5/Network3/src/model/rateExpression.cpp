@@ -7,7 +7,7 @@
 
 #include "rateExpression.hh"
 
-RateExpression::RateExpression() : type("UNKNOWN"){
+RateExpression::RateExpression() : type("UNKNOWN"), kind(GENERIC){
 	if (debug)
 		cout << "RateExpression constructor called." << endl;
 }
@@ -17,25 +17,30 @@ RateExpression::~RateExpression(){
 		cout << "RateExpression destructor called: " << this->type << endl;
 }
 
-double RateExpression::getRate(vector<double> X){
+double RateExpression::getRate(const double* X){
 	cout << "Error: Cannot use base RateExpression::getRate(). Choose a standard one or create your own. Exiting." << endl;
 	exit(1);
 	return NAN;
 }
 
-double RateExpression::get_dRate_dX(unsigned int which, vector<double> X){
+double RateExpression::get_dRate_dX(unsigned int which, const double* X){
+	// The number of rate species is only known to the derived classes, which call numerical_deriv() themselves
+	// if they have no analytical derivative
+	cout << "Error: Cannot use base RateExpression::get_dRate_dX(). Choose a standard one or create your own. Exiting." << endl;
+	exit(1);
+	return NAN;
+}
+
+double RateExpression::numerical_deriv(unsigned int which, const double* X_in, unsigned int n, RateExpression* re){
 	// Error check
-	if (which >= X.size()){
-		cout << "Error in RateExpression::get_dRate_dX(): Parameter 'which' larger than size of X vector. Exiting." << endl;
+	if (which >= n){
+		cout << "Error in RateExpression::numerical_deriv(): Parameter 'which' larger than size of X vector. Exiting." << endl;
 		exit(1);
 	}
-	// In the absence of an overloaded method, call the static numerical_deriv() method
-	if (debug)
-		cout << "Using default RateExpression::numerical_deriv() method to calculate derivative." << endl;
-	return RateExpression::numerical_deriv(which,X,this);
-}
-
-double RateExpression::numerical_deriv(unsigned int which, vector<double> X, RateExpression* re){
+	double X[n];
+	for (unsigned int i=0;i < n;i++){
+		X[i] = X_in[i];
+	}
 	double dRate;
 	X[which] += 1.0;
 	double r_plus = re->getRate(X);
@@ -14,13 +14,23 @@ namespace network3{
 
 	class RateExpression{
 	public:
+		// Rate laws that Reaction::getRates() evaluates without a virtual call
+		enum Kind{GENERIC,ELEMENTARY,SATURATION,HILL,MM,MUPARSER};
 		string type;
+		Kind kind;
 		RateExpression();
 		virtual ~RateExpression();
-		virtual double getRate(vector<double> X);
-		virtual double get_dRate_dX(unsigned int which, vector<double> X);
+		// X[i] is the population of the i-th rate species
+		virtual double getRate(const double* X);
+		virtual double get_dRate_dX(unsigned int which, const double* X);
+		double getRate(const vector<double>& X){ return this->getRate(X.empty() ? NULL : &X[0]); }
+		double get_dRate_dX(unsigned int which, const vector<double>& X){
+			return this->get_dRate_dX(which,X.empty() ? NULL : &X[0]);
+		}
 		string toString(){ return this->type; }
-		static double numerical_deriv(unsigned int which, vector<double> X, RateExpression* re);
+		// Functions are evaluated by muParser, which cannot evaluate one expression in two threads at once
+		bool threadSafe(){ return this->kind != GENERIC && this->kind != MUPARSER; }
+		static double numerical_deriv(unsigned int which, const double* X, unsigned int n, RateExpression* re);
 	};
 
 	class RateElementary : public RateExpression{
@@ -28,8 +38,8 @@ namespace network3{
 		double c;
 		RateElementary(double c, vector<SimpleSpecies*> r, vector<int> rS);
 		~RateElementary();
-		double getRate(vector<double> X);
-		double get_dRate_dX(unsigned int which, vector<double> X);
+		double getRate(const double* X);
+		double get_dRate_dX(unsigned int which, const double* X);
 	protected:
 		vector<int> rStoich;
 	//		bool numerical_derivatives;
@@ -42,8 +52,8 @@ namespace network3{
 		RateSaturation(double kcat, double Km, vector<SimpleSpecies*> r, vector<int> rS);
 		RateSaturation(double kcat, vector<double> Km, vector<SimpleSpecies*> r, vector<int> rS);
 		~RateSaturation();
-		double getRate(vector<double> X);
-		double get_dRate_dX(unsigned int which, vector<double> X);
+		double getRate(const double* X);
+		double get_dRate_dX(unsigned int which, const double* X);
 	protected:
 		vector<int> rStoich;
 	//		bool numerical_derivatives;
@@ -57,8 +67,8 @@ namespace network3{
 		double h;
 		RateHill(double Vmax, double Kh, double h, vector<SimpleSpecies*> r, vector<int> rS);
 		~RateHill();
-		double getRate(vector<double> X);
-		double get_dRate_dX(unsigned int which, vector<double> X);
+		double getRate(const double* X);
+		double get_dRate_dX(unsigned int which, const double* X);
 	protected:
 		vector<int> rStoich;
 	//		bool numerical_derivatives;
@@ -70,8 +80,8 @@ namespace network3{
 		double Km;
 		RateMM(double kcat, double Km, vector<SimpleSpecies*> r, vector<int> rS);
 		~RateMM();
-		double getRate(vector<double> X);
-		double get_dRate_dX(unsigned int which, vector<double> X);
+		double getRate(const double* X);
+		double get_dRate_dX(unsigned int which, const double* X);
 	protected:
 	//		bool numerical_derivatives;
 	};
@@ -32,6 +32,7 @@ RateElementary::RateElementary(double c, vector<SimpleSpecies*> r, vector<int> r
 			}
 		}
 	}
+	this->kind = ELEMENTARY;
 	// Get type string
 	this->type = "ELEMENTARY:";
 	if (r.size() == 0){
@@ -61,15 +62,10 @@ RateElementary::~RateElementary(){
 		cout << "RateElementary destructor called." << endl;
 }
 
-double RateElementary::getRate(vector<double> X){
-	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateElementary::getRate(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
+double RateElementary::getRate(const double* X){
 	// Rate calculation
 	double rate = this->c;
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateElementary::getRate(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting." << endl;
@@ -83,19 +79,15 @@ double RateElementary::getRate(vector<double> X){
 	return rate;
 }
 
-double RateElementary::get_dRate_dX(unsigned int which, vector<double> X){
+double RateElementary::get_dRate_dX(unsigned int which, const double* X){
 	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateElementary::get_dRate_dX(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
-	if (which >= X.size()){ // This will prevent zeroth-order rxns from being passed
+	if (which >= this->rStoich.size()){ // This will prevent zeroth-order rxns from being passed
 		cout << "Error in RateElementary::get_dRate_dX(): Parameter 'which' larger than size of 'X' vector. Exiting." << endl;
 		exit(1);
 	}
 	//
 	double dRate = this->c;
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateElementary::get_dRate_dX(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting.\n";
@@ -32,6 +32,7 @@ RateHill::RateHill(double Vmax, double Kh, double h, vector<SimpleSpecies*> r, v
 			}
 		}
 	}
+	this->kind = HILL;
 	// Get type string
 	this->type = "Hill:{";
 	if (r.size() == 0){
@@ -54,16 +55,11 @@ RateHill::~RateHill(){
 		cout << "RateHill destructor called." << endl;
 }
 
-double RateHill::getRate(vector<double> X){
-	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateHill::getRate(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
+double RateHill::getRate(const double* X){
 	// Rate calculation
 	double rate = this->Vmax;
 	// Loop over reactant species
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateHill::getRate(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting." << endl;
@@ -87,13 +83,9 @@ double RateHill::getRate(vector<double> X){
 	return rate;
 }
 
-double RateHill::get_dRate_dX(unsigned int which, vector<double> X){
+double RateHill::get_dRate_dX(unsigned int which, const double* X){
 	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateHill::get_dRate_dX(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
-	if (which >= X.size()){ // This will prevent zeroth-order rxns from being passed
+	if (which >= this->rStoich.size()){ // This will prevent zeroth-order rxns from being passed
 		cout << "Error in RateHill::get_dRate_dX(): Parameter 'which' larger than size of 'X' vector. Exiting." << endl;
 		exit(1);
 	}
@@ -111,7 +103,7 @@ double RateHill::get_dRate_dX(unsigned int which, vector<double> X){
 	// First species
 	if (which == 0){
 		// Loop over other species
-		for (unsigned int i=1;i < X.size();i++){
+		for (unsigned int i=1;i < this->rStoich.size();i++){
 			// Error check
 			if (X[i] < 0.0){
 				cout << "Error in RateHill::get_dRate_dX(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting.\n";
@@ -143,7 +135,7 @@ double RateHill::get_dRate_dX(unsigned int which, vector<double> X){
 	else{
 		double X0_h = pow(X0_mult,this->h);
 		dRate *= X0_h/( pow(this->Kh,this->h) + X0_h );
-		for (unsigned int i=1;i < X.size();i++){
+		for (unsigned int i=1;i < this->rStoich.size();i++){
 			// Error check
 //			if (X[i] < 0.0){
 //				cout << "Error in RateHill::get_dRate_dX(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting.\n";
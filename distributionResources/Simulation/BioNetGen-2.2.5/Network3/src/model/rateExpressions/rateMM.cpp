@@ -33,6 +33,7 @@ RateMM::RateMM(double kcat, double Km, vector<SimpleSpecies*> r, vector<int> rS)
 		cout << "(" << r[1]->name << ": stoich = " << rS[1] << ")" << endl;
 		exit(1);
 	}
+	this->kind = MM;
 	// Get type string
 	this->type = "MICHAELIS_MENTEN:{";
 	this->type += r[0]->name + " + " + r[1]->name + " ->}{";
@@ -44,13 +45,8 @@ RateMM::~RateMM(){
 	cout << "RateMM destructor called." << endl;
 }
 
-double RateMM::getRate(vector<double> X){
-	// Error check
-	if (X.size() != 2){
-		cout << "Error in RateMM::getRate(): Size of 'X' vector must be exactly 2. Exiting." << endl;
-		exit(1);
-	}
-//	for (unsigned int i=0;i < X.size();i++){
+double RateMM::getRate(const double* X){
+//	for (unsigned int i=0;i < 2;i++){
 //		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateMM::getRate(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting." << endl;
@@ -66,17 +62,13 @@ double RateMM::getRate(vector<double> X){
 	return rate;
 }
 
-double RateMM::get_dRate_dX(unsigned int which, vector<double> X){
+double RateMM::get_dRate_dX(unsigned int which, const double* X){
 	// Error check
-	if (X.size() != 2){
-		cout << "Error in RateMM::get_dRate_dX(): Size of 'X' vector must be exactly 2. Exiting." << endl;
-		exit(1);
-	}
 	if (which > 1){
 		cout << "Error in RateMM::get_dRate_dX(): Parameter 'which' cannot be greater than 1. Exiting." << endl;
 		exit(1);
 	}
-//	for (unsigned int i=0;i < X.size();i++){
+//	for (unsigned int i=0;i < 2;i++){
 //		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateMM::get_dRate_dX(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting." << endl;
@@ -32,6 +32,7 @@ RateMuParser::RateMuParser(mu::Parser* p, vector<SimpleSpecies*> r, vector<int>
 			}
 		}
 	}
+	this->kind = MUPARSER;
 	// Get type string
 	this->type = "FUNCTION:{";
 	if (r.size() == 0){
@@ -53,15 +54,10 @@ RateMuParser::~RateMuParser(){
 		cout << "RateMuParser destructor called." << endl;
 }
 
-double RateMuParser::getRate(vector<double> X){
-	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateMuParser::getRate(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
+double RateMuParser::getRate(const double* X){
 	// Rate calculation
 	double rate = this->p->Eval();
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateMuParser::getRate(): Negative population detected (X[" << i << "] = " << X[i]
@@ -75,3 +71,7 @@ double RateMuParser::getRate(vector<double> X){
 	}
 	return rate;
 }
+
+double RateMuParser::get_dRate_dX(unsigned int which, const double* X){
+	return RateExpression::numerical_deriv(which,X,this->rStoich.size(),this);
+}
@@ -18,7 +18,8 @@ namespace network3{
 		mu::Parser* p;
 		RateMuParser(mu::Parser* p, vector<SimpleSpecies*> r, vector<int> rS);
 		~RateMuParser();
-		double getRate(vector<double> X);
+		double getRate(const double* X);
+		double get_dRate_dX(unsigned int which, const double* X);
 	protected:
 		vector<int> rStoich;
 	};
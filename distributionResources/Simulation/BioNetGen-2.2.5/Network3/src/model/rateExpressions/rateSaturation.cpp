@@ -47,6 +47,7 @@ void RateSaturation::construct(vector<SimpleSpecies*> r, vector<int> rS){
 			}
 		}
 	}
+	this->kind = SATURATION;
 	// Get type string
 	this->type = "SATURATION:{";
 	if (r.size() == 0){
@@ -72,16 +73,11 @@ RateSaturation::~RateSaturation(){
 		cout << "RateSaturation destructor called." << endl;
 }
 
-double RateSaturation::getRate(vector<double> X){
-	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateSaturation::getRate(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
+double RateSaturation::getRate(const double* X){
 	// Rate calculation
 	double rate = this->kcat;
 	// Loop over reactant species
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateSaturation::getRate(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting." << endl;
@@ -100,19 +96,15 @@ double RateSaturation::getRate(vector<double> X){
 	return rate;
 }
 
-double RateSaturation::get_dRate_dX(unsigned int which, vector<double> X){
+double RateSaturation::get_dRate_dX(unsigned int which, const double* X){
 	// Error check
-	if (X.size() != this->rStoich.size()){
-		cout << "Error in RateSaturation::get_dRate_dX(): Size of 'X' vector not equal to that of 'rStoich' vector. Exiting." << endl;
-		exit(1);
-	}
-	if (which >= X.size()){ // This will prevent zeroth-order rxns from being passed
+	if (which >= this->rStoich.size()){ // This will prevent zeroth-order rxns from being passed
 		cout << "Error in RateSaturation::get_dRate_dX(): Parameter 'which' larger than size of 'X' vector. Exiting." << endl;
 		exit(1);
 	}
 	//
 	double dRate = this->kcat;
-	for (unsigned int i=0;i < X.size();i++){
+	for (unsigned int i=0;i < this->rStoich.size();i++){
 		// Error check
 //		if (X[i] < 0.0){
 //			cout << "Error in RateSaturation::get_dRate_dX(): Negative population detected (X[" << i << "] = " << X[i] << "). Exiting.\n";
@@ -6,8 +6,27 @@
  */
 
 #include "reaction.hh"
+#include "rateExpressions/rateMuParser.hh"
 #include "../util/util.hh"
 
+// Calls the standard rate laws directly rather than through the vtable
+static inline double evalRate(RateExpression* re, const double* X){
+	switch (re->kind){
+	case RateExpression::ELEMENTARY:
+		return static_cast<RateElementary*>(re)->RateElementary::getRate(X);
+	case RateExpression::SATURATION:
+		return static_cast<RateSaturation*>(re)->RateSaturation::getRate(X);
+	case RateExpression::HILL:
+		return static_cast<RateHill*>(re)->RateHill::getRate(X);
+	case RateExpression::MM:
+		return static_cast<RateMM*>(re)->RateMM::getRate(X);
+	case RateExpression::MUPARSER:
+		return static_cast<RateMuParser*>(re)->RateMuParser::getRate(X);
+	default:
+		return re->getRate(X);
+	}
+}
+
 Reaction::Reaction(){
 	if (debug)
 		cout << "Reaction constructor called." << endl;
@@ -38,11 +57,11 @@ Reaction::~Reaction(){
 }
 
 double Reaction::getRate(){
-	vector<double> X;
+	double X[this->rateSpecies.size()+1]; // Synthesis rxns have no rate species
 	for (unsigned int i=0;i < this->rateSpecies.size();i++){
-		X.push_back(this->rateSpecies[i]->population);
+		X[i] = this->rateSpecies[i]->population;
 	}
-	double rate = this->re->getRate(X);
+	double rate = evalRate(this->re,X);
 	if (rate < 0.0){
 		if (rate > -network3::TOL){
 			rate = 0.0;
@@ -61,12 +80,25 @@ double Reaction::getRate(){
 }
 
 double Reaction::get_dRate_dX(int which){
-	vector<double> X;
+	double X[this->rateSpecies.size()+1];
 	for (unsigned int i=0;i < this->rateSpecies.size();i++){
-		X.push_back(this->rateSpecies[i]->population);
+		X[i] = this->rateSpecies[i]->population;
 	}
 	return this->re->get_dRate_dX(which,X);
-//	return RateExpression::numerical_deriv(which,X,this->re);
+//	return RateExpression::numerical_deriv(which,X,this->rateSpecies.size(),this->re);
+}
+
+void Reaction::getRates(const vector<Reaction*>& rxn, const double* X, const vector<unsigned int*>& rateSp, double* a,
+						unsigned int first, unsigned int last, bool threadSafeOnly){
+	for (unsigned int v=first;v < last;v++){
+		if (threadSafeOnly && !rxn[v]->re->threadSafe()) continue;
+		unsigned int n = rxn[v]->rateSpecies.size();
+		double Xv[n+1];
+		for (unsigned int i=0;i < n;i++){
+			Xv[i] = X[rateSp[v][i]];
+		}
+		a[v] = evalRate(rxn[v]->re,Xv);
+	}
 }
 
 void Reaction::fire(double K){
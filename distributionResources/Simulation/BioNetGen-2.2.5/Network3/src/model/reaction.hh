@@ -24,6 +24,15 @@ namespace network3{
 		virtual ~Reaction();
 		double getRate();
 		double get_dRate_dX(int which);
+		// Rates of all rxns for the species populations X[], where the rate species of rxn[v] are at X[rateSp[v][i]].
+		// Like re->getRate(), negative rates are not checked for.
+		static void getRates(const vector<Reaction*>& rxn, const double* X, const vector<unsigned int*>& rateSp, double* a){
+			Reaction::getRates(rxn,X,rateSp,a,0,rxn.size(),false);
+		}
+		// Same for rxn[first..last-1]. With threadSafeOnly, rxns whose rates are not RateExpression::threadSafe() are
+		// skipped.
+		static void getRates(const vector<Reaction*>& rxn, const double* X, const vector<unsigned int*>& rateSp, double* a,
+							 unsigned int first, unsigned int last, bool threadSafeOnly);
 		void fire(double K);
 		string toString(){ return string_ID; }
 	protected:
@@ -30,12 +30,18 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <assert.h>
 #include <cfloat>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/wait.h>
 #include "util/mathutils/mathutils.h"
 }
 /*
@@ -51,6 +57,9 @@ extern "C" {
  */
 #include "network.h"
 
+/* The network of the current state (see set_state_network()) */
+#define network (*current_network)
+
 #define BUFSIZE 10000
 
 char* get_line(FILE* infile) {
@@ -76,7 +85,7 @@ char* get_line(FILE* infile) {
 
 char** parse_line(char* buf, int* n_tok, char* comment_chars, char* sep_chars) {
 	int max_tokens = 100;
-	char *sptr, **tokens;
+	char *sptr, **tokens, *save;
 
 	/* remove text after comment #*% */
 	if (comment_chars) {
@@ -84,11 +93,11 @@ char** parse_line(char* buf, int* n_tok, char* comment_chars, char* sep_chars) {
 			*sptr = '\0';
 	}
 
-	/* parse line using strtok */
+	/* parse line using strtok_r (threads may read networks at the same time) */
 	*n_tok = 0;
 	sptr = buf;
 	tokens = (char**) malloc(max_tokens * sizeof(char *));
-	while ((tokens[*n_tok] = strtok(sptr, sep_chars)) != NULL) {
+	while ((tokens[*n_tok] = strtok_r(sptr, sep_chars, &save)) != NULL) {
 		sptr = NULL;
 		++(*n_tok);
 		if (*n_tok == max_tokens) {
@@ -105,6 +114,14 @@ char** parse_line(char* buf, int* n_tok, char* comment_chars, char* sep_chars) {
 	return (tokens);
 }
 
+/* Returns 1 if the first word on line is word. Used to skip the lines before a block without
+ * tokenizing them. */
+static int first_word_is(const char* line, const char* word) {
+	size_t n = strlen(word);
+	while (*line == ' ' || *line == '\t') ++line;
+	return (strncmp(line, word, n) == 0 && (line[n] == '\0' || isspace((unsigned char) line[n])));
+}
+
 char* chop_suffix(char* string, const char* suff) {
 	char *suff_start;
 	int lstr, lsuff;
@@ -409,8 +426,9 @@ void process_function_names(string& a) {
  *
  * Indices of variable parameters vector and functions vector should match
  *
+ * Returns 0, or 1 if the block has errors.
  */
-void read_functions_array(const char* netfile, Elt_array*& rates, map<string,double*>& param_map,
+int read_functions_array(const char* netfile, Elt_array*& rates, map<string,double*>& param_map,
 		map<string,int> param_index_map, map<string,int> observ_index_map, double* t) {
 
 	// find beginning of block
@@ -436,6 +454,7 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 
 	while (getline(infile,line)) {
 
+		if (!foundBegin && !first_word_is(line.c_str(), "begin")) continue;
 		istringstream readLine(line);
 		dummy_string.clear(); // Be sure to clear the string before extracting data to it --LAH
 		readLine >> dummy_string;
@@ -453,7 +472,7 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 			readLine >> dummy_string;
 			if (dummy_string != "functions"){
 				cout << "ERROR: functions block must terminate with an 'end functions' directive." << endl;
-				exit(1);
+				return (1);
 			}
 			break;
 		}
@@ -486,15 +505,15 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 				// Check for function arguments -- exit if they exist
 				if (func_name[func_name.length()-2] != '(') {
 					cout << "Error in network::read_functions_array(): Functions cannot contain arguments ('"
-						 << func_name << "'). Exiting." << endl;
-					exit(1);
+						 << func_name << "')." << endl;
+					return (1);
 				}
 				// Just to be safe
 				if (func_name[func_name.length()-1] != ')') {
 					cout << "Error in network::read_functions_array(): Not sure what's going on with function '"
-						 << func_name << "', but it should end with a ')' character. Exiting."
+						 << func_name << "', but it should end with a ')' character."
 						 << endl;
-					exit(1);
+					return (1);
 				}
 
 				// Erase '()' from end of function name
@@ -505,7 +524,7 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 				if (func_name == "time"){
 					cout << "ERROR: Function name \"time()\" is a reserved keyword. ";
 					cout << "Please choose a different name." << endl;
-					exit(1);
+					return (1);
 				}
 
 				// link it to rates and observables (spec_groups)
@@ -521,8 +540,8 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 				for (unsigned int i = 0; i < variable_names.size(); i++) {
 					if (param_map.find(variable_names[i]) == param_map.end()) {
 						cout << "Error in parsing function '" << func_name << "'. Could not find variable '"
-							 << variable_names[i] << "'. Exiting.\n";
-						exit(1);
+							 << variable_names[i] << "'.\n";
+						return (1);
 					}
 					else {
 						parser.DefineVar(_T(variable_names[i]),param_map[variable_names[i]]); // Define variable
@@ -534,8 +553,8 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 						}
 						else {
 							cout << "Ummm, variable '" << variable_names[i] << "' in function '" << func_name
-								 << "' is not a parameter or an observable. That's a problem. Exiting." << endl;
-							exit(1);
+								 << "' is not a parameter or an observable. That's a problem." << endl;
+							return (1);
 						}
 					}
 				}
@@ -551,13 +570,13 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 				}*/
 
 //				cout << function_string << endl;
-				parser.SetExpr(function_string);
 //				double new_val = parser.Eval();
 			}
 
 			// Error check
 			try
 			{
+				if (func_name != "time") parser.SetExpr(function_string);
 				parser.Eval();
 			}
 			catch(mu::Parser::exception_type &e)
@@ -568,7 +587,7 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 				cout << "Token:    " << e.GetToken() << "\n";
 				cout << "Position: " << e.GetPos() << "\n";
 				cout << "Errc:     " << e.GetCode() << "\n";
-				exit(1);
+				return (1);
 			}
 
 			// Add parser to functions vector
@@ -599,7 +618,7 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 			else network.var_parameters.push_back(1);
 			if (network.functions.size() != network.var_parameters.size()){
 				cout << "ERROR: Function and variable parameter indices do not match." << endl;
-				exit(1);
+				return (1);
 			}
 
 			//////////////////////////////////////////////////////////
@@ -644,13 +663,32 @@ void read_functions_array(const char* netfile, Elt_array*& rates, map<string,dou
 		else if (foundBegin && dummy_string != "" && dummy_string[0] != '#'){ // Allow for blank and commented lines
 			cout << "ERROR: Found invalid line \"" << dummy_string <<
 					"\" while reading functions block." << endl;
-			exit(1);
+			return (1);
 		}
 	}
 
-//	return functions;
+	return (0);
+}
+
+/* Array of the elements in list, with the indices of the n_fixed fixed ones */
+static Elt_array* finish_Elt_array(Elt* list, int n_fixed) {
+	Elt_array* earray = new_Elt_array(list);
+	if (n_fixed) {
+		int *iarray = IALLOC_VECTOR(n_fixed);
+		int i, ifixed = 0;
+		for (i = 0; i < earray->n_elt; ++i) {
+			if (earray->elt[i]->fixed) {
+				iarray[ifixed] = i;
+				++ifixed;
+			}
+		}
+		earray->n_fixed_elts = n_fixed;
+		earray->fixed_elts = iarray;
+	}
+	return (earray);
 }
 
+/* Reads the list in block name of datfile. If the block has errors, returns NULL and sets *n_read to -1. */
 Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_read, Elt_array* params) {
 	Elt_array* earray = NULL;
 	Elt *list_start = NULL, *list_end, *elt, *new_elt;
@@ -661,6 +699,12 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 	char* elt_name;
 	int n_tok;
 	int n_fixed;
+	char* num_end;
+	map<string,int> param_index; // parameters by name (first of each), so that lookups don't scan the vector
+
+	for (unsigned int j=0;j < network.parameters.size();j++){
+		param_index.insert(make_pair(network.parameters[j].name,(int)j));
+	}
 
 	/* read data in block */
 	*n_read = 0;
@@ -668,6 +712,10 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 	while ((line = get_line(datfile))) {
 		fflush(stdout);
 		++(*line_number);
+		if (!read_begin && !first_word_is(line, "begin")) {
+			free(line);
+			continue;
+		}
 		tokens = parse_line(line, &n_tokens, (char*)"#", (char*)" \t\r\n");
 		if (n_tokens == 0)
 			goto cleanup;
@@ -714,7 +762,12 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 			++n_tok;
 
 			/* Read elt value either directly or by looking up parameter value */
-			if (n_tok < n_tokens) {
+			// Plain numbers (e.g., most species counts) don't need an expression parser
+			if (n_tok < n_tokens && strcmp(name,"parameters") != 0 && (val = strtod(tokens[n_tok],&num_end),
+					num_end != tokens[n_tok] && *num_end == '\0')) {
+				++n_tok;
+			}
+			else if (n_tok < n_tokens) {
 				/////////////////////////
 				// NEW CODE (expression parsing): 01/25/13 -- LAH
 				/////////////////////////
@@ -727,23 +780,22 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 				vector<string> v = find_variables(expr); //find_variables(tokens[n_tok]);
 				for (unsigned int i=0;i < v.size();i++){
 					// Look for variable in parameters vector
-					bool found = false;
-					for (unsigned int j=0;j < network.parameters.size() && !found;j++){
-						if (network.parameters[j].name == v[i]){
-							parser.p.DefineVar(v[i],&network.parameters[j].val);
-							found = true;
-						}
+					map<string,int>::iterator it = param_index.find(v[i]);
+					bool found = (it != param_index.end());
+					if (found){
+						parser.p.DefineVar(v[i],&network.parameters[it->second].val);
 					}
 					// Error check
 					if (!found){
 						cout << "Error in parsing '" << name << "' block expression: \"" << expr // tokens[n_tok] <<
-							 <<	"\". Could not find parameter " << v[i] << ". Exiting." << endl;
-						exit(1);
+							 <<	"\". Could not find parameter " << v[i] << "." << endl;
+						++error;
+						goto cleanup;
 					}
 				}
-				parser.p.SetExpr(expr); //parser.p.SetExpr(tokens[n_tok]);
 				try
 				{
+					parser.p.SetExpr(expr); //parser.p.SetExpr(tokens[n_tok]);
 					parser.val = parser.p.Eval();
 				}
 				catch(mu::Parser::exception_type &e)
@@ -754,15 +806,21 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 					cout << "Token:    " << e.GetToken() << "\n";
 					cout << "Position: " << e.GetPos() << "\n";
 					cout << "Errc:     " << e.GetCode() << "\n";
-					exit(1);
+					++error;
+					goto cleanup;
 				}
 //				cout << "\t" << parser.name << " " << parser.val << endl;
 				// Store the value
 				val = parser.val;
 				// If the element is a parameter, store it
 				if (strcmp(name,"parameters") == 0){
+					param_index.insert(make_pair(parser.name,(int)network.parameters.size()));
 					network.parameters.push_back(parser);
 				}
+				// An initial amount is kept too, for init_species_network()
+				else if (strcmp(name,"species") == 0){
+					network.species_exprs[index] = expr;
+				}
 				/////////////////////////
 /*				OLD CODE
 				////////////////////////
@@ -845,25 +903,14 @@ Elt_array* read_Elt_array(FILE* datfile, int* line_number, char* name, int* n_re
 	}
 	if (error) {
 		fprintf(stderr, "%s list not read because of errors.\n", name);
+		*n_read = -1;
 		for (elt = list_start; elt != NULL; elt = new_elt) {
 			new_elt = elt->next;
 			free_Elt(elt);
 		}
 	}
 	else {
-		earray = new_Elt_array(list_start);
-		if (n_fixed) {
-			int *iarray = IALLOC_VECTOR(n_fixed);
-			int i, ifixed = 0;
-			for (i = 0; i < earray->n_elt; ++i) {
-				if (earray->elt[i]->fixed) {
-					iarray[ifixed] = i;
-					++ifixed;
-				}
-			}
-			earray->n_fixed_elts = n_fixed;
-			earray->fixed_elts = iarray;
-		}
+		earray = finish_Elt_array(list_start, n_fixed);
 	}
 
 	return (earray);
@@ -938,6 +985,18 @@ void free_Group(Group* group) {
 	return;
 }
 
+// Calculate total_val of each group
+static void group_totals(Group* glist, Elt_array* earray) {
+	for (Group * curr = glist; curr != NULL; curr = curr->next) {
+		curr->total_val = 0;
+		for (int i = 0; i < curr->n_elt; i++)
+			curr->total_val += curr->elt_factor[i]
+					* earray->elt[curr->elt_index[i] - 1]->val;
+	}
+}
+
+/* Reads the groups in block name of datfile and adds them to glist. If the block has errors, frees glist,
+ * returns NULL and sets *n_read to -1. */
 Group* read_Groups(Group* glist, FILE* datfile, Elt_array* earray, int* line_number, char* name,
 		int* n_read) {
 
@@ -957,6 +1016,10 @@ Group* read_Groups(Group* glist, FILE* datfile, Elt_array* earray, int* line_num
 	*n_read = 0;
 	while ((line = get_line(datfile))) {
 		++(*line_number);
+		if (!read_begin && !first_word_is(line, "begin")) {
+			free(line);
+			continue;
+		}
 		tokens = parse_line(line, &n_tokens, (char*)"#", (char*)", \t\r\n");
 		if (n_tokens == 0)
 			goto cleanup;
@@ -1060,6 +1123,7 @@ Group* read_Groups(Group* glist, FILE* datfile, Elt_array* earray, int* line_num
 	if (error) {
 		Group *group, *new_elt;
 		fprintf(stderr, "%s list not read because of errors.\n", name);
+		*n_read = -1;
 		for (group = glist_ret; group != NULL; group = new_elt) {
 			new_elt = group->next;
 			free_Group(group);
@@ -1067,13 +1131,7 @@ Group* read_Groups(Group* glist, FILE* datfile, Elt_array* earray, int* line_num
 		glist_ret = NULL;
 	}
 
-	// Calculate total_val of group
-	for (Group * curr = glist_ret; curr != NULL; curr = curr->next) {
-		curr->total_val = 0;
-		for (int i = 0; i < curr->n_elt; i++)
-			curr->total_val += curr->elt_factor[i]
-					* earray->elt[curr->elt_index[i] - 1]->val;
-	}
+	group_totals(glist_ret, earray);
 
 	return (glist_ret);
 }
@@ -1673,7 +1731,15 @@ Rxn_array* read_Rxn_array(FILE* datfile, int* line_number, int* n_read, Elt_arra
 	int n_tok, i;
 	char buf[1000];
 	enum { FMT_NONE, FMT_DFLT };
+	map<string,int> rate_index; // rate constant names (first of each), so that lookups don't walk the list
+	map<string,int>::iterator rate_it;
+	map<string,bool>::iterator func_it;
 
+	if (rates) {
+		for (elt = rates->list; elt != NULL; elt = elt->next) {
+			rate_index.insert(make_pair(string(elt->name), elt->index));
+		}
+	}
 	read_begin = FMT_NONE;
 
 	/* read data in block */
@@ -1750,7 +1816,8 @@ Rxn_array* read_Rxn_array(FILE* datfile, int* line_number, int* n_read, Elt_arra
 			}
 			// Determine rateLaw type
 			if (n_rateLaw_tokens == 1) {
-				if (is_func_map_p[tokens[n_tok]]) {
+				func_it = is_func_map_p.find(tokens[n_tok]);
+				if (func_it != is_func_map_p.end() && func_it->second) {
 					rateLaw_type = FUNCTIONAL;
 //					remove_zero = 0;
 				}
@@ -1814,8 +1881,8 @@ Rxn_array* read_Rxn_array(FILE* datfile, int* line_number, int* n_read, Elt_arra
 			for (i = 0; i < n_rateLaw_tokens; ++i) {
 				/* Lookup rate name */
 				if (rates) {
-					if ((elt = lookup_Elt(tokens[n_tok], rates->list))) {
-						rateLaw_indices[i] = elt->index;
+					if ((rate_it = rate_index.find(tokens[n_tok])) != rate_index.end()) {
+						rateLaw_indices[i] = rate_it->second;
 					}
 					else {
 						fprintf(stderr,
@@ -1834,27 +1901,6 @@ Rxn_array* read_Rxn_array(FILE* datfile, int* line_number, int* n_read, Elt_arra
 		new_elt = new_Rxn(index, n_reactants, n_products, r_index, p_index, rateLaw_type,
 				  	  	  n_rateLaw_tokens, rateLaw_indices, stat_factor, rates);
 
-		// Create rxn string
-//		new_elt->toString = "";
-		if (new_elt->n_reactants == 0) *new_elt->toString += "0";
-		else *new_elt->toString += (string)species->elt[new_elt->r_index[0]-1]->name;
-		for (int y=1;y < new_elt->n_reactants;y++){
-			*new_elt->toString += " + " + (string)species->elt[new_elt->r_index[y]-1]->name;
-		}
-		*new_elt->toString += " -> ";
-		if (new_elt->n_products == 0) *new_elt->toString += "0";
-		else *new_elt->toString += (string)species->elt[new_elt->p_index[0]-1]->name;
-		for (int y=1;y < new_elt->n_products;y++){
-			*new_elt->toString += " + " + (string)species->elt[new_elt->p_index[y]-1]->name;
-		}
-		*new_elt->toString += " ";
-		if (new_elt->stat_factor > 1.0){
-			*new_elt->toString += Util::toString(new_elt->stat_factor) + "*";
-		}
-		*new_elt->toString += (string)rates->elt[new_elt->rateLaw_indices[0]-1]->name;
-		*new_elt->toString += " (= " + Util::toString(new_elt->stat_factor*
-				rates->elt[new_elt->rateLaw_indices[0]-1]->val) + ")";
-
 		/* Add new reaction to list of reactions */
 		if (list_start) {
 			rxn->next = new_elt;
@@ -1901,6 +1947,35 @@ Rxn_array* read_Rxn_array(FILE* datfile, int* line_number, int* n_read, Elt_arra
 	return (rarray);
 }
 
+/* The reaction as text, for messages. It is built on first use, since building it for every reaction
+ * takes a large share of the time to read big networks. */
+static const string& rxn_string(Rxn* rxn) {
+	Elt_array* species = network.species;
+	Elt_array* rates = network.rates;
+
+	if (rxn->toString->empty()) {
+		if (rxn->n_reactants == 0) *rxn->toString += "0";
+		else *rxn->toString += (string)species->elt[rxn->r_index[0]-1]->name;
+		for (int y=1;y < rxn->n_reactants;y++){
+			*rxn->toString += " + " + (string)species->elt[rxn->r_index[y]-1]->name;
+		}
+		*rxn->toString += " -> ";
+		if (rxn->n_products == 0) *rxn->toString += "0";
+		else *rxn->toString += (string)species->elt[rxn->p_index[0]-1]->name;
+		for (int y=1;y < rxn->n_products;y++){
+			*rxn->toString += " + " + (string)species->elt[rxn->p_index[y]-1]->name;
+		}
+		*rxn->toString += " ";
+		if (rxn->stat_factor > 1.0){
+			*rxn->toString += Util::toString(rxn->stat_factor) + "*";
+		}
+		*rxn->toString += (string)rates->elt[rxn->rateLaw_indices[0]-1]->name;
+		*rxn->toString += " (= " + Util::toString(rxn->stat_factor*
+				rates->elt[rxn->rateLaw_indices[0]-1]->val) + ")";
+	}
+	return (*rxn->toString);
+}
+
 void print_Rxn_array(FILE* out, Rxn_array* reactions, Elt_array* species, Elt_array* rates) {
 	register int i;
 	Rxn* rxn;
@@ -1977,7 +2052,45 @@ void print_Rxn_text(FILE* out, Rxn* rxn, Elt_array* species, Elt_array* rates) {
 /* Compute network reaction rates and time derivatives of concentrations   */
 /*=========================================================================*/
 
-struct NETWORK network;
+/* Everything that loading and simulating a network changes is kept in a Network_state. network and
+ * the private states below (VAR_PARAMS, NATIVE, SPARSE_LS, ODE, BATCH, HYBRID, GSP and SSA_SEL) refer
+ * to the current state, so that several networks can be loaded side by side and switched between with
+ * set_state_network(). The current state is per thread, so that threads can each load a network into
+ * their own state and integrate it with CVODE at the same time. (The stochastic propagators still share
+ * the random number generator, and the output functions the binary trajectory writers.) */
+struct VAR_PARAMS_STATE;
+struct NATIVE_STATE;
+struct SPARSE_LS_STATE;
+struct ODE_STATE;
+struct BATCH_STATE;
+struct HYBRID_STATE;
+struct GSP_STATE;
+struct SSA_SEL_STATE;
+
+struct NETWORK_STATE {
+	NETWORK net;
+	VAR_PARAMS_STATE* var_params;
+	NATIVE_STATE* native;
+	SPARSE_LS_STATE* sparse_ls;
+	ODE_STATE* ode;
+	BATCH_STATE* batch;
+	HYBRID_STATE* hybrid;
+	GSP_STATE* gsp;
+	SSA_SEL_STATE* ssa_sel;
+	NETWORK_STATE(); // allocates the private states, see new_state_network()
+};
+
+/* The state of a program that never switches, which every thread starts out with */
+static Network_state MAIN_STATE;
+static __thread Network_state* STATE = &MAIN_STATE;
+__thread NETWORK* current_network = &MAIN_STATE.net;
+
+Network_state* set_state_network(Network_state* state) {
+	Network_state* previous = STATE;
+	STATE = state;
+	current_network = &state->net;
+	return (previous);
+}
 
 //Method modified to take into account variable rates that depend on global functions 
 void derivs_network(double t, double* conc, double* derivs);
@@ -2009,6 +2122,9 @@ int init_network(Rxn_array* reactions, Elt_array* rates, Elt_array* species, Gro
 		network.spec_groups_vec.push_back(group);
 	}
 
+	/* Lay out reactions contiguously for rate and derivative evaluation */
+	update_layout_network();
+
 	/* Set function for calculating time derivatives of species */
 	network.derivs = derivs_network;
 
@@ -2018,6 +2134,589 @@ int init_network(Rxn_array* reactions, Elt_array* rates, Elt_array* species, Gro
 	return (0);
 }
 
+/*
+ * Binary network cache. With a cache directory set, read_network() stores the species, reactions and
+ * groups it has parsed in a file named after a hash of the contents of the .net (and group) file, and later
+ * runs on the same input map that file instead of parsing the text. Parameters and functions are always
+ * read from the text: they are muParser expressions, which set_parameter_network() has to re-evaluate,
+ * and they are short. Initial amounts that are expressions are kept as text, for init_species_network().
+ * The file is in native byte order and is only meant to be reused on the same machine.
+ */
+#define NET_CACHE_VERSION 2
+static const char* NET_CACHE_DIR = NULL;
+
+struct Net_cache_header {
+	char magic[8];
+	int version;
+	int n_species, n_rxn, n_r_index, n_p_index, n_k_index, n_groups, n_group_elts, n_chars;
+	int pad;
+	unsigned long long key;
+};
+
+void set_net_cache_network(const char* dir) {
+	NET_CACHE_DIR = dir;
+}
+
+/* 64-bit FNV-1a hash, continuing from h */
+static unsigned long long fnv1a_hash(const char* data, size_t n, unsigned long long h) {
+	for (size_t i = 0; i < n; ++i) {
+		h ^= (unsigned char) data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+#define FNV1A_START 14695981039346656037ULL
+
+/* Maps the file name read-only. Returns NULL (and size 0) if it can't. */
+static char* map_file(const char* name, size_t* size) {
+	struct stat st;
+	void* data;
+	int fd;
+
+	*size = 0;
+	if ((fd = open(name, O_RDONLY)) < 0) return (NULL);
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return (NULL);
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return (NULL);
+	*size = st.st_size;
+	return ((char*) data);
+}
+
+static unsigned long long hash_file(const char* name, unsigned long long h) {
+	size_t size;
+	char* data = map_file(name, &size);
+	if (data) {
+		h = fnv1a_hash(data, size, h);
+		munmap(data, size);
+	}
+	return h;
+}
+
+/* Pointers into a mapped cache file */
+struct Net_cache {
+	char* data;
+	size_t size;
+	Net_cache_header* h;
+	double *sp_val, *rxn_stat_factor, *group_factor;
+	int *sp_index, *sp_fixed, *sp_name, *sp_expr;
+	int *rxn_index, *rxn_type, *r_start, *r_index, *p_start, *p_index, *k_start, *k_index;
+	int *group_index, *group_name, *group_start, *group_elt;
+	char* chars;
+};
+
+/* Sets the section pointers of cache from its header; returns the size the file should have */
+static size_t net_cache_layout(Net_cache& c, char* base) {
+	Net_cache_header& h = *(Net_cache_header*) base;
+	char* p = base + sizeof(Net_cache_header);
+	// Doubles first, so that everything is aligned
+	c.sp_val = (double*) p;				p += h.n_species * sizeof(double);
+	c.rxn_stat_factor = (double*) p;	p += h.n_rxn * sizeof(double);
+	c.group_factor = (double*) p;		p += h.n_group_elts * sizeof(double);
+	c.sp_index = (int*) p;				p += h.n_species * sizeof(int);
+	c.sp_fixed = (int*) p;				p += h.n_species * sizeof(int);
+	c.sp_name = (int*) p;				p += h.n_species * sizeof(int);
+	c.sp_expr = (int*) p;				p += h.n_species * sizeof(int);
+	c.rxn_index = (int*) p;				p += h.n_rxn * sizeof(int);
+	c.rxn_type = (int*) p;				p += h.n_rxn * sizeof(int);
+	c.r_start = (int*) p;				p += (h.n_rxn + 1) * sizeof(int);
+	c.r_index = (int*) p;				p += h.n_r_index * sizeof(int);
+	c.p_start = (int*) p;				p += (h.n_rxn + 1) * sizeof(int);
+	c.p_index = (int*) p;				p += h.n_p_index * sizeof(int);
+	c.k_start = (int*) p;				p += (h.n_rxn + 1) * sizeof(int);
+	c.k_index = (int*) p;				p += h.n_k_index * sizeof(int);
+	c.group_index = (int*) p;			p += h.n_groups * sizeof(int);
+	c.group_name = (int*) p;			p += h.n_groups * sizeof(int);
+	c.group_start = (int*) p;			p += (h.n_groups + 1) * sizeof(int);
+	c.group_elt = (int*) p;				p += h.n_group_elts * sizeof(int);
+	c.chars = p;						p += h.n_chars;
+	return (p - base);
+}
+
+/* Maps the cache file name if it is a valid cache for key */
+static int open_net_cache(Net_cache& c, const char* name, unsigned long long key) {
+	c.data = map_file(name, &c.size);
+	if (!c.data) return (0);
+	c.h = (Net_cache_header*) c.data;
+	if (c.size < sizeof(Net_cache_header) || strncmp(c.h->magic, "N3NETC", 8) != 0
+			|| c.h->version != NET_CACHE_VERSION || c.h->key != key || net_cache_layout(c, c.data) != c.size) {
+		fprintf(stderr, "Warning: Ignoring invalid network cache %s.\n", name);
+		munmap(c.data, c.size);
+		c.data = NULL;
+		return (0);
+	}
+	return (1);
+}
+
+static Elt_array* species_from_cache(Net_cache& c) {
+	Elt *list_start = NULL, *list_end = NULL;
+	int n_fixed = 0;
+
+	for (int i = 0; i < c.h->n_species; ++i) {
+		Elt* new_elt = new_Elt(c.chars + c.sp_name[i], c.sp_val[i], c.sp_index[i]);
+		new_elt->fixed = c.sp_fixed[i];
+		if (c.sp_expr[i] >= 0) network.species_exprs[c.sp_index[i]] = c.chars + c.sp_expr[i];
+		if (new_elt->fixed) {
+			printf("%s is a fixed (boundaryCondition) variable\n", new_elt->name);
+			++n_fixed;
+		}
+		if (list_start) list_end->next = new_elt;
+		else list_start = new_elt;
+		list_end = new_elt;
+	}
+	return (list_start ? finish_Elt_array(list_start, n_fixed) : NULL);
+}
+
+static Group* groups_from_cache(Net_cache& c, Elt_array* species) {
+	Group* glist = NULL;
+	for (int g = 0; g < c.h->n_groups; ++g) {
+		int start = c.group_start[g];
+		glist = add_Group(glist, c.chars + c.group_name[g], c.group_index[g], c.group_start[g+1] - start,
+				c.group_elt + start, c.group_factor + start);
+	}
+	group_totals(glist, species);
+	return (glist);
+}
+
+static Rxn_array* reactions_from_cache(Net_cache& c, Elt_array* rates) {
+	Rxn *list_start = NULL, *list_end = NULL;
+	for (int r = 0; r < c.h->n_rxn; ++r) {
+		Rxn* new_elt = new_Rxn(c.rxn_index[r], c.r_start[r+1] - c.r_start[r], c.p_start[r+1] - c.p_start[r],
+				c.r_index + c.r_start[r], c.p_index + c.p_start[r], c.rxn_type[r], c.k_start[r+1] - c.k_start[r],
+				c.k_index + c.k_start[r], c.rxn_stat_factor[r], rates);
+		if (list_start) list_end->next = new_elt;
+		else list_start = new_elt;
+		list_end = new_elt;
+	}
+	return (list_start ? new_Rxn_array(list_start) : NULL);
+}
+
+/* Writes what read_network() has parsed to the cache file name. The file is written under a temporary
+ * name and renamed, so that concurrent runs never map a partial cache. */
+static void write_net_cache(const char* name, unsigned long long key, Elt_array* species, Group* groups,
+		Rxn_array* reactions) {
+	Net_cache_header h;
+	Net_cache c;
+	vector<char> buf;
+	char tmp_name[1024];
+	FILE* out;
+	Group* grp;
+	Rxn* rxn;
+	Elt* elt;
+	int i, n;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "N3NETC", 6);
+	h.version = NET_CACHE_VERSION;
+	h.key = key;
+	map<int, string>::const_iterator expr;
+	for (elt = species ? species->list : NULL; elt != NULL; elt = elt->next) {
+		++h.n_species;
+		h.n_chars += strlen(elt->name) + 1;
+		if ((expr = network.species_exprs.find(elt->index)) != network.species_exprs.end()) {
+			h.n_chars += expr->second.size() + 1;
+		}
+	}
+	for (rxn = reactions ? reactions->list : NULL; rxn != NULL; rxn = rxn->next) {
+		++h.n_rxn;
+		h.n_r_index += rxn->n_reactants;
+		h.n_p_index += rxn->n_products;
+		h.n_k_index += rxn->n_rateLaw_params;
+	}
+	for (grp = groups; grp != NULL; grp = grp->next) {
+		++h.n_groups;
+		h.n_group_elts += grp->n_elt;
+		h.n_chars += strlen(grp->name) + 1;
+	}
+
+	buf.resize(sizeof(h) + 8 * (h.n_species + h.n_rxn + h.n_group_elts) + 4 * (4 * h.n_species + 5 * h.n_rxn + 3
+			+ h.n_r_index + h.n_p_index + h.n_k_index + 3 * h.n_groups + 1 + h.n_group_elts) + h.n_chars);
+	memcpy(&buf[0], &h, sizeof(h));
+	if (net_cache_layout(c, &buf[0]) != buf.size()) {
+		fprintf(stderr, "Warning: Network cache layout mismatch; not writing %s.\n", name);
+		return;
+	}
+
+	char* chars = c.chars;
+	for (i = 0, elt = species ? species->list : NULL; elt != NULL; elt = elt->next, ++i) {
+		c.sp_val[i] = elt->val;
+		c.sp_index[i] = elt->index;
+		c.sp_fixed[i] = elt->fixed;
+		c.sp_name[i] = chars - c.chars;
+		strcpy(chars, elt->name);
+		chars += strlen(elt->name) + 1;
+		c.sp_expr[i] = -1;
+		if ((expr = network.species_exprs.find(elt->index)) != network.species_exprs.end()) {
+			c.sp_expr[i] = chars - c.chars;
+			strcpy(chars, expr->second.c_str());
+			chars += expr->second.size() + 1;
+		}
+	}
+	c.r_start[0] = c.p_start[0] = c.k_start[0] = 0;
+	for (i = 0, rxn = reactions ? reactions->list : NULL; rxn != NULL; rxn = rxn->next, ++i) {
+		c.rxn_index[i] = rxn->index;
+		c.rxn_type[i] = rxn->rateLaw_type;
+		c.rxn_stat_factor[i] = rxn->stat_factor;
+		for (n = 0; n < rxn->n_reactants; ++n) c.r_index[c.r_start[i] + n] = rxn->r_index[n];
+		for (n = 0; n < rxn->n_products; ++n) c.p_index[c.p_start[i] + n] = rxn->p_index[n];
+		for (n = 0; n < rxn->n_rateLaw_params; ++n) c.k_index[c.k_start[i] + n] = rxn->rateLaw_indices[n];
+		c.r_start[i+1] = c.r_start[i] + rxn->n_reactants;
+		c.p_start[i+1] = c.p_start[i] + rxn->n_products;
+		c.k_start[i+1] = c.k_start[i] + rxn->n_rateLaw_params;
+	}
+	c.group_start[0] = 0;
+	for (i = 0, grp = groups; grp != NULL; grp = grp->next, ++i) {
+		c.group_index[i] = grp->index;
+		c.group_name[i] = chars - c.chars;
+		strcpy(chars, grp->name);
+		chars += strlen(grp->name) + 1;
+		for (n = 0; n < grp->n_elt; ++n) {
+			c.group_elt[c.group_start[i] + n] = grp->elt_index[n];
+			c.group_factor[c.group_start[i] + n] = grp->elt_factor[n];
+		}
+		c.group_start[i+1] = c.group_start[i] + grp->n_elt;
+	}
+
+	if (snprintf(tmp_name, sizeof(tmp_name), "%s.%d", name, (int) getpid()) >= (int) sizeof(tmp_name)) {
+		fprintf(stderr, "Warning: Couldn't write network cache %s.\n", name);
+		return;
+	}
+	bool ok = ((out = fopen(tmp_name, "wb")) != NULL && fwrite(&buf[0], 1, buf.size(), out) == buf.size());
+	if (out && fclose(out) != 0) ok = false;
+	if (!ok || rename(tmp_name, name) != 0) {
+		fprintf(stderr, "Warning: Couldn't write network cache %s.\n", name);
+		remove(tmp_name);
+		return;
+	}
+	fprintf(stdout, "Wrote network cache %s\n", name);
+}
+
+/* Reads a .net file into the current state and initializes the network from it. Groups are read from
+ * group_file_name, if given (BNG writes them into the .net file itself). The time() function of the
+ * network reads *t. Sets param_map to the addresses of the values of all parameters, functions and groups
+ * by name, for parsing expressions such as stopping conditions. Returns 0, or 1 if a file can't be read
+ * or has errors, which have then been reported. After an error, the state holds what was read and is
+ * only good for free_state_network(). */
+int read_network(const char* netfile_name, const char* group_file_name, bool remove_zero, double* t,
+		map<string,double*>& param_map) {
+	FILE *netfile, *group_file;
+	int net_line_number, group_line_number, n_read;
+	Elt_array *species = NULL, *rates;
+	Group *spec_groups = NULL;
+	Rxn_array *reactions;
+	Net_cache cache;
+	char cache_name[1024];
+	unsigned long long cache_key = 0;
+	map<string, int> observ_index_map, param_index_map;
+	int n_func;
+	string name(netfile_name);
+
+	cache.data = NULL;
+	cache_name[0] = '\0';
+
+	// Find NET file
+	if (!(netfile = fopen(netfile_name, "r"))) {
+		fprintf(stderr, "ERROR: Couldn't open file %s.\n", netfile_name);
+		return (1);
+	}
+
+	/* Rate constants and concentration parameters should now be placed in the parameters block. */
+	net_line_number = 0;
+	rates = read_Elt_array(netfile, &net_line_number, (char*)"parameters", &n_read, 0x0);
+	if (n_read < 0) goto error;
+	fprintf(stdout, "Read %d parameters\n", n_read);
+	rewind(netfile);
+	net_line_number = 0;
+
+	/* Look for a cache of the species, reactions and groups */
+	if (NET_CACHE_DIR) {
+		cache_key = hash_file(netfile_name, FNV1A_START);
+		if (group_file_name) cache_key = hash_file(group_file_name, cache_key);
+		if (snprintf(cache_name, sizeof(cache_name), "%s/net_%016llx.n3c", NET_CACHE_DIR, cache_key)
+				>= (int) sizeof(cache_name)) {
+			fprintf(stderr, "Warning: Network cache directory name %s is too long; not caching.\n", NET_CACHE_DIR);
+			cache_name[0] = '\0';
+		}
+		else if (open_net_cache(cache, cache_name, cache_key)) fprintf(stdout, "Using network cache %s\n", cache_name);
+	}
+
+	/* Read species */
+	if (cache.data) {
+		species = species_from_cache(cache);
+		n_read = cache.h->n_species;
+	}
+	else {
+		species = read_Elt_array(netfile, &net_line_number, (char*)"species", &n_read, rates);
+	}
+	if (!species){
+		fprintf(stderr,"ERROR: Couldn't read species array.\n");
+		goto error;
+	}
+	fprintf(stdout, "Read %d species\n", n_read);
+
+	/* Read optional groups */
+	if (group_file_name && cache.data){
+		spec_groups = groups_from_cache(cache, species);
+		fprintf(stdout, "Read %d group(s) from %s\n", cache.h->n_groups, group_file_name);
+	}
+	else if (group_file_name){
+		if (!(group_file = fopen(group_file_name, "r"))) {
+			fprintf(stderr, "ERROR: Couldn't open file %s.\n", group_file_name);
+			goto error;
+		}
+		group_line_number = 0;
+		spec_groups = read_Groups(0x0, group_file, species, &group_line_number, (char*)"groups", &n_read);
+		fclose(group_file);
+		if (n_read < 0) goto error;
+		fprintf(stdout, "Read %d group(s) from %s\n", n_read, group_file_name);
+	}
+
+	/** Ilya Korsunsky 6/2/10: Global Functions */
+	param_map = init_param_map(rates,spec_groups);
+	observ_index_map = init_observ_index_map(spec_groups);
+	param_index_map = init_param_index_map(rates);
+
+	if (read_functions_array(netfile_name,rates,param_map,param_index_map,observ_index_map,t) != 0) goto error;
+	n_func = network.functions.size();
+	if (n_func > 0) n_func--; // Subtract off 'time' function
+	cout << "Read " << n_func << " function(s)" << endl;
+	if (!rates){ // Error if the 'rates' array doesn't exist (means 0 parameters, 0 functions)
+		fprintf(stderr,"ERROR: Reaction network must have parameters and/or functions defined to be used as rate laws.\n");
+		goto error;
+	}
+
+	/* Read reactions */
+	if (cache.data) {
+		reactions = reactions_from_cache(cache, rates);
+		n_read = cache.h->n_rxn;
+		munmap(cache.data, cache.size);
+		cache.data = NULL;
+	}
+	else {
+		reactions = read_Rxn_array(netfile,&net_line_number,&n_read,species,rates,network.is_func_map);
+		if (reactions && cache_name[0]) write_net_cache(cache_name, cache_key, species, spec_groups, reactions);
+	}
+	if (!reactions){
+		fprintf(stderr, "ERROR: No reactions in the network.\n");
+		goto error;
+	}
+	fprintf(stdout, "Read %d reaction(s)\n", n_read);
+	if (remove_zero) {
+		remove_zero_rate_rxns(&reactions, rates);
+		int n_rxn = 0;
+		if (reactions){
+			n_rxn = reactions->n_rxn;
+		}
+		fprintf(stdout, "%d reaction(s) have nonzero rate\n", n_rxn);
+	}
+	else{
+		fprintf(stdout, "nonzero rate reactions were not removed\n");
+	}
+	fclose(netfile);
+
+	/* Initialize reaction network */
+	if (name.size() > 4 && name.substr(name.size()-4) == ".net") name.erase(name.size()-4);
+	init_network(reactions, rates, species, spec_groups, (char*)name.c_str());
+
+	return (0);
+
+	error:
+	// Leave what was read to the state, which free_state_network() frees
+	if (cache.data) munmap(cache.data, cache.size);
+	fclose(netfile);
+	network.rates = rates;
+	network.species = species;
+	network.spec_groups = spec_groups;
+	network.has_functions = (network.functions.size() > 0);
+	return (1);
+}
+
+/* The groups and functions that derivs_network() has to refresh before computing rates. Only the
+ * functions whose parameters appear in a rate law, directly or through other functions, are needed,
+ * and only the groups that those functions read. The groups are stored as the rows of a sparse
+ * matrix over the species, so that their totals are one matrix-vector product. */
+struct VAR_PARAMS_STATE {
+	vector<Group*> groups;
+	vector<int> g_start;     // rows of the matrix, one per group in groups
+	vector<int> g_index;     // species indices (0-based)
+	vector<double> g_factor;
+	vector<int> functions;   // indices into network.functions, in increasing order
+};
+#define VAR_PARAMS (*STATE->var_params)
+
+static void update_var_param_layout() {
+	int n_func = (int)network.functions.size();
+	int n_rates = network.rates ? network.rates->n_elt : 0;
+	vector<int> func_of_param(n_rates+1,-1);
+	vector<char> needed(n_func,0), group_needed(network.spec_groups_vec.size(),0);
+	vector<int> stack;
+	int i, j;
+
+	for (j = 0; j < n_func; ++j) func_of_param[network.var_parameters[j]] = j;
+	// Functions that set rate law parameters
+	for (i = 0; i < n_rxns_network(); ++i) {
+		Rxn* rxn = network.reactions->rxn[i];
+		if (!rxn) continue;
+		for (j = 0; j < rxn->n_rateLaw_params; ++j) {
+			int f = func_of_param[rxn->rateLaw_indices[j]];
+			if (f >= 0 && !needed[f]) { needed[f] = 1; stack.push_back(f); }
+		}
+	}
+	// and the functions that they read
+	while (!stack.empty()) {
+		int f = stack.back();
+		stack.pop_back();
+		for (j = 0; j < (int)network.func_param_depend[f].size(); ++j) {
+			int g = func_of_param[network.func_param_depend[f][j]];
+			if (g >= 0 && !needed[g]) { needed[g] = 1; stack.push_back(g); }
+		}
+	}
+	// Functions are still evaluated in the order of the .net file, so that a function that reads
+	// another one sees the same value as when all functions are evaluated
+	VAR_PARAMS.functions.clear();
+	for (j = 0; j < n_func; ++j) {
+		if (!needed[j]) continue;
+		VAR_PARAMS.functions.push_back(j);
+		for (i = 0; i < (int)network.func_observ_depend[j].size(); ++i) {
+			group_needed[network.func_observ_depend[j][i]-1] = 1;
+		}
+	}
+	VAR_PARAMS.groups.clear();
+	VAR_PARAMS.g_start.assign(1,0);
+	VAR_PARAMS.g_index.clear();
+	VAR_PARAMS.g_factor.clear();
+	for (i = 0; i < (int)network.spec_groups_vec.size(); ++i) {
+		Group* group = network.spec_groups_vec[i];
+		if (!group_needed[i]) continue;
+		VAR_PARAMS.groups.push_back(group);
+		for (j = 0; j < group->n_elt; ++j) {
+			VAR_PARAMS.g_index.push_back(group->elt_index[j]-1);
+			VAR_PARAMS.g_factor.push_back(group->elt_factor[j]);
+		}
+		VAR_PARAMS.g_start.push_back((int)VAR_PARAMS.g_index.size());
+	}
+}
+
+static void free_layout(Rxn_layout* L) {
+	if (L->r_start) {
+		free(L->r_start); free(L->r_index);
+		free(L->p_start); free(L->p_index);
+		free(L->k_start); free(L->k);
+		free(L->rateLaw_type); free(L->rate_param); free(L->stat_factor);
+	}
+	if (L->fixed) free(L->fixed);
+	if (L->rate) {
+		free(L->elem0_rxn); free(L->elem0_k);
+		free(L->elem1_rxn); free(L->elem1_k); free(L->elem1_x);
+		free(L->elem2_rxn); free(L->elem2_k); free(L->elem2_x1); free(L->elem2_x2);
+		free(L->other_rxn); free(L->rate);
+	}
+}
+
+/* (Re)builds network.layout from network.reactions and network.species. Must be called whenever
+ * reactions or species are added. */
+void update_layout_network() {
+	Rxn_layout* L = &network.layout;
+	int i, j, n_r = 0, n_p = 0, n_k = 0;
+	Rxn* rxn;
+
+	free_layout(L);
+
+	L->n_rxn = n_rxns_network();
+	for (i = 0; i < L->n_rxn; ++i) {
+		if (!(rxn = network.reactions->rxn[i])) continue;
+		n_r += rxn->n_reactants;
+		n_p += rxn->n_products;
+		n_k += rxn->n_rateLaw_params;
+	}
+	L->r_start = IALLOC_VECTOR(L->n_rxn+1);
+	L->r_index = IALLOC_VECTOR(n_r+1);
+	L->p_start = IALLOC_VECTOR(L->n_rxn+1);
+	L->p_index = IALLOC_VECTOR(n_p+1);
+	L->k_start = IALLOC_VECTOR(L->n_rxn+1);
+	L->k = ALLOC_VECTOR(n_k+1);
+	L->rateLaw_type = IALLOC_VECTOR(L->n_rxn+1);
+	L->rate_param = IALLOC_VECTOR(L->n_rxn+1);
+	L->stat_factor = ALLOC_VECTOR(L->n_rxn+1);
+
+	n_r = n_p = n_k = 0;
+	for (i = 0; i < L->n_rxn; ++i) {
+		L->r_start[i] = n_r;
+		L->p_start[i] = n_p;
+		L->k_start[i] = n_k;
+		L->rateLaw_type[i] = -1;
+		L->rate_param[i] = -1;
+		L->stat_factor[i] = 0.0;
+		if (!(rxn = network.reactions->rxn[i])) continue;
+		for (j = 0; j < rxn->n_reactants; ++j) L->r_index[n_r++] = rxn->r_index[j];
+		for (j = 0; j < rxn->n_products; ++j) L->p_index[n_p++] = rxn->p_index[j];
+		for (j = 0; j < rxn->n_rateLaw_params; ++j) L->k[n_k++] = rxn->rateLaw_params[j];
+		L->rateLaw_type[i] = rxn->rateLaw_type;
+		if (rxn->rateLaw_type == FUNCTIONAL) L->rate_param[i] = rxn->rateLaw_indices[0]-1;
+		L->stat_factor[i] = rxn->stat_factor;
+	}
+	L->r_start[L->n_rxn] = n_r;
+	L->p_start[L->n_rxn] = n_p;
+	L->k_start[L->n_rxn] = n_k;
+
+	L->n_species = n_species_network();
+	L->fixed = (char*) calloc(L->n_species+1, sizeof(char));
+	for (i = 0; i < L->n_species; ++i) {
+		L->fixed[i] = (network.species->elt[i]->fixed ? 1 : 0);
+	}
+
+	/* Group reactions by rate law and order for derivs_network() */
+	L->elem0_rxn = IALLOC_VECTOR(L->n_rxn+1);
+	L->elem0_k = ALLOC_VECTOR(L->n_rxn+1);
+	L->elem1_rxn = IALLOC_VECTOR(L->n_rxn+1);
+	L->elem1_k = ALLOC_VECTOR(L->n_rxn+1);
+	L->elem1_x = IALLOC_VECTOR(L->n_rxn+1);
+	L->elem2_rxn = IALLOC_VECTOR(L->n_rxn+1);
+	L->elem2_k = ALLOC_VECTOR(L->n_rxn+1);
+	L->elem2_x1 = IALLOC_VECTOR(L->n_rxn+1);
+	L->elem2_x2 = IALLOC_VECTOR(L->n_rxn+1);
+	L->other_rxn = IALLOC_VECTOR(L->n_rxn+1);
+	L->rate = ALLOC_VECTOR(L->n_rxn+1);
+	L->n_elem0 = L->n_elem1 = L->n_elem2 = L->n_other = 0;
+	for (i = 0; i < L->n_rxn; ++i) {
+		int n_reactants = L->r_start[i+1] - L->r_start[i];
+		int* r = L->r_index + L->r_start[i];
+		double k;
+		L->rate[i] = 0.0;
+		if (L->rateLaw_type[i] != ELEMENTARY) continue;
+		// stat_factor*k is the first product rxn_rate() forms, so this does not change any rates
+		k = L->stat_factor[i] * L->k[L->k_start[i]];
+		if (n_reactants == 0) {
+			L->elem0_rxn[L->n_elem0] = i;
+			L->elem0_k[L->n_elem0++] = k;
+		}
+		else if (n_reactants == 1) {
+			L->elem1_rxn[L->n_elem1] = i;
+			L->elem1_k[L->n_elem1] = k;
+			L->elem1_x[L->n_elem1++] = r[0];
+		}
+		else if (n_reactants == 2) {
+			L->elem2_rxn[L->n_elem2] = i;
+			L->elem2_k[L->n_elem2] = k;
+			L->elem2_x1[L->n_elem2] = r[0];
+			L->elem2_x2[L->n_elem2++] = r[1];
+		}
+	}
+	for (int type = ELEMENTARY; type <= FUNCTIONAL; ++type) {
+		for (i = 0; i < L->n_rxn; ++i) {
+			int n_reactants = L->r_start[i+1] - L->r_start[i];
+			if (L->rateLaw_type[i] != type) continue;
+			if (type == ELEMENTARY && n_reactants <= 2) continue;
+			L->other_rxn[L->n_other++] = i;
+		}
+	}
+
+	update_var_param_layout();
+}
+
 int n_rate_calls_network() { return (network.n_rate_calls); }
 
 int n_deriv_calls_network() { return (network.n_deriv_calls); }
@@ -2093,35 +2792,37 @@ int set_conc_network(double* conc) {
 	return (error);
 }
 
-/* Return the rate of rxn -- for internal use only */
-static double rxn_rate(Rxn* rxn, double* X, int discrete) {
+/* Return the rate of reaction irxn (base 0) -- for internal use only */
+static double rxn_rate(int irxn, double* X, int discrete) {
+	const Rxn_layout& L = network.layout;
 	double rate;
 	int *iarr, *index;
 	int ig, /*i1, i2,*/n_denom;
 	int q;
 	double *param, x, xn, kn;
 	double St, Et, kcat, Km, S, b;
+	int n_reactants = L.r_start[irxn+1] - L.r_start[irxn];
 
 	/* Don't calculate rate of null reactions */
-	if (!rxn)
+	if (L.rateLaw_type[irxn] < 0)
 		return (0.0);
 
 	++network.n_rate_calls;
 
-	switch (rxn->rateLaw_type) {
+	iarr = L.r_index + L.r_start[irxn];
+	param = L.k + L.k_start[irxn];
+
+	switch (L.rateLaw_type[irxn]) {
 
 	case ELEMENTARY:
 		// v= k1*X1...Xn
-		rate = rxn->stat_factor * rxn->rateLaw_params[0];
-		iarr = rxn->r_index;
+		rate = L.stat_factor[irxn] * param[0];
 		// Handle reactions with discrete molecules with multiple copies of the same reactants.
 		// NOTE: Will only apply correct formula if repeated species are grouped together (which is done
 		//       automatically by BNG).
 		if (discrete) {
 			double n = 0.0;
-			//rate*= X[*iarr]; // NOTE: This assumes at least one reactant species (no zeroth-order rxns)
-			//for (index=iarr+1; index<iarr+rxn->n_reactants; ++index){
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
+			for (index = iarr; index < iarr + n_reactants; ++index) {
 				if (index > iarr) {
 					if (*index == *(index-1)) {
 						n += 1.0;
@@ -2134,7 +2835,7 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 		}
 		// Continuous case
 		else {
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
+			for (index = iarr; index < iarr + n_reactants; ++index) {
 				rate *= X[*index];
 			}
 		}
@@ -2142,30 +2843,28 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 
 	case MICHAELIS_MENTEN:
 		/* Second rate, if present, is Michaelis-Menten Km */
-		St = X[rxn->r_index[0]];
-		kcat = rxn->rateLaw_params[0];
-		Km = rxn->rateLaw_params[1];
+		St = X[iarr[0]];
+		kcat = param[0];
+		Km = param[1];
 		/* S + E + ... -> P + E + .. */
-		for (q = 1, Et = 0; q < rxn->n_reactants; ++q) {
-			Et += X[rxn->r_index[q]];
+		for (q = 1, Et = 0; q < n_reactants; ++q) {
+			Et += X[iarr[q]];
 		}
 		b = St - Km - Et;
 		S = 0.5 * (b + sqrt(b * b + 4.0 * St * Km));
-		rate = rxn->stat_factor * kcat * Et * S / (Km + S);
+		rate = L.stat_factor[irxn] * kcat * Et * S / (Km + S);
 		break;
 
 	case SATURATION:
-		param = rxn->rateLaw_params;
 		/* if dim(param)==1
 		 rate= stat_factor*param[0], a zeroth order rate law
 		 else
 		 rate = stat_factor*param[0]*R1...Rn/((R1+param[1])*(R2+param[2])...
 		 where terms in denominator are only calculated if param[n] is defined
 		 */
-		rate = rxn->stat_factor * param[0];
-		iarr = rxn->r_index;
+		rate = L.stat_factor[irxn] * param[0];
+		n_denom = L.k_start[irxn+1] - L.k_start[irxn] - 1;
 		++param;
-		n_denom = rxn->n_rateLaw_params - 1;
 		if (n_denom > 0) {
 			// Handle reactions with discrete molecules with multiple copies of the same reactants.
 			// NOTE: Will only apply correct formula if repeated species are grouped together (which is done
@@ -2186,7 +2885,7 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 					rate *= (x - n) / (param[ig] + x);
 				}
 				/* Compute contributions to rate from species appearing only in numerator */
-				for (ig = n_denom; ig < rxn->n_reactants; ++ig) {
+				for (ig = n_denom; ig < n_reactants; ++ig) {
 					if (iarr[ig] == iarr[ig - 1]) {
 						n += 1.0;
 					} else {
@@ -2204,7 +2903,7 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 				}
 
 				/* Compute contributions to rate from species appearing only in numerator */
-				for (ig = n_denom; ig < rxn->n_reactants; ++ig) {
+				for (ig = n_denom; ig < n_reactants; ++ig) {
 					rate *= X[iarr[ig]];
 				}
 			}
@@ -2212,19 +2911,17 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 		break;
 
 	case HILL:
-		param = rxn->rateLaw_params;
-		iarr = rxn->r_index;
 		x = X[iarr[0]];
 		xn = pow(x, param[2]);
 		kn = pow(param[1], param[2]);
-		rate = rxn->stat_factor * param[0] * xn / (kn + xn);
+		rate = L.stat_factor[irxn] * param[0] * xn / (kn + xn);
 		// Handle reactions with discrete molecules with multiple copies of the same reactants.
 		// NOTE: Will only apply correct formula if repeated species are grouped together (which is done
 		//       automatically by BNG).
 		if (discrete) {
 			double n = 0.0;
 			/* Compute contributions to rate from species appearing only in numerator */
-			for (ig = 1; ig < rxn->n_reactants; ++ig) {
+			for (ig = 1; ig < n_reactants; ++ig) {
 				if (iarr[ig] == iarr[ig-1]) {
 					n += 1.0;
 				} else {
@@ -2236,7 +2933,7 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 		// Continuous case
 		else {
 			/* Compute contributions to rate from species appearing only in numerator */
-			for (ig = 1; ig < rxn->n_reactants; ++ig) {
+			for (ig = 1; ig < n_reactants; ++ig) {
 				rate *= X[iarr[ig]];
 			}
 		}
@@ -2244,16 +2941,14 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 
 	case FUNCTIONAL:
 		// v= k1*X1...Xn
-		rate = rxn->stat_factor*network.rates->elt[rxn->rateLaw_indices[0]-1]->val;
-//		rate = rxn->stat_factor*rxn->rateLaw_params[0];
-		iarr = rxn->r_index;
+		rate = L.stat_factor[irxn]*network.rates->elt[L.rate_param[irxn]]->val;
 		// Handle reactions with discrete molecules with multiple copies of the same reactants.
 		// NOTE: Will only apply correct formula if repeated species are grouped together (which is done
 		//       automatically by BNG).
-		if (discrete && rxn->n_reactants) { // Make sure the rxn has reactants (not pure synth)
+		if (discrete && n_reactants) { // Make sure the rxn has reactants (not pure synth)
 			double n = 0.0;
 			rate *= X[*iarr];
-			for (index = iarr + 1; index < iarr + rxn->n_reactants; ++index) {
+			for (index = iarr + 1; index < iarr + n_reactants; ++index) {
 				if (*index == *(index-1)) {
 					n += 1.0;
 				} else {
@@ -2264,7 +2959,7 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 		}
 		// Continuous case
 		else {
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
+			for (index = iarr; index < iarr + n_reactants; ++index) {
 				rate *= X[*index];
 			}
 		}
@@ -2273,9 +2968,10 @@ static double rxn_rate(Rxn* rxn, double* X, int discrete) {
 
 	// Exit if running SSA and negative rate detected
 	if (discrete && rate < 0.0){
+		Rxn* rxn = network.reactions->rxn[irxn];
 		cout << "Error: Negative rate detected in rxn_rate() (rate = " << rate << "). Exiting." << endl;
 		// Print rxn string
-		cout << "R" << rxn->index << ": " << *rxn->toString;
+		cout << "R" << rxn->index << ": " << rxn_string(rxn);
 		if (rxn->rateLaw_type == ELEMENTARY) cout << " (ELEMENTARY)" << endl;
 		else if (rxn->rateLaw_type == MICHAELIS_MENTEN) cout << " (MICHAELIS_MENTEN)" << endl;
 		else if (rxn->rateLaw_type == SATURATION) cout << " (SATURATION)" << endl;
@@ -2300,7 +2996,6 @@ int rxn_rates_network(double* rxn_rates, int discrete) {
 
 	register int i;
 	int error = 0, n_reactions, n_species;
-	Rxn** rarray;
 	double *X;
 //	double *conc = NULL;
 
@@ -2316,11 +3011,10 @@ int rxn_rates_network(double* rxn_rates, int discrete) {
 	}
 	INIT_VECTOR(rxn_rates, 0.0, n_reactions);
 
-	rarray = network.reactions->rxn;
 	X = conc - network.species->offset;
 
 	for (i = 0; i < n_reactions; ++i) {
-		rxn_rates[i] = rxn_rate(rarray[i], X, discrete);
+		rxn_rates[i] = rxn_rate(i, X, discrete);
 	}
 /*
 cout << "\n__before FREE_VECTOR(conc)__" << endl;
@@ -2346,14 +3040,70 @@ for (int j=network.rates->n_elt-1;j >=0 ;j--){
 	return (error);
 }
 
+/* Update the groups and the rate parameters given by functions that reaction rates depend on, for the
+ * concentrations conc. Groups and functions that are only output are left alone (see VAR_PARAMS). */
+static void update_var_parameters(double* conc) {
+	if (VAR_PARAMS.functions.empty()) return;
+	// update groups (only those that inform variables parameters)
+	const int* start = &VAR_PARAMS.g_start[0];
+	const int* index = VAR_PARAMS.g_index.empty() ? NULL : &VAR_PARAMS.g_index[0];
+	const double* factor = VAR_PARAMS.g_factor.empty() ? NULL : &VAR_PARAMS.g_factor[0];
+	for (unsigned int g = 0; g < VAR_PARAMS.groups.size(); g++) {
+		double total = 0;
+		for (int e = start[g]; e < start[g+1]; e++) total += factor[e] * conc[index[e]];
+		VAR_PARAMS.groups[g]->total_val = total;
+	}
+	// update variable rate parameters
+	for (unsigned int f = 0; f < VAR_PARAMS.functions.size(); f++) {
+		int j = VAR_PARAMS.functions[f];
+		network.rates->elt[network.var_parameters[j]-1]->val = network.functions[j].Eval();
+	}
+}
+
+/* Update all groups and all functions for the concentrations conc, for stopping conditions that
+ * may read any of them */
+static void update_all_var_parameters(double* conc) {
+	for (Group* curr = network.spec_groups; curr != NULL; curr = curr->next) {
+		curr->total_val = 0;
+		for (int i = 0; i < curr->n_elt; i++)
+			curr->total_val += curr->elt_factor[i] * conc[curr->elt_index[i]-1];
+	}
+	for (unsigned int j=0;j < network.var_parameters.size();j++) {
+		network.rates->elt[network.var_parameters[j]-1]->val = network.functions[j].Eval();
+	}
+}
+
+/* Compute the (continuous) rates of all reactions into network.layout.rate, one group of reactions with the
+ * same rate law at a time, so that the loops over elementary reactions are free of branches. Rates that
+ * depend on functions must have been updated with update_var_parameters(). */
+static double* layout_rates(double* conc) {
+	const Rxn_layout& L = network.layout;
+	double* R = L.rate;
+	double* X = conc - network.species->offset;
+	int i;
+
+	for (i = 0; i < L.n_elem0; ++i) {
+		R[L.elem0_rxn[i]] = L.elem0_k[i];
+	}
+	for (i = 0; i < L.n_elem1; ++i) {
+		R[L.elem1_rxn[i]] = L.elem1_k[i] * X[L.elem1_x[i]];
+	}
+	for (i = 0; i < L.n_elem2; ++i) {
+		R[L.elem2_rxn[i]] = L.elem2_k[i] * X[L.elem2_x1[i]] * X[L.elem2_x2[i]];
+	}
+	network.n_rate_calls += L.n_elem0 + L.n_elem1 + L.n_elem2;
+	for (i = 0; i < L.n_other; ++i) {
+		R[L.other_rxn[i]] = rxn_rate(L.other_rxn[i], X, 0);
+	}
+	return (R);
+}
+
 void derivs_network(double t, double* conc, double* derivs) {
 	int i;
 //	int ig;
 //	int error=0;
 	int n_reactions = 0, n_species = 0, *index, *iarr;
-	Rxn **rarray, *rxn;
-	Elt** rates;
-	double /*x, xn, kn,*/ *X, *dX, rate/*, rate0, *param*/;
+	double /*x, xn, kn,*/ *dX, rate/*, rate0, *param*/;
 //	int q, n_denom;
 //	double St, Et, kcat, Km, S, b;
 
@@ -2369,147 +3119,23 @@ void derivs_network(double t, double* conc, double* derivs) {
 	INIT_VECTOR(derivs, 0.0, n_species);
 
 	// Update reaction rates that depend on functions
-	// update groups (only those that inform variables parameters)
-	for (Group* curr = network.spec_groups; curr != NULL; curr = curr->next) {
-		curr->total_val = 0;
-		for (int i = 0; i < curr->n_elt; i++)
-			curr->total_val += curr->elt_factor[i] * conc[curr->elt_index[i]-1];
-	}
-	// update variable rate parameters
-	for (unsigned int j=0;j < network.var_parameters.size();j++) {
-		network.rates->elt[network.var_parameters[j]-1]->val = network.functions[j].Eval();
-	}
+	update_var_parameters(conc);
 
-	/* Compute derivatives of each species by looping over reactions. */
-//	rarray = network.reactions->rxn;
-	rates = network.rates->elt - network.rates->offset;
-	X = conc - network.species->offset;
+	const Rxn_layout& L = network.layout;
+	double* R = layout_rates(conc);
 	dX = derivs - network.species->offset;
-	for (i = 0; i < n_reactions; ++i) {
-		/* Compute rate for current reaction */
-//		if (!(rxn = rarray[i])) continue;
-		if (!(rxn = network.reactions->rxn[i])) continue;
-		++network.n_rate_calls;
-		int rateLaw_type = rxn->rateLaw_type;
-
-		// Calculate rate here using rxn_rate() (no need to repeat the calculation). --Leonard (4/16/12)
-		rate = rxn_rate(rxn,X,0);
-		iarr = rxn->r_index;
-
-		switch (rateLaw_type){
-
-		case ELEMENTARY:
-			// v= k1*X1...Xn
-//			rate = rxn->stat_factor * rxn->rateLaw_params[0];
-//			iarr = rxn->r_index;
-//			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-//				rate *= X[*index];
-//			}
-			// Compute contribution to rate of change of each participant
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-				dX[*index] -= rate;
-			}
-			iarr = rxn->p_index;
-			for (index = iarr; index < iarr + rxn->n_products; ++index) {
-				dX[*index] += rate;
-			}
-			break;
-
-		case MICHAELIS_MENTEN:
-			/* Second rate, if present, is Michaelis-Menten Km */
-//			St = X[rxn->r_index[0]];
-//			kcat = rxn->rateLaw_params[0];
-//			Km = rxn->rateLaw_params[1];
-			/* S + E ... -> P + E + .. */
-//			for (q = 1, Et = 0; q < rxn->n_reactants; ++q) {
-//				Et += X[rxn->r_index[q]];
-//			}
-//			b = St - Km - Et;
-//			S = 0.5 * (b + sqrt(b * b + 4 * St * Km));
-//			rate = rxn->stat_factor * kcat * Et * S / (Km + S);
-			// Compute contribution to rate of change of each participant
-//			iarr = rxn->r_index;
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-				dX[*index] -= rate;
-			}
-			iarr = rxn->p_index;
-			for (index = iarr; index < iarr + rxn->n_products; ++index) {
-				dX[*index] += rate;
-			}
-			break;
-
-		case SATURATION:
-//			param = rxn->rateLaw_params;
-			/* if dim(param)==1
-			 rate= stat_factor*param[0], a zeroth order rate law
-			 else
-			 rate = stat_factor*param[0]*R1...Rn/((R1+param[1])*(R2+param[2])...
-			 where terms in denominator are only calculated if param[n] is defined
-			 */
-//			rate = rxn->stat_factor * param[0];
-//			iarr = rxn->r_index;
-//			++param;
-//			n_denom = rxn->n_rateLaw_params - 1;
-//			if (n_denom > 0) {
-				/* Compute contributions to rate from species appearing in both numerator and denominator */
-//				for (ig = 0; ig < n_denom; ++ig) {
-//					x = X[iarr[ig]];
-//					rate *= x / (param[ig] + x);
-//				}
-
-				/* Compute contributions to rate from species appearing only in numerator */
-//				for (ig = n_denom; ig < rxn->n_reactants; ++ig) {
-//					rate *= X[iarr[ig]];
-//				}
-//			}
-			// Compute contribution to rate of change of each participant
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-				dX[*index] -= rate;
-			}
-			iarr = rxn->p_index;
-			for (index = iarr; index < iarr + rxn->n_products; ++index) {
-				dX[*index] += rate;
-			}
-			break;
 
-		case HILL:
-//			param = rxn->rateLaw_params;
-//			iarr = rxn->r_index;
-//			x = X[iarr[0]];
-//			xn = pow(x, param[2]);
-//			kn = pow(param[1], param[2]);
-//			rate = rxn->stat_factor * param[0] * xn / (kn + xn);
-			/* Compute contributions to rate from species appearing only in numerator */
-//			for (ig = 1; ig < rxn->n_reactants; ++ig) {
-//				rate *= X[iarr[ig]];
-//			}
-			// Compute contribution to rate of change of each participant
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-				dX[*index] -= rate;
-			}
-			iarr = rxn->p_index;
-			for (index = iarr; index < iarr + rxn->n_products; ++index) {
-				dX[*index] += rate;
-			}
-			break;
-
-		case FUNCTIONAL:
-//			rxn->rateLaw_params[0] = network.rates->elt[rxn->rateLaw_indices[0]-1]->val;
-			// v= k1*X1...Xn
-//			rate = rxn->stat_factor * rxn->rateLaw_params[0];
-//			iarr = rxn->r_index;
-//			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-//				rate *= X[*index];
-//			}
-			// Compute contribution to rate of change of each participant
-			for (index = iarr; index < iarr + rxn->n_reactants; ++index) {
-				dX[*index] -= rate;
-			}
-			iarr = rxn->p_index;
-			for (index = iarr; index < iarr + rxn->n_products; ++index) {
-				dX[*index] += rate;
-			}
-			break;
+	/* Add the contribution of each reaction to the rate of change of each participant. This is done in
+	 * reaction order, so that the sums come out the same as when every rate is added as it is computed. */
+	for (i = 0; i < n_reactions; ++i) {
+		rate = R[i];
+		iarr = L.r_index + L.r_start[i];
+		for (index = iarr; index < L.r_index + L.r_start[i+1]; ++index) {
+			dX[*index] -= rate;
+		}
+		iarr = L.p_index + L.p_start[i];
+		for (index = iarr; index < L.p_index + L.p_start[i+1]; ++index) {
+			dX[*index] += rate;
 		}
 	}
 
@@ -2525,34 +3151,259 @@ void derivs_network(double t, double* conc, double* derivs) {
 	return;
 }
 
-int print_derivs_network(FILE* out) {
-	register int i/*,j*/;
-	int error = 0, n_species;
-//	double *X = NULL, *dX = NULL;
+/*
+ * Native derivatives. compile_derivs_network() writes the right-hand side of the ODEs for the loaded
+ * network out as straight-line C, one statement per reaction in reaction order, compiles it into a
+ * shared object and loads it with dlopen. Rate constants are passed in at run time rather than
+ * written into the code, so the object only depends on the structure of the network; it is cached
+ * under a hash of its source, and later runs on the same network (e.g., parameter scans) reuse it.
+ *
+ * Elementary reactions with up to two reactants are evaluated in the compiled code, in the same order
+ * as derivs_network(), so the results are identical. Rates of all other reactions are computed by
+ * rxn_rate() first and passed in. The compiled code also provides the reactant derivatives of the
+ * elementary rates for the sparse Jacobian.
+ */
+typedef void (*native_rhs_fn)(const double* X, const double* c, const double* R, double* dX);
+typedef void (*native_drdx_fn)(const double* X, const double* c, double* dRdx);
+
+struct NATIVE_STATE {
+	void* handle;
+	native_rhs_fn rhs;
+	native_drdx_fn drdx;
+	vector<double> c; // stat_factor*k of each elementary reaction that is compiled, 0 otherwise
+};
+#define NATIVE (*STATE->native)
 
-	n_species = n_species_network();
-//	X = ALLOC_VECTOR(n_species);
-	double X[n_species];
-//	dX = ALLOC_VECTOR(n_species);
-	double dX[n_species];
+#define NATIVE_CHUNK 100 /* reactions per generated function, to keep compile times down */
 
-	// Compute time derivs of species concentration by reaction
-	if (get_conc_network(X)){
-		cout << "Error in network::print_derivs_network(): 'conc' vector could not be populated. Exiting." << endl;
-		exit(1);
+// Rate constants of the compiled reactions, which are passed to the compiled code as data
+static void native_rate_constants() {
+	const Rxn_layout& L = network.layout;
+	NATIVE.c.assign(L.n_rxn + 1, 0.0);
+	for (int r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] == ELEMENTARY && L.r_start[r+1] - L.r_start[r] <= 2) {
+			NATIVE.c[r] = L.stat_factor[r] * L.k[L.k_start[r]];
+		}
 	}
-	derivs_network(0.0, X, dX);
+}
 
-	// Print reaction rates
-	fprintf(out, "begin derivs\n");
-	for (i = 0; i < n_species; ++i) {
-		fprintf(out, "%5d", i + 1);
-		fprintf(out, " %11.4e", dX[i]);
-		fprintf(out, "\n");
+static void native_derivs_network(double t, double* conc, double* derivs) {
+	const Rxn_layout& L = network.layout;
+	double* X = conc - network.species->offset;
+	int i;
+
+	++network.n_deriv_calls;
+	update_var_parameters(conc);
+	for (i = 0; i < L.n_other; ++i) {
+		L.rate[L.other_rxn[i]] = rxn_rate(L.other_rxn[i], X, 0);
 	}
-	fprintf(out, "end derivs\n");
+	network.n_rate_calls += L.n_elem0 + L.n_elem1 + L.n_elem2;
 
-//	exit:
+	INIT_VECTOR(derivs, 0.0, network.species->n_elt);
+	NATIVE.rhs(conc, &NATIVE.c[0], L.rate, derivs);
+
+	// Set derivatives to zero for fixed species
+	if (network.species->fixed_elts) {
+		for (i = 0; i < network.species->n_fixed_elts; ++i) {
+			derivs[network.species->fixed_elts[i]] = 0.0;
+		}
+	}
+}
+
+static void native_source(string& src) {
+	const Rxn_layout& L = network.layout;
+	int off = network.species->offset;
+	char buf[256];
+	int r, a, chunk, n_chunks = (L.n_rxn + NATIVE_CHUNK - 1) / NATIVE_CHUNK;
+
+	sprintf(buf, "/* Generated by run_network: %d species, %d reactions */\n", n_species_network(), L.n_rxn);
+	src = buf;
+
+	// Right-hand side
+	for (chunk = 0; chunk < n_chunks; ++chunk) {
+		sprintf(buf, "static void rhs_%d(const double* X, const double* c, const double* R, double* dX) {\n\tdouble r;\n", chunk);
+		src += buf;
+		for (r = chunk*NATIVE_CHUNK; r < L.n_rxn && r < (chunk+1)*NATIVE_CHUNK; ++r) {
+			int n_reactants = L.r_start[r+1] - L.r_start[r];
+			if (L.rateLaw_type[r] < 0) continue;
+			if (L.rateLaw_type[r] == ELEMENTARY && n_reactants <= 2) {
+				sprintf(buf, "\tr = c[%d]", r);
+				src += buf;
+				for (a = L.r_start[r]; a < L.r_start[r+1]; ++a) {
+					sprintf(buf, "*X[%d]", L.r_index[a] - off);
+					src += buf;
+				}
+				src += ";";
+			}
+			else {
+				sprintf(buf, "\tr = R[%d];", r);
+				src += buf;
+			}
+			for (a = L.r_start[r]; a < L.r_start[r+1]; ++a) {
+				sprintf(buf, " dX[%d] -= r;", L.r_index[a] - off);
+				src += buf;
+			}
+			for (a = L.p_start[r]; a < L.p_start[r+1]; ++a) {
+				sprintf(buf, " dX[%d] += r;", L.p_index[a] - off);
+				src += buf;
+			}
+			src += "\n";
+		}
+		src += "}\n";
+	}
+	src += "void rn_rhs(const double* X, const double* c, const double* R, double* dX) {\n";
+	for (chunk = 0; chunk < n_chunks; ++chunk) {
+		sprintf(buf, "\trhs_%d(X, c, R, dX);\n", chunk);
+		src += buf;
+	}
+	src += "}\n";
+
+	// Derivatives of the compiled rates with respect to each of their reactants, indexed like L.r_index
+	// (which is also how sparse_jac_values() lays out SPARSE_LS.dRdx)
+	for (chunk = 0; chunk < n_chunks; ++chunk) {
+		sprintf(buf, "static void drdx_%d(const double* X, const double* c, double* d) {\n", chunk);
+		src += buf;
+		for (r = chunk*NATIVE_CHUNK; r < L.n_rxn && r < (chunk+1)*NATIVE_CHUNK; ++r) {
+			if (L.rateLaw_type[r] != ELEMENTARY || L.r_start[r+1] - L.r_start[r] > 2) continue;
+			for (a = L.r_start[r]; a < L.r_start[r+1]; ++a) {
+				sprintf(buf, "\td[%d] = c[%d]", a, r);
+				src += buf;
+				for (int b = L.r_start[r]; b < L.r_start[r+1]; ++b) {
+					if (b == a) continue;
+					sprintf(buf, "*X[%d]", L.r_index[b] - off);
+					src += buf;
+				}
+				src += ";\n";
+			}
+		}
+		src += "}\n";
+	}
+	src += "void rn_drdx(const double* X, const double* c, double* d) {\n";
+	for (chunk = 0; chunk < n_chunks; ++chunk) {
+		sprintf(buf, "\tdrdx_%d(X, c, d);\n", chunk);
+		src += buf;
+	}
+	src += "}\n";
+}
+
+/* Hash of the generated source, which names its compiled object in the cache */
+static unsigned long long native_hash(const string& src) {
+	return fnv1a_hash(src.data(), src.size(), FNV1A_START);
+}
+
+/* A file name quoted for the shell */
+static string shell_quote(const char* name) {
+	string q = "'";
+	for (const char* c = name; *c; ++c) {
+		if (*c == '\'') q += "'\\''";
+		else q += *c;
+	}
+	return (q + "'");
+}
+
+/*
+ * Compile the derivatives of the network to native code in cache_dir (or reuse a previous compile)
+ * and use them as network.derivs. The system C compiler is taken from $CC, or cc if that is not set.
+ * Returns 0 on success; otherwise a warning is printed and the interpreted derivatives stay in use.
+ */
+int compile_derivs_network(const char* cache_dir) {
+	string src;
+	char so_name[1024], c_name[1024], tmp_name[1024], c_tmp_name[1024];
+	unsigned long long hash;
+	int pid = (int) getpid();
+	struct stat st;
+
+	native_source(src);
+	hash = native_hash(src);
+	if (snprintf(so_name, sizeof(so_name), "%s/rn_%016llx.so", cache_dir, hash) >= (int) sizeof(so_name)
+			|| snprintf(c_name, sizeof(c_name), "%s/rn_%016llx.c", cache_dir, hash) >= (int) sizeof(c_name)
+			|| snprintf(tmp_name, sizeof(tmp_name), "%s.%d", so_name, pid) >= (int) sizeof(tmp_name)
+			|| snprintf(c_tmp_name, sizeof(c_tmp_name), "%s/rn_%016llx.%d.c", cache_dir, hash, pid)
+					>= (int) sizeof(c_tmp_name)) {
+		fprintf(stderr, "Warning: Cache directory name %s is too long; using interpreted derivatives.\n", cache_dir);
+		return (1);
+	}
+
+	if (stat(so_name, &st) == 0) {
+		fprintf(stdout, "Using compiled derivatives %s\n", so_name);
+	}
+	else {
+		const char* cc = getenv("CC");
+		string cmd;
+		FILE* out;
+
+		// The source and the object are written under names of their own and renamed when complete, so that
+		// concurrent runs sharing the cache never read or load a partial file
+		if ((out = fopen(c_tmp_name, "w")) == NULL) {
+			fprintf(stderr, "Warning: Couldn't write %s; using interpreted derivatives.\n", c_tmp_name);
+			return (1);
+		}
+		fputs(src.c_str(), out);
+		fclose(out);
+
+		// -ffp-contract=off keeps the compiler from fusing multiplies and adds, so results match derivs_network().
+		// $CC may hold options, so only the file names are quoted.
+		cmd = string((cc && *cc) ? cc : "cc") + " -O2 -ffp-contract=off -fPIC -shared -o " + shell_quote(tmp_name)
+				+ " " + shell_quote(c_tmp_name);
+		fprintf(stdout, "Compiling derivatives: %s\n", cmd.c_str());
+		fflush(stdout);
+		if (system(cmd.c_str()) != 0 || rename(tmp_name, so_name) != 0) {
+			fprintf(stderr, "Warning: Couldn't compile %s; using interpreted derivatives.\n", c_tmp_name);
+			remove(tmp_name);
+			remove(c_tmp_name);
+			return (1);
+		}
+		rename(c_tmp_name, c_name);
+	}
+
+	if (NATIVE.handle) dlclose(NATIVE.handle);
+	NATIVE.handle = dlopen(so_name, RTLD_NOW | RTLD_LOCAL);
+	if (NATIVE.handle) {
+		NATIVE.rhs = (native_rhs_fn) dlsym(NATIVE.handle, "rn_rhs");
+		NATIVE.drdx = (native_drdx_fn) dlsym(NATIVE.handle, "rn_drdx");
+	}
+	if (!NATIVE.handle || !NATIVE.rhs || !NATIVE.drdx) {
+		fprintf(stderr, "Warning: Couldn't load %s (%s); using interpreted derivatives.\n", so_name, dlerror());
+		if (NATIVE.handle) dlclose(NATIVE.handle);
+		NATIVE.handle = NULL;
+		NATIVE.rhs = NULL;
+		NATIVE.drdx = NULL;
+		return (1);
+	}
+
+	native_rate_constants();
+	network.derivs = native_derivs_network;
+	return (0);
+}
+
+int print_derivs_network(FILE* out) {
+	register int i/*,j*/;
+	int error = 0, n_species;
+//	double *X = NULL, *dX = NULL;
+
+	n_species = n_species_network();
+//	X = ALLOC_VECTOR(n_species);
+	double X[n_species];
+//	dX = ALLOC_VECTOR(n_species);
+	double dX[n_species];
+
+	// Compute time derivs of species concentration by reaction
+	if (get_conc_network(X)){
+		cout << "Error in network::print_derivs_network(): 'conc' vector could not be populated. Exiting." << endl;
+		exit(1);
+	}
+	derivs_network(0.0, X, dX);
+
+	// Print reaction rates
+	fprintf(out, "begin derivs\n");
+	for (i = 0; i < n_species; ++i) {
+		fprintf(out, "%5d", i + 1);
+		fprintf(out, " %11.4e", dX[i]);
+		fprintf(out, "\n");
+	}
+	fprintf(out, "end derivs\n");
+
+//	exit:
 //	if (X) FREE_VECTOR(X);
 //	if (dX) FREE_VECTOR(dX);
 	return (error);
@@ -2624,6 +3475,8 @@ int print_rates_network(FILE* out, int discrete) {
 #include "cvode/cvode_spgmr.h"
 #include "sundials/sundials_spgmr.h"
 
+#include "../cvode-2.6.0/src/cvode/cvode_impl.h"
+
 typedef struct jacnode* jacnode_ref;
 
 struct jacnode {
@@ -2960,6 +3813,255 @@ static int CVjtimes(N_Vector v, N_Vector Jv, realtype t, N_Vector y, N_Vector fy
 	return (0);
 }
 
+/*
+ * Sparse direct linear solver for CVODE.
+ *
+ * The Jacobian is assembled analytically from the reaction list: a reaction contributes to column j
+ * (for each of its reactants j) in the rows of all of its reactants and products. Elementary rates
+ * are differentiated exactly; for the other rate laws the derivative with respect to each reactant is
+ * taken by a forward difference of rxn_rate(), and the dependence of functional rate laws on
+ * observables is left out. CVODE only needs the Jacobian for its Newton iteration, so an approximate
+ * Jacobian costs iterations but not accuracy. The iteration matrix I - gamma*J is factored by
+ * Util::SparseLU, whose pattern is analyzed once per propagation.
+ *
+ * The same Jacobian provides the ILU(0) preconditioner for GMRES (SOLVER == GMRES_ILU).
+ */
+#define SPARSE_MSBJ  50   /* max steps between Jacobian evaluations, as in cvode_direct_impl.h */
+#define SPARSE_DGMAX 0.2  /* max change in gamma allowed when the Jacobian is reused */
+
+struct SPARSE_LS_STATE {
+	Util::SparseLU lu;
+	int n_species;
+	vector<int> m_start, m_index; // pattern of the Jacobian, one row per species
+	vector<int> m_diag;
+	vector<double> J, M;
+	vector<int> d_start;          // contributions of the derivative of reaction rates with respect to each reactant:
+	vector<int> e_start;          //   position d_start[r]+n is reactant n of reaction r and adds e_sign[e]*dR/dx
+	vector<int> e_slot;           //   to J[e_slot[e]] for e_start[pos] <= e < e_start[pos+1]
+	vector<double> e_sign;
+	vector<double> dRdx;
+	long int nstlj;
+	long int n_jac;
+};
+#define SPARSE_LS (*STATE->sparse_ls)
+
+static void sparse_jac_structure(bool incomplete) {
+	const Rxn_layout& L = network.layout;
+	int off = network.species->offset;
+	int n = SPARSE_LS.n_species = n_species_network();
+	vector<vector<int> > rows(n);
+	int r, i, a, b;
+
+	// Pattern: the diagonal plus (participant, reactant) for every reaction
+	for (i = 0; i < n; ++i) rows[i].push_back(i);
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] < 0) continue;
+		for (a = L.r_start[r]; a < L.r_start[r+1]; ++a) {
+			int col = L.r_index[a] - off;
+			for (b = L.r_start[r]; b < L.r_start[r+1]; ++b) rows[L.r_index[b] - off].push_back(col);
+			for (b = L.p_start[r]; b < L.p_start[r+1]; ++b) rows[L.p_index[b] - off].push_back(col);
+		}
+	}
+	SPARSE_LS.m_start.assign(n+1, 0);
+	SPARSE_LS.m_diag.assign(n, 0);
+	SPARSE_LS.m_index.clear();
+	for (i = 0; i < n; ++i) {
+		sort(rows[i].begin(), rows[i].end());
+		rows[i].erase(unique(rows[i].begin(), rows[i].end()), rows[i].end());
+		SPARSE_LS.m_start[i] = SPARSE_LS.m_index.size();
+		SPARSE_LS.m_diag[i] = SPARSE_LS.m_start[i] + (lower_bound(rows[i].begin(), rows[i].end(), i) - rows[i].begin());
+		SPARSE_LS.m_index.insert(SPARSE_LS.m_index.end(), rows[i].begin(), rows[i].end());
+	}
+	SPARSE_LS.m_start[n] = SPARSE_LS.m_index.size();
+	SPARSE_LS.J.assign(SPARSE_LS.m_index.size(), 0.0);
+	SPARSE_LS.M.assign(SPARSE_LS.m_index.size(), 0.0);
+
+	// Where the derivative of each rate goes. Rows of fixed species are left at zero, as in derivs_network().
+	SPARSE_LS.d_start.assign(L.n_rxn+1, 0);
+	SPARSE_LS.e_start.assign(1, 0);
+	SPARSE_LS.e_slot.clear();
+	SPARSE_LS.e_sign.clear();
+	for (r = 0; r < L.n_rxn; ++r) {
+		SPARSE_LS.d_start[r] = SPARSE_LS.e_start.size() - 1;
+		for (a = L.r_start[r]; a < L.r_start[r+1]; ++a) {
+			int col = L.r_index[a] - off;
+			for (int sign = -1; sign <= 1; sign += 2) {
+				int start = (sign < 0) ? L.r_start[r] : L.p_start[r];
+				int end = (sign < 0) ? L.r_start[r+1] : L.p_start[r+1];
+				int* index = (sign < 0) ? L.r_index : L.p_index;
+				for (b = start; b < end; ++b) {
+					int row = index[b] - off;
+					if (L.fixed[row]) continue;
+					int* first = &SPARSE_LS.m_index[0] + SPARSE_LS.m_start[row];
+					int* last = &SPARSE_LS.m_index[0] + SPARSE_LS.m_start[row+1];
+					SPARSE_LS.e_slot.push_back(lower_bound(first, last, col) - &SPARSE_LS.m_index[0]);
+					SPARSE_LS.e_sign.push_back(sign);
+				}
+			}
+			SPARSE_LS.e_start.push_back(SPARSE_LS.e_slot.size());
+		}
+	}
+	SPARSE_LS.d_start[L.n_rxn] = SPARSE_LS.e_start.size() - 1;
+	SPARSE_LS.dRdx.assign(SPARSE_LS.e_start.size(), 0.0);
+
+	SPARSE_LS.lu.analyze(n, &SPARSE_LS.m_start[0], &SPARSE_LS.m_index[0], incomplete);
+	if (incomplete) return;
+	// Networks without much local structure fill in badly; GMRES is the better choice for those
+	fprintf(stdout, "Sparse LU: %d nonzeros in Jacobian, %d in factors (%.1f%% of dense)\n",
+			(int)SPARSE_LS.m_index.size(), SPARSE_LS.lu.nonzeros(), 100.0*SPARSE_LS.lu.nonzeros()/((double)n*n));
+}
+
+static void sparse_jac_values(N_Vector y, N_Vector tmp) {
+	const Rxn_layout& L = network.layout;
+	double* X = NV_DATA_S(y) - network.species->offset;
+	double* Xh = NV_DATA_S(tmp) - network.species->offset;
+	double* J = &SPARSE_LS.J[0];
+	int r, n, i, e;
+
+	fill(SPARSE_LS.J.begin(), SPARSE_LS.J.end(), 0.0);
+	N_VScale(1.0, y, tmp);
+	if (NATIVE.drdx) NATIVE.drdx(NV_DATA_S(y), &NATIVE.c[0], &SPARSE_LS.dRdx[0]);
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] < 0) continue;
+		int* irxn = L.r_index + L.r_start[r];
+		int n_reactants = L.r_start[r+1] - L.r_start[r];
+		double* dRdx = &SPARSE_LS.dRdx[0] + SPARSE_LS.d_start[r];
+		if (NATIVE.drdx && L.rateLaw_type[r] == ELEMENTARY && n_reactants <= 2) {
+			// already done by the compiled code
+		}
+		else if (L.rateLaw_type[r] == ELEMENTARY) {
+			// v = k*X1*...*Xn; a repeated reactant appears once per copy, which adds up to the right derivative
+			double k = L.stat_factor[r] * L.k[L.k_start[r]];
+			for (n = 0; n < n_reactants; ++n) {
+				dRdx[n] = k;
+				for (i = 0; i < n_reactants; ++i) {
+					if (i != n) dRdx[n] *= X[irxn[i]];
+				}
+			}
+		}
+		else {
+			double rate = rxn_rate(r, X, 0);
+			for (n = 0; n < n_reactants; ++n) {
+				dRdx[n] = 0.0;
+				if (n > 0 && irxn[n] == irxn[n-1]) continue; // counted with the first copy
+				double x = X[irxn[n]];
+				double h = sqrt(DBL_EPSILON) * max(fabs(x), 1.0);
+				Xh[irxn[n]] = x + h;
+				dRdx[n] = (rxn_rate(r, Xh, 0) - rate) / h;
+				Xh[irxn[n]] = x;
+			}
+		}
+		for (n = 0; n < n_reactants; ++n) {
+			int pos = SPARSE_LS.d_start[r] + n;
+			for (e = SPARSE_LS.e_start[pos]; e < SPARSE_LS.e_start[pos+1]; ++e) {
+				J[SPARSE_LS.e_slot[e]] += SPARSE_LS.e_sign[e] * dRdx[n];
+			}
+		}
+	}
+	++SPARSE_LS.n_jac;
+}
+
+/* Factor I - gamma*J, the matrix of a Newton iteration */
+static int sparse_factor_M(double gamma) {
+	int nnz = SPARSE_LS.m_index.size();
+	for (int e = 0; e < nnz; ++e) SPARSE_LS.M[e] = -gamma * SPARSE_LS.J[e];
+	for (int i = 0; i < SPARSE_LS.n_species; ++i) SPARSE_LS.M[SPARSE_LS.m_diag[i]] += 1.0;
+	return SPARSE_LS.lu.factor(&SPARSE_LS.M[0]);
+}
+
+static int cvSparseInit(CVodeMem cv_mem) {
+	SPARSE_LS.nstlj = 0;
+	return (0);
+}
+
+static int cvSparseSetup(CVodeMem cv_mem, int convfail, N_Vector ypred, N_Vector fpred, booleantype* jcurPtr,
+		N_Vector vtemp1, N_Vector vtemp2, N_Vector vtemp3) {
+	double dgamma = fabs((cv_mem->cv_gamma / cv_mem->cv_gammap) - 1.0);
+	booleantype jbad = (cv_mem->cv_nst == 0) || (cv_mem->cv_nst > SPARSE_LS.nstlj + SPARSE_MSBJ)
+			|| ((convfail == CV_FAIL_BAD_J) && (dgamma < SPARSE_DGMAX)) || (convfail == CV_FAIL_OTHER);
+
+	// Same Jacobian update policy as the dense solver
+	if (jbad) {
+		SPARSE_LS.nstlj = cv_mem->cv_nst;
+		*jcurPtr = TRUE;
+		sparse_jac_values(ypred, vtemp1);
+	}
+	else {
+		*jcurPtr = FALSE;
+	}
+
+	// A zero pivot is a recoverable failure: CVODE retries with a smaller step
+	return (sparse_factor_M(cv_mem->cv_gamma) > 0) ? 1 : 0;
+}
+
+static int cvSparseSolve(CVodeMem cv_mem, N_Vector b, N_Vector weight, N_Vector ycur, N_Vector fcur) {
+	SPARSE_LS.lu.solve(NV_DATA_S(b));
+
+	// If CV_BDF, scale the correction to account for change in gamma
+	if ((cv_mem->cv_lmm == CV_BDF) && (cv_mem->cv_gamrat != 1.0)) {
+		N_VScale(2.0 / (1.0 + cv_mem->cv_gamrat), b, b);
+	}
+	return (0);
+}
+
+static void cvSparseFree(CVodeMem cv_mem) {
+	cv_mem->cv_lmem = NULL;
+}
+
+/*
+ * Attach the sparse solver to a CVODE instance (the counterpart of CVDense)
+ */
+static int CVSparse_network(void* cvode_mem) {
+	CVodeMem cv_mem = (CVodeMem) cvode_mem;
+	if (cv_mem == NULL) return (-1);
+	if (cv_mem->cv_lfree != NULL) cv_mem->cv_lfree(cv_mem);
+
+	sparse_jac_structure(false);
+	SPARSE_LS.n_jac = 0;
+
+	cv_mem->cv_linit = cvSparseInit;
+	cv_mem->cv_lsetup = cvSparseSetup;
+	cv_mem->cv_lsolve = cvSparseSolve;
+	cv_mem->cv_lfree = cvSparseFree;
+	cv_mem->cv_lmem = &SPARSE_LS;
+	cv_mem->cv_setupNonNull = TRUE;
+	return (0);
+}
+
+/*
+ * ILU(0) preconditioner for the CVODE GMRES solver. The Jacobian is only re-evaluated when CVODE
+ * says the saved one is out of date (jok == FALSE); otherwise just the new gamma is factored in.
+ */
+static int CVprec_setup(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype* jcurPtr, realtype gamma,
+		void* user_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	if (jok) {
+		*jcurPtr = FALSE;
+	}
+	else {
+		sparse_jac_values(y, tmp1);
+		*jcurPtr = TRUE;
+	}
+	return (sparse_factor_M(gamma) > 0) ? 1 : 0;
+}
+
+static int CVprec_solve(realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta,
+		int lr, void* user_data, N_Vector tmp) {
+	N_VScale(1.0, r, z);
+	SPARSE_LS.lu.solve(NV_DATA_S(z));
+	return (0);
+}
+
+/* Integrator state that is kept from one call of propagate_cvode_network() or
+ * propagate_rkcs_network() to the next */
+struct ODE_STATE {
+	int n_species;
+	N_Vector y;
+	void* cvode_mem;
+	int initflag;
+	double rkcs_hnext; // suggested size of the next rkcs step
+};
+#define ODE (*STATE->ode)
+
 static int cvode_derivs(realtype t, N_Vector y, N_Vector ydot, void* f_data) {
 	/* printf("t=%.15e\n", t); */
 	(*network.derivs)((double) t, (double*) NV_DATA_S(y), (double*) NV_DATA_S(ydot));
@@ -2969,12 +4071,13 @@ static int cvode_derivs(realtype t, N_Vector y, N_Vector ydot, void* f_data) {
 int propagate_cvode_network(double* t, double delta_t, double* n_steps, double* rtol, double* atol, int SOLVER,
 		double maxStep, mu::Parser& stop_condition){
 	int error = 0;
-	double t_end;
-	static int n_species;
-	static N_Vector y;
-	static void* cvode_mem;
-	static int initflag = 0;
+	double t_start = *t, t_end;
+	int& n_species = ODE.n_species;
+	N_Vector& y = ODE.y;
+	void*& cvode_mem = ODE.cvode_mem;
+	int& initflag = ODE.initflag;
 	long int cvode_maxnumsteps = 2000;
+	bool stop_reads_network = !stop_condition.GetUsedVar().empty();
 
 	/* Initializations at the beginning of new propagation */
 	if (initflag == 0) {
@@ -3005,18 +4108,26 @@ int propagate_cvode_network(double* t, double delta_t, double* n_steps, double*
 		 * GMRES vs Dense
 		 * Jacobian vs finite difference
 		 */
-		if (SOLVER == GMRES || SOLVER == GMRES_J) {
+		if (SOLVER == GMRES_ILU) {
+			sparse_jac_structure(true);
+			CVSpgmr(cvode_mem, PREC_LEFT, 0);
+			CVSpilsSetPreconditioner(cvode_mem, CVprec_setup, CVprec_solve);
+		}
+		else if (SOLVER == GMRES || SOLVER == GMRES_J) {
 			CVSpgmr(cvode_mem, PREC_NONE, 0);
 			if (SOLVER == GMRES_J) {
 				cout << "ERROR: Jacobian no longer supported for GMRES solver" << endl;
-				exit(1);
+				return (1);
 			}
 		}
+		else if (SOLVER == SPARSE) {
+			CVSparse_network(cvode_mem);
+		}
 		else if (SOLVER == DENSE || SOLVER == DENSE_J) {
 			CVDense(cvode_mem, n_species);
 			if (SOLVER == DENSE_J) {
 				cout << "ERROR: Jacobian no longer supported for dense solver" << endl;
-				exit(1);
+				return (1);
 			}
 		}
 		else {
@@ -3057,7 +4168,11 @@ int propagate_cvode_network(double* t, double delta_t, double* n_steps, double*
 		// Check error status
 		if (error == CV_SUCCESS){
 			if (*n_steps >= maxStep) error = -1; // Max steps reached
-			else if (stop_condition.Eval()) error = -2; // Stopping condition met
+			else {
+				// derivs_network() only refreshes what the rates need, which may not cover the stopping condition
+				if (stop_reads_network) update_all_var_parameters(NV_DATA_S(y));
+				if (stop_condition.Eval()) error = -2; // Stopping condition met
+			}
 			break;
 		}
 		else if (error == CV_TSTOP_RETURN){
@@ -3072,7 +4187,10 @@ int propagate_cvode_network(double* t, double delta_t, double* n_steps, double*
 		}
 		else{
 			cout << "Error in CVODE integration (error code " << error << ")." << endl;
-			exit(1);
+			// The network keeps its time and concentrations, from which the next call starts over
+			*t = t_start;
+			initflag = 0;
+			return (1);
 		}
 	}
 
@@ -3097,6 +4215,1017 @@ int propagate_cvode_network(double* t, double delta_t, double* n_steps, double*
 	return (error);
 }
 
+/*
+ * Steady states by pseudo-transient continuation (Kelley and Keyes, SIAM J Numer Anal 35:508, 1998).
+ * Each iteration solves (sigma*D - J)*dx = F and moves to x + dx, where F is the right-hand side of the
+ * ODEs and J its Jacobian. That is a step of implicit Euler of size 1/sigma, which follows the trajectory
+ * while the residual is large; sigma is then lowered in proportion to the residual (switched evolution
+ * relaxation), which turns the iteration into Newton's method near the steady state. The linear systems
+ * are solved by GMRES, with products by J taken as differences of F, and preconditioned by the sparse LU
+ * factors of the same matrix with the analytic Jacobian of sparse_jac_values(). Where that Jacobian is
+ * exact GMRES converges at once; where it isn't (functions of observables) the steps are still Newton's.
+ *
+ * Groups whose totals no reaction changes are conservation laws. Each independent one replaces the
+ * equation of one of its species by g.x = total (D = 0 in that row), so that Newton's method has a
+ * nonsingular matrix and the totals stay at their initial values. Implicit Euler keeps every other linear
+ * invariant of the network as well, so sigma is kept above a small fraction of the largest diagonal entry
+ * of J, which keeps the matrix nonsingular along conservation laws that aren't groups. A step that can't
+ * be solved or makes a species negative is retried with a larger sigma. If sigma grows too large or the
+ * iteration doesn't converge, the network is integrated by CVODE for a while and the iteration starts
+ * over from where the integration ended, each time integrating ten times longer.
+ */
+#define STEADY_MAX_ITER     200   /* iterations before falling back to integration */
+#define STEADY_MAX_RESTARTS 6
+#define STEADY_SIGMA_MIN    1e-8  /* bounds on sigma, relative to the largest diagonal entry of J */
+#define STEADY_SIGMA_MAX    1e12
+#define STEADY_T_INT        1e2   /* first integration, in units of the fastest time scale */
+#define STEADY_KRYLOV_DIM   10
+#define STEADY_KRYLOV_TOL   1e-3  /* reduction of the residual by GMRES */
+
+/* Conservation laws and the linear system of steady_state_network(). Law k is coef[k].x = total[k] and
+ * replaces the equation of species pivot[k]; law_of[i] is the law in the row of species i, or -1. */
+struct STEADY_SYSTEM {
+	int n;
+	vector<vector<double> > coef;
+	vector<int> pivot;
+	vector<double> total;
+	vector<int> law_of;
+	double rtol, atol;
+	double sigma;
+	double *x, *F;        // current iterate and its residual
+	vector<double> xh, Fh; // scratch space for differences of F
+	Util::SparseLU lu;     // preconditioner
+};
+
+// Weighted RMS norm of v over the rows that are ODEs, with the weights of the integrator
+static double steady_norm(const STEADY_SYSTEM& S, const double* v, const double* x) {
+	double sum = 0.0;
+	int m = 0;
+	for (int i = 0; i < S.n; ++i) {
+		if (S.law_of[i] >= 0) continue;
+		double w = v[i] / (S.atol + S.rtol*fabs(x[i]));
+		sum += w*w;
+		++m;
+	}
+	return (m > 0) ? sqrt(sum/m) : 0.0;
+}
+
+// Residual at x: the derivatives, and for each law the amount by which its total is off. Returns its norm.
+static double steady_residual(const STEADY_SYSTEM& S, double* x, double* F) {
+	(*network.derivs)(0.0, x, F);
+	for (unsigned int k = 0; k < S.coef.size(); ++k) {
+		double sum = 0.0;
+		for (int i = 0; i < S.n; ++i) sum += S.coef[k][i] * x[i];
+		F[S.pivot[k]] = S.total[k] - sum;
+	}
+	return steady_norm(S, F, x);
+}
+
+// Sets the totals of the laws to their values at x
+static void steady_totals(STEADY_SYSTEM& S, const double* x) {
+	for (unsigned int k = 0; k < S.coef.size(); ++k) {
+		S.total[k] = 0.0;
+		for (int i = 0; i < S.n; ++i) S.total[k] += S.coef[k][i] * x[i];
+	}
+}
+
+// z = (sigma*D - J)*v for GMRES, where J*v is a difference of F
+static int steady_atimes(void* data, N_Vector v, N_Vector z) {
+	STEADY_SYSTEM& S = *(STEADY_SYSTEM*) data;
+	const char* fixed = network.layout.fixed;
+	double* V = NV_DATA_S(v);
+	double* Z = NV_DATA_S(z);
+	int i;
+
+	double x_norm = 0.0, v_norm = 0.0;
+	for (i = 0; i < S.n; ++i) {
+		x_norm += S.x[i]*S.x[i];
+		v_norm += V[i]*V[i];
+	}
+	if (v_norm == 0.0) {
+		N_VConst(0.0, z);
+		return (0);
+	}
+	double h = sqrt(DBL_EPSILON) * max(sqrt(x_norm), 1.0) / sqrt(v_norm);
+	for (i = 0; i < S.n; ++i) S.xh[i] = S.x[i] + h*V[i];
+	(*network.derivs)(0.0, &S.xh[0], &S.Fh[0]);
+	for (i = 0; i < S.n; ++i) {
+		if (S.law_of[i] >= 0) {
+			const vector<double>& c = S.coef[S.law_of[i]];
+			Z[i] = 0.0;
+			for (int k = 0; k < S.n; ++k) Z[i] += c[k] * V[k];
+		}
+		else if (fixed[i]) Z[i] = V[i];
+		else Z[i] = S.sigma*V[i] - (S.Fh[i] - S.F[i]) / h;
+	}
+	return (0);
+}
+
+static int steady_psolve(void* data, N_Vector r, N_Vector z, int lr) {
+	STEADY_SYSTEM& S = *(STEADY_SYSTEM*) data;
+	N_VScale(1.0, r, z);
+	S.lu.solve(NV_DATA_S(z));
+	return (0);
+}
+
+/* Replaces the concentrations by the steady state that they relax to. n_iter is incremented by the
+ * number of iterations. Returns 0 if a steady state was found, otherwise 1, with the concentrations
+ * left at the last iterate. */
+int steady_state_network(double* n_iter, double rtol, double atol, int SOLVER, int verbose) {
+	const Rxn_layout& L = network.layout;
+	int off = network.species->offset;
+	int n = n_species_network();
+	int i, k, r, s;
+
+	N_Vector y = N_VNew_Serial(n);
+	N_Vector tmp = N_VNew_Serial(n);
+	N_Vector b = N_VNew_Serial(n);
+	N_Vector dx = N_VNew_Serial(n);
+	N_Vector w = N_VNew_Serial(n);
+	double* x = NV_DATA_S(y);
+	get_conc_network(x);
+	sparse_jac_structure(true);
+
+	STEADY_SYSTEM S;
+	S.n = n;
+	S.rtol = rtol;
+	S.atol = atol;
+	S.law_of.assign(n, -1);
+	S.xh.resize(n);
+	S.Fh.resize(n);
+
+	// Independent conservation laws among the groups, with the species whose equation each one replaces
+	vector<vector<double> > reduced;
+	vector<double> g(n);
+	for (Group* group = network.spec_groups; group != NULL; group = group->next) {
+		// Fixed species don't change, so they only add to the total
+		fill(g.begin(), g.end(), 0.0);
+		for (k = 0; k < group->n_elt; ++k) {
+			i = group->elt_index[k] - 1;
+			if (!L.fixed[i]) g[i] += group->elt_factor[k];
+		}
+		bool conserved = true;
+		for (r = 0; r < L.n_rxn && conserved; ++r) {
+			if (L.rateLaw_type[r] < 0) continue;
+			double change = 0.0, scale = 0.0;
+			for (k = L.r_start[r]; k < L.r_start[r+1]; ++k) {
+				change -= g[L.r_index[k] - off];
+				scale += fabs(g[L.r_index[k] - off]);
+			}
+			for (k = L.p_start[r]; k < L.p_start[r+1]; ++k) {
+				change += g[L.p_index[k] - off];
+				scale += fabs(g[L.p_index[k] - off]);
+			}
+			if (fabs(change) > 1e-10*scale) conserved = false;
+		}
+		if (!conserved) continue;
+		// Eliminate the laws found so far and pivot on the largest remaining coefficient
+		vector<double> v(g);
+		for (k = 0; k < (int)reduced.size(); ++k) {
+			double a = v[S.pivot[k]] / reduced[k][S.pivot[k]];
+			if (a == 0.0) continue;
+			for (i = 0; i < n; ++i) v[i] -= a * reduced[k][i];
+			v[S.pivot[k]] = 0.0;
+		}
+		int p = -1;
+		double g_max = 0.0, v_max = 0.0;
+		for (i = 0; i < n; ++i) {
+			g_max = max(g_max, fabs(g[i]));
+			if (g[i] != 0.0 && fabs(v[i]) > v_max) {
+				v_max = fabs(v[i]);
+				p = i;
+			}
+		}
+		if (p < 0 || v_max <= 1e-10*g_max) continue; // depends on the others
+		S.law_of[p] = S.coef.size();
+		S.coef.push_back(g);
+		S.pivot.push_back(p);
+		reduced.push_back(v);
+	}
+	reduced.clear();
+	S.total.resize(S.coef.size());
+	steady_totals(S, x);
+
+	// Pattern of the preconditioner: rows of the Jacobian, with the laws in the rows of their pivots
+	vector<int> m_start(n+1, 0), m_index, m_diag(n, 0);
+	for (i = 0; i < n; ++i) {
+		m_start[i] = m_index.size();
+		if (S.law_of[i] >= 0) {
+			const vector<double>& c = S.coef[S.law_of[i]];
+			for (k = 0; k < n; ++k) {
+				if (c[k] != 0.0) {
+					if (k == i) m_diag[i] = m_index.size();
+					m_index.push_back(k);
+				}
+			}
+		}
+		else {
+			m_diag[i] = SPARSE_LS.m_diag[i] - SPARSE_LS.m_start[i] + m_start[i];
+			m_index.insert(m_index.end(), SPARSE_LS.m_index.begin() + SPARSE_LS.m_start[i],
+					SPARSE_LS.m_index.begin() + SPARSE_LS.m_start[i+1]);
+		}
+	}
+	m_start[n] = m_index.size();
+	vector<double> M(m_index.size());
+	S.lu.analyze(n, &m_start[0], &m_index[0]);
+	SpgmrMem gmres = SpgmrMalloc(STEADY_KRYLOV_DIM, y);
+
+	vector<double> F(n), F_new(n), x_new(n);
+	S.x = x;
+	S.F = &F[0];
+	double F_norm = steady_residual(S, x, &F[0]);
+
+	mu::Parser no_stop;
+	no_stop.SetExpr("0");
+	double t_int = STEADY_T_INT;
+	int converged = 0, restarts = 0;
+	fprintf(stdout, "Solving for the steady state (%d conservation laws from groups)\n", (int)S.coef.size());
+	while (!converged) {
+		// Scale of the Jacobian for the bounds on sigma; the first sigma follows the fastest time scale
+		sparse_jac_values(y, tmp);
+		double j_scale = 0.0;
+		for (i = 0; i < n; ++i) {
+			if (S.law_of[i] < 0) j_scale = max(j_scale, fabs(SPARSE_LS.J[SPARSE_LS.m_diag[i]]));
+		}
+		if (j_scale == 0.0) j_scale = 1.0;
+		double sigma_min = STEADY_SIGMA_MIN * j_scale, sigma_max = STEADY_SIGMA_MAX * j_scale;
+		double sigma = j_scale;
+		bool stalled = false;
+		if (F_norm == 0.0) converged = 1;
+
+		for (int iter = 0; !converged && !stalled; ++iter) {
+			if (iter >= STEADY_MAX_ITER) {
+				stalled = true;
+				break;
+			}
+			if (iter > 0) sparse_jac_values(y, tmp);
+			for (i = 0; i < n; ++i) {
+				NV_Ith_S(b, i) = F[i];
+				NV_Ith_S(w, i) = 1.0 / (atol + rtol*fabs(x[i]));
+			}
+			// Take a step, increasing sigma until it can be solved and leaves every species nonnegative
+			while (true) {
+				for (i = 0; i < n; ++i) {
+					s = m_start[i];
+					if (S.law_of[i] >= 0) {
+						for (; s < m_start[i+1]; ++s) M[s] = S.coef[S.law_of[i]][m_index[s]];
+					}
+					else {
+						const double* J = &SPARSE_LS.J[0] + SPARSE_LS.m_start[i];
+						for (; s < m_start[i+1]; ++s) M[s] = -J[s - m_start[i]];
+						M[m_diag[i]] += L.fixed[i] ? 1.0 : sigma;
+					}
+				}
+				bool ok = (S.lu.factor(&M[0]) == 0);
+				if (ok) {
+					double res_norm;
+					int nli, nps;
+					S.sigma = sigma;
+					N_VConst(0.0, dx);
+					int flag = SpgmrSolve(gmres, &S, dx, b, PREC_RIGHT, MODIFIED_GS, STEADY_KRYLOV_TOL * N_VWL2Norm(b, w),
+							STEADY_KRYLOV_DIM, &S, w, w, steady_atimes, steady_psolve, &res_norm, &nli, &nps);
+					ok = (flag == SPGMR_SUCCESS || flag == SPGMR_RES_REDUCED);
+					for (i = 0; i < n && ok; ++i) {
+						x_new[i] = x[i] + NV_Ith_S(dx, i);
+						if (!(x_new[i] >= -atol) || !(fabs(x_new[i]) <= DBL_MAX)) ok = false;
+					}
+				}
+				if (ok) break;
+				sigma *= 10.0;
+				if (sigma > sigma_max) {
+					stalled = true;
+					break;
+				}
+			}
+			if (stalled) break;
+			++(*n_iter);
+
+			// Switched evolution relaxation
+			double dx_norm = steady_norm(S, NV_DATA_S(dx), &x_new[0]);
+			double F_new_norm = steady_residual(S, &x_new[0], &F_new[0]);
+			if (verbose) fprintf(stdout, "%8d %13.3e %13.3e %13.3e\n", (int)*n_iter, sigma, dx_norm, F_new_norm);
+			for (i = 0; i < n; ++i) x[i] = x_new[i];
+			F.swap(F_new);
+			S.F = &F[0];
+			if (dx_norm <= 1.0) {
+				// Little is left to do on the time scale 1/sigma: converged, or try Newton's method
+				if (sigma <= sigma_min) converged = 1;
+				sigma = sigma_min;
+			}
+			else if (F_norm > 0.0) {
+				sigma = min(max(sigma * F_new_norm / F_norm, sigma_min), sigma_max);
+			}
+			F_norm = F_new_norm;
+			if (F_norm == 0.0) converged = 1;
+		}
+		if (converged || restarts == STEADY_MAX_RESTARTS) break;
+
+		// Integrate for a while and start over
+		++restarts;
+		double t = 0.0, n_steps = 0.0;
+		fprintf(stdout, "  Steady state iteration stalled, integrating for %.3e time units\n", t_int / j_scale);
+		set_conc_network(x);
+		ODE.initflag = 0;
+		int failed = (propagate_cvode_network(&t, t_int / j_scale, &n_steps, &rtol, &atol, SOLVER, INFINITY,
+				no_stop) > 0);
+		ODE.initflag = 0;
+		if (failed) break;
+		get_conc_network(x);
+		t_int *= 10.0;
+		steady_totals(S, x); // The integrator only keeps the totals to within its tolerances
+		F_norm = steady_residual(S, x, &F[0]);
+	}
+
+	if (converged) {
+		fprintf(stdout, "Steady state found after %.0f iterations", *n_iter);
+		if (restarts > 0) fprintf(stdout, " and %d restarts", restarts);
+		fprintf(stdout, " (weighted RMS of dx/dt %.1e)\n", F_norm);
+	}
+	else {
+		fprintf(stdout, "Steady state not found after %.0f iterations and %d restarts\n", *n_iter, restarts);
+	}
+
+	set_conc_network(x);
+	update_all_var_parameters(x);
+	SpgmrFree(gmres);
+	N_VDestroy_Serial(w);
+	N_VDestroy_Serial(dx);
+	N_VDestroy_Serial(b);
+	N_VDestroy_Serial(tmp);
+	N_VDestroy_Serial(y);
+	return (converged ? 0 : 1);
+}
+
+/*
+ * Batched ODE integration. B copies of the network, each with its own rate constants and initial
+ * concentrations (e.g., the points of a parameter scan), are integrated by CVODE as one system. The
+ * state is stored species by species with the B lanes of a species next to each other, so that the rate
+ * of each reaction and its contributions to the derivatives are computed for all lanes by loops over
+ * contiguous memory, which the compiler vectorizes. The lanes share CVODE's steps. Their error weights
+ * are scaled by sqrt(B), which bounds the error of every lane, not just the average over lanes, by the
+ * tolerances. The Newton systems are block diagonal with the pattern of the sparse Jacobian in every
+ * block, and Util::SparseLU factors all blocks at once.
+ *
+ * Functional rate laws aren't supported: their rates come from the scalar expression parser.
+ */
+struct BATCH_STATE {
+	int B;
+	int n_species;
+	vector<double> k;       // rate law parameters (Rxn_layout.k) of each lane
+	vector<double> elem0_k; // stat_factor*k of the elementary reactions in derivs_network()
+	vector<double> elem1_k;
+	vector<double> elem2_k;
+	vector<double> conc;    // initial concentrations
+	vector<double> R;       // rates of the reactions
+	vector<double> xh, Rh, h; // scratch space for differences of rates
+	vector<double> J, M;    // Jacobian and iteration matrix, pattern of SPARSE_LS
+	vector<double> dRdx;    // derivatives of the rates, as in SPARSE_LS
+	Util::SparseLU lu;
+	double rtol, atol;
+	N_Vector y;
+	void* cvode_mem;
+	int initflag;
+	long int nstlj;
+	BATCH_STATE() : B(0), n_species(0), rtol(0.0), atol(0.0), y(NULL), cvode_mem(NULL), initflag(0), nstlj(0) {}
+};
+#define BATCH (*STATE->batch)
+/* All arrays are lane fastest: value j of lane b is at [j*B + b] */
+
+/* Makes room for B lanes. Their constants and concentrations are then set one at a time by
+ * set_batch_lane_network(). Returns 1 if the network can't be batched. */
+int init_batch_network(int B) {
+	const Rxn_layout& L = network.layout;
+	for (int r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] == FUNCTIONAL) {
+			fprintf(stderr, "ERROR: Batched integration doesn't support functional rate laws.\n");
+			return (1);
+		}
+	}
+	BATCH.B = B;
+	BATCH.n_species = n_species_network();
+	BATCH.k.assign((size_t)L.k_start[L.n_rxn]*B, 0.0);
+	BATCH.elem0_k.assign((size_t)L.n_elem0*B, 0.0);
+	BATCH.elem1_k.assign((size_t)L.n_elem1*B, 0.0);
+	BATCH.elem2_k.assign((size_t)L.n_elem2*B, 0.0);
+	BATCH.conc.assign((size_t)BATCH.n_species*B, 0.0);
+	BATCH.R.assign((size_t)L.n_rxn*B, 0.0);
+	BATCH.initflag = 0;
+	return (0);
+}
+
+/* Copies the current rate constants and concentrations of the network to lane b */
+void set_batch_lane_network(int b) {
+	const Rxn_layout& L = network.layout;
+	int B = BATCH.B, i;
+	for (i = 0; i < L.k_start[L.n_rxn]; ++i) BATCH.k[(size_t)i*B + b] = L.k[i];
+	for (i = 0; i < L.n_elem0; ++i) BATCH.elem0_k[(size_t)i*B + b] = L.elem0_k[i];
+	for (i = 0; i < L.n_elem1; ++i) BATCH.elem1_k[(size_t)i*B + b] = L.elem1_k[i];
+	for (i = 0; i < L.n_elem2; ++i) BATCH.elem2_k[(size_t)i*B + b] = L.elem2_k[i];
+	for (i = 0; i < BATCH.n_species; ++i) BATCH.conc[(size_t)i*B + b] = network.species->elt[i]->val;
+	BATCH.initflag = 0;
+}
+
+/* Concentrations of lane b, as of the last propagate_cvode_batch_network() */
+void get_batch_conc_network(int b, double* conc) {
+	int B = BATCH.B;
+	const double* x = BATCH.initflag ? NV_DATA_S(BATCH.y) : &BATCH.conc[0];
+	for (int i = 0; i < BATCH.n_species; ++i) conc[i] = x[(size_t)i*B + b];
+}
+
+/* Rate of reaction r in all lanes, as rxn_rate() computes it for continuous species */
+static void rxn_rate_batch(int r, const double* X, double* rate) {
+	const Rxn_layout& L = network.layout;
+	int B = BATCH.B, off = network.species->offset, b, ig;
+	const int* iarr = L.r_index + L.r_start[r];
+	int n_reactants = L.r_start[r+1] - L.r_start[r];
+	const double* param = &BATCH.k[0] + (size_t)L.k_start[r]*B; // parameter j of lane b is param[j*B + b]
+	double sf = L.stat_factor[r];
+
+	network.n_rate_calls += B;
+	switch (L.rateLaw_type[r]) {
+	case ELEMENTARY:
+		for (b = 0; b < B; ++b) rate[b] = sf * param[b];
+		for (ig = 0; ig < n_reactants; ++ig) {
+			const double* x = X + (size_t)(iarr[ig] - off)*B;
+			for (b = 0; b < B; ++b) rate[b] *= x[b];
+		}
+		break;
+	case MICHAELIS_MENTEN: {
+		const double* St = X + (size_t)(iarr[0] - off)*B;
+		for (b = 0; b < B; ++b) {
+			double Et = 0.0;
+			for (ig = 1; ig < n_reactants; ++ig) Et += X[(size_t)(iarr[ig] - off)*B + b];
+			double kcat = param[b], Km = param[B + b];
+			double c = St[b] - Km - Et;
+			double S = 0.5 * (c + sqrt(c * c + 4.0 * St[b] * Km));
+			rate[b] = sf * kcat * Et * S / (Km + S);
+		}
+		break;
+	}
+	case SATURATION: {
+		int n_denom = L.k_start[r+1] - L.k_start[r] - 1;
+		for (b = 0; b < B; ++b) rate[b] = sf * param[b];
+		for (ig = 0; ig < n_reactants; ++ig) {
+			const double* x = X + (size_t)(iarr[ig] - off)*B;
+			if (ig < n_denom) {
+				const double* K = param + (size_t)(ig + 1)*B;
+				for (b = 0; b < B; ++b) rate[b] *= x[b] / (K[b] + x[b]);
+			}
+			else {
+				for (b = 0; b < B; ++b) rate[b] *= x[b];
+			}
+		}
+		// Zeroth order if there are no constants in the denominator
+		if (n_denom == 0) {
+			for (b = 0; b < B; ++b) rate[b] = sf * param[b];
+		}
+		break;
+	}
+	case HILL: {
+		const double* x = X + (size_t)(iarr[0] - off)*B;
+		for (b = 0; b < B; ++b) {
+			double xn = pow(x[b], param[2*B + b]);
+			double kn = pow(param[B + b], param[2*B + b]);
+			rate[b] = sf * param[b] * xn / (kn + xn);
+		}
+		for (ig = 1; ig < n_reactants; ++ig) {
+			const double* xi = X + (size_t)(iarr[ig] - off)*B;
+			for (b = 0; b < B; ++b) rate[b] *= xi[b];
+		}
+		break;
+	}
+	default:
+		for (b = 0; b < B; ++b) rate[b] = 0.0;
+		break;
+	}
+}
+
+/* Structure-of-arrays version of derivs_network() for all lanes: conc and derivs are lane fastest */
+void derivs_batch_network(const double* conc, double* derivs) {
+	const Rxn_layout& L = network.layout;
+	int B = BATCH.B, off = network.species->offset, n = BATCH.n_species;
+	double* R = &BATCH.R[0];
+	int i, b;
+
+	++network.n_deriv_calls;
+	for (i = 0; i < L.n_elem0; ++i) {
+		double* r = R + (size_t)L.elem0_rxn[i]*B;
+		const double* k = &BATCH.elem0_k[0] + (size_t)i*B;
+		for (b = 0; b < B; ++b) r[b] = k[b];
+	}
+	for (i = 0; i < L.n_elem1; ++i) {
+		double* r = R + (size_t)L.elem1_rxn[i]*B;
+		const double* k = &BATCH.elem1_k[0] + (size_t)i*B;
+		const double* x = conc + (size_t)(L.elem1_x[i] - off)*B;
+		for (b = 0; b < B; ++b) r[b] = k[b] * x[b];
+	}
+	for (i = 0; i < L.n_elem2; ++i) {
+		double* r = R + (size_t)L.elem2_rxn[i]*B;
+		const double* k = &BATCH.elem2_k[0] + (size_t)i*B;
+		const double* x1 = conc + (size_t)(L.elem2_x1[i] - off)*B;
+		const double* x2 = conc + (size_t)(L.elem2_x2[i] - off)*B;
+		for (b = 0; b < B; ++b) r[b] = k[b] * x1[b] * x2[b];
+	}
+	network.n_rate_calls += (L.n_elem0 + L.n_elem1 + L.n_elem2) * B;
+	for (i = 0; i < L.n_other; ++i) {
+		rxn_rate_batch(L.other_rxn[i], conc, R + (size_t)L.other_rxn[i]*B);
+	}
+
+	for (i = 0; i < n*B; ++i) derivs[i] = 0.0;
+	for (int r = 0; r < L.n_rxn; ++r) {
+		const double* rate = R + (size_t)r*B;
+		int* index;
+		for (index = L.r_index + L.r_start[r]; index < L.r_index + L.r_start[r+1]; ++index) {
+			double* d = derivs + (size_t)(*index - off)*B;
+			for (b = 0; b < B; ++b) d[b] -= rate[b];
+		}
+		for (index = L.p_index + L.p_start[r]; index < L.p_index + L.p_start[r+1]; ++index) {
+			double* d = derivs + (size_t)(*index - off)*B;
+			for (b = 0; b < B; ++b) d[b] += rate[b];
+		}
+	}
+	for (i = 0; i < n; ++i) {
+		if (!L.fixed[i]) continue;
+		for (b = 0; b < B; ++b) derivs[(size_t)i*B + b] = 0.0;
+	}
+}
+
+/* Jacobian of all lanes in the pattern of sparse_jac_structure(), as sparse_jac_values() computes it */
+static void batch_jac_values(const double* X) {
+	const Rxn_layout& L = network.layout;
+	int B = BATCH.B, off = network.species->offset;
+	double* J = &BATCH.J[0];
+	double* dRdx = &BATCH.dRdx[0];
+	double* h = &BATCH.h[0];
+	int r, n, i, e, b;
+
+	fill(BATCH.J.begin(), BATCH.J.end(), 0.0);
+	copy(X, X + BATCH.xh.size(), BATCH.xh.begin());
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] < 0) continue;
+		int* irxn = L.r_index + L.r_start[r];
+		int n_reactants = L.r_start[r+1] - L.r_start[r];
+		double* d = dRdx + (size_t)SPARSE_LS.d_start[r]*B;
+		if (L.rateLaw_type[r] == ELEMENTARY) {
+			const double* k = &BATCH.k[0] + (size_t)L.k_start[r]*B;
+			for (n = 0; n < n_reactants; ++n) {
+				double* dn = d + (size_t)n*B;
+				for (b = 0; b < B; ++b) dn[b] = L.stat_factor[r] * k[b];
+				for (i = 0; i < n_reactants; ++i) {
+					if (i == n) continue;
+					const double* x = X + (size_t)(irxn[i] - off)*B;
+					for (b = 0; b < B; ++b) dn[b] *= x[b];
+				}
+			}
+		}
+		else {
+			double* rate = &BATCH.R[0] + (size_t)r*B;
+			double* rate_h = &BATCH.Rh[0];
+			rxn_rate_batch(r, X, rate);
+			for (n = 0; n < n_reactants; ++n) {
+				double* dn = d + (size_t)n*B;
+				for (b = 0; b < B; ++b) dn[b] = 0.0;
+				if (n > 0 && irxn[n] == irxn[n-1]) continue; // counted with the first copy
+				double* xh = &BATCH.xh[0] + (size_t)(irxn[n] - off)*B;
+				const double* x = X + (size_t)(irxn[n] - off)*B;
+				for (b = 0; b < B; ++b) {
+					h[b] = sqrt(DBL_EPSILON) * max(fabs(x[b]), 1.0);
+					xh[b] = x[b] + h[b];
+				}
+				rxn_rate_batch(r, &BATCH.xh[0], rate_h);
+				for (b = 0; b < B; ++b) {
+					dn[b] = (rate_h[b] - rate[b]) / h[b];
+					xh[b] = x[b];
+				}
+			}
+		}
+		for (n = 0; n < n_reactants; ++n) {
+			int pos = SPARSE_LS.d_start[r] + n;
+			const double* dn = d + (size_t)n*B;
+			for (e = SPARSE_LS.e_start[pos]; e < SPARSE_LS.e_start[pos+1]; ++e) {
+				double* Je = J + (size_t)SPARSE_LS.e_slot[e]*B;
+				double sign = SPARSE_LS.e_sign[e];
+				for (b = 0; b < B; ++b) Je[b] += sign * dn[b];
+			}
+		}
+	}
+}
+
+static int cvode_batch_derivs(realtype t, N_Vector y, N_Vector ydot, void* f_data) {
+	derivs_batch_network(NV_DATA_S(y), NV_DATA_S(ydot));
+	return 0;
+}
+
+// Error weights, scaled so that the error of every lane is within the tolerances
+static int cvode_batch_ewt(N_Vector y, N_Vector ewt, void* user_data) {
+	double* Y = NV_DATA_S(y);
+	double* W = NV_DATA_S(ewt);
+	double scale = sqrt((double)BATCH.B);
+	for (long int i = 0; i < NV_LENGTH_S(y); ++i) W[i] = scale / (BATCH.rtol * fabs(Y[i]) + BATCH.atol);
+	return 0;
+}
+
+static int cvBatchInit(CVodeMem cv_mem) {
+	BATCH.nstlj = 0;
+	return (0);
+}
+
+static int cvBatchSetup(CVodeMem cv_mem, int convfail, N_Vector ypred, N_Vector fpred, booleantype* jcurPtr,
+		N_Vector vtemp1, N_Vector vtemp2, N_Vector vtemp3) {
+	int B = BATCH.B;
+	double dgamma = fabs((cv_mem->cv_gamma / cv_mem->cv_gammap) - 1.0);
+	booleantype jbad = (cv_mem->cv_nst == 0) || (cv_mem->cv_nst > BATCH.nstlj + SPARSE_MSBJ)
+			|| ((convfail == CV_FAIL_BAD_J) && (dgamma < SPARSE_DGMAX)) || (convfail == CV_FAIL_OTHER);
+	// Same Jacobian update policy as the sparse solver
+	if (jbad) {
+		BATCH.nstlj = cv_mem->cv_nst;
+		batch_jac_values(NV_DATA_S(ypred));
+	}
+	*jcurPtr = jbad;
+	int nnz = SPARSE_LS.m_index.size();
+	double gamma = cv_mem->cv_gamma;
+	for (size_t e = 0; e < (size_t)nnz*B; ++e) BATCH.M[e] = -gamma * BATCH.J[e];
+	for (int i = 0; i < BATCH.n_species; ++i) {
+		double* m = &BATCH.M[0] + (size_t)SPARSE_LS.m_diag[i]*B;
+		for (int b = 0; b < B; ++b) m[b] += 1.0;
+	}
+	return (BATCH.lu.factorBatch(&BATCH.M[0], B) > 0) ? 1 : 0;
+}
+
+static int cvBatchSolve(CVodeMem cv_mem, N_Vector b, N_Vector weight, N_Vector ycur, N_Vector fcur) {
+	BATCH.lu.solveBatch(NV_DATA_S(b), BATCH.B);
+
+	// If CV_BDF, scale the correction to account for change in gamma
+	if ((cv_mem->cv_lmm == CV_BDF) && (cv_mem->cv_gamrat != 1.0)) {
+		N_VScale(2.0 / (1.0 + cv_mem->cv_gamrat), b, b);
+	}
+	return (0);
+}
+
+static void cvBatchFree(CVodeMem cv_mem) {
+	cv_mem->cv_lmem = NULL;
+}
+
+/* Integrates all lanes by delta_t. Works like propagate_cvode_network(), without the step limit and
+ * stopping condition. The concentrations of the network itself are not changed. */
+int propagate_cvode_batch_network(double* t, double delta_t, double* n_steps, double* rtol, double* atol,
+		int SOLVER) {
+	void*& cvode_mem = BATCH.cvode_mem;
+	N_Vector& y = BATCH.y;
+	int B = BATCH.B, error;
+	long int cvode_maxnumsteps = 2000, n_old, n_new;
+
+	if (BATCH.initflag == 0) {
+		if (y) N_VDestroy_Serial(y);
+		if (cvode_mem) CVodeFree(&cvode_mem);
+		y = N_VNew_Serial((long int)BATCH.n_species*B);
+		for (unsigned int i = 0; i < BATCH.conc.size(); ++i) NV_Ith_S(y, i) = BATCH.conc[i];
+		BATCH.rtol = *rtol;
+		BATCH.atol = *atol;
+
+		cvode_mem = CVodeCreate(CV_BDF, CV_NEWTON);
+		if (cvode_mem == NULL) {
+			fprintf(stderr, "CVodeCreate failed.\n");
+			return (1);
+		}
+		CVodeInit(cvode_mem, cvode_batch_derivs, *t, y);
+		CVodeWFtolerances(cvode_mem, cvode_batch_ewt);
+		CVodeSetErrFile(cvode_mem, stdout);
+		CVodeSetMaxNumSteps(cvode_mem, cvode_maxnumsteps);
+
+		if (SOLVER == GMRES) {
+			CVSpgmr(cvode_mem, PREC_NONE, 0);
+		}
+		else {
+			// Block diagonal sparse LU
+			sparse_jac_structure(true);
+			int nnz = SPARSE_LS.m_index.size();
+			BATCH.J.assign((size_t)nnz*B, 0.0);
+			BATCH.M.assign((size_t)nnz*B, 0.0);
+			BATCH.dRdx.assign(SPARSE_LS.dRdx.size()*B, 0.0);
+			BATCH.xh.assign((size_t)BATCH.n_species*B, 0.0);
+			BATCH.Rh.assign(B, 0.0);
+			BATCH.h.assign(B, 0.0);
+			BATCH.lu.analyze(BATCH.n_species, &SPARSE_LS.m_start[0], &SPARSE_LS.m_index[0]);
+			CVodeMem cv_mem = (CVodeMem) cvode_mem;
+			cv_mem->cv_linit = cvBatchInit;
+			cv_mem->cv_lsetup = cvBatchSetup;
+			cv_mem->cv_lsolve = cvBatchSolve;
+			cv_mem->cv_lfree = cvBatchFree;
+			cv_mem->cv_lmem = &BATCH;
+			cv_mem->cv_setupNonNull = TRUE;
+		}
+		BATCH.initflag = 1;
+	}
+
+	double t_end = (*t) + delta_t;
+	CVodeSetStopTime(cvode_mem, t_end);
+	while (1) {
+		CVodeGetNumSteps(cvode_mem, &n_old);
+		error = CVode(cvode_mem, t_end, y, t, CV_NORMAL);
+		CVodeGetNumSteps(cvode_mem, &n_new);
+		*n_steps += (double)(n_new - n_old);
+		if (error == CV_SUCCESS || error == CV_TSTOP_RETURN) {
+			error = CV_SUCCESS;
+			break;
+		}
+		else if (error == CV_TOO_MUCH_WORK) {
+			cvode_maxnumsteps *= 2;
+			cout << "  Increasing mxstep to " << cvode_maxnumsteps << endl;
+			CVodeSetMaxNumSteps(cvode_mem, cvode_maxnumsteps);
+		}
+		else {
+			cout << "Error in CVODE integration (error code " << error << ")." << endl;
+			return (1);
+		}
+	}
+	return (error);
+}
+
+/*
+ * Hybrid SSA/ODE propagation (Haseltine and Rawlings, J Chem Phys 117:6959, 2002; Salis and Kaznessis,
+ * J Chem Phys 122:054103, 2005). A reaction is fast if it is expected to fire at least lambda times in a
+ * sample interval and all of its reactants and products have at least epsilon molecules; all others are
+ * slow. CVODE integrates the fast reactions as ODEs together with the integral of the total propensity of
+ * the slow reactions. When the integral reaches -ln(U), a root function stops the integrator, one slow
+ * reaction is chosen in proportion to its propensity and fired, and the integration starts over. The
+ * reactions are partitioned again at the start of every sample interval and after every slow reaction.
+ */
+struct HYBRID_STATE {
+	int n_species;
+	N_Vector y; // species populations, followed by the integral of the total slow propensity
+	void* cvode_mem;
+	int initflag;
+	double lambda; // minimum number of firings per sample interval of a fast reaction
+	double epsilon; // minimum population of the reactants and products of a fast reaction
+	double target; // value of the integral at which the next slow reaction fires
+	int n_fast;
+	vector<char> fast; // fast[r] is 1 if reaction r is currently integrated as an ODE
+	vector<char> continuous; // continuous[i] is 1 if species i is changed by a fast reaction
+	HYBRID_STATE() : n_species(0), y(NULL), cvode_mem(NULL), initflag(0), lambda(10.0), epsilon(100.0),
+		target(0.0), n_fast(0) {}
+};
+#define HYBRID (*STATE->hybrid)
+
+void init_hybrid_network(double lambda, double epsilon, int seed) {
+	// Initialize random number generator
+	if (seed >= 0) {
+		SEED_RANDOM(seed);
+	}
+	HYBRID.lambda = lambda;
+	HYBRID.epsilon = epsilon;
+	HYBRID.initflag = 0;
+}
+
+/* Number of reactions that were integrated as ODEs in the last partition */
+int hybrid_n_fast_network() {
+	return (HYBRID.n_fast);
+}
+
+/* Propensity of slow reaction r, or zero if a reactant doesn't have a whole molecule left for every copy of
+ * it that r consumes */
+static double hybrid_slow_rate(int r, double* X) {
+	const Rxn_layout& L = network.layout;
+	int* iarr = L.r_index + L.r_start[r];
+	int n_reactants = L.r_start[r+1] - L.r_start[r];
+	double n = 0.0;
+
+	if (L.rateLaw_type[r] < 0) return (0.0);
+	for (int i = 0; i < n_reactants; ++i) {
+		n = (i > 0 && iarr[i] == iarr[i-1]) ? n + 1.0 : 0.0;
+		if (X[iarr[i]] - n < 1.0) return (0.0);
+	}
+	return (rxn_rate(r, X, 1));
+}
+
+/* Partitions the reactions into fast and slow ones at populations conc. Species that no fast reaction
+ * changes are rounded, so that the slow reactions only ever see whole molecules. */
+static void hybrid_partition(double* conc, double delta_t) {
+	const Rxn_layout& L = network.layout;
+	int offset = network.species->offset;
+	double* X = conc - offset;
+	int r, i;
+
+	update_var_parameters(conc);
+	double* R = layout_rates(conc);
+	HYBRID.fast.assign(L.n_rxn, 0);
+	HYBRID.continuous.assign(HYBRID.n_species, 0);
+	HYBRID.n_fast = 0;
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (L.rateLaw_type[r] < 0 || R[r] * delta_t < HYBRID.lambda) continue;
+		bool fast = true;
+		for (i = L.r_start[r]; fast && i < L.r_start[r+1]; ++i) fast = (X[L.r_index[i]] >= HYBRID.epsilon);
+		for (i = L.p_start[r]; fast && i < L.p_start[r+1]; ++i) fast = (X[L.p_index[i]] >= HYBRID.epsilon);
+		if (!fast) continue;
+		HYBRID.fast[r] = 1;
+		++HYBRID.n_fast;
+		for (i = L.r_start[r]; i < L.r_start[r+1]; ++i) HYBRID.continuous[L.r_index[i] - offset] = 1;
+		for (i = L.p_start[r]; i < L.p_start[r+1]; ++i) HYBRID.continuous[L.p_index[i] - offset] = 1;
+	}
+	for (i = 0; i < HYBRID.n_species; ++i) {
+		if (!HYBRID.continuous[i] && !L.fixed[i]) conc[i] = rint(conc[i]);
+	}
+}
+
+/* Right-hand side: the rates of change due to the fast reactions, and the total slow propensity */
+static int hybrid_derivs(realtype t, N_Vector y, N_Vector ydot, void* f_data) {
+	const Rxn_layout& L = network.layout;
+	int n_species = HYBRID.n_species;
+	double* conc = NV_DATA_S(y);
+	double* derivs = NV_DATA_S(ydot);
+	double* X = conc - network.species->offset;
+	double* dX = derivs - network.species->offset;
+	double a_slow = 0.0;
+	int r, i;
+
+	++network.n_deriv_calls;
+	INIT_VECTOR(derivs, 0.0, n_species + 1);
+	update_var_parameters(conc);
+	double* R = layout_rates(conc);
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (!HYBRID.fast[r]) {
+			a_slow += hybrid_slow_rate(r, X);
+			continue;
+		}
+		for (i = L.r_start[r]; i < L.r_start[r+1]; ++i) dX[L.r_index[i]] -= R[r];
+		for (i = L.p_start[r]; i < L.p_start[r+1]; ++i) dX[L.p_index[i]] += R[r];
+	}
+	for (i = 0; i < n_species; ++i) {
+		if (L.fixed[i]) derivs[i] = 0.0;
+	}
+	derivs[n_species] = a_slow;
+	return (0);
+}
+
+/* Changes sign when the integrated slow propensity reaches the target */
+static int hybrid_root(realtype t, N_Vector y, realtype* gout, void* user_data) {
+	gout[0] = NV_Ith_S(y, HYBRID.n_species) - HYBRID.target;
+	return (0);
+}
+
+static double hybrid_draw_target() {
+	double rnd;
+	while ( (rnd = RANDOM(0.0, 1.0)) == 0.0 || rnd == 1.0 )
+		;
+	return (-log(rnd));
+}
+
+/* Fires one slow reaction, chosen in proportion to its propensity at populations conc */
+static void hybrid_fire(double* conc) {
+	const Rxn_layout& L = network.layout;
+	int offset = network.species->offset;
+	double* X = conc - offset;
+	double a_tot = 0.0, f;
+	int r, i, irxn = -1;
+
+	update_var_parameters(conc);
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (!HYBRID.fast[r]) a_tot += hybrid_slow_rate(r, X);
+	}
+	// The root can be reached through integration error after the last slow reaction has been disabled
+	if (a_tot <= 0.0) return;
+	f = RANDOM(0.0, a_tot);
+	for (r = 0; r < L.n_rxn; ++r) {
+		if (HYBRID.fast[r]) continue;
+		double a = hybrid_slow_rate(r, X);
+		if (a <= 0.0) continue;
+		irxn = r;
+		if ((f -= a) < 0.0) break;
+	}
+	for (i = L.r_start[irxn]; i < L.r_start[irxn+1]; ++i) {
+		if (!L.fixed[L.r_index[i] - offset]) X[L.r_index[i]] -= 1.0;
+	}
+	for (i = L.p_start[irxn]; i < L.p_start[irxn+1]; ++i) {
+		if (!L.fixed[L.p_index[i] - offset]) X[L.p_index[i]] += 1.0;
+	}
+}
+
+int propagate_hybrid_network(double* t, double delta_t, double* n_steps, double* rtol, double* atol, int SOLVER,
+		double maxStep, mu::Parser& stop_condition){
+	int error = 0;
+	double t_start = *t, t_end;
+	int& n_species = HYBRID.n_species;
+	N_Vector& y = HYBRID.y;
+	void*& cvode_mem = HYBRID.cvode_mem;
+	long int cvode_maxnumsteps = 2000;
+	bool stop_reads_network = !stop_condition.GetUsedVar().empty();
+
+	/* Initializations at the beginning of new propagation */
+	if (HYBRID.initflag == 0) {
+		/* Free previously allocated space */
+		if (y) N_VDestroy_Serial(y);
+		if (cvode_mem) CVodeFree(&cvode_mem);
+
+		n_species = n_species_network();
+		y = N_VNew_Serial(n_species + 1);
+		get_conc_network(NV_DATA_S(y));
+		NV_Ith_S(y, n_species) = 0.0;
+
+		cvode_mem = CVodeCreate(CV_BDF, CV_NEWTON);
+		if (cvode_mem == NULL) {
+			fprintf(stderr, "CVodeMalloc failed.\n");
+			return (1);
+		}
+		CVodeInit(cvode_mem, hybrid_derivs, *t, y);
+		CVodeSStolerances(cvode_mem, *rtol, *atol);
+		CVodeSetErrFile(cvode_mem, stdout);
+		CVodeSetMaxNumSteps(cvode_mem, cvode_maxnumsteps);
+		CVodeRootInit(cvode_mem, 1, hybrid_root);
+		// The partition changes the right-hand side, so only the solvers that don't need its structure are used
+		if (SOLVER == GMRES) {
+			CVSpgmr(cvode_mem, PREC_NONE, 0);
+		}
+		else if (SOLVER == DENSE) {
+			CVDense(cvode_mem, n_species + 1);
+		}
+		else {
+			fprintf(stderr, "ERROR: The hybrid propagator only supports the dense and gmres solvers.\n");
+			return (1);
+		}
+		HYBRID.target = hybrid_draw_target();
+
+		/* Done with initialization */
+		HYBRID.initflag = 1;
+	}
+	else {
+		get_conc_network(NV_DATA_S(y));
+	}
+
+	/* Propagation */
+	t_end = (*t) + delta_t;
+	double* conc = NV_DATA_S(y);
+	while (1){
+		// An event closer to t_end than CVODE can step (its CV_TOO_CLOSE test) leaves nothing to integrate
+		if (t_end - *t < 2.0*DBL_EPSILON*max(fabs(*t), fabs(t_end))){
+			*t = t_end;
+			error = CV_TSTOP_RETURN;
+		}
+		else{
+			// Partition at the current populations and restart the integrator, which can't step across the jump
+			hybrid_partition(conc, delta_t);
+			CVodeReInit(cvode_mem, *t, y);
+			CVodeSetStopTime(cvode_mem, t_end);
+			error = CVode(cvode_mem, t_end, y, t, CV_NORMAL);
+		}
+
+		if (error == CV_ROOT_RETURN){
+			hybrid_fire(conc);
+			NV_Ith_S(y, n_species) = 0.0;
+			HYBRID.target = hybrid_draw_target();
+			*n_steps += 1.0;
+			error = CV_SUCCESS;
+			if (*n_steps >= maxStep){ // Max steps reached
+				error = -1;
+				break;
+			}
+			if (stop_reads_network) update_all_var_parameters(conc);
+			if (stop_condition.Eval()){ // Stopping condition met
+				error = -2;
+				break;
+			}
+			continue;
+		}
+		else if (error == CV_SUCCESS || error == CV_TSTOP_RETURN){
+			error = CV_SUCCESS; // Reaching t_end isn't an error
+			if (stop_reads_network) update_all_var_parameters(conc);
+			if (stop_condition.Eval()) error = -2; // Stopping condition met
+			break;
+		}
+		else if (error == CV_TOO_MUCH_WORK){
+			cvode_maxnumsteps *= 2; // Increase max steps
+			cout << "  Increasing mxstep to " << cvode_maxnumsteps << endl;
+			CVodeSetMaxNumSteps(cvode_mem, cvode_maxnumsteps);
+			continue;
+		}
+		else{
+			cout << "Error in CVODE integration (error code " << error << ")." << endl;
+			// As in propagate_cvode_network()
+			*t = t_start;
+			HYBRID.initflag = 0;
+			return (1);
+		}
+	}
+
+	/* Set network concentrations to values returned in X */
+	set_conc_network(conc);
+
+	// Update functions, if any
+	if (network.has_functions){
+		// update groups
+		for (Group* curr = network.spec_groups; curr != NULL; curr = curr->next) {
+			curr->total_val = 0;
+			for (int i = 0; i < curr->n_elt; i++)
+				curr->total_val += curr->elt_factor[i] * network.species->elt[curr->elt_index[i]-1]->val;
+		}
+		// update variable rate parameters
+		for (unsigned int j=0;j < network.var_parameters.size();j++) {
+			network.rates->elt[network.var_parameters[j]-1]->val = network.functions[j].Eval();
+		}
+	}
+
+	return (error);
+}
+
 #define TINY 1e-8
 
 //int propagate_euler_network(double* t, double delta_t, long int* n_steps, double h, double maxStep){
@@ -3107,6 +5236,7 @@ int propagate_euler_network(double* t, double delta_t, double* n_steps, double h
 	int n_species;
 	double htry, /*t_end,*/ t_left, dt_inv;
 	double *y, *dy;
+	bool stop_reads_network = !stop_condition.GetUsedVar().empty();
 
 	n_species = n_species_network();
 	y = ALLOC_VECTOR(n_species);
@@ -3142,6 +5272,7 @@ int propagate_euler_network(double* t, double delta_t, double* n_steps, double h
 		if (fabs(t_left * dt_inv) < TINY) break;
 
 		// Check for stopping condition
+		if (stop_reads_network) update_all_var_parameters(y);
 		if (stop_condition.Eval()){
 			error = -2;
 			break;
@@ -3185,7 +5316,8 @@ int propagate_rkcs_network(double* t, double delta_t, double* n_steps, double to
 	int error = 0, n_species;
 	double *X = NULL, *dX = NULL;
 	double t_end, t_left, htry, hdid, dt_inv;
-	static double hnext;
+	double& hnext = ODE.rkcs_hnext;
+	bool stop_reads_network = !stop_condition.GetUsedVar().empty();
 
 	n_species = n_species_network();
 	X = ALLOC_VECTOR(n_species);
@@ -3221,6 +5353,7 @@ int propagate_rkcs_network(double* t, double delta_t, double* n_steps, double to
 		if (hdid == t_left) break;
 
 		// Check for stopping condition
+		if (stop_reads_network) update_all_var_parameters(X);
 		if (stop_condition.Eval()){
 			error = -2;
 			break;
@@ -3250,6 +5383,64 @@ int propagate_rkcs_network(double* t, double delta_t, double* n_steps, double to
 	return (error);
 }
 
+/*
+ * Binary trajectory output. With a value size set, the .cdat, .gdat and .fdat files are written as
+ * <prefix>.cdat.bin etc. by a Util::TrajectoryWriter, which buffers rows into column chunks and writes them on
+ * its own thread. The init functions still return a FILE*, the writer's, which the print and finish functions
+ * use to look the writer up, so callers don't change. Util::trajectoryToText() turns the files back into text.
+ */
+static int BINARY_OUTPUT = 0; // Bytes per value (8 or 4), 0 for text
+static map<FILE*, Util::TrajectoryWriter*> TRAJECTORY_WRITERS;
+
+void set_binary_output_network(int value_size) {
+	BINARY_OUTPUT = value_size;
+}
+
+static Util::TrajectoryWriter* trajectory_writer(FILE* out) {
+	if (!BINARY_OUTPUT) return NULL;
+	map<FILE*, Util::TrajectoryWriter*>::iterator it = TRAJECTORY_WRITERS.find(out);
+	return (it != TRAJECTORY_WRITERS.end()) ? it->second : NULL;
+}
+
+/*
+ * Writers hold their last rows until they are deleted, so whatever is still open when the program exits (e.g. on
+ * an error) is closed here, leaving complete files.
+ */
+static void close_all_trajectories() {
+	while (!TRAJECTORY_WRITERS.empty()) {
+		Util::TrajectoryWriter* writer = TRAJECTORY_WRITERS.begin()->second;
+		TRAJECTORY_WRITERS.erase(TRAJECTORY_WRITERS.begin());
+		delete writer; // Closes its file
+	}
+}
+
+static Util::TrajectoryWriter* open_trajectory(char* prefix, const char* suffix, int append, int width,
+		int precision, bool header) {
+	char buf[1000];
+	FILE* out;
+	sprintf(buf, "%s.%s.bin", prefix, suffix);
+	// A continuation reads the header back to check it
+	if (!(out = fopen(buf, (append) ? "a+b" : "wb"))) {
+		fprintf(stderr, "Couldn't open file %s.\n", buf);
+		return (NULL);
+	}
+	static bool close_at_exit = false;
+	if (!close_at_exit) {
+		atexit(close_all_trajectories);
+		close_at_exit = true;
+	}
+	Util::TrajectoryWriter* writer = new Util::TrajectoryWriter(out, append, BINARY_OUTPUT == sizeof(float),
+			width, precision, header);
+	TRAJECTORY_WRITERS[out] = writer;
+	return (writer);
+}
+
+static void close_trajectory(FILE* out) {
+	Util::TrajectoryWriter* writer = trajectory_writer(out);
+	TRAJECTORY_WRITERS.erase(out);
+	delete writer; // Closes out
+}
+
 FILE *init_print_concentrations_network(char* prefix, int append){
 	FILE* out;
 	int i, error = 0;
@@ -3261,6 +5452,15 @@ FILE *init_print_concentrations_network(char* prefix, int append){
 	if (append) mode = (char*)"a";
 	else mode = (char*)"w";
 
+	if (BINARY_OUTPUT) {
+		Util::TrajectoryWriter* writer = open_trajectory(prefix, "cdat", append, 19, 12, true);
+		if (!writer) return (NULL);
+		for (i = 0; i < n_species_network(); ++i) {
+			writer->addColumn("S"+Util::toString(i+1));
+		}
+		return (writer->file());
+	}
+
 	sprintf(buf, "%s.cdat", prefix);
 	if (!(out = fopen(buf, mode))) {
 		++error;
@@ -3300,6 +5500,18 @@ int print_concentrations_network(FILE* out, double t) {
 	}
 	n_species = n_species_network();
 
+	if (Util::TrajectoryWriter* writer = trajectory_writer(out)) {
+		writer->beginRow(t);
+		nconc = network.species->elt;
+		for (i = 0; i < n_species; ++i, ++nconc) {
+			conc = (*nconc)->val;
+			if (fabs(conc) < 10*DBL_MIN) conc = 0; // To avoid underflow problems
+			writer->value(conc);
+		}
+		writer->endRow();
+		return (error);
+	}
+
 	fprintf(out, "%19.12e", t);
 	nconc = network.species->elt;
 	for (i = 0; i < n_species; ++i, ++nconc) {
@@ -3324,7 +5536,8 @@ int finish_print_concentrations_network(FILE* out) {
 	}
 
 	/* fprintf(out, "end conc(time)\n"); */
-	fclose(out);
+	if (trajectory_writer(out)) close_trajectory(out);
+	else fclose(out);
 
 //	exit:
 	return (error);
@@ -3346,6 +5559,21 @@ FILE* init_print_group_concentrations_network(char* prefix, int append, bool no_
 		return (out); // exit
 	}*/
 
+	if (BINARY_OUTPUT) {
+		Util::TrajectoryWriter* writer = open_trajectory(prefix, "gdat", append, 19, 12, true);
+		if (!writer) return (NULL);
+		for (group = network.spec_groups; group != NULL; group = group->next) {
+			writer->addColumn(group->name);
+		}
+		// Function values follow the groups on each line (see init_print_function_values_network())
+		if (no_newline) {
+			for (unsigned int i = 1; i < network.functions.size(); ++i) {
+				writer->addColumn(network.rates->elt[network.var_parameters[i]-network.rates->offset]->name);
+			}
+		}
+		return (writer->file());
+	}
+
 	sprintf(buf, "%s.gdat", prefix);
 	if (!(out = fopen(buf, mode))) {
 		++error;
@@ -3389,7 +5617,9 @@ int print_group_concentrations_network(FILE* out, double t, bool no_newline) {
 	X = ALLOC_VECTOR(n_species);
 	get_conc_network(X);
 
-	fprintf(out, fmt, t);
+	Util::TrajectoryWriter* writer = trajectory_writer(out);
+	if (writer) writer->beginRow(t);
+	else fprintf(out, fmt, t);
 	offset = network.species->offset;
 	for (group = network.spec_groups; group != NULL; group = group->next) {
 		conc = 0.0;
@@ -3398,11 +5628,20 @@ int print_group_concentrations_network(FILE* out, double t, bool no_newline) {
 			index = group->elt_index[i] - offset;
 			conc += factor * X[index];
 		}
+		if (writer) {
+			writer->value(conc);
+			continue;
+		}
 		fprintf(out, " ");
 		fprintf(out, fmt, conc);
 	}
-	if (!no_newline) fprintf(out, "\n");
-	fflush(out);
+	if (writer) {
+		if (!no_newline) writer->endRow();
+	}
+	else {
+		if (!no_newline) fprintf(out, "\n");
+		fflush(out);
+	}
 
 //	exit:
 	if (X) FREE_VECTOR(X);
@@ -3416,7 +5655,10 @@ int finish_print_group_concentrations_network(FILE* out, bool leave_open) {
 		++error;
 		return (error); // exit
 	}
-	if (!leave_open) fclose(out);
+	if (!leave_open) {
+		if (trajectory_writer(out)) close_trajectory(out);
+		else fclose(out);
+	}
 
 //	exit:
 	return (error);
@@ -3431,6 +5673,9 @@ int init_print_function_values_network(FILE* out){
 		return error;
 	}
 
+	// Binary files get the function names from init_print_group_concentrations_network()
+	if (trajectory_writer(out)) return error;
+
 	// Write header
 //	fprintf(out, "#");
 //	fprintf(out, "%18s", "time");
@@ -3464,6 +5709,13 @@ int print_function_values_network(FILE* out, double t){
 	exit(1);
 ////*/
 //	fprintf(out, "%19.12e", t);
+	if (Util::TrajectoryWriter* writer = trajectory_writer(out)) {
+		for (unsigned int i = 1; i < network.functions.size(); i++) {
+			writer->value(network.rates->elt[network.var_parameters[i]-network.rates->offset]->val);
+		}
+		writer->endRow();
+		return error;
+	}
 	for (unsigned int i = 1; i < network.functions.size(); i++) { // Don't print 'time' function (i=0)
 		fprintf(out, " %19.12e", network.rates->elt[network.var_parameters[i]-network.rates->offset]->val);
 	}
@@ -3480,7 +5732,8 @@ int finish_print_function_values_network(FILE* out){
 		++error;
 		return error;
 	}
-	fclose(out);
+	if (trajectory_writer(out)) close_trajectory(out);
+	else fclose(out);
 
 	return error;
 }
@@ -3591,6 +5844,12 @@ FILE* init_print_flux_network(char* prefix) {
 	int error = 0;
 	char buf[1000];
 
+	if (BINARY_OUTPUT) {
+		printf("Writing fluxes to file %s.fdat.bin.\n", prefix);
+		Util::TrajectoryWriter* writer = open_trajectory(prefix, "fdat", 0, 15, 8, false);
+		return (writer) ? writer->file() : NULL;
+	}
+
 	sprintf(buf, "%s.fdat", prefix);
 	printf("Writing fluxes to file %s.\n", buf);
 	if (!(out = fopen(buf, "w"))) {
@@ -3618,6 +5877,15 @@ int print_flux_network(FILE* out, double t, int discrete) {
 	rxn_rates_network(rates_rxn,discrete);
 
 	/* Print reaction fluxes */
+	if (Util::TrajectoryWriter* writer = trajectory_writer(out)) {
+		writer->beginRow(t);
+		for (i = 0; i < n_reactions; ++i) {
+			writer->value(rates_rxn[i]);
+		}
+		writer->endRow();
+		if (rates_rxn) FREE_VECTOR(rates_rxn);
+		return (error);
+	}
 	fprintf(out, fmt, t);
 	for (i = 0; i < n_reactions; ++i) {
 		fprintf(out, " ");
@@ -3631,6 +5899,19 @@ int print_flux_network(FILE* out, double t, int discrete) {
 	return (error);
 }
 
+int finish_print_flux_network(FILE* out) {
+	int error = 0;
+
+	if (!out) {
+		++error;
+		return (error);
+	}
+	if (trajectory_writer(out)) close_trajectory(out);
+	else fclose(out);
+
+	return (error);
+}
+
 int print_network(FILE* out) {
 	int error = 0;
 	if (network.rates) {
@@ -3893,7 +6174,7 @@ public:
 	}
 };
 
-static struct {
+struct GSP_STATE {
 	double* c; /* concentrations- could be integer */
 	int* ever_populated; /* array of length nc: element is 1 if corresponding species was ever populated, 0 otherwise --justin */
 	double* c_offset; /* Offset pointer for passing to routines that use species element indices */
@@ -3929,7 +6210,11 @@ static struct {
 	vector<vector<int> > rxn_update_func;
 	vector<vector<int> > rxn_update_rxn;
 
-} GSP;
+	// Number of species with nonzero population, kept by update_concentrations()
+	int n_spec_act;
+	bool n_spec_act_ready;
+};
+#define GSP (*STATE->gsp)
 
 int n_species_ever_populated() {
 	int ii;
@@ -4403,6 +6688,311 @@ int create_update_lists() {
 	return (err);
 }
 
+/*
+ * Next reaction selection for the direct method.
+ *
+ * SSA_LINEAR scans the propensities, keeping them roughly sorted by swapping neighbors.
+ * This is cheap for small networks but O(N) per step.
+ *
+ * SSA_SUM_TREE keeps the propensities in the leaves of a complete binary tree whose
+ * internal nodes hold the sums of their children, so that both updates and selection
+ * are O(log N).
+ *
+ * SSA_COMPOSITION_REJECTION (Slepoy, Thompson & Plimpton, J Chem Phys 128:205101, 2008)
+ * groups reactions by the binary exponent of their propensity. A group is chosen by a
+ * linear search over the (few) nonempty groups and a reaction within the group by
+ * rejection sampling, which accepts with probability at least 1/2. Both steps are
+ * independent of N.
+ *
+ * Since all three pick reaction j with probability a_j/a_tot, trajectories are
+ * statistically identical, but not identical for the same seed.
+ *
+ * SSA_NEXT_REACTION is not a selector for the direct method but the state of the next
+ * reaction method (Gibson & Bruck, J Phys Chem A 104:1876, 2000), see next_reaction_network().
+ */
+struct SSA_SEL_STATE {
+	int type;
+	// SSA_SUM_TREE
+	vector<double> tree; // node k has children 2k and 2k+1, leaves start at n_leaves
+	int n_leaves;
+	vector<int> dirty; // nodes changed since the last sum_tree_propagate()
+	// SSA_COMPOSITION_REJECTION
+	vector<vector<int> > group_rxns; // reactions in each group
+	vector<double> group_sum; // propensity sum of each group
+	vector<int> rxn_group; // group of each reaction (-1 if propensity is zero)
+	vector<int> rxn_pos; // position of each reaction in its group
+	vector<int> active_groups; // nonempty groups
+	vector<int> group_active_pos; // position of each group in active_groups (-1 if empty)
+	// SSA_NEXT_REACTION
+	vector<double> nrm_tau; // absolute putative firing time of each reaction
+	vector<int> nrm_heap; // binary min-heap of reactions ordered by nrm_tau
+	vector<int> nrm_pos; // position of each reaction in nrm_heap
+	double nrm_t; // current time
+	bool nrm_ready; // false until the putative times have been drawn
+};
+#define SSA_SEL (*STATE->ssa_sel)
+
+/* Groups hold propensities in [2^(k-1-CR_EXP_OFFSET), 2^(k-CR_EXP_OFFSET)), which covers
+ * every positive double with frexp() exponents between -1073 and 1024 */
+static const int CR_EXP_OFFSET = 1074;
+static const int CR_N_GROUPS = 2100;
+
+void set_gillespie_selector_network(int selector) {
+	SSA_SEL.type = selector;
+}
+
+/* Propagates changed leaves up the tree. The update lists are sorted, so the changed
+ * nodes are in increasing order on every level and shared ancestors are adjacent. Sums
+ * are recomputed rather than adjusted by differences, so they never accumulate rounding
+ * errors. */
+static void sum_tree_propagate() {
+	vector<int>& dirty = SSA_SEL.dirty;
+	unsigned int i, n;
+	while (!dirty.empty() && dirty[0] > 1) {
+		n = 0;
+		for (i = 0; i < dirty.size(); ++i) {
+			int parent = dirty[i] / 2;
+			if (n > 0 && dirty[n-1] == parent) continue;
+			SSA_SEL.tree[parent] = SSA_SEL.tree[2*parent] + SSA_SEL.tree[2*parent+1];
+			dirty[n++] = parent;
+		}
+		dirty.resize(n);
+	}
+	dirty.clear();
+	GSP.a_tot = SSA_SEL.tree[1];
+}
+
+static void cr_remove(int irxn) {
+	int g = SSA_SEL.rxn_group[irxn];
+	if (g < 0) return;
+	vector<int>& members = SSA_SEL.group_rxns[g];
+	int pos = SSA_SEL.rxn_pos[irxn];
+	members[pos] = members.back();
+	SSA_SEL.rxn_pos[members[pos]] = pos;
+	members.pop_back();
+	SSA_SEL.rxn_group[irxn] = -1;
+	if (members.empty()) {
+		SSA_SEL.group_sum[g] = 0.0; // Reset so that rounding errors don't survive
+		int apos = SSA_SEL.group_active_pos[g];
+		SSA_SEL.active_groups[apos] = SSA_SEL.active_groups.back();
+		SSA_SEL.group_active_pos[SSA_SEL.active_groups[apos]] = apos;
+		SSA_SEL.active_groups.pop_back();
+		SSA_SEL.group_active_pos[g] = -1;
+	}
+	else {
+		SSA_SEL.group_sum[g] -= GSP.a[irxn];
+	}
+}
+
+static void cr_insert(int irxn, double anew) {
+	if (anew <= 0.0) return;
+	int e;
+	frexp(anew, &e);
+	int g = e + CR_EXP_OFFSET;
+	if (SSA_SEL.group_active_pos[g] < 0) {
+		SSA_SEL.group_active_pos[g] = SSA_SEL.active_groups.size();
+		SSA_SEL.active_groups.push_back(g);
+	}
+	SSA_SEL.rxn_group[irxn] = g;
+	SSA_SEL.rxn_pos[irxn] = SSA_SEL.group_rxns[g].size();
+	SSA_SEL.group_rxns[g].push_back(irxn);
+	SSA_SEL.group_sum[g] += anew;
+}
+
+static inline void nrm_swap(int i, int j) {
+	int ri = SSA_SEL.nrm_heap[i], rj = SSA_SEL.nrm_heap[j];
+	SSA_SEL.nrm_heap[i] = rj;
+	SSA_SEL.nrm_heap[j] = ri;
+	SSA_SEL.nrm_pos[rj] = i;
+	SSA_SEL.nrm_pos[ri] = j;
+}
+
+/* Restores the heap order after the putative time of irxn changed */
+static void nrm_update_heap(int irxn) {
+	vector<int>& heap = SSA_SEL.nrm_heap;
+	vector<double>& tau = SSA_SEL.nrm_tau;
+	int n = heap.size();
+	int i = SSA_SEL.nrm_pos[irxn];
+	while (i > 0 && tau[heap[(i-1)/2]] > tau[irxn]) {
+		nrm_swap(i, (i-1)/2);
+		i = (i-1)/2;
+	}
+	while (1) {
+		int child = 2*i+1;
+		if (child >= n) break;
+		if (child+1 < n && tau[heap[child+1]] < tau[heap[child]]) ++child;
+		if (tau[heap[child]] >= tau[irxn]) break;
+		nrm_swap(i, child);
+		i = child;
+	}
+}
+
+/* Draws a new putative time for irxn from the current time and propensity a */
+static void nrm_draw_time(int irxn, double a) {
+	double rnd;
+	if (a > 0.0) {
+		while ( (rnd = RANDOM(0.0, 1.0)) == 0.0 || rnd == 1.0 )
+			;
+		SSA_SEL.nrm_tau[irxn] = SSA_SEL.nrm_t - log(rnd) / a;
+	}
+	else {
+		SSA_SEL.nrm_tau[irxn] = INFINITY;
+	}
+	nrm_update_heap(irxn);
+}
+
+/* Draws putative times for all reactions at time t and builds the heap */
+static void nrm_init_times(double t) {
+	int i;
+	SSA_SEL.nrm_t = t;
+	SSA_SEL.nrm_tau.assign(GSP.na, INFINITY);
+	SSA_SEL.nrm_heap.resize(GSP.na);
+	SSA_SEL.nrm_pos.resize(GSP.na);
+	for (i = 0; i < GSP.na; ++i) {
+		SSA_SEL.nrm_heap[i] = i;
+		SSA_SEL.nrm_pos[i] = i;
+	}
+	for (i = 0; i < GSP.na; ++i) {
+		nrm_draw_time(i, GSP.a[i]);
+	}
+	SSA_SEL.nrm_ready = true;
+}
+
+/* Builds the selector from scratch for the current GSP.a and sets GSP.a_tot */
+static void init_selector() {
+	int i;
+	if (SSA_SEL.type == SSA_SUM_TREE) {
+		for (SSA_SEL.n_leaves = 1; SSA_SEL.n_leaves < GSP.na; SSA_SEL.n_leaves *= 2)
+			;
+		SSA_SEL.tree.assign(2*SSA_SEL.n_leaves, 0.0);
+		for (i = 0; i < GSP.na; ++i) {
+			SSA_SEL.tree[SSA_SEL.n_leaves + i] = GSP.a[i];
+		}
+		for (i = SSA_SEL.n_leaves-1; i >= 1; --i) {
+			SSA_SEL.tree[i] = SSA_SEL.tree[2*i] + SSA_SEL.tree[2*i+1];
+		}
+		GSP.a_tot = SSA_SEL.tree[1];
+	}
+	else if (SSA_SEL.type == SSA_COMPOSITION_REJECTION) {
+		SSA_SEL.group_rxns.assign(CR_N_GROUPS, vector<int>());
+		SSA_SEL.group_sum.assign(CR_N_GROUPS, 0.0);
+		SSA_SEL.group_active_pos.assign(CR_N_GROUPS, -1);
+		SSA_SEL.active_groups.clear();
+		SSA_SEL.rxn_group.assign(GSP.na, -1);
+		SSA_SEL.rxn_pos.assign(GSP.na, -1);
+		GSP.a_tot = 0.0;
+		for (i = 0; i < GSP.na; ++i) {
+			cr_insert(i, GSP.a[i]);
+			GSP.a_tot += GSP.a[i];
+		}
+	}
+	else if (SSA_SEL.type == SSA_NEXT_REACTION && SSA_SEL.nrm_ready) {
+		// Reactions were added on the fly. They all start with zero propensity, so they
+		// never fire until update_rxn_rates() gives them a rate.
+		int na_old = SSA_SEL.nrm_tau.size();
+		SSA_SEL.nrm_tau.resize(GSP.na, INFINITY);
+		SSA_SEL.nrm_pos.resize(GSP.na);
+		for (i = na_old; i < GSP.na; ++i) {
+			SSA_SEL.nrm_pos[i] = SSA_SEL.nrm_heap.size();
+			SSA_SEL.nrm_heap.push_back(i);
+		}
+	}
+}
+
+/* Sets the propensity of a reaction, keeping GSP.a_tot and the selector up to date.
+ * For SSA_SUM_TREE, GSP.a_tot is only updated by the sum_tree_propagate() call that
+ * must follow a series of these. */
+static void set_propensity(int irxn, double anew) {
+	if (anew == GSP.a[irxn]) return;
+	if (SSA_SEL.type == SSA_SUM_TREE) {
+		SSA_SEL.tree[SSA_SEL.n_leaves + irxn] = anew;
+		SSA_SEL.dirty.push_back(SSA_SEL.n_leaves + irxn);
+	}
+	else {
+		if (SSA_SEL.type == SSA_NEXT_REACTION && SSA_SEL.nrm_ready) {
+			// Rescale the time remaining until the putative firing time, so that no new
+			// random number is needed. Reactions that had zero propensity have no time to
+			// rescale and get a fresh one.
+			double aold = GSP.a[irxn];
+			if (anew > 0.0 && aold > 0.0) {
+				double t = SSA_SEL.nrm_t;
+				SSA_SEL.nrm_tau[irxn] = t + (aold/anew)*(SSA_SEL.nrm_tau[irxn] - t);
+				nrm_update_heap(irxn);
+			}
+			else {
+				nrm_draw_time(irxn, anew);
+			}
+		}
+		else if (SSA_SEL.type == SSA_COMPOSITION_REJECTION) {
+			int g = SSA_SEL.rxn_group[irxn], e;
+			frexp(anew, &e);
+			if (g >= 0 && anew > 0.0 && e + CR_EXP_OFFSET == g) {
+				SSA_SEL.group_sum[g] += anew - GSP.a[irxn]; // Stays in the same group
+			}
+			else {
+				cr_remove(irxn);
+				cr_insert(irxn, anew);
+			}
+		}
+		GSP.a_tot += anew - GSP.a[irxn];
+	}
+	GSP.a[irxn] = anew;
+}
+
+static int select_next_rxn_sum_tree() {
+	double f, left;
+	int node;
+	// All leaves are non-negative, so GSP.a_tot == tree[1] > 0 guarantees a leaf with a > 0
+	while ( (f = RANDOM(0.0, GSP.a_tot)) == 0.0 )
+		;
+	node = 1;
+	while (node < SSA_SEL.n_leaves) {
+		left = SSA_SEL.tree[2*node];
+		// Guard against rounding sending us down a branch with zero propensity
+		if ((f <= left && left > 0.0) || SSA_SEL.tree[2*node+1] <= 0.0) {
+			node = 2*node;
+		}
+		else {
+			f -= left;
+			node = 2*node+1;
+		}
+	}
+	return (node - SSA_SEL.n_leaves);
+}
+
+static int select_next_rxn_composition_rejection() {
+	double f, g_sum, a_max;
+	int i, g, irxn;
+
+	while (1) {
+		// choose the group by linear search
+		while ( (f = RANDOM(0.0, GSP.a_tot)) == 0.0 )
+			;
+		g = -1;
+		g_sum = 0.0;
+		for (i = 0; i < (int)SSA_SEL.active_groups.size(); ++i) {
+			g = SSA_SEL.active_groups[i];
+			g_sum += SSA_SEL.group_sum[g];
+			if (f <= g_sum) break;
+		}
+		if (i == (int)SSA_SEL.active_groups.size()) {
+			// Rounding errors in GSP.a_tot: recompute and try again
+			GSP.a_tot = g_sum;
+			if (g_sum <= 0.0) return (GSP.na);
+			// Fall back on the last group if f just missed the end
+			if (g < 0 || f - g_sum > 1e-12*g_sum) continue;
+		}
+
+		// choose the reaction within the group by rejection
+		vector<int>& members = SSA_SEL.group_rxns[g];
+		a_max = ldexp(1.0, g - CR_EXP_OFFSET);
+		while (1) {
+			irxn = members[(int)(RANDOM(0.0, 1.0)*members.size()) % members.size()];
+			if (RANDOM(0.0, a_max) < GSP.a[irxn]) return (irxn);
+		}
+	}
+}
+
 int init_gillespie_direct_network(int update_interval, int seed) {
 	int i;
 	Rxn** rarray;
@@ -4441,7 +7031,7 @@ int init_gillespie_direct_network(int update_interval, int seed) {
 //	rarray = network.reactions->rxn;
 	for (i = 0; i < GSP.na; ++i) {
 //		GSP.a[i] = rxn_rate(rarray, GSP.c_offset, 1);
-		GSP.a[i] = rxn_rate(network.reactions->rxn[i], GSP.c_offset, 1);
+		GSP.a[i] = rxn_rate(i, GSP.c_offset, 1);
 		GSP.a_tot += GSP.a[i];
 	}
 
@@ -4457,6 +7047,7 @@ int init_gillespie_direct_network(int update_interval, int seed) {
 	for (i = 0; i < GSP.na; i++){
 		GSP.prop.push_back(i);
 	}
+	init_selector();
 
 	// Arrays used in creating the update lists
 	GSP.included = new GSP_included_arrays;
@@ -4505,6 +7096,7 @@ int update_gillespie_direct_network(int n_spec_new, int n_rxns_new) {
 	for (i = na_old;i < GSP.na;i++){
 		GSP.prop.push_back(i);
 	}
+	init_selector();
 
 	// Arrays used in creating the update lists
 	delete_GSP_included();
@@ -4655,6 +7247,9 @@ int select_next_rxn() {
 	int irxn, temp_prop;
 	double f, a_sum;
 
+	if (SSA_SEL.type == SSA_SUM_TREE) return select_next_rxn_sum_tree();
+	if (SSA_SEL.type == SSA_COMPOSITION_REJECTION) return select_next_rxn_composition_rejection();
+
 	// find next reaction
     while (1) {
 
@@ -4704,26 +7299,21 @@ int update_concentrations(int irxn) {
 	int i;
 	int offset;
 	int force_update = 0;
-	Rxn* rxn;
-	Elt** spec;
+	const Rxn_layout& L = network.layout;
 	iarray* spec_newpop = 0x0;
 	const int thresh_occ = 10;
-	static int n_spec_act = 0;
-	static int initialize = 1;
 
-	if (initialize) {
-		n_spec_act = n_species_active();
-		initialize = 0;
+	if (!GSP.n_spec_act_ready) {
+		GSP.n_spec_act = n_species_active();
+		GSP.n_spec_act_ready = true;
 	}
 
-	rxn = network.reactions->rxn[irxn];
 	offset = network.species->offset;
 
 	/* loop over reactants */
-	spec = network.species->elt;
-	for (i = 0; i < rxn->n_reactants; ++i) {
-		int ri = rxn->r_index[i] - offset;
-		if (!spec[ri]->fixed) {
+	for (i = L.r_start[irxn]; i < L.r_start[irxn+1]; ++i) {
+		int ri = L.r_index[i] - offset;
+		if (!L.fixed[ri]) {
 			double newpop = --GSP.c[ri];
 			if (newpop < 1.0){
 				GSP.c[ri] = 0; // This must be done to avoid negative concentrations!
@@ -4735,9 +7325,9 @@ int update_concentrations(int irxn) {
 	}
 
 	/* loop over products */
-	for (i = 0; i < rxn->n_products; ++i) {
-		int pi = rxn->p_index[i] - offset;
-		if (!spec[pi]->fixed) {
+	for (i = L.p_start[irxn]; i < L.p_start[irxn+1]; ++i) {
+		int pi = L.p_index[i] - offset;
+		if (!L.fixed[pi]) {
 			double newpop = ++GSP.c[pi];
 			if (newpop <= thresh_occ)
 				force_update = 1;
@@ -4769,7 +7359,7 @@ int update_concentrations(int irxn) {
 		int nspec_newpop = spec_newpop->l_arr[0];
 		int* ispec_newpop = spec_newpop->arr[0];
 
-		++n_spec_act;
+		++GSP.n_spec_act;
 		/* Call network generator with index and name of newly populated species */
 		elt = network.species->elt - network.species->offset;
 		printf("edgepop:");
@@ -4785,6 +7375,7 @@ int update_concentrations(int irxn) {
 		if (strncmp("read", line, 4) == 0) {
 			/* Read new species */
 			spec_new = read_Elt_array(stdin, &line_number, (char*)"species", &n_spec_new, 0x0);
+			if (n_spec_new < 0) exit(1); // The errors in the list from the generator have been reported
 			append_Elt_array(network.species, spec_new);
 			/*cout << "n_spec_new: " << n_spec_new << endl;
 			if (n_spec_new > 0){
@@ -4800,6 +7391,7 @@ int update_concentrations(int irxn) {
 			rxns_new = read_Rxn_array(stdin, &line_number, &n_rxns_new, network.species, network.rates,
 					network.is_func_map);
 			append_Rxn_array(network.reactions, rxns_new);
+			update_layout_network();
 			/*cout << "n_rxns_new: " << n_rxns_new << endl;
 			if (n_rxns_new > 0){
 				for (Rxn* r = rxns_new->list;r != NULL;r = r->next){
@@ -4813,9 +7405,10 @@ int update_concentrations(int irxn) {
 
 			/* Read group updates */
 			read_Groups(network.spec_groups, stdin, network.species, &line_number, (char*)"groups", &n_groups_updated);
+			if (n_groups_updated < 0) exit(1); // read_Groups() has reported the errors and freed the groups
 
 			printf( "At step %d added %d new species (%d total %d active) %d new reactions (%d total)\n",
-					(int)(GSP.n_steps+0.5), n_spec_new, GSP.nc, n_spec_act, n_rxns_new, GSP.na );
+					(int)(GSP.n_steps+0.5), n_spec_new, GSP.nc, GSP.n_spec_act, n_rxns_new, GSP.na );
 			/* 	if (n_groups_updated){
 			 	  printf("  and updated %d groups.", n_groups_updated);
 			 	}
@@ -4840,10 +7433,9 @@ int update_concentrations(int irxn) {
 
 void update_rxn_rates(int irxn) {
 	//iarray *iarr;
-	Rxn** rarray;
 	unsigned int j;
 	int jrxn; //, n_rxns, *rxns;
-	double *a, anew, *c;
+	double anew;
 
 	if (network.has_functions){
 		// Update observables
@@ -4872,15 +7464,12 @@ void update_rxn_rates(int irxn) {
 	}
 
 	// Loop over reactions in rxn update list updating both reaction and total rate
-	rarray = network.reactions->rxn;
-	c = GSP.c_offset;
-	a = GSP.a;
 	for (j = 0; j < GSP.rxn_update_rxn[irxn].size(); j++) {
 		jrxn = GSP.rxn_update_rxn[irxn][j];
-		anew = rxn_rate(rarray[jrxn], GSP.c_offset, 1);
-		GSP.a_tot += anew - a[jrxn];
-		a[jrxn] = anew;
+		anew = rxn_rate(jrxn, GSP.c_offset, 1);
+		set_propensity(jrxn, anew);
 	}
+	if (SSA_SEL.type == SSA_SUM_TREE) sum_tree_propagate();
 
 	// Error check
 	if (GSP.a_tot < 0.0){
@@ -4997,6 +7586,333 @@ int gillespie_direct_network(double* t, double delta_t, double* C_avg, double* C
 	return (error);
 }
 
+/* Init function for the next reaction method. Shares all of its state with the direct method. */
+int init_next_reaction_network(int update_interval, int seed) {
+	SSA_SEL.type = SSA_NEXT_REACTION;
+	SSA_SEL.nrm_ready = false;
+	return (init_gillespie_direct_network(update_interval, seed));
+}
+
+/*
+ * Next reaction method (Gibson & Bruck, J Phys Chem A 104:1876, 2000). Every reaction has
+ * an absolute putative firing time, kept in an indexed binary heap, and the reaction with
+ * the earliest time fires next. When a propensity changes from a_old to a_new, the time
+ * remaining until its putative time is rescaled by a_old/a_new instead of being redrawn,
+ * so each step needs a single random number, for the reaction that fired, and O(log N)
+ * heap updates for the reactions in its update list (GSP.rxn_update_rxn).
+ */
+int next_reaction_network(double* t, double delta_t, double* C_avg, double* C_sig, double maxStep,
+		mu::Parser& stop_condition) {
+
+	double t_end, t_next;
+	int irxn;
+	int error = 0;
+	int rxn_rate_update;
+	bool reached_end = false;
+
+	t_end = *t + delta_t;
+
+	if (!GSP.c) {
+		fprintf(stderr,"next_reaction_network called without initialization.\n");
+		exit(1);
+	}
+
+	if (!SSA_SEL.nrm_ready) nrm_init_times(*t);
+
+	while (1){
+
+		// Don't exceed maxStep limit
+		if (GSP.n_steps >= maxStep){
+			error = -1; // Step limit reached
+			break;
+		}
+
+		// Don't fire the next reaction if it occurs past the current integration endpoint.
+		// This also covers an empty heap or all propensities being zero.
+		irxn = (SSA_SEL.nrm_heap.empty() ? -1 : SSA_SEL.nrm_heap[0]);
+		t_next = (irxn < 0 ? INFINITY : SSA_SEL.nrm_tau[irxn]);
+		if (t_next > t_end){
+			reached_end = true;
+			break;
+		}
+		SSA_SEL.nrm_t = *t = t_next;
+
+		/* fire rule by updating concentrations */
+		rxn_rate_update = update_concentrations(irxn);
+		++GSP.n_steps;
+
+		/* update rxn rates */
+		double GSP_interval = (double)GSP.rxn_rate_update_interval;
+		double fmod = GSP.n_steps - (double)((long)(GSP.n_steps/GSP_interval))*GSP_interval;
+		if (rxn_rate_update || fmod <= 1e-12){ // Use 1e-12 as a tolerance
+			update_rxn_rates(irxn);
+		}
+
+		// The reaction that fired always needs a new putative time
+		nrm_draw_time(irxn, GSP.a[irxn]);
+
+		// Check stopping condition
+		if (stop_condition.Eval()){
+			error = -2; // Stop condition satisfied
+			break;
+		}
+	}
+
+	if (reached_end){
+		SSA_SEL.nrm_t = *t = t_end;
+		// Need to update time(), functions that depend on time(), and rates that depend on time()
+		if (network.has_functions){
+			update_rxn_rates(0); // All rxns have the necessary update lists, so just call any of them
+		}
+	}
+
+	/* Set final network concentrations */
+	set_conc_network(GSP.c);
+
+	return (error);
+}
+
+/*
+ * Ensembles of SSA trajectories. All of the simulation state (network, GSP, SSA_SEL and the random
+ * number generator) is global, so the trajectories are run in worker processes rather than threads.
+ * Each worker is forked from the initialized simulator, which gives it a private copy of the network
+ * in its initial state without reading the .net file again, reseeds the generator with seed+run and
+ * sends the species and group values at every sample time back through a pipe. The parent folds
+ * the trajectories into running means and variances (Welford's method), in the order of the runs,
+ * so that the statistics for a given seed do not depend on the number of workers.
+ */
+static bool write_all(int fd, const char* buf, size_t n) {
+	while (n > 0) {
+		ssize_t w = write(fd, buf, n);
+		if (w < 0 && errno == EINTR) continue;
+		if (w <= 0) return false;
+		buf += w;
+		n -= w;
+	}
+	return true;
+}
+
+// Species values followed by group totals
+static void ensemble_sample(double* out) {
+	int n_species = n_species_network();
+	get_conc_network(out);
+	double* g = out + n_species;
+	int offset = network.species->offset;
+	for (Group* group = network.spec_groups; group != NULL; group = group->next, ++g) {
+		*g = 0.0;
+		for (int i = 0; i < group->n_elt; ++i) {
+			double factor = (group->elt_factor) ? group->elt_factor[i] : 1.0;
+			*g += factor * out[group->elt_index[i] - offset];
+		}
+	}
+}
+
+// Runs one trajectory in a forked worker and writes it to fd. A trajectory that meets the stopping
+// condition or the step limit keeps its last state for the remaining sample times.
+static void ensemble_trajectory(int run, int seed, const vector<double>& times, double maxStep,
+		mu::Parser& stop_condition, int fd) {
+	int n_values = n_species_network() + n_groups_network();
+	vector<double> x((times.size())*n_values);
+	double t = times[0];
+	bool stopped = false;
+
+	SEED_RANDOM(seed + run);
+	ensemble_sample(&x[0]);
+	for (unsigned int n = 1; n < times.size(); ++n) {
+		if (!stopped && times[n] > t) {
+			int error;
+			if (SSA_SEL.type == SSA_NEXT_REACTION)
+				error = next_reaction_network(&t, times[n]-t, NULL, NULL, maxStep, stop_condition);
+			else
+				error = gillespie_direct_network(&t, times[n]-t, NULL, NULL, maxStep, stop_condition);
+			if (error) stopped = true;
+		}
+		ensemble_sample(&x[n*n_values]);
+	}
+	if (!write_all(fd, (const char*)&x[0], x.size()*sizeof(double))) _exit(1);
+	_exit(0);
+}
+
+static void print_ensemble_header(FILE* out, const vector<string>& names) {
+	fprintf(out, "#%18s", "time");
+	for (unsigned int i = 0; i < names.size(); ++i) fprintf(out, " %19s", names[i].c_str());
+	for (unsigned int i = 0; i < names.size(); ++i) fprintf(out, " %19s", (names[i] + "_stddev").c_str());
+	fprintf(out, "\n");
+}
+
+static void print_ensemble_row(FILE* out, double t, const double* mean, const double* m2, int first,
+		int n, int n_runs) {
+	fprintf(out, "%19.12e", t);
+	for (int i = first; i < first+n; ++i) fprintf(out, " %19.12e", mean[i]);
+	for (int i = first; i < first+n; ++i) {
+		double sd = (n_runs > 1) ? sqrt(m2[i] / (n_runs-1)) : 0.0;
+		fprintf(out, " %19.12e", sd);
+	}
+	fprintf(out, "\n");
+}
+
+int gillespie_ensemble_network(int n_runs, int n_workers, int seed, double t_start, double sample_time,
+		double* sample_times, int n_sample, double maxStep, mu::Parser& stop_condition, char* prefix,
+		bool print_cdat) {
+
+	int n_species = n_species_network();
+	int n_values = n_species + n_groups_network();
+	char buf[1000];
+
+	if (!GSP.c) {
+		fprintf(stderr,"gillespie_ensemble_network called without initialization.\n");
+		exit(1);
+	}
+	if (n_workers < 1) n_workers = 1;
+	if (n_workers > n_runs) n_workers = n_runs;
+	if (seed < 0) seed = (int)time(NULL);
+
+	// Sample times, computed the way run_network computes them for a single trajectory
+	vector<double> times(n_sample+1);
+	times[0] = t_start;
+	for (int n = 1; n <= n_sample; ++n) {
+		times[n] = (sample_times) ? sample_times[n] : times[n-1] + sample_time;
+	}
+	int traj_size = (n_sample+1)*n_values;
+
+	fprintf(stdout, "Running %d SSA trajectories in %d worker processes (seeds %d to %d)\n",
+			n_runs, n_workers, seed, seed + n_runs - 1);
+	fflush(stdout);
+	fflush(stderr);
+
+	// Running statistics, and the trajectories that finished ahead of their turn
+	vector<double> mean(traj_size, 0.0), m2(traj_size, 0.0);
+	vector<vector<double> > pending(n_runs);
+	vector<char> finished(n_runs, 0);
+	vector<int> run_of_worker(n_workers, -1), fd_of_worker(n_workers, -1);
+	vector<pid_t> pid_of_worker(n_workers, 0);
+	vector<size_t> bytes_of_worker(n_workers, 0);
+	int next_run = 0, n_folded = 0, n_active = 0;
+
+	while (n_folded < n_runs) {
+		// Keep all workers busy
+		for (int w = 0; w < n_workers && next_run < n_runs; ++w) {
+			if (run_of_worker[w] >= 0) continue;
+			int fd[2];
+			if (pipe(fd) != 0) {
+				fprintf(stderr, "ERROR: Couldn't open a pipe to an SSA worker (%s).\n", strerror(errno));
+				exit(1);
+			}
+			pid_t pid = fork();
+			if (pid < 0) {
+				fprintf(stderr, "ERROR: Couldn't start an SSA worker (%s).\n", strerror(errno));
+				exit(1);
+			}
+			if (pid == 0) {
+				close(fd[0]);
+				for (int v = 0; v < n_workers; ++v) if (fd_of_worker[v] >= 0) close(fd_of_worker[v]);
+				ensemble_trajectory(next_run, seed, times, maxStep, stop_condition, fd[1]);
+			}
+			close(fd[1]);
+			run_of_worker[w] = next_run++;
+			fd_of_worker[w] = fd[0];
+			pid_of_worker[w] = pid;
+			bytes_of_worker[w] = 0;
+			pending[run_of_worker[w]].resize(traj_size);
+			++n_active;
+		}
+
+		// Read from whichever workers have data
+		if (n_active > 0) {
+			vector<struct pollfd> fds;
+			vector<int> worker;
+			for (int w = 0; w < n_workers; ++w) {
+				if (run_of_worker[w] < 0) continue;
+				struct pollfd p;
+				p.fd = fd_of_worker[w];
+				p.events = POLLIN;
+				p.revents = 0;
+				fds.push_back(p);
+				worker.push_back(w);
+			}
+			if (poll(&fds[0], fds.size(), -1) < 0) {
+				if (errno == EINTR) continue;
+				fprintf(stderr, "ERROR: Lost contact with the SSA workers (%s).\n", strerror(errno));
+				exit(1);
+			}
+			for (unsigned int k = 0; k < fds.size(); ++k) {
+				if (!fds[k].revents) continue;
+				int w = worker[k];
+				int run = run_of_worker[w];
+				char* dest = (char*)&pending[run][0];
+				size_t total = traj_size*sizeof(double);
+				ssize_t r = read(fd_of_worker[w], dest + bytes_of_worker[w], total - bytes_of_worker[w]);
+				if (r < 0 && errno == EINTR) continue;
+				if (r > 0) {
+					bytes_of_worker[w] += r;
+					if (bytes_of_worker[w] < total) continue;
+				}
+				// Trajectory complete, or the worker died
+				int status;
+				close(fd_of_worker[w]);
+				waitpid(pid_of_worker[w], &status, 0);
+				if (bytes_of_worker[w] < total || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					fprintf(stderr, "ERROR: SSA worker for run %d failed.\n", run);
+					exit(1);
+				}
+				finished[run] = 1;
+				run_of_worker[w] = -1;
+				fd_of_worker[w] = -1;
+				--n_active;
+			}
+		}
+
+		// Fold finished trajectories into the statistics, in run order
+		while (n_folded < n_runs && finished[n_folded]) {
+			const double* x = &pending[n_folded][0];
+			double k = n_folded + 1;
+			for (int i = 0; i < traj_size; ++i) {
+				double delta = x[i] - mean[i];
+				mean[i] += delta / k;
+				m2[i] += delta * (x[i] - mean[i]);
+			}
+			vector<double>().swap(pending[n_folded]);
+			++n_folded;
+		}
+	}
+
+	// Output: means followed by standard deviations
+	vector<string> names;
+	if (print_cdat) {
+		FILE* out;
+		sprintf(buf, "%s.cdat", prefix);
+		if (!(out = fopen(buf, "w"))) {
+			fprintf(stderr, "Couldn't open file %s.\n", buf);
+			exit(1);
+		}
+		for (int i = 0; i < n_species; ++i) names.push_back("S" + Util::toString(i+1));
+		print_ensemble_header(out, names);
+		for (int n = 0; n <= n_sample; ++n) {
+			print_ensemble_row(out, times[n], &mean[0], &m2[0], n*n_values, n_species, n_runs);
+		}
+		fclose(out);
+		fprintf(stdout, "Ensemble mean and standard deviation of concentrations written to file %s.\n", buf);
+	}
+	if (n_groups_network()) {
+		FILE* out;
+		sprintf(buf, "%s.gdat", prefix);
+		if (!(out = fopen(buf, "w"))) {
+			fprintf(stderr, "Couldn't open file %s.\n", buf);
+			exit(1);
+		}
+		names.clear();
+		for (Group* group = network.spec_groups; group != NULL; group = group->next) names.push_back(group->name);
+		print_ensemble_header(out, names);
+		for (int n = 0; n <= n_sample; ++n) {
+			print_ensemble_row(out, times[n], &mean[0], &m2[0], n*n_values + n_species, n_groups_network(), n_runs);
+		}
+		fclose(out);
+		fprintf(stdout, "Ensemble mean and standard deviation of groups written to file %s.\n", buf);
+	}
+
+	return (0);
+}
+
 double gillespie_frac_species_active() {
 	int i;
 	int n_act = 0;
@@ -5033,3 +7949,129 @@ void delete_GSP_included(){
 	GSP.included = NULL;
 	return;
 }
+
+/* Makes the ODE propagators start over from the current concentrations on their next call, e.g. after
+ * the rate constants or the concentrations have been changed */
+void reset_ode_network() {
+	ODE.initflag = 0;
+	ODE.rkcs_hnext = 0.0;
+	HYBRID.initflag = 0;
+}
+
+/* Sets the parameter called name to value, recomputes the parameters whose expressions depend on it
+ * and the rate constants of the reactions, and restarts the ODE propagators. A parameter that has
+ * been set keeps its value when other parameters are set. Returns 1 if there is no such parameter. */
+int set_parameter_network(const char* name, double value) {
+	vector<myParser>& P = network.parameters;
+	unsigned int i, j, k;
+
+	for (i = 0; i < P.size() && P[i].name != name; ++i);
+	if (i == P.size()) return (1);
+	P[i].val = value;
+	P[i].overridden = true;
+
+	// An expression holds the addresses of the parameters it reads, which may have moved while
+	// network.parameters grew, so they are linked again before it is evaluated
+	for (j = 0; j < P.size(); ++j) {
+		if (P[j].overridden) continue;
+		mu::varmap_type vars = P[j].p.GetVar();
+		for (mu::varmap_type::const_iterator v = vars.begin(); v != vars.end(); ++v) {
+			for (k = 0; k < j && P[k].name != v->first; ++k);
+			if (k < j) P[j].p.DefineVar(v->first, &P[k].val);
+		}
+		P[j].val = P[j].p.Eval();
+	}
+
+	// Parameters are the first elements of the rates array, in the same order
+	for (j = 0; j < P.size(); ++j) network.rates->elt[j]->val = P[j].val;
+	Elt** karray = network.rates->elt - network.rates->offset;
+	for (j = 0; j < (unsigned int)n_rxns_network(); ++j) {
+		Rxn* rxn = network.reactions->rxn[j];
+		if (!rxn) continue;
+		for (k = 0; k < (unsigned int)rxn->n_rateLaw_params; ++k) {
+			rxn->rateLaw_params[k] = karray[rxn->rateLaw_indices[k]]->val;
+		}
+	}
+	update_layout_network();
+	if (NATIVE.rhs) native_rate_constants();
+	reset_ode_network();
+	return (0);
+}
+
+/* Sets the species whose initial amounts in the .net file are expressions of the parameters to the values
+ * of those expressions for the current parameters, e.g. after set_parameter_network(). The other species
+ * keep their concentrations. */
+void init_species_network() {
+	vector<myParser>& P = network.parameters;
+	Elt** sarray = network.species->elt - network.species->offset;
+	map<string,int> param_index; // first parameter of each name, as in read_Elt_array()
+	unsigned int j;
+
+	if (network.species_exprs.empty()) return;
+	for (j = 0; j < P.size(); ++j) param_index.insert(make_pair(P[j].name, (int)j));
+	for (map<int,string>::const_iterator s = network.species_exprs.begin(); s != network.species_exprs.end(); ++s) {
+		mu::Parser p;
+		p.DefineFun(_T("if"), If);
+		vector<string> v = find_variables(s->second);
+		for (j = 0; j < v.size(); ++j) p.DefineVar(v[j], &P[param_index[v[j]]].val);
+		p.SetExpr(s->second);
+		sarray[s->first]->val = p.Eval();
+	}
+}
+
+NETWORK_STATE::NETWORK_STATE() : net(), var_params(new VAR_PARAMS_STATE()), native(new NATIVE_STATE()),
+		sparse_ls(new SPARSE_LS_STATE()), ode(new ODE_STATE()), batch(new BATCH_STATE()), hybrid(new HYBRID_STATE()),
+		gsp(new GSP_STATE()), ssa_sel(new SSA_SEL_STATE()) {}
+
+Network_state* new_state_network() {
+	return (new Network_state());
+}
+
+/* Frees a state and the network loaded into it. The state must not be the current one of this thread,
+ * nor be in use by another thread. */
+void free_state_network(Network_state* state) {
+	if (!state || state == STATE || state == &MAIN_STATE) return;
+	NETWORK& net = state->net;
+
+	if (state->ode->y) N_VDestroy_Serial(state->ode->y);
+	if (state->ode->cvode_mem) CVodeFree(&state->ode->cvode_mem);
+	if (state->batch->y) N_VDestroy_Serial(state->batch->y);
+	if (state->batch->cvode_mem) CVodeFree(&state->batch->cvode_mem);
+	if (state->hybrid->y) N_VDestroy_Serial(state->hybrid->y);
+	if (state->hybrid->cvode_mem) CVodeFree(&state->hybrid->cvode_mem);
+	if (state->native->handle) dlclose(state->native->handle);
+	GSP_STATE& gsp = *state->gsp;
+	if (gsp.c) FREE_VECTOR(gsp.c);
+	if (gsp.a) FREE_VECTOR(gsp.a);
+	if (gsp.ever_populated) free(gsp.ever_populated);
+	if (gsp.as_reactant_list) free_iarray(gsp.as_reactant_list);
+	if (gsp.as_product_list) free_iarray(gsp.as_product_list);
+	if (gsp.rxn_update_list) free_iarray(gsp.rxn_update_list);
+	delete gsp.included;
+
+	free_layout(&net.layout);
+	free_Rxn_array(net.reactions);
+	// With functions, the array of rates was reallocated with new[] (see read_functions_array())
+	if (net.rates && net.has_functions) {
+		delete[] net.rates->elt;
+		net.rates->elt = NULL;
+	}
+	free_Elt_array(net.rates);
+	free_Elt_array(net.species);
+	for (Group* group = net.spec_groups; group != NULL;) {
+		Group* next = group->next;
+		free_Group(group);
+		group = next;
+	}
+	if (net.name) free(net.name);
+
+	delete state->var_params;
+	delete state->native;
+	delete state->sparse_ls;
+	delete state->ode;
+	delete state->batch;
+	delete state->hybrid;
+	delete state->gsp;
+	delete state->ssa_sel;
+	delete state;
+}
@@ -102,6 +102,40 @@ typedef struct{
     Rxn*			list;
 } Rxn_array;
 
+/* Reactions of a Rxn_array laid out in compressed sparse row form, for the loops that visit every
+ * reaction. The reactants of reaction i (base 0) are r_index[r_start[i]] ... r_index[r_start[i+1]-1]
+ * and likewise for products and rate law parameters. Species indices are the same as in Rxn.r_index.
+ * Null reactions have rateLaw_type -1 and no reactants, products or parameters. */
+typedef struct{
+	int				n_rxn;
+	int*			r_start;
+	int*			r_index;
+	int*			p_start;
+	int*			p_index;
+	int*			k_start;
+	double*			k; /* rate law parameters */
+	int*			rateLaw_type;
+	int*			rate_param; /* FUNCTIONAL: base 0 index of the rate in network.rates->elt, otherwise -1 */
+	double*			stat_factor;
+	int				n_species;
+	char*			fixed; /* 1 if species (base 0) is fixed */
+	/* Elementary reactions grouped by number of reactants for derivs_network(). Each group lists the
+	 * reaction, its constant stat_factor*k and its reactant indices; all other reactions are in
+	 * other_rxn, sorted by rate law. */
+	int				n_elem0, n_elem1, n_elem2, n_other;
+	int*			elem0_rxn;
+	double*			elem0_k;
+	int*			elem1_rxn;
+	double*			elem1_k;
+	int*			elem1_x;
+	int*			elem2_rxn;
+	double*			elem2_k;
+	int*			elem2_x1;
+	int*			elem2_x2;
+	int*			other_rxn;
+	double*			rate; /* scratch space for the rate of each reaction */
+} Rxn_layout;
+
 /* I/O parsing routines */
 extern char*  get_line(FILE* infile);
 extern char** parse_line (char* buf, int* n_tok, char* comment_chars, char* sep_chars);
@@ -133,7 +167,7 @@ extern map<string, int> init_observ_index_map(Group*& spec_groups);
 extern bool isMuParserFunction(string in_string);
 extern vector<string> find_variables(string a);
 extern void process_function_names(string& a);
-extern void read_functions_array(const char* netfile, Elt_array*& rates, map<string,double*>& param_map,
+extern int read_functions_array(const char* netfile, Elt_array*& rates, map<string,double*>& param_map,
 		map<string,int> param_index_map,map<string,int> observ_index_map, double* t);
 extern void remove_redundancies(vector<int>& vec);
 
@@ -159,8 +193,10 @@ extern void print_Rxn_array(FILE* outfile, Rxn_array* reactions, Elt_array* spec
 
 class myParser{
 	public:
+	myParser() : val(0.0), overridden(false) {}
 	string name;
 	double val;
+	bool overridden; // set with set_parameter_network(), so the expression no longer applies
 	mu::Parser p;
 };
 
@@ -168,9 +204,11 @@ class myParser{
 struct NETWORK{
 	char*					name;
 	Rxn_array*				reactions;
+	Rxn_layout				layout; // contiguous copy of reactions and species flags for the hot loops
 	Elt_array*				rates;
 	vector<myParser>		parameters;
 	Elt_array*				species;
+	map<int, string>		species_exprs; // initial amounts of species (by index) that are expressions of parameters
 	int       	 			n_groups;
 	Group*					spec_groups;
 	vector<GROUP*> 			spec_groups_vec;
@@ -185,11 +223,29 @@ struct NETWORK{
 	bool has_functions; // true iff at least 1 rxn with (user defined) functional rate law
 };
 
-extern struct NETWORK network;
-enum {DENSE, GMRES, DENSE_J, GMRES_J};
+/* The network and the propagator states that all of the functions below work on. The current
+ * state is switched with set_state_network(); a program that loads a single network never needs to.
+ * It is per thread, and all threads start out with the same one. net() is the network of the current
+ * state. */
+typedef struct NETWORK_STATE Network_state;
+extern __thread struct NETWORK* current_network;
+inline NETWORK& net() { return (*current_network); }
+extern Network_state* new_state_network();
+extern void free_state_network(Network_state* state);
+extern Network_state* set_state_network(Network_state* state); // for this thread, returns the previous state
+enum {DENSE, GMRES, DENSE_J, GMRES_J, SPARSE, GMRES_ILU};
+enum {SSA_LINEAR, SSA_SUM_TREE, SSA_COMPOSITION_REJECTION, // SSA next-reaction selectors
+	  SSA_NEXT_REACTION}; // set by init_next_reaction_network()
 extern void  sparse_jac_matlab(FILE* outfile);
 extern void  init_sparse_matlab_file(FILE* outfile);
 extern int   init_network(Rxn_array* reactions, Elt_array* rates, Elt_array* species, Group* spec_groups, char* name);
+extern int   read_network(const char* netfile_name, const char* group_file_name, bool remove_zero, double* t,
+		map<string,double*>& param_map);
+extern void  set_net_cache_network(const char* dir); // where read_network() keeps binary caches (NULL = none)
+extern void  update_layout_network();
+extern int   set_parameter_network(const char* name, double value);
+extern void  init_species_network();
+extern void  reset_ode_network();
 extern int   n_rate_calls_network();
 extern int   n_deriv_calls_network();
 extern int   n_rxns_network();
@@ -199,6 +255,7 @@ extern int   n_species_ever_populated();
 extern int   n_rate_constants_network();
 extern int   n_groups_network();
 extern void  c_code_network();
+extern int   compile_derivs_network(const char* cache_dir);
 extern int   get_conc_network(double* conc);
 extern int   set_conc_network(double* conc);
 extern double* get_group_concentrations_network();
@@ -215,6 +272,21 @@ extern int   propagate_euler_network(double* t, double delta_t, double* n_steps,
 									 mu::Parser& stop_condition);
 extern int   propagate_rkcs_network (double* t, double delta_t, double* n_steps, double tol, double maxStep,
 									 mu::Parser& stop_condition);
+extern int   steady_state_network(double* n_iter, double rtol, double atol, int SOLVER_TYPE, int verbose);
+
+/* Batched ODE functions: B parameter sets of the network integrated together */
+extern int   init_batch_network(int B);
+extern void  set_batch_lane_network(int b);
+extern void  get_batch_conc_network(int b, double* conc);
+extern void  derivs_batch_network(const double* conc, double* derivs);
+extern int   propagate_cvode_batch_network(double* t, double delta_t, double* n_steps, double* rtol, double* atol,
+										   int SOLVER_TYPE);
+
+/* Hybrid SSA/ODE functions */
+extern void  init_hybrid_network(double lambda, double epsilon, int seed);
+extern int   propagate_hybrid_network(double* t, double delta_t, double* n_steps, double* rtol, double* atol,
+									  int SOLVER_TYPE, double maxStep, mu::Parser& stop_condition);
+extern int   hybrid_n_fast_network();
 
 extern FILE* init_print_concentrations_network(char* prefix, int append);
 extern int   print_concentrations_network(FILE* out, double t);
@@ -238,6 +310,8 @@ extern int   finish_print_species_stats(FILE* out);
 extern void  connectivity_Rxn_array(Rxn_array* reactions, Elt_array* species, int** as_reactant, int** as_product);
 extern FILE* init_print_flux_network(char* filename);
 extern int   print_flux_network(FILE* out, double t, int discrete);
+extern int   finish_print_flux_network(FILE* out);
+extern void  set_binary_output_network(int value_size); // .cdat/.gdat/.fdat as .bin trajectories (8 or 4 bytes, 0 = text)
 extern FILE* init_print_pc_network(char* filename);
 extern int   print_pc_network(FILE* out, double t);
 extern FILE* init_print_jac_network(char* filename);
@@ -246,11 +320,18 @@ extern FILE* init_print_pca_network(char* filename);
 extern int   print_pca_network(FILE* out, double t);
 
 /* Gillespie Monte Carlo functions */
+extern void   set_gillespie_selector_network(int selector);
 extern int    init_gillespie_direct_network(int update_interval, int seed);
 extern int    gillespie_direct_network(double* t, double delta_t, double* C_avg, double* C_sig,
 									   double maxStep, mu::Parser& stop_condition);
 //extern long int gillespie_n_steps();
 extern double gillespie_n_steps();
+extern int    init_next_reaction_network(int update_interval, int seed);
+extern int    next_reaction_network(double* t, double delta_t, double* C_avg, double* C_sig,
+									double maxStep, mu::Parser& stop_condition);
+extern int    gillespie_ensemble_network(int n_runs, int n_workers, int seed, double t_start, double sample_time,
+									double* sample_times, int n_sample, double maxStep, mu::Parser& stop_condition,
+									char* prefix, bool print_cdat);
 extern double gillespie_frac_species_active();
 extern double gillespie_frac_rxns_active();
 extern void	  delete_GSP_included();
@@ -25,8 +25,8 @@ void Network3::init_Network3(double* t, bool verbose){
 //	vector<SimpleSpecies*> SPECIES;
 	vector<bool> fixed;
     {
-		Elt* elt = network.species->list;
-		for (int i=0;i < network.species->n_elt;i++){
+		Elt* elt = net().species->list;
+		for (int i=0;i < net().species->n_elt;i++){
 			SPECIES.push_back(new SimpleSpecies(elt->name,floor(elt->val+0.5)));
 			fixed.push_back(elt->fixed);
 			if (verbose) cout << i << ". " << SPECIES[i]->name << "\t" << SPECIES[i]->population << endl;
@@ -39,11 +39,11 @@ void Network3::init_Network3(double* t, bool verbose){
     if (verbose) cout << "------------\nOBSERVABLES\n------------\n";
 //    vector<pair<Observable*,double> > OBSERVABLE;
     {
-		Group* grp = network.spec_groups;
+		Group* grp = net().spec_groups;
 		vector<SimpleSpecies*> sp;
 		vector<double> mult;
-		int off = network.species->offset;
-		for (int i=0;i < network.n_groups;i++){
+		int off = net().species->offset;
+		for (int i=0;i < net().n_groups;i++){
 			sp.clear(); mult.clear();
 			for (int j=0;j < grp->n_elt;j++){
 				sp.push_back(SPECIES.at(grp->elt_index[j]-off));
@@ -63,18 +63,18 @@ void Network3::init_Network3(double* t, bool verbose){
     if (verbose) cout << "------------\nFUNCTIONS\n------------\n";
 //	vector<pair<Function*,double> > FUNCTION;
 	{
-    	int off = network.species->offset;
-		for (unsigned int i=0;i < network.functions.size();i++){
+    	int off = net().species->offset;
+		for (unsigned int i=0;i < net().functions.size();i++){
 //			cout << network.functions[i].GetExpr() << "= " << network.functions[i].Eval() << "\t";
 			//
 			FUNCTION.push_back(new pair<Function*,double>(
-					new Function(network.rates->elt[network.var_parameters[i]-off]->name),0.0));
+					new Function(net().rates->elt[net().var_parameters[i]-off]->name),0.0));
 			//
 			if (i==0){ // 'time' function
 				FUNCTION[0]->first->p->DefineVar("time",t);
 			}
 			else{
-				map<string,double*> var = network.functions[i].GetUsedVar();
+				map<string,double*> var = net().functions[i].GetUsedVar();
 /*				map<string,double*>::iterator iter;
 				for (iter = var.begin();iter != var.end();iter++){
 					cout << "{" << (*iter).first << " = " << *(*iter).second << "}\t";
@@ -89,20 +89,20 @@ void Network3::init_Network3(double* t, bool verbose){
 					}
 				}
 				// Search parameters
-				for (Elt* elt=network.rates->list;elt != NULL;elt=elt->next){
+				for (Elt* elt=net().rates->list;elt != NULL;elt=elt->next){
 					if (var.find(elt->name) != var.end()){
 	//					cout << "\t" << "rates[" << elt->index << "] = " << elt->name << " (";
 						bool func = false;
 						// Is it a function?
-						for (unsigned int j=0;j < network.var_parameters.size() && !func;j++){
-							if (elt->index == network.var_parameters[j]){
+						for (unsigned int j=0;j < net().var_parameters.size() && !func;j++){
+							if (elt->index == net().var_parameters[j]){
 								// YES
 	//							cout << "function[" << j <<"] = " << network.functions[j].GetExpr() << ")" << endl;
 								func = true;
 								bool found = false;
 								// Which one?
 								for (unsigned int k=0;k < FUNCTION.size() && !found;k++){
-									if (network.functions[j].GetExpr() == FUNCTION[k]->first->GetExpr()){
+									if (net().functions[j].GetExpr() == FUNCTION[k]->first->GetExpr()){
 										found = true;
 										FUNCTION[i]->first->p->DefineVar(elt->name,&FUNCTION[k]->second);
 									}
@@ -110,7 +110,7 @@ void Network3::init_Network3(double* t, bool verbose){
 								// Error check
 								if (!found){
 									cout << "Error in Network3::init_Network3(): Couldn't find function "
-										 << network.functions[j].GetExpr() << ". Exiting." << endl;
+										 << net().functions[j].GetExpr() << ". Exiting." << endl;
 									exit(1);
 								}
 							}
@@ -124,7 +124,7 @@ void Network3::init_Network3(double* t, bool verbose){
 				}
 			}
 			// Set expression
-			string expr = network.functions[i].GetExpr();
+			string expr = net().functions[i].GetExpr();
 			expr.erase(expr.size()-1); // Trim last character (muParser adds a null to the end)
 			FUNCTION[i]->first->p->SetExpr(expr);
 			FUNCTION[i]->second = FUNCTION[i]->first->Eval();
@@ -137,16 +137,16 @@ void Network3::init_Network3(double* t, bool verbose){
 	if (verbose) cout << "------------\nREACTIONS\n------------\n";
 //	vector<Reaction*> REACTION;
     {
-		int off = network.species->offset;
-		Rxn* rxn = network.reactions->list;
-		REACTION.resize(network.reactions->n_rxn);
+		int off = net().species->offset;
+		Rxn* rxn = net().reactions->list;
+		REACTION.resize(net().reactions->n_rxn);
 		//
 		// Original rates (for comparison)
 		double orig_rates[n_rxns_network()];
 		rxn_rates_network(orig_rates,1);
 		//
 		// Loop over reactions
-		for (int i=0;i < network.reactions->n_rxn;i++){
+		for (int i=0;i < net().reactions->n_rxn;i++){
 			if (verbose) cout << i << ". ";
 			double fixed_factor = 1.0; // Populations of any fixed species (incorporate into rate constant)
 			//
@@ -279,8 +279,8 @@ void Network3::init_Network3(double* t, bool verbose){
 				if (verbose) cout << "]]] Function rxn type [[[" << endl;
 				// Find the function
 				unsigned int func_index;
-				for (unsigned int j=0;j < network.var_parameters.size();j++){
-					if (network.var_parameters[j] == rxn->rateLaw_indices[0]){
+				for (unsigned int j=0;j < net().var_parameters.size();j++){
+					if (net().var_parameters[j] == rxn->rateLaw_indices[0]){
 						func_index = j;
 						break;
 					}
@@ -0,0 +1,196 @@
+/*
+ * network_api.cpp
+ *
+ *  C interface for simulating reaction networks inside another program.
+ */
+
+#include <pthread.h>
+#include "network.h"
+#include "network_api.h"
+
+struct n3_engine {
+	Network_state* state;
+	pthread_mutex_t lock;    // held by the thread that uses the engine
+	double t;                // read by the time() function of the network
+	double n_steps;
+	double rtol, atol;
+	int solver;
+	vector<double> initial;  // concentrations read from the .net file
+	vector<double> species;  // current concentrations and observables (n3_species_data() etc.)
+	vector<double> observables;
+	mu::Parser no_stop;      // stopping condition that is never met
+};
+
+// Makes the network of an engine the current one of this thread while the object exists. Other threads
+// can use other engines meanwhile.
+class Engine_scope {
+public:
+	Engine_scope(n3_engine* engine) : engine(engine) {
+		pthread_mutex_lock(&engine->lock);
+		this->previous = set_state_network(engine->state);
+	}
+	~Engine_scope() {
+		set_state_network(this->previous);
+		pthread_mutex_unlock(&this->engine->lock);
+	}
+private:
+	n3_engine* engine;
+	Network_state* previous;
+};
+
+// Copies the current concentrations and observables of the network to the engine (inside an Engine_scope)
+static void update_outputs(n3_engine* engine) {
+	if (!engine->species.empty()) get_conc_network(&engine->species[0]);
+	int offset = net().species->offset;
+	double* values = (engine->observables.empty()) ? NULL : &engine->observables[0];
+	for (Group* group = net().spec_groups; group != NULL; group = group->next, ++values) {
+		double total = 0.0;
+		for (int i = 0; i < group->n_elt; ++i) {
+			double factor = (group->elt_factor) ? group->elt_factor[i] : 1.0;
+			total += factor * engine->species[group->elt_index[i] - offset];
+		}
+		*values = total;
+	}
+}
+
+n3_engine* n3_load(const char* netfile) {
+	n3_engine* engine = new n3_engine();
+	engine->state = new_state_network();
+	pthread_mutex_init(&engine->lock, NULL);
+	engine->t = 0.0;
+	engine->n_steps = 0.0;
+	engine->rtol = engine->atol = 1.0e-8;
+	engine->solver = DENSE;
+	engine->no_stop.SetExpr("0");
+
+	map<string,double*> param_map;
+	int error;
+	{
+		Engine_scope scope(engine);
+		error = read_network(netfile, netfile, false, &engine->t, param_map);
+	}
+	if (error) {
+		n3_free(engine); // and what was read
+		return (NULL);
+	}
+
+	Engine_scope scope(engine);
+	engine->initial.resize(n_species_network());
+	get_conc_network(&engine->initial[0]);
+	engine->species.resize(n_species_network());
+	engine->observables.resize(n_groups_network());
+	update_outputs(engine);
+	return (engine);
+}
+
+void n3_free(n3_engine* engine) {
+	if (!engine) return;
+	free_state_network(engine->state);
+	pthread_mutex_destroy(&engine->lock);
+	delete engine;
+}
+
+int n3_set_parameter(n3_engine* engine, const char* name, double value) {
+	Engine_scope scope(engine);
+	return (set_parameter_network(name, value));
+}
+
+int n3_get_parameter(n3_engine* engine, const char* name, double* value) {
+	Engine_scope scope(engine);
+	for (Elt* elt = net().rates->list; elt != NULL; elt = elt->next) {
+		if (strcmp(elt->name, name) == 0) {
+			*value = elt->val;
+			return (0);
+		}
+	}
+	return (1);
+}
+
+int n3_set_solver(n3_engine* engine, const char* solver, double rtol, double atol) {
+	Engine_scope scope(engine);
+	if (strcmp(solver, "dense") == 0) engine->solver = DENSE;
+	else if (strcmp(solver, "gmres") == 0) engine->solver = GMRES;
+	else if (strcmp(solver, "gmres-ilu") == 0) engine->solver = GMRES_ILU;
+	else if (strcmp(solver, "sparse") == 0) engine->solver = SPARSE;
+	else return (1);
+	engine->rtol = rtol;
+	engine->atol = atol;
+	reset_ode_network();
+	return (0);
+}
+
+void n3_reset(n3_engine* engine) {
+	Engine_scope scope(engine);
+	set_conc_network(&engine->initial[0]);
+	init_species_network(); // Initial amounts given by parameters follow n3_set_parameter()
+	engine->t = 0.0;
+	engine->n_steps = 0.0;
+	reset_ode_network();
+	update_outputs(engine);
+}
+
+int n3_run_to(n3_engine* engine, double t) {
+	Engine_scope scope(engine);
+	if (t < engine->t) return (1);
+	if (t == engine->t) return (0);
+	int error = propagate_cvode_network(&engine->t, t - engine->t, &engine->n_steps, &engine->rtol, &engine->atol,
+			engine->solver, INFINITY, engine->no_stop);
+	update_outputs(engine);
+	return (error);
+}
+
+int n3_run_samples(n3_engine* engine, const double* times, int n_times, n3_sample_callback callback,
+		void* data) {
+	for (int i = 0; i < n_times; ++i) {
+		if (n3_run_to(engine, times[i]) != 0) return (1);
+		// Outside the lock, so that the callback can call back into the API
+		if (callback && callback(engine, engine->t, n3_observables_data(engine), data) != 0) return (2);
+	}
+	return (0);
+}
+
+int n3_steady_state(n3_engine* engine) {
+	Engine_scope scope(engine);
+	double n_iter = 0.0;
+	int error = steady_state_network(&n_iter, engine->rtol, engine->atol, engine->solver, 0);
+	reset_ode_network(); // The integrator starts over from the steady state
+	update_outputs(engine);
+	return (error);
+}
+
+double n3_time(n3_engine* engine) {
+	return (engine->t);
+}
+
+int n3_n_species(n3_engine* engine) {
+	return ((int)engine->initial.size());
+}
+
+void n3_get_species(n3_engine* engine, double* conc) {
+	Engine_scope scope(engine);
+	get_conc_network(conc);
+}
+
+int n3_n_observables(n3_engine* engine) {
+	Engine_scope scope(engine);
+	return (n_groups_network());
+}
+
+const char* n3_observable_name(n3_engine* engine, int i) {
+	Engine_scope scope(engine);
+	if (i < 0 || i >= n_groups_network()) return (NULL);
+	return (net().spec_groups_vec[i]->name);
+}
+
+void n3_get_observables(n3_engine* engine, double* values) {
+	Engine_scope scope(engine);
+	for (unsigned int i = 0; i < engine->observables.size(); ++i) values[i] = engine->observables[i];
+}
+
+const double* n3_species_data(n3_engine* engine) {
+	return ((engine->species.empty()) ? NULL : &engine->species[0]);
+}
+
+const double* n3_observables_data(n3_engine* engine) {
+	return ((engine->observables.empty()) ? NULL : &engine->observables[0]);
+}
@@ -0,0 +1,84 @@
+/*
+ * network_api.h
+ *
+ *  C interface for simulating reaction networks inside another program.
+ *
+ *  An engine holds one network read from a BNG .net file, together with the state of its ODE
+ *  integrator. Any number of engines can be loaded at the same time, e.g. one per parameter set of a
+ *  fit, and each is run forward with n3_run_to(). Engines share nothing that a run changes, so
+ *  different engines can be loaded and run on different threads at the same time. Calls on the same
+ *  engine are serialized by a lock of the engine; n3_free() must not overlap with other calls on it.
+ *
+ *  Errors are reported on stdout or stderr, as run_network does, and returned to the caller: n3_load()
+ *  returns NULL if the .net file can't be read, and the functions that integrate return nonzero if
+ *  CVODE fails, after which the next call starts over from the last concentrations reached.
+ *
+ *  The CMake build makes this into libnetwork3.so, next to run_network.
+ */
+
+#ifndef NETWORK_API_H_
+#define NETWORK_API_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct n3_engine n3_engine;
+
+/* Loads a .net file (with the groups in it). Reactions with zero rate constants are kept, so that
+ * setting their parameters later switches them on. Returns NULL if the file can't be read or has errors. */
+n3_engine* n3_load(const char* netfile);
+void n3_free(n3_engine* engine);
+
+/* Sets a parameter, recomputing the parameters defined by expressions of it and the rate constants.
+ * The current concentrations don't change; initial amounts that are expressions of parameters take
+ * the new value at the next n3_reset(). Returns 1 if there is no such parameter. */
+int n3_set_parameter(n3_engine* engine, const char* name, double value);
+int n3_get_parameter(n3_engine* engine, const char* name, double* value);
+
+/* Selects the CVODE linear solver ("dense", "gmres", "gmres-ilu" or "sparse") and tolerances.
+ * Returns 1 if the solver is not known. */
+int n3_set_solver(n3_engine* engine, const char* solver, double rtol, double atol);
+
+/* Goes back to time 0 and the initial concentrations, re-evaluating the initial amounts that are
+ * expressions of parameters */
+void n3_reset(n3_engine* engine);
+
+/* Integrates to time t, which must not be before the current time. Returns 0 on success, and 1 if t is
+ * before the current time or the integrator fails. */
+int n3_run_to(n3_engine* engine, double t);
+double n3_time(n3_engine* engine);
+
+/* Current concentrations of the species and values of the groups (observables), in the order of the
+ * .net file */
+int n3_n_species(n3_engine* engine);
+void n3_get_species(n3_engine* engine, double* conc);
+int n3_n_observables(n3_engine* engine);
+const char* n3_observable_name(n3_engine* engine, int i);
+void n3_get_observables(n3_engine* engine, double* values);
+
+/* The same values without copying: arrays owned by the engine, which n3_load(), n3_reset(), n3_run_to()
+ * and n3_run_samples() bring up to date. They stay at the same address until n3_free(). */
+const double* n3_species_data(n3_engine* engine);
+const double* n3_observables_data(n3_engine* engine);
+
+/* Called at each sample time with the observables at that time (n3_observables_data()). Returning
+ * nonzero stops the run. The engine is not locked during the call, so the callback may use the API. */
+typedef int (*n3_sample_callback)(n3_engine* engine, double t, const double* observables, void* data);
+
+/* Integrates through the n_times sample times in ascending order, calling callback (if not NULL) at each.
+ * Returns 0 when all samples were taken, 1 on failure of the integrator or an out of order time, and 2
+ * if the callback stopped the run. */
+int n3_run_samples(n3_engine* engine, const double* times, int n_times, n3_sample_callback callback,
+		void* data);
+
+/* Replaces the concentrations by the steady state that they relax to, solved for directly as by
+ * run_network -p steady; the time stays the same. Returns 0 if a steady state was found. For a
+ * dose-response curve, set the parameter, n3_reset() and solve again for each dose. */
+int n3_steady_state(n3_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETWORK_API_H_ */
@@ -16,6 +16,7 @@
 #include "base/rxnClassifier.hh"
 #include "base/firingGenerator.hh"
 #include "base/postleapChecker.hh"
+#include "util/plaThreads.hh"
 
 namespace network3{
 
@@ -45,7 +46,7 @@ namespace network3{
 		}
 		void addOutputFile(string filePath);
 		void setOutputInterval(double outInterval){ this->output_interval = outInterval; }
-		void setSeed(unsigned long seed){ Util::SEED_RANDOM(seed); }
+		void setSeed(unsigned long seed){ Util::SEED_RANDOM(seed); PLA_Threads::seed(seed); }
 		void setSeed(long seed){ this->setSeed((unsigned long)seed); }
 		void setSeed(int seed){ this->setSeed((unsigned long)seed); }
 
@@ -58,6 +58,15 @@ namespace network3{
 		Preleap_TC* ptc;
 		aEff_Calculator* aCalc;
 		BinomialCorrector_RK* bc;
+		// Arguments of drawBlock()
+		struct Firings{
+			eRungeKutta_TC_RC_FG_PL* pl;
+			vector<double>* k;
+			vector<int>* classif;
+			double tau;
+		};
+		double drawFirings(unsigned int v, int classif, double tau, Util::RandomStream* stream);
+		static void drawBlock(void* firings, unsigned int block);
 	private:
 		vector<Reaction*>& rxn;
 	};
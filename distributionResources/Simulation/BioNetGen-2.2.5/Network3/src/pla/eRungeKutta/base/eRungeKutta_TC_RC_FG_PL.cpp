@@ -146,34 +146,84 @@ void eRungeKutta_TC_RC_FG_PL::fireRxns(vector<double>& k, vector<int>& classif,
 		exit(1);
 	}
 	// Fire rxns
-	for (unsigned int v=0;v < this->rxn.size();v++){
-		if (classif[v] != RxnClassifier::EXACT_STOCHASTIC){ // ES rxn is fired in PLA::nextStep() after postleap check
-			double a_tau = this->aCalc->a_eff[v]*tau;
-			if (classif[v] == RxnClassifier::POISSON){
-				k[v] = Util::RANDOM_POISSON(a_tau);
-			}
-			else if (classif[v] == RxnClassifier::LANGEVIN){
-				k[v] = a_tau + sqrt(a_tau)*Util::RANDOM_GAUSSIAN();
-				if (k[v] < 0.0) k[v] = 0.0; // Just to be safe
-				else if (this->round) k[v] = floor(k[v] + 0.5);
-			}
-			else if (classif[v] == RxnClassifier::DETERMINISTIC){
-				k[v] = a_tau;
-				if (this->round) k[v] = floor(k[v] + 0.5);
+	if (PLA_Threads::active()){
+		// Draw the firings block by block, each block from its own stream, then update the populations in rxn order
+		PLA_Threads::reserveStreams(PLA_Threads::nBlocks(this->rxn.size()));
+		Firings f = {this,&k,&classif,tau};
+		PLA_Threads::run(eRungeKutta_TC_RC_FG_PL::drawBlock,&f,this->rxn.size());
+		for (unsigned int v=0;v < this->rxn.size();v++){
+			if (classif[v] != RxnClassifier::EXACT_STOCHASTIC) this->rxn[v]->fire(k[v]);
+		}
+	}
+	else{
+		for (unsigned int v=0;v < this->rxn.size();v++){
+			if (classif[v] != RxnClassifier::EXACT_STOCHASTIC){ // ES rxn is fired in PLA::nextStep() after postleap check
+				k[v] = this->drawFirings(v,classif[v],tau,NULL);
+				this->rxn[v]->fire(k[v]);
 			}
 			else{
-				cout << "Error in eRungeKutta_TC_RC_FG_PL::fireRxns(): Reaction classification for "
-					 << this->rxn[v]->toString() << " (" << classif[v] << ") not recognized." << endl;
-				cout << "Only Exact Stochastic (" << RxnClassifier::EXACT_STOCHASTIC << "), Poisson ("
-					 << RxnClassifier::POISSON << "), Langevin (" << RxnClassifier::LANGEVIN
-					 << ") and Deterministic (" << RxnClassifier::DETERMINISTIC << ") are supported. "
-					 << "Exiting." << endl;
-				exit(1);
+				k[v] = 0.0;
 			}
-			this->rxn[v]->fire(k[v]);
+		}
+	}
+}
+
+// Number of firings of rxn v in time tau. Draws from 'stream' if given, otherwise from the global generator.
+double eRungeKutta_TC_RC_FG_PL::drawFirings(unsigned int v, int classif, double tau, Util::RandomStream* stream){
+	double k;
+	double a_tau = this->aCalc->a_eff[v]*tau;
+	if (classif == RxnClassifier::POISSON){
+		k = stream ? stream->poisson(a_tau) : Util::RANDOM_POISSON(a_tau);
+	}
+	else if (classif == RxnClassifier::LANGEVIN){
+		k = a_tau + sqrt(a_tau)*(stream ? stream->gaussian() : Util::RANDOM_GAUSSIAN());
+		if (k < 0.0) k = 0.0; // Just to be safe
+		else if (this->round) k = floor(k + 0.5);
+	}
+	else if (classif == RxnClassifier::DETERMINISTIC){
+		k = a_tau;
+		if (this->round) k = floor(k + 0.5);
+	}
+	else{
+		cout << "Error in eRungeKutta_TC_RC_FG_PL::fireRxns(): Reaction classification for "
+			 << this->rxn[v]->toString() << " (" << classif << ") not recognized." << endl;
+		cout << "Only Exact Stochastic (" << RxnClassifier::EXACT_STOCHASTIC << "), Poisson ("
+			 << RxnClassifier::POISSON << "), Langevin (" << RxnClassifier::LANGEVIN
+			 << ") and Deterministic (" << RxnClassifier::DETERMINISTIC << ") are supported. "
+			 << "Exiting." << endl;
+		exit(1);
+	}
+	return k;
+}
+
+void eRungeKutta_TC_RC_FG_PL::drawBlock(void* firings, unsigned int block){
+	Firings& f = *(Firings*)firings;
+	unsigned int first = block*PLA_Threads::BLOCK_SIZE;
+	unsigned int last = min(first + PLA_Threads::BLOCK_SIZE,(unsigned int)f.pl->rxn.size());
+	Util::RandomStream& stream = PLA_Threads::stream(block);
+	// Poisson rxns are drawn together in one call
+	double mean[PLA_Threads::BLOCK_SIZE];
+	double k_poisson[PLA_Threads::BLOCK_SIZE];
+	unsigned int poisson[PLA_Threads::BLOCK_SIZE];
+	unsigned int nPoisson = 0;
+	for (unsigned int v=first;v < last;v++){
+		int classif = (*f.classif)[v];
+		if (classif == RxnClassifier::POISSON){
+			mean[nPoisson] = f.pl->aCalc->a_eff[v]*f.tau;
+			poisson[nPoisson++] = v;
+		}
+		else if (classif != RxnClassifier::EXACT_STOCHASTIC){
+			(*f.k)[v] = f.pl->drawFirings(v,classif,f.tau,&stream);
 		}
 		else{
-			k[v] = 0.0;
+			(*f.k)[v] = 0.0;
 		}
 	}
+	if (nPoisson == 0){
+		return;
+	}
+	stream.poisson(mean,k_poisson,nPoisson);
+	for (unsigned int i=0;i < nPoisson;i++){
+		(*f.k)[poisson[i]] = k_poisson[i];
+	}
 }
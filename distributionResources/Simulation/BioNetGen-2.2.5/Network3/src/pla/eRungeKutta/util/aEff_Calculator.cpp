@@ -62,58 +62,51 @@ void aEff_Calculator::calc_aEff(double tau){
 	}
 	// # of stages
 	unsigned int nStages = this->bt.size();
+	// Populations and rates at each stage, stored stage by stage so that Reaction::getRates() can read them directly
+	unsigned int nSp = this->sp.size();
+	unsigned int nRxn = this->rxn.size();
+	double X[nStages*nSp+1];
+	double a[nStages*nRxn+1];
 	// Initial populations
-	double X[this->sp.size()][nStages];
-	for (unsigned int j=0;j < this->sp.size();j++){
-//		X[j][0] = this->sp[j]->population;
-		X[j][0] = this->x_curr[j];
-		this->X_eff[j] = this->bt.beta[0]*X[j][0];
+	for (unsigned int j=0;j < nSp;j++){
+//		X[j] = this->sp[j]->population;
+		X[j] = this->x_curr[j];
+		this->X_eff[j] = this->bt.beta[0]*X[j];
 	}
 	// Initial rates
-	double a[this->rxn.size()][nStages];
-	for (unsigned int v=0;v < this->rxn.size();v++){
-//		a[v][0] = this->rxn[v]->getRate();
-		a[v][0] = this->a_curr[v];
-//		this->a_eff[v] = this->bt.beta[0]*a[v][0];
+	for (unsigned int v=0;v < nRxn;v++){
+//		a[v] = this->rxn[v]->getRate();
+		a[v] = this->a_curr[v];
+//		this->a_eff[v] = this->bt.beta[0]*a[v];
 	}
 	// Loop over stages
+	Stage stage = {this,tau,0,X,a,NULL,NULL};
 	for (unsigned int s=1;s < nStages;s++){
-		// Populations
-		for (unsigned int j=0;j < this->sp.size();j++){
-			X[j][s] = 0.0;
-			for (unsigned int ss=0;ss < s;ss++){
-				if (fabs(this->bt.alpha[s][ss]) > TOL){ // Skip the sum if alpha[s][ss] is zero.
-					double m_j = 0.0;
-					for (unsigned int v=0;v < this->spInRxn[j].size();v++){
-						m_j += this->stoich[j][v]*a[this->spInRxn[j][v]][ss];
-					}
-					X[j][s] += this->bt.alpha[s][ss]*m_j;
-				}
-			}
-			X[j][s] *= tau;
-			X[j][s] += X[j][0];
-//			X[j][s] += this->sp[j]->population;
-			this->X_eff[j] += this->bt.beta[s]*X[j][s];
+		stage.s = s;
+		stage.Xs = &X[s*nSp];
+		stage.as = &a[s*nRxn];
+		if (PLA_Threads::active()){
+			PLA_Threads::run(aEff_Calculator::stagePopulations,&stage,nSp);
+			PLA_Threads::run(aEff_Calculator::stageRates,&stage,nRxn);
+			this->serialRates(stage.Xs,stage.as);
 		}
-		// Rates
-		vector<double> Xs;
-		for (unsigned int v=0;v < this->rxn.size();v++){
-			Xs.resize(this->rxn[v]->rateSpecies.size());
-			for (unsigned int j=0;j < this->rxn[v]->rateSpecies.size();j++){
-				Xs[j] = X[this->rateSp[v][j]][s];
-			}
-			a[v][s] = this->rxn[v]->re->getRate(Xs); // Have to calculate this, even if beta[s] = 0.
-//			this->a_eff[v] += this->bt.beta[s]*a[v][s];
+		else{
+			this->calcPopulations(stage,0,nSp);
+			Reaction::getRates(this->rxn,stage.Xs,this->rateSp,stage.as); // Have to calculate these, even if beta[s] = 0.
 		}
+//		for (unsigned int v=0;v < nRxn;v++) this->a_eff[v] += this->bt.beta[s]*stage.as[v];
 	}
 	// Calculate a_eff[v] = getRate(X_eff)
-	vector<double> xEff;
-	for (unsigned int v=0;v < this->rxn.size();v++){
-		xEff.resize(this->rxn[v]->rateSpecies.size());
-		for (unsigned int j=0;j < this->rxn[v]->rateSpecies.size();j++){
-			xEff[j] = this->X_eff[this->rateSp[v][j]];
+	if (nRxn > 0){
+		if (PLA_Threads::active()){
+			stage.Xs = &this->X_eff[0];
+			stage.as = &this->a_eff[0];
+			PLA_Threads::run(aEff_Calculator::stageRates,&stage,nRxn);
+			this->serialRates(stage.Xs,stage.as);
+		}
+		else{
+			Reaction::getRates(this->rxn,&this->X_eff[0],this->rateSp,&this->a_eff[0]);
 		}
-		this->a_eff[v] = this->rxn[v]->re->getRate(xEff);
 	}
 /*
 	//////////////
@@ -152,6 +145,53 @@ void aEff_Calculator::calc_aEff(double tau){
 //*/
 }
 
+// Populations of species first..last-1 at stage s, and their contributions to X_eff
+void aEff_Calculator::calcPopulations(const Stage& stage, unsigned int first, unsigned int last){
+	unsigned int s = stage.s;
+	unsigned int nRxn = this->rxn.size();
+	const double* X0 = stage.X;
+	for (unsigned int j=first;j < last;j++){
+		stage.Xs[j] = 0.0;
+		for (unsigned int ss=0;ss < s;ss++){
+			if (fabs(this->bt.alpha[s][ss]) > TOL){ // Skip the sum if alpha[s][ss] is zero.
+				const double* a_ss = &stage.a[ss*nRxn];
+				double m_j = 0.0;
+				for (unsigned int v=0;v < this->spInRxn[j].size();v++){
+					m_j += this->stoich[j][v]*a_ss[this->spInRxn[j][v]];
+				}
+				stage.Xs[j] += this->bt.alpha[s][ss]*m_j;
+			}
+		}
+		stage.Xs[j] *= stage.tau;
+		stage.Xs[j] += X0[j];
+//		stage.Xs[j] += this->sp[j]->population;
+		this->X_eff[j] += this->bt.beta[s]*stage.Xs[j];
+	}
+}
+
+void aEff_Calculator::stagePopulations(void* stage, unsigned int block){
+	Stage& st = *(Stage*)stage;
+	unsigned int first = block*PLA_Threads::BLOCK_SIZE;
+	unsigned int last = min(first + PLA_Threads::BLOCK_SIZE,(unsigned int)st.calc->sp.size());
+	st.calc->calcPopulations(st,first,last);
+}
+
+void aEff_Calculator::stageRates(void* stage, unsigned int block){
+	Stage& st = *(Stage*)stage;
+	unsigned int first = block*PLA_Threads::BLOCK_SIZE;
+	unsigned int last = min(first + PLA_Threads::BLOCK_SIZE,(unsigned int)st.calc->rxn.size());
+	Reaction::getRates(st.calc->rxn,st.Xs,st.calc->rateSp,st.as,first,last,true);
+}
+
+// Rates that stageRates() leaves to the calling thread
+void aEff_Calculator::serialRates(const double* X, double* a){
+	for (unsigned int v=0;v < this->rxn.size();v++){
+		if (!this->rxn[v]->re->threadSafe()){
+			Reaction::getRates(this->rxn,X,this->rateSp,a,v,v+1,false);
+		}
+	}
+}
+
 void aEff_Calculator::update(){
 	for (unsigned int j=0;j < this->sp.size();j++){
 		x_curr.at(j) = this->sp[j]->population;
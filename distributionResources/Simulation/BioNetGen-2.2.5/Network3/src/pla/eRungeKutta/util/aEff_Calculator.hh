@@ -10,6 +10,7 @@
 
 #include "../../../model/reaction.hh"
 #include "butcherTableau.hh"
+#include "../../util/plaThreads.hh"
 
 namespace network3{
 
@@ -34,6 +35,21 @@ namespace network3{
 		vector<double> a_curr;
 		void addSpecies();
 		void addRxn();
+		// One stage of calc_aEff(). X and a hold the populations and rates of all stages, stage by stage; Xs and as
+		// are where stage s goes.
+		struct Stage{
+			aEff_Calculator* calc;
+			double tau;
+			unsigned int s;
+			double* X;
+			double* a;
+			double* Xs;
+			double* as;
+		};
+		void calcPopulations(const Stage& stage, unsigned int first, unsigned int last);
+		void serialRates(const double* X, double* a);
+		static void stagePopulations(void* stage, unsigned int block);
+		static void stageRates(void* stage, unsigned int block);
 	private:
 		vector<SimpleSpecies*>& sp;
 		vector<Reaction*>& rxn;
@@ -47,12 +47,30 @@ void BinomialCorrector_RK::correct(vector<double>& k, aEff_Calculator* aCalc, do
 	aCalc->calc_aEff(tau); // Recalculate a_eff[]
 	double k_old;
 	bool stop = true;
+	// With PLA threads, draw all the reduced firings in one call
+	vector<double> k_new;
+	if (PLA_Threads::active()){
+		vector<double> pp, n;
+		for (unsigned int v=0;v < this->rxn.size();v++){
+			if (k[v] > 0.0){
+				pp.push_back(this->p*aCalc->a_eff[v]/aEff_old[v]);
+				n.push_back(floor(k[v] + 0.5));
+			}
+		}
+		k_new.resize(pp.size());
+		if (!pp.empty()){
+			PLA_Threads::reserveStreams(1);
+			PLA_Threads::stream(0).binomial(&pp[0],&n[0],&k_new[0],pp.size());
+		}
+	}
+	unsigned int next = 0;
 	for (unsigned int v=0;v < this->rxn.size();v++){
 		if (k[v] > 0.0){
 			stop = false;
 			k_old = k[v];
 			// Reduce k[v]
-			k[v] = Util::RANDOM_BINOMIAL(this->p*aCalc->a_eff[v]/aEff_old[v],floor(k_old + 0.5));
+			if (PLA_Threads::active()) k[v] = k_new[next++];
+			else k[v] = Util::RANDOM_BINOMIAL(this->p*aCalc->a_eff[v]/aEff_old[v],floor(k_old + 0.5));
 //			k[v] = Util::RANDOM_BINOMIAL(this->p,floor(k_old + 0.5));
 			// Error check
 			if (k[v] < 0.0){
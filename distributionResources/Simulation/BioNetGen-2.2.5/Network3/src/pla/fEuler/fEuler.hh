@@ -15,6 +15,7 @@
 #include "../base/tauCalculator.hh"
 #include "../util/g_Getter.hh"
 #include "../util/preleap_TC.hh"
+#include "../util/rxnDependencies.hh"
 
 namespace network3{
 
@@ -125,6 +126,13 @@ namespace network3{
 		virtual ~fEulerPreleapRB_TC();
 		virtual void getNewTau(double& tau);
 		virtual Preleap_TC* clone() const{ return new fEulerPreleapRB_TC(*this); }
+	protected:
+		RxnDependencies dep;
+		vector<double> tau_;			// tau[u] as of the last step
+		vector<bool> stale;				// Rxns whose tau[u] must be recalculated this step
+		vector<double> f_u;				// Scratch for f_u[v], kept at zero between rxns
+		vector<unsigned int> touched;	// Marks v with f_u[v] set for the current u
+		unsigned int pass;
 	private:
 		vector<Reaction*>& rxn;
 	};
@@ -139,6 +147,11 @@ namespace network3{
 		virtual Preleap_TC* clone() const{ return new fEulerPreleapSB_TC(*this); }
 	protected:
 		g_Getter* gGet;
+		RxnDependencies dep;
+		vector<double> m;		// m_i as of the last step
+		vector<double> sig2;	// sig_i2 as of the last step
+		vector<double> tee;		// tee[i] as of the last step
+		vector<bool> stale;		// Species whose tee[i] must be recalculated this step
 	private:
 		vector<SimpleSpecies*>& sp;
 		vector<Reaction*>& rxn;
@@ -6,13 +6,14 @@
  */
 
 #include "fEuler.hh"
+#include <algorithm>
 /*
 fEulerPreleapRB_TC::fEulerPreleapRB_TC() : rxn(){
 	if (MoMMA::debug)
 		cout << "fEulerPreleapRB_TC constructor called." << endl;
 }
 */
-fEulerPreleapRB_TC::fEulerPreleapRB_TC(double eps, vector<Reaction*>& rxn) : Preleap_TC(eps), rxn(rxn){
+fEulerPreleapRB_TC::fEulerPreleapRB_TC(double eps, vector<Reaction*>& rxn) : Preleap_TC(eps), dep(rxn), pass(0), rxn(rxn){
 	if (debug)
 		cout << "fEulerPreleapRB_TC constructor called." << endl;
 	// Error check
@@ -23,7 +24,7 @@ fEulerPreleapRB_TC::fEulerPreleapRB_TC(double eps, vector<Reaction*>& rxn) : Pre
 	}
 }
 
-fEulerPreleapRB_TC::fEulerPreleapRB_TC(const fEulerPreleapRB_TC& tc) : Preleap_TC(tc), rxn(tc.rxn){
+fEulerPreleapRB_TC::fEulerPreleapRB_TC(const fEulerPreleapRB_TC& tc) : Preleap_TC(tc), dep(tc.dep), pass(0), rxn(tc.rxn){
 	if (debug)
 		cout << "fEulerPreleapRB_TC copy constructor called.\n";
 }
@@ -46,20 +47,42 @@ void fEulerPreleapRB_TC::getNewTau(double& tau){
 	// eps_u = max{eps*a_u,beta_u}
 	// beta_u = min{da_u/dX_j}>0 or a_u^MIN
 
-//	double tauLeap; // Return value
-	double beta_u, eps_u, m_u, sig_u2, tau_m, tau_sig;
-	vector<double> dau_dX;
-	double tau_[this->rxn.size()];  // One for each reaction
-	double f_u[this->rxn.size()];  // One for each reaction at given u
-
-	// Collect rates for all reactions at the outset
-	double rate[this->rxn.size()];
-	for (unsigned int v=0;v < this->rxn.size();v++){
-		rate[v] = this->rxn[v]->getRate();
+	// Only tau[u] of rxns whose reactant populations or rates have changed, or that depend on a rxn whose rate
+	// has changed, are recalculated
+	bool all = this->dep.refresh();
+	unsigned int nRxn = this->rxn.size();
+	if (all){
+		this->tau_.assign(nRxn,INFINITY);
+		this->f_u.assign(nRxn,0.0);
+		this->touched.assign(nRxn,0);
+		this->pass = 0;
+	}
+	this->stale.assign(nRxn,all);
+	for (unsigned int n=0;n < this->dep.changedSp.size();n++){
+		vector<unsigned int>& rateRxn = this->dep.rateRxn[this->dep.changedSp[n]];
+		for (unsigned int k=0;k < rateRxn.size();k++){
+			this->stale[rateRxn[k]] = true;
+		}
+	}
+	for (unsigned int n=0;n < this->dep.changedRxn.size();n++){
+		unsigned int v = this->dep.changedRxn[n];
+		this->stale[v] = true;
+		for (unsigned int k=0;k < this->dep.rxnStoichSp[v].size();k++){
+			vector<unsigned int>& rateRxn = this->dep.rateRxn[this->dep.rxnStoichSp[v][k]];
+			for (unsigned int l=0;l < rateRxn.size();l++){
+				this->stale[rateRxn[l]] = true;
+			}
+		}
 	}
+	vector<double>& rate = this->dep.rate;
 
 	// Loop over reactions calculating values of tau[u]
-	for (unsigned int u=0;u < this->rxn.size();u++){
+	double beta_u, eps_u, m_u, sig_u2, tau_m, tau_sig;
+	vector<double> dau_dX;
+	vector<unsigned int> nonzero; // v with f_u[v] != 0
+	for (unsigned int u=0;u < nRxn;u++){
+		int kind = this->rxn[u]->re->kind;
+		if (!this->stale[u] && kind != RateExpression::GENERIC && kind != RateExpression::MUPARSER) continue;
 
 		// Calculate derivatives dau/dXj
 		dau_dX.clear(); // Make sure it's empty
@@ -87,27 +110,33 @@ void fEulerPreleapRB_TC::getNewTau(double& tau){
 		// Get eps_u
 		eps_u = max(this->eps*rate[u],beta_u);
 
-		// Calculate elements of f_u[v]
-		for (unsigned int v=0;v < this->rxn.size();v++){
-			f_u[v] = 0.0;
-			SimpleSpecies* rateSp;
-			map<SimpleSpecies*,int>::iterator stoichSp;
-			// Loop over reactant species in reaction R_u
-			for (unsigned int j=0;j < this->rxn[u]->rateSpecies.size();j++){
-				rateSp = this->rxn[u]->rateSpecies[j];
-				stoichSp = this->rxn[v]->stoichSpecies.find(rateSp);
-				if (stoichSp != this->rxn[v]->stoichSpecies.end()){ // Species j is created/consumed in reaction R_v
-					f_u[v] += dau_dX[j] * static_cast<double>((*stoichSp).second);
+		// Calculate elements of f_u[v], which are nonzero only for rxns that create/consume a reactant of R_u
+		if (++this->pass == 0){ // Wrapped around
+			this->touched.assign(nRxn,0);
+			this->pass = 1;
+		}
+		nonzero.clear();
+		for (unsigned int j=0;j < this->dep.rxnRateSp[u].size();j++){
+			unsigned int sp_j = this->dep.rxnRateSp[u][j];
+			for (unsigned int k=0;k < this->dep.stoichRxn[sp_j].size();k++){
+				unsigned int v = this->dep.stoichRxn[sp_j][k];
+				if (this->touched[v] != this->pass){
+					this->touched[v] = this->pass;
+					nonzero.push_back(v);
 				}
+				this->f_u[v] += dau_dX[j] * this->dep.stoich[sp_j][k];
 			}
 		}
+		sort(nonzero.begin(),nonzero.end());
 
 		// Calculate m_u and sig_u2
 		m_u = 0.0;
 		sig_u2 = 0.0;
-		for (unsigned int v=0;v < this->rxn.size();v++){
-			m_u += f_u[v]*rate[v];
-			sig_u2 += f_u[v]*f_u[v]*rate[v];
+		for (unsigned int k=0;k < nonzero.size();k++){
+			unsigned int v = nonzero[k];
+			m_u += this->f_u[v]*rate[v];
+			sig_u2 += this->f_u[v]*this->f_u[v]*rate[v];
+			this->f_u[v] = 0.0;
 		}
 
 		// Calculate tau_m and tau_sig
@@ -115,15 +144,15 @@ void fEulerPreleapRB_TC::getNewTau(double& tau){
 		tau_sig = 0.25*eps_u*eps_u/sig_u2;
 
 		// Set tau[u] = min{tau_m,tau_sig}
-		tau_[u] = min(tau_m,tau_sig);
-//		tau_[u] = tau_m; // ORIGINAL TAU-SELECTION METHOD
+		this->tau_[u] = min(tau_m,tau_sig);
+//		this->tau_[u] = tau_m; // ORIGINAL TAU-SELECTION METHOD
 	}
 	// Find min{tau[v]}
 	tau = INFINITY;
-	for (unsigned int v=0;v < this->rxn.size();v++){
-//		cout << "tau[" << v << "] = " << tau_[v] << endl;
-		if (tau_[v] < tau){
-			tau = tau_[v];
+	for (unsigned int v=0;v < nRxn;v++){
+//		cout << "tau[" << v << "] = " << this->tau_[v] << endl;
+		if (this->tau_[v] < tau){
+			tau = this->tau_[v];
 		}
 	}
 //	return tauLeap;
@@ -12,7 +12,8 @@ fEulerPreleapSB_TC::fEulerPreleapSB_TC() : sp(), rxn(){
 		cout << "fEulerPreleapSB_TC constructor called." << endl;
 }
 */
-fEulerPreleapSB_TC::fEulerPreleapSB_TC(double eps, vector<SimpleSpecies*>& sp, vector<Reaction*>& rxn) : Preleap_TC(eps), sp(sp), rxn(rxn){
+fEulerPreleapSB_TC::fEulerPreleapSB_TC(double eps, vector<SimpleSpecies*>& sp, vector<Reaction*>& rxn) : Preleap_TC(eps),
+		dep(sp,rxn), sp(sp), rxn(rxn){
 	if (debug)
 		cout << "fEulerPreleapSB_TC constructor called." << endl;
 	// Error check
@@ -25,7 +26,8 @@ fEulerPreleapSB_TC::fEulerPreleapSB_TC(double eps, vector<SimpleSpecies*>& sp, v
 	this->gGet = new g_Getter(this->sp,this->rxn);
 }
 
-fEulerPreleapSB_TC::fEulerPreleapSB_TC(const fEulerPreleapSB_TC& tc) : Preleap_TC(tc), sp(tc.sp), rxn(tc.rxn){
+fEulerPreleapSB_TC::fEulerPreleapSB_TC(const fEulerPreleapSB_TC& tc) : Preleap_TC(tc), dep(tc.dep), sp(tc.sp),
+		rxn(tc.rxn){
 	if (debug)
 		cout << "fEulerPreleapSB_TC copy constructor called.\n";
 	this->gGet = new g_Getter(this->sp,this->rxn);
@@ -54,62 +56,66 @@ void fEulerPreleapSB_TC::getNewTau(double& tau){
 		exit(1);
 	}
 
-//	double tauLeap; // Return value
-	double e_i, m_i, sig_i2, tee_m, tee_sig;
-	double tee[this->sp.size()];  // One for each species
-
-	// Collect rates for all reactions at the outset
-	double rate[this->rxn.size()];
-	for (unsigned int v=0;v < this->rxn.size();v++){
-		rate[v] = this->rxn[v]->getRate();
+	// Only m_i and sig_i2 of species created/consumed in rxns whose rates have changed, and tee[i] of those
+	// species and of species whose populations or g_i may have changed, are recalculated
+	bool all = this->dep.refresh();
+	unsigned int nSp = this->sp.size();
+	if (all){
+		this->m.assign(nSp,0.0);
+		this->sig2.assign(nSp,0.0);
+		this->tee.assign(nSp,INFINITY);
+	}
+	this->stale.assign(nSp,all);
+	for (unsigned int n=0;n < this->dep.changedRxn.size();n++){
+		vector<unsigned int>& spInRxn = this->dep.rxnStoichSp[this->dep.changedRxn[n]];
+		for (unsigned int k=0;k < spInRxn.size();k++){
+			this->stale[spInRxn[k]] = true;
+		}
+	}
+	// Calculate m_i and sig_i2
+	for (unsigned int i=0;i < nSp;i++){
+		if (this->stale[i]){
+			vector<unsigned int>& rxnIn = this->dep.stoichRxn[i];
+			double m_i = 0.0;
+			double sig_i2 = 0.0;
+			for (unsigned int k=0;k < rxnIn.size();k++){ // Rxns in which species i is created/consumed
+				double z_vi = this->dep.stoich[i][k];
+				double rate_v = this->dep.rate[rxnIn[k]];
+				m_i += z_vi*rate_v;
+				sig_i2 += z_vi*z_vi*rate_v;
+			}
+			this->m[i] = m_i;
+			this->sig2[i] = sig_i2;
+		}
+	}
+	for (unsigned int n=0;n < this->dep.changedSp.size();n++){
+		if (this->dep.changedSp[n] < nSp) this->stale[this->dep.changedSp[n]] = true;
 	}
 
 	// Loop over species calculating values of tee[i]
-	for (unsigned int i=0;i < this->sp.size();i++){
+	double e_i, tee_m, tee_sig;
+	for (unsigned int i=0;i < nSp;i++){
+		if (!this->stale[i] && !this->gGet->variable(i)) continue;
 
 		// Get e_i
 		if (this->sp[i]->population < network3::TOL) e_i = 1.0;
 		else e_i = max(this->eps*this->sp[i]->population/this->gGet->get_g(i),1.0);
-/*
-cout << "g_" << i << ": " << this->gGet->get_g(i) << endl;
-cout << "e_" << i << ": " << e_i << endl;
-//*/
-		// Calculate m_i and sig_i2
-		m_i = 0.0;
-		sig_i2 = 0.0;
-		double z_vi;
-		map<SimpleSpecies*,int>::iterator stoichSp;
-		for (unsigned int v=0;v < this->rxn.size();v++){
-			stoichSp = this->rxn[v]->stoichSpecies.find(this->sp[i]);
-			if (stoichSp != this->rxn[v]->stoichSpecies.end()){ // Species i created/consumed in reaction R_v
-				z_vi = static_cast<double>((*stoichSp).second);
-				m_i += z_vi*rate[v];
-				sig_i2 += z_vi*z_vi*rate[v];
-			}
-		}
-/*
-cout << "m_" << i << ": " << m_i << endl;
-cout << "sig2_" << i << ": " << sig_i2 << endl;
-//*/
+
 		// Calculate tee_m and tee_sig
-		tee_m = 0.5*e_i/fabs(m_i);
-		tee_sig = 0.25*e_i*e_i/sig_i2;
+		tee_m = 0.5*e_i/fabs(this->m[i]);
+		tee_sig = 0.25*e_i*e_i/this->sig2[i];
 //		tee_m = e_i/fabs(m_i);
 //		tee_sig = e_i*e_i/sig_i2;
-/*
-cout << "tee_m_" << i << ": " << tee_m << endl;
-cout << "tee_sig_" << i << ": " << tee_sig << endl;
-//*/
+
 		// Set tee[i] = min{tee_m,tee_sig}
-		tee[i] = min(tee_m,tee_sig);
-//cout << "tee[" << i << "]: " << tee[i] << endl;
+		this->tee[i] = min(tee_m,tee_sig);
 	}
 
 	// Find min{tee[j]}
 	tau = INFINITY;
-	for (unsigned int j=0;j < this->sp.size();j++){
-		if (tee[j] < tau){
-			tau = tee[j];
+	for (unsigned int j=0;j < nSp;j++){
+		if (this->tee[j] < tau){
+			tau = this->tee[j];
 		}
 	}
 
@@ -53,7 +53,7 @@ for (unsigned int i=0;i < this->g.size();i++){
 //	}
 }
 
-g_Getter::g_Getter(const g_Getter& gGet) : g(gGet.g), nRxns(gGet.nRxns), sp(gGet.sp), rxn(gGet.rxn){
+g_Getter::g_Getter(const g_Getter& gGet) : g(gGet.g), varRxn(gGet.varRxn), nRxns(gGet.nRxns), sp(gGet.sp), rxn(gGet.rxn){
 	if (debug)
 		cout << "g_Getter copy constructor called." << endl;
 }
@@ -156,13 +156,31 @@ cout << R_u->toString() << endl;*/
 
 double g_Getter::get_var_g(unsigned int i){
 	double g_var_i = 0.0; // Variable part of g_i
-	// Loop over reactions
-	for (unsigned int v=0;v < this->nRxns;v++){
-		g_var_i = max(g_var_i,this->get_var_g(v,i));
+	// Loop over reactions (get_var_g(v,i) is zero for all others)
+	for (unsigned int k=0;k < this->varRxn[i].size();k++){
+		g_var_i = max(g_var_i,this->get_var_g(this->varRxn[i][k],i));
 	}
 	return g_var_i;
 }
 
+// True if species S_i is a reactant in reaction R_u and R_u is not of a known type, i.e., get_var_g(u,i) is nonzero
+bool g_Getter::isVariable(unsigned int u, unsigned int i){
+	SimpleSpecies* S_i = this->sp[i];
+	Reaction* R_u = this->rxn[u];
+	for (unsigned int j=0;j < R_u->rateSpecies.size();j++){
+		if (S_i == R_u->rateSpecies[j]){
+			return (R_u->type.find("ELEMENTARY:SYNTHESIS")        == string::npos &&
+					R_u->type.find("ELEMENTARY:UNIMOLECULAR")     == string::npos &&
+					R_u->type.find("ELEMENTARY:BIMOLECULAR_AA")   == string::npos &&
+					R_u->type.find("ELEMENTARY:BIMOLECULAR_AB")   == string::npos &&
+					R_u->type.find("ELEMENTARY:TRIMOLECULAR_AAA") == string::npos &&
+					R_u->type.find("ELEMENTARY:TRIMOLECULAR_AAB") == string::npos &&
+					R_u->type.find("ELEMENTARY:TRIMOLECULAR_ABC") == string::npos);
+		}
+	}
+	return false;
+}
+
 double g_Getter::get_var_g(unsigned int u, unsigned int i){
 	double g_ui = 0.0; // Initialize to zero
 	SimpleSpecies* S_i = this->sp[i];
@@ -219,6 +237,7 @@ void g_Getter::addRxn(){
 		// Loop over species
 		double var_g_uj;
 		for (unsigned int j=0;j < this->g.size();j++){ // g.size(), not sp.size(), in case species have been added
+			if (this->isVariable(u,j)) this->varRxn[j].push_back(u);
 			this->g[j][0] = max(this->g[j][0],this->get_const_g(u,j)); // Constant part
 			var_g_uj = this->get_var_g(u,j);
 			if (this->g[j].size() == 2){
@@ -239,6 +258,10 @@ void g_Getter::addSpecies(){
 	if (this->g.size() < this->sp.size()){
 		unsigned int i = this->g.size();
 		this->g.push_back(vector<double>());
+		this->varRxn.push_back(vector<unsigned int>());
+		for (unsigned int u=0;u < this->nRxns;u++){
+			if (this->isVariable(u,i)) this->varRxn[i].push_back(u);
+		}
 		double var_gi;
 		this->g[i].push_back(this->get_const_g(i)); // Constant part of g_i only needs to be determined once
 		var_gi = this->get_var_g(i); // If S_i in non-standard rxn type, size of g[i] will be increased to 2 in get_var_g()
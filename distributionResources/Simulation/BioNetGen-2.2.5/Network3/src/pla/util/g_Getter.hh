@@ -21,12 +21,15 @@ namespace network3{
 		~g_Getter();
 		unsigned int size(){ return this->g.size(); }
 		double get_g(unsigned int i);
+		bool variable(unsigned int i){ return this->g[i].size() == 2; } // g_i depends on the current populations
 	protected:
 		vector<vector<double> > g;
+		vector<vector<unsigned int> > varRxn; // [sp.size()][rxns for which get_var_g(u,i) is nonzero]
 		double get_const_g(unsigned int i);
 		double get_const_g(unsigned int u, unsigned int i);
 		double get_var_g(unsigned int i);
 		double get_var_g(unsigned int u, unsigned int i);
+		bool isVariable(unsigned int u, unsigned int i);
 	private:
 		unsigned int nRxns;
 		vector<SimpleSpecies*>& sp;
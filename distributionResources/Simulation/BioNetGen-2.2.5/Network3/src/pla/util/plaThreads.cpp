@@ -0,0 +1,47 @@
+/*
+ * plaThreads.cpp
+ *
+ *  Threads and random number streams shared by the PLA stages.
+ */
+
+#include <ctime>
+#include "plaThreads.hh"
+
+Util::ThreadPool* PLA_Threads::pool = NULL;
+vector<Util::RandomStream> PLA_Threads::streams;
+unsigned long PLA_Threads::seedValue = 0;
+bool PLA_Threads::seeded = false;
+
+void PLA_Threads::start(unsigned int nThreads){
+	if (nThreads < 1){
+		cout << "Error in PLA_Threads::start(): Number of threads must be at least 1. Exiting." << endl;
+		exit(1);
+	}
+	delete pool;
+	pool = new Util::ThreadPool(nThreads);
+}
+
+void PLA_Threads::stop(){
+	delete pool;
+	pool = NULL;
+}
+
+void PLA_Threads::seed(unsigned long seed){
+	seedValue = seed;
+	seeded = true;
+	for (unsigned int b=0;b < streams.size();b++){
+		streams[b].seed(seedValue,b);
+	}
+}
+
+void PLA_Threads::reserveStreams(unsigned int n_blocks){
+	if (!seeded) PLA_Threads::seed((unsigned long)time(NULL)); // Like the global generator
+	while (streams.size() < n_blocks){
+		streams.push_back(Util::RandomStream());
+		streams.back().seed(seedValue,streams.size()-1);
+	}
+}
+
+void PLA_Threads::run(void (*task)(void*,unsigned int), void* arg, unsigned int n){
+	pool->run(task,arg,nBlocks(n));
+}
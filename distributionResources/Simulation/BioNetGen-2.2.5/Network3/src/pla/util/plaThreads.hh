@@ -0,0 +1,43 @@
+/*
+ * plaThreads.hh
+ *
+ *  Threads and random number streams shared by the PLA stages.
+ */
+
+#ifndef PLATHREADS_HH_
+#define PLATHREADS_HH_
+
+#include "../../std_include.hh"
+#include "../../util/util.hh"
+
+namespace network3{
+
+	//! Splits the per-rxn and per-species loops of a PLA step over threads
+	/*!
+	 *  Off by default, in which case the effective rates are calculated and the rxns are fired serially using the
+	 *  global random number generator. After start(), loops are cut into blocks of BLOCK_SIZE elements that run
+	 *  on the pool. Firings for block b are drawn from stream(b), and the populations are updated afterward in rxn
+	 *  order, so a given seed gives the same trajectory for any number of threads.
+	 */
+	class PLA_Threads{
+	public:
+		static const unsigned int BLOCK_SIZE = 256;
+		static void start(unsigned int nThreads);
+		static void stop();
+		static bool active(){ return pool != NULL; }
+		static void seed(unsigned long seed);
+		static unsigned int nBlocks(unsigned int n){ return (n + BLOCK_SIZE - 1)/BLOCK_SIZE; }
+		// Calls task(arg,b) for each block b of n elements
+		static void run(void (*task)(void*,unsigned int), void* arg, unsigned int n);
+		// Must be called before run() for the blocks that will use a stream
+		static void reserveStreams(unsigned int n_blocks);
+		static Util::RandomStream& stream(unsigned int block){ return streams[block]; }
+	protected:
+		static Util::ThreadPool* pool;
+		static vector<Util::RandomStream> streams;
+		static unsigned long seedValue;
+		static bool seeded;
+	};
+}
+
+#endif /* PLATHREADS_HH_ */
@@ -0,0 +1,134 @@
+/*
+ * rxnDependencies.cpp
+ *
+ *  Species-to-rxn dependency graph for updating tau-selection quantities incrementally.
+ */
+
+#include "rxnDependencies.hh"
+
+RxnDependencies::RxnDependencies(vector<Reaction*>& rxn) : pass(0), sp(NULL), rxn(rxn){
+	if (debug)
+		cout << "RxnDependencies constructor called." << endl;
+}
+
+RxnDependencies::RxnDependencies(vector<SimpleSpecies*>& sp, vector<Reaction*>& rxn) : pass(0), sp(&sp), rxn(rxn){
+	if (debug)
+		cout << "RxnDependencies constructor called." << endl;
+}
+
+// Copies are rebuilt on their first refresh()
+RxnDependencies::RxnDependencies(const RxnDependencies& dep) : pass(0), sp(dep.sp), rxn(dep.rxn){
+	if (debug)
+		cout << "RxnDependencies copy constructor called." << endl;
+}
+
+RxnDependencies::~RxnDependencies(){
+	if (debug)
+		cout << "RxnDependencies destructor called." << endl;
+}
+
+void RxnDependencies::build(){
+	// Species indices
+	this->species.clear();
+	map<SimpleSpecies*,unsigned int> index;
+	if (this->sp){
+		for (unsigned int j=0;j < this->sp->size();j++){
+			index[(*this->sp)[j]] = j;
+			this->species.push_back((*this->sp)[j]);
+		}
+	}
+	for (unsigned int v=0;v < this->rxn.size();v++){
+		for (unsigned int j=0;j < this->rxn[v]->rateSpecies.size();j++){
+			if (index.insert(make_pair(this->rxn[v]->rateSpecies[j],(unsigned int)this->species.size())).second){
+				this->species.push_back(this->rxn[v]->rateSpecies[j]);
+			}
+		}
+		map<SimpleSpecies*,int>::iterator it;
+		for (it = this->rxn[v]->stoichSpecies.begin();it != this->rxn[v]->stoichSpecies.end();it++){
+			if (index.insert(make_pair((*it).first,(unsigned int)this->species.size())).second){
+				this->species.push_back((*it).first);
+			}
+		}
+	}
+	unsigned int nSp = this->species.size();
+	unsigned int nRxn = this->rxn.size();
+	// Graph
+	this->stoichRxn.assign(nSp,vector<unsigned int>());
+	this->stoich.assign(nSp,vector<double>());
+	this->rateRxn.assign(nSp,vector<unsigned int>());
+	this->rxnStoichSp.assign(nRxn,vector<unsigned int>());
+	this->rxnRateSp.assign(nRxn,vector<unsigned int>());
+	this->always.clear();
+	for (unsigned int v=0;v < nRxn;v++){
+		map<SimpleSpecies*,int>::iterator it;
+		for (it = this->rxn[v]->stoichSpecies.begin();it != this->rxn[v]->stoichSpecies.end();it++){
+			unsigned int j = index[(*it).first];
+			this->stoichRxn[j].push_back(v);
+			this->stoich[j].push_back(static_cast<double>((*it).second));
+			this->rxnStoichSp[v].push_back(j);
+		}
+		for (unsigned int k=0;k < this->rxn[v]->rateSpecies.size();k++){
+			unsigned int j = index[this->rxn[v]->rateSpecies[k]];
+			if (this->rateRxn[j].empty() || this->rateRxn[j].back() != v) this->rateRxn[j].push_back(v);
+			this->rxnRateSp[v].push_back(j);
+		}
+		int kind = this->rxn[v]->re->kind;
+		if (kind == RateExpression::GENERIC || kind == RateExpression::MUPARSER){
+			this->always.push_back(v);
+		}
+	}
+	// Everything has changed
+	this->x.resize(nSp);
+	this->changedSp.resize(nSp);
+	for (unsigned int j=0;j < nSp;j++){
+		this->x[j] = this->species[j]->population;
+		this->changedSp[j] = j;
+	}
+	this->rate.resize(nRxn);
+	this->changedRxn.resize(nRxn);
+	for (unsigned int v=0;v < nRxn;v++){
+		this->rate[v] = this->rxn[v]->getRate();
+		this->changedRxn[v] = v;
+	}
+	this->seen.assign(nRxn,0);
+	this->pass = 0;
+}
+
+bool RxnDependencies::refresh(){
+	// Build on first call or if the network has grown
+	if (this->rate.size() != this->rxn.size() || (this->sp && this->sp->size() > this->x.size()) || this->pass == 0){
+		this->build();
+		this->pass = 1;
+		return true;
+	}
+	this->pass++;
+	if (this->pass == 0){ // Wrapped around
+		this->seen.assign(this->seen.size(),0);
+		this->pass = 1;
+	}
+	// Species
+	this->changedSp.clear();
+	for (unsigned int j=0;j < this->x.size();j++){
+		if (this->species[j]->population != this->x[j]){
+			this->x[j] = this->species[j]->population;
+			this->changedSp.push_back(j);
+		}
+	}
+	// Rates of rxns that depend on a changed species, plus those that are always recalculated
+	this->changedRxn.clear();
+	for (unsigned int n=0;n <= this->changedSp.size();n++){
+		vector<unsigned int>& dep = (n < this->changedSp.size()) ? this->rateRxn[this->changedSp[n]] : this->always;
+		for (unsigned int k=0;k < dep.size();k++){
+			unsigned int v = dep[k];
+			if (this->seen[v] != this->pass){
+				this->seen[v] = this->pass;
+				double r = this->rxn[v]->getRate();
+				if (!(r == this->rate[v])){ // NaN counts as changed
+					this->rate[v] = r;
+					this->changedRxn.push_back(v);
+				}
+			}
+		}
+	}
+	return false;
+}
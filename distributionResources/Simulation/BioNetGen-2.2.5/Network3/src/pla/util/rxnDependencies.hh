@@ -0,0 +1,53 @@
+/*
+ * rxnDependencies.hh
+ *
+ *  Species-to-rxn dependency graph for updating tau-selection quantities incrementally.
+ */
+
+#ifndef RXNDEPENDENCIES_HH_
+#define RXNDEPENDENCIES_HH_
+
+#include "../../std_include.hh"
+#include "../../model/reaction.hh"
+
+namespace network3{
+
+	//! Tracks which species populations and rxn rates have changed between steps
+	/*!
+	 *  The graph is built once, on the first call to refresh(), and rebuilt if rxns or species are added. Each
+	 *  later call compares the species populations to those seen last time and recalculates only the rates of
+	 *  rxns that depend on a changed species. Rates given by functions (muParser) can depend on observables and
+	 *  time, so they are recalculated every time. The rates seen by the caller are exactly those that
+	 *  Reaction::getRate() would return.
+	 */
+	class RxnDependencies{
+	public:
+		RxnDependencies(vector<Reaction*>& rxn);
+		RxnDependencies(vector<SimpleSpecies*>& sp, vector<Reaction*>& rxn);
+		RxnDependencies(const RxnDependencies& dep);
+		~RxnDependencies();
+		// Returns true if the graph was (re)built, in which case everything counts as changed
+		bool refresh();
+		unsigned int nSpecies(){ return this->species.size(); }
+		vector<SimpleSpecies*> species;				// sp[] if given, else in order of first appearance in rxn[]
+		vector<vector<unsigned int> > stoichRxn;	// [species][rxns that create/consume it], ascending
+		vector<vector<double> > stoich;				// [species][stoichiometry in each of stoichRxn]
+		vector<vector<unsigned int> > rxnStoichSp;	// [rxn][species it creates/consumes]
+		vector<vector<unsigned int> > rateRxn;		// [species][rxns whose rates depend on it], ascending
+		vector<vector<unsigned int> > rxnRateSp;	// [rxn][index of each of rateSpecies]
+		vector<double> rate;						// Rates as of the last refresh()
+		vector<unsigned int> changedSp;				// Species whose populations changed in the last refresh()
+		vector<unsigned int> changedRxn;			// Rxns whose rates changed in the last refresh()
+	protected:
+		vector<double> x;				// Populations as of the last refresh()
+		vector<unsigned int> always;	// Rxns whose rates are recalculated on every refresh()
+		vector<unsigned int> seen;		// Marks rxns already visited in the current refresh()
+		unsigned int pass;
+		void build();
+	private:
+		vector<SimpleSpecies*>* sp;
+		vector<Reaction*>& rxn;
+	};
+}
+
+#endif /* RXNDEPENDENCIES_HH_ */
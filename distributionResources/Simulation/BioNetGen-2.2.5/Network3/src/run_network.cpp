@@ -42,6 +42,8 @@ extern "C" {
 #include <vector>
 #include <map>
 #include <list>
+#include <fstream>
+#include <sstream>
 
 #include "network3.hh"
 
@@ -84,6 +86,8 @@ void print_error(){
 	fprintf(stderr,	"Usage:\n%s netfile sample_time n_sample\n",usage);
 	fprintf(stderr, "or\n");
 	fprintf(stderr,	"%s netfile t1 t2 ... tn\n", usage);
+	fprintf(stderr, "or\n");
+	fprintf(stderr, "run_network --to-text file.bin ...   (convert --binary-output trajectories to text)\n");
 	exit(1);
 }
 
@@ -96,11 +100,7 @@ int main(int argc, char *argv[]){
     char *netfile_name, *network_name;
     char *group_input_file_name = NULL;
     char *save_file_name;
-    FILE *netfile, *conc_file, *group_file/*, *func_file*/, *out, *flux_file, *species_stats_file;
-    int net_line_number, group_line_number, n_read;
-    Elt_array *species, *rates/*, *parameters*/;
-    Group *spec_groups = NULL;
-    Rxn_array *reactions;
+    FILE *conc_file, *group_file/*, *func_file*/, *out, *flux_file, *species_stats_file;
     int n, n_sample;
     double t_start=0.0, t, dt, atol = 1.0e-8, rtol = 1.0e-8;
     double sample_time, *sample_times = 0x0/*, *st, t1*/;
@@ -120,7 +120,7 @@ int main(int argc, char *argv[]){
 //  extern int optind, opterr;
     //
     // Allowed propagator types
-    enum {SSA, CVODE, EULER, RKCS, PLA};
+    enum {SSA, CVODE, EULER, RKCS, PLA, NRM, HYBRID, STEADY};
     int propagator = CVODE;
     int SOLVER = DENSE;
     int outtime = -1;
@@ -132,8 +132,27 @@ int main(int argc, char *argv[]){
     bool additional_pla_output = false; // Print PLA-specific data (e.g., rxn classifications)
     bool print_on_stop = true; // Print to file if stopping condition met?
     string stop_string = "0";
+    char* native_cache = NULL; // Directory for compiled derivatives
+    int n_ensemble = 0, n_ensemble_workers = 0; // Number of SSA trajectories to average, and processes to run them in
+    int n_pla_threads = 0; // Threads for calculating effective rates and firing rxns in PLA (0 = serial)
+    double hybrid_lambda = 10.0, hybrid_epsilon = 100.0; // Firings per sample and population of a fast rxn (hybrid)
+    int binary_output = 0; // Bytes per value in binary .cdat/.gdat/.fdat files (0 = text)
+    char* batch_file = NULL; // Parameter sets to integrate together
     mu::Parser stop_condition;
 
+    /* Convert binary trajectories to text, e.g. foo.cdat.bin to foo.cdat */
+    if (argc > 1 && strcmp(argv[1], "--to-text") == 0){
+    	if (argc < 3) print_error();
+    	for (iarg = 2; iarg < argc; iarg++){
+    		string bin_name = argv[iarg];
+    		string text_name = chop_suffix(argv[iarg], ".bin");
+    		if (text_name == bin_name) text_name += ".txt";
+    		if (Util::trajectoryToText(bin_name.c_str(), text_name.c_str()) != 0) error = 1;
+    		else fprintf(stdout, "Wrote %s.\n", text_name.c_str());
+    	}
+    	return (error);
+    }
+
     if (argc < 4) print_error();
 
     /* Process input options */
@@ -191,9 +210,12 @@ int main(int argc, char *argv[]){
     		break;
     	case 'p':
     		if (strcmp(argv[iarg],"ssa") == 0) propagator= SSA;
+    		else if (strcmp(argv[iarg],"nrm") == 0) propagator= NRM;
     		else if (strcmp(argv[iarg],"cvode") == 0) propagator= CVODE;
     		else if (strcmp(argv[iarg],"euler") == 0) propagator= EULER;
     		else if (strcmp(argv[iarg],"rkcs") == 0) propagator= RKCS;
+    		else if (strcmp(argv[iarg],"hybrid") == 0) propagator= HYBRID;
+    		else if (strcmp(argv[iarg],"steady") == 0) propagator= STEADY;
     		else if (strcmp(argv[iarg],"pla") == 0){
     			propagator= PLA;
     			if (argv[iarg+1][0] != '-') pla_config = argv[++iarg];
@@ -284,6 +306,74 @@ int main(int argc, char *argv[]){
 				cout << endl;
 //				cout << stop_string << endl;
 			}
+			// Linear solver for CVODE
+			else if (long_opt == "solver"){
+				if (strcmp(argv[iarg],"dense") == 0) SOLVER = DENSE;
+				else if (strcmp(argv[iarg],"gmres") == 0) SOLVER = GMRES;
+				else if (strcmp(argv[iarg],"sparse") == 0) SOLVER = SPARSE;
+				else if (strcmp(argv[iarg],"gmres-ilu") == 0) SOLVER = GMRES_ILU;
+				else{
+					fprintf(stderr, "ERROR: Unrecognized CVODE solver %s (use dense, gmres, gmres-ilu or sparse).\n", argv[iarg]);
+					exit(1);
+				}
+			}
+			// Compile the ODEs to native code, caching the shared objects in the given directory
+			else if (long_opt == "native"){
+				native_cache = argv[iarg];
+			}
+			// Keep a binary copy of the parsed network in the given directory, for faster loading next time
+			else if (long_opt == "net-cache"){
+				set_net_cache_network(argv[iarg]);
+			}
+			// Write .cdat, .gdat and .fdat as binary trajectories (convert with --to-text)
+			else if (long_opt == "binary-output"){
+				if (strcmp(argv[iarg],"double") == 0) binary_output = sizeof(double);
+				else if (strcmp(argv[iarg],"float") == 0) binary_output = sizeof(float);
+				else{
+					fprintf(stderr, "ERROR: Unrecognized binary output type %s (use double or float).\n", argv[iarg]);
+					exit(1);
+				}
+			}
+			// Integrate the parameter sets in the given file together, with one set of output files per set
+			else if (long_opt == "batch"){
+				batch_file = argv[iarg];
+			}
+			// Run an ensemble of SSA trajectories and output their mean and standard deviation
+			else if (long_opt == "ensemble"){
+				n_ensemble = atoi(argv[iarg]);
+				if (n_ensemble < 1){
+					fprintf(stderr, "ERROR: The ensemble must have at least one trajectory.\n");
+					exit(1);
+				}
+			}
+			else if (long_opt == "ensemble-workers"){
+				n_ensemble_workers = atoi(argv[iarg]);
+			}
+			// Split the PLA rate and firing loops over threads
+			else if (long_opt == "pla-threads"){
+				n_pla_threads = atoi(argv[iarg]);
+				if (n_pla_threads < 1){
+					fprintf(stderr, "ERROR: --pla-threads must be at least 1.\n");
+					exit(1);
+				}
+			}
+			// Partitioning thresholds for the hybrid SSA/ODE propagator
+			else if (long_opt == "hybrid-lambda"){
+				hybrid_lambda = atof(argv[iarg]);
+			}
+			else if (long_opt == "hybrid-epsilon"){
+				hybrid_epsilon = atof(argv[iarg]);
+			}
+			// Next reaction selection method for SSA
+			else if (long_opt == "ssa-selector"){
+				if (strcmp(argv[iarg],"linear") == 0) set_gillespie_selector_network(SSA_LINEAR);
+				else if (strcmp(argv[iarg],"tree") == 0) set_gillespie_selector_network(SSA_SUM_TREE);
+				else if (strcmp(argv[iarg],"cr") == 0) set_gillespie_selector_network(SSA_COMPOSITION_REJECTION);
+				else{
+					fprintf(stderr, "ERROR: Unrecognized SSA selector %s (use linear, tree or cr).\n", argv[iarg]);
+					exit(1);
+				}
+			}
 			//...
 			else{
 //				cout << endl;
@@ -378,66 +468,25 @@ int main(int argc, char *argv[]){
 	// Initialize time
 	t = t_start;
 
-	// Find NET file
-	if (!(netfile = fopen(netfile_name, "r"))) {
-		fprintf(stderr, "ERROR: Couldn't open file %s.\n", netfile_name);
-		exit(1);
-	}
-
 	/* Assign network_name based on netfile_name */
-	network_name = chop_suffix(netfile_name,".net");
+	network_name = chop_suffix(strdup(netfile_name),".net");
 	if (!outpre){
 		outpre = network_name;
 	}
 
-	/* Rate constants and concentration parameters should now be placed in the parameters block. */
-	net_line_number = 0;
-	rates = read_Elt_array(netfile, &net_line_number, (char*)"parameters", &n_read, 0x0);
-	fprintf(stdout, "Read %d parameters\n", n_read);
-//	if (n_read < 1) {
-//		fprintf(stderr,"ERROR: Reaction network must have parameters defined to be used as rate constants.\n");
-//		exit(1);
-//	}
-	rewind(netfile);
-	net_line_number = 0;
-
-    /* Read species */
-    if (!(species = read_Elt_array(netfile, &net_line_number, (char*)"species", &n_read, rates))){
-    	fprintf(stderr,"ERROR: Couldn't read rates array.\n");
-    	exit(1);
-    }
-    fprintf(stdout, "Read %d species\n", n_read);
-
-	/* Read optional groups */
-	if (group_input_file_name){
-		if (!(group_file = fopen(group_input_file_name, "r"))) {
-			fprintf(stderr, "ERROR: Couldn't open file %s.\n", group_input_file_name);
-			exit(1);
-		}
-		group_line_number = 0;
-		spec_groups = read_Groups(0x0, group_file, species, &group_line_number, (char*)"groups", &n_read);
-		fprintf(stdout, "Read %d group(s) from %s\n", n_read, group_input_file_name);
-		fclose(group_file);
-    }
-
-	/** Ilya Korsunsky 6/2/10: Global Functions */
-    map<string, double*> param_map = init_param_map(rates,spec_groups);
-    map<string, int> observ_index_map = init_observ_index_map(spec_groups);
-    map<string, int> param_index_map = init_param_index_map(rates);
-//    vector<vector<int> > func_observ_depend;
-//    vector<vector<int> > func_param_depend;
-
-    char* netfile_name_tmp = netfile_name; 
-    sprintf(netfile_name_tmp, "%s%s", netfile_name_tmp, ".net");
-    read_functions_array(netfile_name_tmp,rates,param_map,param_index_map,observ_index_map,&t);
-    int n_func = network.functions.size();
-    if (n_func > 0) n_func--; // Subtract off 'time' function
-    cout << "Read " << n_func << " function(s)" << endl;
-	if (!rates){ // Error if the 'rates' array doesn't exist (means 0 parameters, 0 functions)
-		fprintf(stderr,"ERROR: Reaction network must have parameters and/or functions defined to be used as rate laws.\n");
+	/* Should add check that reactions, rates, and species are defined */
+	/* Also should check that definitions don't exceed array bounds */
+	if (n_sample < 1) {
+		fprintf(stderr, "ERROR: n_sample < 1\n");
 		exit(1);
 	}
 
+	/* Read and initialize reaction network. Parameter sets of a batch may switch on reactions whose rate
+	 * constants are zero in the .net file, so those are kept. */
+	if (batch_file) remove_zero = 0;
+	map<string, double*> param_map;
+	if (read_network(netfile_name, group_input_file_name, remove_zero, &t, param_map) != 0) exit(1);
+
     // Create stop condition
 	process_function_names(stop_string); // Remove parentheses from variable names
 	vector<string> variable_names = find_variables(stop_string); // Extract variable names
@@ -459,48 +508,28 @@ int main(int argc, char *argv[]){
 	}
 	stop_condition.SetExpr(stop_string);
 
-    /* Read reactions */
-//	if (!(reactions = read_Rxn_array(netfile,&net_line_number,&n_read,species,rates,network.is_func_map,remove_zero))){
-	if (!(reactions = read_Rxn_array(netfile,&net_line_number,&n_read,species,rates,network.is_func_map))){
-		fprintf(stderr, "ERROR: No reactions in the network.\n");
-		exit(1);
-	}
-	fprintf(stdout, "Read %d reaction(s)\n", n_read);
-	if (remove_zero) {
-		remove_zero_rate_rxns(&reactions, rates);
-		int n_rxn = 0;
-		if (reactions){
-			n_rxn = reactions->n_rxn;
+	// Round species populations if propagator is SSA, NRM, PLA or HYBRID
+	if (propagator == SSA || propagator == NRM || propagator == PLA || propagator == HYBRID){
+		for (int i=0;i < net().species->n_elt;i++) {
+			net().species->elt[i]->val = floor(net().species->elt[i]->val + 0.5);
 		}
-		fprintf(stdout, "%d reaction(s) have nonzero rate\n", n_rxn);
-	}
-	else{
-		fprintf(stdout, "nonzero rate reactions were not removed\n"); 
-	}
-	/* sort_Rxn_array( reactions, rates); */
-    fclose(netfile);
-
-	/* Should add check that reactions, rates, and species are defined */
-	/* Also should check that definitions don't exceed array bounds */
-	if (n_sample < 1) {
-		fprintf(stderr, "ERROR: n_sample < 1\n");
-		exit(1);
 	}
 
-	/* Initialize reaction network */
-	init_network(reactions, rates, species, spec_groups, network_name);
-
-	// Round species populations if propagator is SSA or PLA
-	if (propagator == SSA || propagator == PLA){
-		for (int i=0;i < network.species->n_elt;i++) {
-			network.species->elt[i]->val = floor(network.species->elt[i]->val + 0.5);
-		}
+	/* Compile derivatives for the ODE propagators */
+	if (native_cache && (propagator == CVODE || propagator == EULER || propagator == RKCS || propagator == STEADY)){
+		compile_derivs_network(native_cache);
 	}
 
 	/* Initialize SSA */
 	if (propagator == SSA){
 		init_gillespie_direct_network(gillespie_update_interval,seed);
 	}
+	else if (propagator == NRM){
+		init_next_reaction_network(gillespie_update_interval,seed);
+	}
+	else if (propagator == HYBRID){
+		init_hybrid_network(hybrid_lambda,hybrid_epsilon,seed);
+	}
 
 	/* Save network to file */
 	if (save_file) {
@@ -534,6 +563,144 @@ int main(int argc, char *argv[]){
 	}
 	outpre = chop_suffix(outpre, ".net");
 
+	/* Binary trajectories (PLA and the ensemble statistics write their own text files) */
+	if (binary_output){
+		if (propagator == PLA || n_ensemble > 0){
+			fprintf(stdout, "Warning: --binary-output isn't supported with %s, writing text.\n",
+					(n_ensemble > 0) ? "--ensemble" : "PLA");
+			binary_output = 0;
+		}
+		set_binary_output_network(binary_output);
+	}
+
+	/* Ensemble of SSA trajectories: only the statistics are output */
+	if (n_ensemble > 0){
+		if (propagator != SSA && propagator != NRM){
+			fprintf(stderr, "ERROR: --ensemble requires the ssa or nrm propagator.\n");
+			exit(1);
+		}
+		if (continuation){
+			fprintf(stderr, "ERROR: --ensemble can't continue a previous simulation (-x).\n");
+			exit(1);
+		}
+		if (n_ensemble_workers < 1) n_ensemble_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		gillespie_ensemble_network(n_ensemble, n_ensemble_workers, seed, t_start, sample_time, sample_times,
+				n_sample, maxSteps-network3::TOL, stop_condition, outpre, print_cdat);
+		delete_GSP_included();
+		if (sample_times) free(sample_times);
+		// Note that "/^Program times:/" must be last message sent from Network3 (see BNGAction.pm)
+		ptimes = t_elapsed();
+		fprintf(stdout, "Program times:  %.2f CPU s %.2f clock s \n", ptimes.total_cpu, ptimes.total_real);
+		return (0);
+	}
+
+	/* Batch of parameter sets integrated together: each set has its own output files, named like those of
+	 * a BNG parameter scan (outpre_00001.cdat, ...) */
+	if (batch_file){
+		if (propagator != CVODE){
+			fprintf(stderr, "ERROR: --batch requires the cvode propagator.\n");
+			exit(1);
+		}
+		if (continuation || print_flux || enable_species_stats || print_func || stop_string != "0"){
+			fprintf(stderr, "ERROR: --batch can't be combined with -x, -f, -j, --fdat or --stop_cond.\n");
+			exit(1);
+		}
+		// First line: parameter names; then one line of values per set
+		ifstream in(batch_file);
+		if (!in){
+			fprintf(stderr, "ERROR: Couldn't open batch file %s.\n", batch_file);
+			exit(1);
+		}
+		vector<string> names;
+		vector<vector<double> > sets;
+		string line, word;
+		while (getline(in, line)){
+			line = line.substr(0, line.find('#'));
+			istringstream fields(line);
+			vector<string> words;
+			while (fields >> word) words.push_back(word);
+			if (words.empty()) continue;
+			if (names.empty()){
+				names = words;
+				continue;
+			}
+			if (words.size() != names.size()){
+				fprintf(stderr, "ERROR: Batch file %s has a line with %d values for %d parameters.\n", batch_file,
+						(int)words.size(), (int)names.size());
+				exit(1);
+			}
+			sets.push_back(vector<double>());
+			for (unsigned int j=0;j < words.size();j++) sets.back().push_back(atof(words[j].c_str()));
+		}
+		int B = sets.size();
+		if (B < 1){
+			fprintf(stderr, "ERROR: Batch file %s has no parameter sets.\n", batch_file);
+			exit(1);
+		}
+		if (init_batch_network(B) != 0) exit(1);
+		for (int b=0;b < B;b++){
+			for (unsigned int j=0;j < names.size();j++){
+				if (set_parameter_network(names[j].c_str(), sets[b][j]) != 0){
+					fprintf(stderr, "ERROR: Batch file %s sets unknown parameter %s.\n", batch_file, names[j].c_str());
+					exit(1);
+				}
+			}
+			init_species_network(); // Initial amounts may be given by the parameters of the set
+			set_batch_lane_network(b);
+		}
+
+		// Output files, with the initial concentrations
+		conc = ALLOC_VECTOR(n_species_network());
+		vector<FILE*> conc_files(B, (FILE*)NULL), group_files(B, (FILE*)NULL);
+		for (int b=0;b < B;b++){
+			sprintf(buf, "%s_%05d", outpre, b+1);
+			get_batch_conc_network(b, conc);
+			set_conc_network(conc);
+			conc_files[b] = init_print_concentrations_network(buf, 0);
+			print_concentrations_network(conc_files[b], t);
+			if (net().spec_groups){
+				group_files[b] = init_print_group_concentrations_network(buf, 0, false);
+				print_group_concentrations_network(group_files[b], t, false);
+			}
+		}
+
+		fprintf(stdout, "Propagating %d parameter sets together with cvode using %s\n", B,
+				(SOLVER == GMRES) ? "GMRES" : "block sparse LU");
+		if (verbose) fprintf(stdout, "%15s %13s %13s\n", "time", "n_steps", "n_deriv_calls");
+		double n_steps = 0.0, t_out = t_start;
+		double t_end = sample_times ? sample_times[n_sample] : t_start + (double)n_sample*sample_time;
+		for (n = 1; n <= n_sample && t < t_end-network3::TOL; ++n){
+			if (sample_times) t_out = sample_times[n];
+			else t_out += sample_time;
+			if (t_end < t_out) t_out = t_end;
+			error = propagate_cvode_batch_network(&t, t_out-t, &n_steps, &rtol, &atol, SOLVER);
+			if (error){
+				fprintf(stderr, "Stopping due to error in integration.\n");
+				exit(1);
+			}
+			if (verbose) fprintf(stdout, "%15.2f %13.0f %13d\n", t, n_steps, n_deriv_calls_network());
+			for (int b=0;b < B;b++){
+				get_batch_conc_network(b, conc);
+				set_conc_network(conc);
+				if (print_cdat || n == n_sample) print_concentrations_network(conc_files[b], t);
+				if (group_files[b]) print_group_concentrations_network(group_files[b], t, false);
+			}
+		}
+		for (int b=0;b < B;b++){
+			finish_print_concentrations_network(conc_files[b]);
+			if (group_files[b]) finish_print_group_concentrations_network(group_files[b], false);
+		}
+		fprintf(stdout, "Time courses written to files %s_00001.cdat ... %s_%05d.cdat%s.\n", outpre, outpre, B,
+				net().spec_groups ? " (and .gdat)" : "");
+		ptimes = t_elapsed();
+		fprintf(stdout, "Propagation took %.2e CPU seconds\n", ptimes.cpu);
+		if (sample_times) free(sample_times);
+		// Note that "/^Program times:/" must be last message sent from Network3 (see BNGAction.pm)
+		ptimes = t_elapsed();
+		fprintf(stdout, "Program times:  %.2f CPU s %.2f clock s \n", ptimes.total_cpu, ptimes.total_real);
+		return (0);
+	}
+
 	/* Initialize and print initial concentrations */
 	conc_file = NULL; // Just to be safe
 	conc_file = init_print_concentrations_network(outpre,continuation);
@@ -541,7 +708,7 @@ int main(int argc, char *argv[]){
 
 	/* Initialize and print initial group concentrations and function values */
 	group_file = NULL;
-	if (spec_groups || (print_func && network.functions.size() > 0)){
+	if (net().spec_groups || (print_func && net().functions.size() > 0)){
 		group_file = init_print_group_concentrations_network(outpre,continuation,print_func);
 		if (print_func & !continuation) init_print_function_values_network(group_file);
 		if (!continuation){
@@ -562,7 +729,7 @@ int main(int argc, char *argv[]){
 	if (print_flux){
 		flux_file = init_print_flux_network(outpre);
 		int discrete = 0;
-		if (propagator == SSA || propagator == PLA) discrete = 1;
+		if (propagator == SSA || propagator == NRM || propagator == PLA) discrete = 1;
 		print_flux_network(flux_file,t,discrete);
 	}
 
@@ -592,20 +759,20 @@ int main(int argc, char *argv[]){
 			}
 		}
 		// Search parameters
-		for (Elt* elt=network.rates->list;elt != NULL;elt=elt->next){
+		for (Elt* elt=net().rates->list;elt != NULL;elt=elt->next){
 			if (var.find(elt->name) != var.end()){
 //				cout << "\t" << "rates[" << elt->index << "] = " << elt->name << " (";
 				bool func = false;
 				// Is it a function?
-				for (unsigned int j=0;j < network.var_parameters.size() && !func;j++){
-					if (elt->index == network.var_parameters[j]){
+				for (unsigned int j=0;j < net().var_parameters.size() && !func;j++){
+					if (elt->index == net().var_parameters[j]){
 						// YES
 //						cout << "function[" << j <<"] = " << network.functions[j].GetExpr() << ")" << endl;
 						func = true;
 						bool found = false;
 						// Which one?
 						for (unsigned int k=0;k < Network3::FUNCTION.size() && !found;k++){
-							if (network.functions[j].GetExpr() == Network3::FUNCTION[k]->first->GetExpr()){
+							if (net().functions[j].GetExpr() == Network3::FUNCTION[k]->first->GetExpr()){
 								found = true;
 								pla_stop_condition.DefineVar(elt->name,&Network3::FUNCTION[k]->second);
 							}
@@ -613,7 +780,7 @@ int main(int argc, char *argv[]){
 						// Error check
 						if (!found){
 							cout << "Error constructing PLA stop condition in run_network: "
-								 << "Couldn't find function " << network.functions[j].GetExpr()
+								 << "Couldn't find function " << net().functions[j].GetExpr()
 								 << ". Exiting." << endl;
 							exit(1);
 						}
@@ -634,6 +801,7 @@ int main(int argc, char *argv[]){
 
 		// Initialize PLA
 		Network3::init_PLA(pla_config,verbose);
+		if (n_pla_threads > 0) PLA_Threads::start(n_pla_threads);
 		if (seed >= 0)	Network3::PLA_SIM->setSeed(seed);
 
 		// PLA-specific output
@@ -714,6 +882,7 @@ int main(int argc, char *argv[]){
 
 		// Clean up
 		Network3::close_Network3(false);
+		PLA_Threads::stop();
 	}
 	// ODE & SSA simulators
 	else{
@@ -728,7 +897,9 @@ int main(int argc, char *argv[]){
 		// Initial screen outputs
 		switch (propagator) {
 		case SSA:
-			fprintf(stdout, "Stochastic simulation using direct Gillespie algorithm\n");
+		case NRM:
+			if (propagator == NRM) fprintf(stdout, "Stochastic simulation using Gibson-Bruck next reaction method\n");
+			else fprintf(stdout, "Stochastic simulation using direct Gillespie algorithm\n");
 			if (verbose){
 				fprintf(stdout, "%15s %8s %12s %7s %7s %10s %7s\n", "time", "n_steps", "n_rate_calls",
 								 "% spec", "% rxn", "n_species", "n_rxns");
@@ -748,6 +919,8 @@ int main(int argc, char *argv[]){
 			if (SOLVER == GMRES) fprintf(stdout, " using GMRES\n");
 			else if (SOLVER == GMRES_J) fprintf(stdout, " using GMRES with specified Jacobian multiply\n");
 			else if (SOLVER == DENSE_J) fprintf(stdout, " using dense LU with specified Jacobian\n");
+			else if (SOLVER == SPARSE) fprintf(stdout, " using sparse LU with analytic Jacobian\n");
+			else if (SOLVER == GMRES_ILU) fprintf(stdout, " using GMRES with ILU(0) preconditioner\n");
 			else fprintf(stdout, " using dense LU\n");
 			if (verbose){
 				fprintf(stdout, "%15s %13s %13s\n", "time", "n_steps", "n_deriv_calls");
@@ -768,6 +941,18 @@ int main(int argc, char *argv[]){
 				fprintf(stdout, "%15.2f %13.0f %13d\n", t, n_steps, n_deriv_calls_network());
 			}
 		break;
+		case HYBRID:
+			fprintf(stdout, "Hybrid SSA/ODE simulation (fast rxns fire at least %g times per sample and have at least %g "
+					"molecules of every participant)\n", hybrid_lambda, hybrid_epsilon);
+			if (verbose){
+				fprintf(stdout, "%15s %13s %13s %10s\n", "time", "n_steps", "n_deriv_calls", "n_fast");
+				fprintf(stdout, "%15.2f %13.0f %13d %10s\n", t, n_steps, n_deriv_calls_network(), "-");
+			}
+		break;
+		case STEADY:
+			fprintf(stdout, "Steady state by pseudo-transient continuation (written at t=%g)\n", t_end);
+			if (verbose) fprintf(stdout, "%8s %13s %13s %13s\n", "iter", "sigma", "|dx|", "|dx/dt|");
+		break;
 		}
 		if (verbose) fflush(stdout);
 
@@ -790,6 +975,7 @@ int main(int argc, char *argv[]){
 			dt = t_out-t;
 			switch (propagator){
 			case SSA:
+			case NRM:
 				if (gillespie_n_steps() >= stepLimit - network3::TOL){
 					// Error check
 					if (gillespie_n_steps() > stepLimit + network3::TOL){
@@ -800,7 +986,8 @@ int main(int argc, char *argv[]){
 					// Continue
 					stepLimit = min(stepLimit+stepInterval,maxSteps);
 				}
-				error = gillespie_direct_network(&t, dt, 0x0, 0x0, stepLimit-network3::TOL,stop_condition);
+				if (propagator == NRM) error = next_reaction_network(&t, dt, 0x0, 0x0, stepLimit-network3::TOL,stop_condition);
+				else error = gillespie_direct_network(&t, dt, 0x0, 0x0, stepLimit-network3::TOL,stop_condition);
 				if (verbose){
 //					fprintf(stdout, "%15.6f %8ld %12d %7.3f %7.3f %10d %7d",
 					fprintf(stdout, "%15.6f %8.0f %12d %7.3f %7.3f %10d %7d",
@@ -904,6 +1091,41 @@ int main(int argc, char *argv[]){
 							") reached in RKCS simulation.";
 				}
 				break;
+			case HYBRID:
+				if (n_steps >= stepLimit - network3::TOL){
+					// Error check
+					if (n_steps > stepLimit + network3::TOL){
+						cout << "Uh oh, step limit exceeded in HYBRID (step limit = " << stepLimit << ", current step = "
+							 << n_steps << "). This shouldn't happen. Exiting." << endl;
+						exit(1);
+					}
+					// Continue
+					stepLimit = min(stepLimit+stepInterval,maxSteps);
+				}
+				error = propagate_hybrid_network(&t, dt, &n_steps, &rtol, &atol, SOLVER, stepLimit-network3::TOL,
+						stop_condition);
+				if (verbose) fprintf(stdout, "%15.2f %13.0f %13d %10d", t, n_steps, n_deriv_calls_network(),
+						hybrid_n_fast_network());
+				if (error == -1) n -= 1; // stepLimit reached in propagation
+				if (error == -2){ // Stop condition satisfied
+					forceQuit = true;
+					forceQuit_message = "Stopping condition " + stop_condition.GetExpr() +
+							"met in HYBRID simulation.";
+				}
+				if (n_steps >= maxSteps - network3::TOL){ // maxSteps limit reached
+					forceQuit = true;
+					forceQuit_message = "Maximum step limit (" + Util::toString(maxSteps) +
+							") reached in HYBRID simulation.";
+				}
+				break;
+			case STEADY:
+				// The steady state is found once and stands for the end of the time course
+				if (steady_state_network(&n_steps, rtol, atol, SOLVER, verbose) != 0){
+					forceQuit = true;
+					forceQuit_message = "Steady state not reached; the last iterate was written.";
+				}
+				t = t_end;
+				break;
 			}
 			n_rate_calls_last = n_rate_calls_network();
 			n_deriv_calls_last = n_deriv_calls_network();
@@ -922,7 +1144,7 @@ int main(int argc, char *argv[]){
 				if (enable_species_stats) print_species_stats(species_stats_file,t);
 				if (print_flux){
 					int discrete = 0;
-					if (propagator == SSA || propagator == PLA) discrete = 1;
+					if (propagator == SSA || propagator == NRM || propagator == PLA) discrete = 1;
 					print_flux_network(flux_file,t,discrete);
 				}
 				if (print_save_net){
@@ -977,6 +1199,7 @@ int main(int argc, char *argv[]){
 			if (forceQuit) cout << forceQuit_message << endl;
 
 		} // end for
+		if (propagator == HYBRID) fprintf(stdout, "TOTAL SLOW RXN FIRINGS: %-16.0f\n", n_steps);
 	} // end else
 
 	// Final printouts
@@ -988,13 +1211,15 @@ int main(int argc, char *argv[]){
 	if (group_file) finish_print_group_concentrations_network(group_file,print_func);
 	if (group_file && print_func) finish_print_function_values_network(group_file);
 	if (enable_species_stats) finish_print_species_stats(species_stats_file);
+	if (flux_file) finish_print_flux_network(flux_file);
 
 	// Screen outputs
 	outpre = chop_suffix(outpre, ".net");
-	if (propagator == SSA) fprintf(stdout, "TOTAL STEPS: %-16.0f\n", gillespie_n_steps());
-	fprintf(stdout, "Time course of concentrations written to file %s.cdat.\n", outpre);
-	if (n_groups_network()) fprintf(stdout, "Time course of groups written to file %s.gdat.\n", outpre);
-	if (print_func && network.functions.size() > 0) fprintf(stdout, "Time course of functions written to file %s.gdat.\n", outpre);
+	const char* bin = (binary_output) ? ".bin" : "";
+	if (propagator == SSA || propagator == NRM) fprintf(stdout, "TOTAL STEPS: %-16.0f\n", gillespie_n_steps());
+	fprintf(stdout, "Time course of concentrations written to file %s.cdat%s.\n", outpre, bin);
+	if (n_groups_network()) fprintf(stdout, "Time course of groups written to file %s.gdat%s.\n", outpre, bin);
+	if (print_func && net().functions.size() > 0) fprintf(stdout, "Time course of functions written to file %s.gdat%s.\n", outpre, bin);
 	ptimes = t_elapsed();
 	fprintf(stdout, "Propagation took %.2e CPU seconds\n", ptimes.cpu);
 
@@ -1010,8 +1235,8 @@ int main(int argc, char *argv[]){
 
 //	exit:
 	// Clean up memory allocated for functions
-	if (network.has_functions) delete[] network.rates->elt;
-	if (propagator == SSA){
+	if (net().has_functions) delete[] net().rates->elt;
+	if (propagator == SSA || propagator == NRM){
 		// GSP.included added to GSP struct in code extension for functions
 		// NOTE: GSP.included is created whether functions exist or not, so it must always be deleted
 		delete_GSP_included();
@@ -0,0 +1,165 @@
+/*
+ * check_rand2_samplers.cpp
+ *
+ * Statistical check of the array Poisson and binomial samplers of Util::RandomStream
+ * (Network3/src/util/rand2), which the PLA uses with --pla-threads.
+ *
+ * SYNOPSIS:
+ *   check_rand2_samplers [SEED]
+ *
+ * Each case is drawn N_DRAWS times. All cases are interleaved in the same array calls, so that a
+ * deviate that takes the wrong uniform or leaks state into its neighbor shows up too. The cases
+ * straddle the switch from inversion to PTRS (Poisson, mean 10) and BTRS (binomial, n*min(p,1-p) =
+ * 10), and the binomial cases include p > 1/2, which is sampled as n minus a draw of 1-p. For every
+ * case, the sample mean and variance must be within 5 standard errors of the exact values, and the
+ * chi-square statistic over bins with at least 5 expected counts must be below its 0.001
+ * significance level.
+ *
+ * Exits with the number of failed cases (0 if all passed). CMakeLists.txt builds it as a test, which
+ * "make -f Makefile.cmake check" runs.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "rand2.hh"
+
+using namespace std;
+
+#define N_DRAWS 1000000
+#define MIN_EXPECTED 5.0
+#define Z_CRIT 3.090232 // Standard normal quantile at 0.999
+
+struct Case{
+	const char* name;
+	bool binomial;
+	double mean;	// Poisson mean, or binomial p
+	double n;		// Binomial trials
+	vector<double> k;
+};
+
+// Log of the probability of k
+static double log_pmf(const Case& c, double k){
+	if (c.binomial){
+		return lgamma(c.n+1.0) - lgamma(k+1.0) - lgamma(c.n-k+1.0) + k*log(c.mean) + (c.n-k)*log(1.0-c.mean);
+	}
+	return k*log(c.mean) - c.mean - lgamma(k+1.0);
+}
+
+// Chi-square statistic of the draws against the exact distribution, over bins of at least MIN_EXPECTED
+// expected counts (the tails are merged into the bins next to them); df is set to the number of bins - 1
+static double chi_square(const Case& c, int& df){
+	double top = c.binomial ? c.n : c.mean + 20.0*sqrt(c.mean) + 20.0;
+	vector<double> count((size_t)top + 2, 0.0);
+	for (size_t i = 0; i < c.k.size(); ++i){
+		if (c.k[i] < 0.0 || c.k[i] > top) count.back() += 1.0; // Out of range, always a failure
+		else count[(size_t)c.k[i]] += 1.0;
+	}
+	double chi2 = 0.0, obs = 0.0, expected = 0.0;
+	int bins = 0;
+	for (size_t k = 0; k + 1 < count.size(); ++k){
+		obs += count[k];
+		expected += N_DRAWS*exp(log_pmf(c, (double)k));
+		if (expected >= MIN_EXPECTED){
+			chi2 += (obs-expected)*(obs-expected)/expected;
+			obs = expected = 0.0;
+			bins++;
+		}
+	}
+	// Whatever is left over (the upper tail) goes with the last bin
+	if (obs > 0.0 || expected > 0.0) chi2 += (obs-expected)*(obs-expected)/(expected > 0.0 ? expected : 1.0);
+	chi2 += count.back()*N_DRAWS;
+	df = bins - 1;
+	return chi2;
+}
+
+// Chi-square value at the 0.001 significance level (Wilson and Hilferty)
+static double chi_square_crit(int df){
+	double h = 2.0/(9.0*df);
+	double x = 1.0 - h + Z_CRIT*sqrt(h);
+	return df*x*x*x;
+}
+
+static Case make_case(const char* name, bool binomial, double mean, double n){
+	Case c;
+	c.name = name;
+	c.binomial = binomial;
+	c.mean = mean;
+	c.n = n;
+	c.k.reserve(N_DRAWS);
+	return c;
+}
+
+int main(int argc, char* argv[]){
+	unsigned long seed = (argc > 1) ? strtoul(argv[1], NULL, 10) : 12345;
+	Util::RandomStream stream;
+	stream.seed(seed, 0);
+
+	vector<Case> cases;
+	cases.push_back(make_case("Poisson(0.3)", false, 0.3, 0.0));
+	cases.push_back(make_case("Poisson(4)", false, 4.0, 0.0));
+	cases.push_back(make_case("Poisson(9.9)", false, 9.9, 0.0));
+	cases.push_back(make_case("Poisson(10)", false, 10.0, 0.0));
+	cases.push_back(make_case("Poisson(10.5)", false, 10.5, 0.0));
+	cases.push_back(make_case("Poisson(15)", false, 15.0, 0.0));
+	cases.push_back(make_case("Poisson(200)", false, 200.0, 0.0));
+	cases.push_back(make_case("Poisson(1e4)", false, 1e4, 0.0));
+	cases.push_back(make_case("Bin(12,0.25)", true, 0.25, 12.0));
+	cases.push_back(make_case("Bin(33,0.3)", true, 0.3, 33.0));
+	cases.push_back(make_case("Bin(34,0.3)", true, 0.3, 34.0));
+	cases.push_back(make_case("Bin(60,0.3)", true, 0.3, 60.0));
+	cases.push_back(make_case("Bin(30,0.8)", true, 0.8, 30.0));
+	cases.push_back(make_case("Bin(200,0.95)", true, 0.95, 200.0));
+	cases.push_back(make_case("Bin(1000,0.5)", true, 0.5, 1000.0));
+	cases.push_back(make_case("Bin(100000,0.01)", true, 0.01, 100000.0));
+
+	// The Poisson and binomial cases each go in one array call per round, in case order
+	vector<double> xm, pp, nTrials, kp, kb;
+	vector<int> ip, ib;
+	for (size_t c = 0; c < cases.size(); ++c){
+		if (cases[c].binomial){
+			pp.push_back(cases[c].mean);
+			nTrials.push_back(cases[c].n);
+			ib.push_back(c);
+		}
+		else{
+			xm.push_back(cases[c].mean);
+			ip.push_back(c);
+		}
+	}
+	kp.resize(xm.size());
+	kb.resize(pp.size());
+	for (int draw = 0; draw < N_DRAWS; ++draw){
+		stream.poisson(&xm[0], &kp[0], xm.size());
+		stream.binomial(&pp[0], &nTrials[0], &kb[0], pp.size());
+		for (size_t i = 0; i < ip.size(); ++i) cases[ip[i]].k.push_back(kp[i]);
+		for (size_t i = 0; i < ib.size(); ++i) cases[ib[i]].k.push_back(kb[i]);
+	}
+
+	int n_failed = 0;
+	printf("%-18s %12s %12s %12s %12s %10s %10s\n", "case", "mean", "exact", "variance", "exact", "chi2",
+			"crit");
+	for (size_t c = 0; c < cases.size(); ++c){
+		const Case& C = cases[c];
+		double mu = C.binomial ? C.n*C.mean : C.mean;
+		double var = C.binomial ? mu*(1.0-C.mean) : mu;
+		// Fourth central moment, for the standard error of the sample variance
+		double mu4 = C.binomial ? var*(1.0 + 3.0*(C.n-2.0)*C.mean*(1.0-C.mean)) : mu*(1.0 + 3.0*mu);
+		double sum = 0.0, sum2 = 0.0;
+		for (size_t i = 0; i < C.k.size(); ++i) sum += C.k[i];
+		double mean = sum/N_DRAWS;
+		for (size_t i = 0; i < C.k.size(); ++i) sum2 += (C.k[i]-mean)*(C.k[i]-mean);
+		double s2 = sum2/(N_DRAWS-1);
+		int df;
+		double chi2 = chi_square(C, df);
+		double crit = chi_square_crit(df);
+		bool ok = fabs(mean-mu) <= 5.0*sqrt(var/N_DRAWS) && fabs(s2-var) <= 5.0*sqrt((mu4-var*var)/N_DRAWS)
+				&& chi2 <= crit;
+		if (!ok) n_failed++;
+		printf("%-18s %12.5g %12.5g %12.5g %12.5g %10.2f %10.2f  %s\n", C.name, mean, mu, s2, var, chi2, crit,
+				ok ? "PASSED" : "FAILED!!");
+	}
+	printf("\n%d of %d case(s) failed.\n", n_failed, (int)cases.size());
+	return (n_failed);
+}
@@ -27,13 +27,24 @@ double gammln(double xx){
 	return -tmp+log(2.5066282746310005*ser/x);
 }
 
+// Uniform deviates on (0,1) from the global generator
+struct GlobalUniform{
+	double operator()(){ return Util::RANDOM_CLOSED(); }
+};
+
+// Uniform deviates on (0,1) from a stream
+struct StreamUniform{
+	Util::RandomStream& stream;
+	StreamUniform(Util::RandomStream& stream) : stream(stream){}
+	double operator()(){ return stream.closed(); }
+};
+
 // Returns as a floating-point number an integer value that is a random deviate drawn from a
-// Poisson distribution of mean xm, using ran1(idum) as a source of uniform random deviates.
+// Poisson distribution of mean xm, using ran1() as a source of uniform random deviates.
+// oldm, sq, alxm and g keep the quantities computed for the last mean between calls.
 //double poidev(double xm, long *idum){
-double Util::RANDOM_POISSON(double xm){
-//	double gammln(double xx);
-	//float ran1(long *idum);
-	static double sq,alxm,g,oldm=(-1.0); /// oldm is a flag for whether xm has changed since last call.
+template<class Uniform>
+static double poidev(double xm, Uniform ran1, double& oldm, double& sq, double& alxm, double& g){
 	double em,t,y;
 	if (xm < 12.0) { // Use direct method.
 		if (xm != oldm) {
@@ -45,8 +56,7 @@ double Util::RANDOM_POISSON(double xm){
 		do { // Instead of adding exponential deviates it is equivalent to multiply uniform deviates. We never
 			 // actually have to take the log, merely compare to the pre-computed exponential.
 			++em;
-//			t *= ran1(idum);
-			t *= Util::RANDOM_CLOSED();
+			t *= ran1();
 		} while (t > g);
 	} else { // Use rejection method.
 		if (xm != oldm) { // If xm has changed since the last call, then precompute some functions that occur below.
@@ -58,8 +68,7 @@ double Util::RANDOM_POISSON(double xm){
 		}
 		do {
 			do { // y is a deviate from a Lorentzian comparison function.
-//				y=tan(PI*ran1(idum));
-				y=tan(PI*Util::RANDOM_CLOSED());
+				y=tan(PI*ran1());
 				em=sq*y+xm; // em is y, shifted and scaled.
 			} while (em < 0.0); // Reject if in regime of zero probability.
 			em=floor(em); // The trick for integer-valued distributions.
@@ -67,12 +76,16 @@ double Util::RANDOM_POISSON(double xm){
 			// The ratio of the desired distribution to the comparison function; we accept or
 			// reject by comparing it to another uniform deviate. The factor 0.9 is chosen so
 			// that t never exceeds 1.
-//		} while (ran1(idum) > t);
-		} while (Util::RANDOM_CLOSED() > t);
+		} while (ran1() > t);
 	}
 	return em;
 }
 
+double Util::RANDOM_POISSON(double xm){
+	static double sq,alxm,g,oldm=(-1.0); /// oldm is a flag for whether xm has changed since last call.
+	return poidev(xm,GlobalUniform(),oldm,sq,alxm,g);
+}
+
 // Returns as a floating-point number an integer value that is a random deviate drawn from a binomial distribution of n trials
 // each of probability pp, using ran1(idum) as a source of uniform random deviates.
 //double Util::RANDOM_BINOMIAL(double pp, int n){
@@ -135,3 +148,183 @@ double Util::RANDOM_BINOMIAL(double pp, double n){
 	if (p != pp) bnl=n-bnl; // Remember to undo the symmetry transformation.
 	return bnl;
 }
+
+// Seeds the state with splitmix64, as recommended for xoshiro generators
+static uint64_t splitmix64(uint64_t& x){
+	uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k){
+	return (x << k) | (x >> (64 - k));
+}
+
+Util::RandomStream::RandomStream(){
+	this->seed(0,0);
+}
+
+void Util::RandomStream::seed(unsigned long seed, unsigned long index){
+	uint64_t x = ((uint64_t)seed << 32) ^ (uint64_t)index;
+	for (int i=0;i < 4;i++){
+		this->s[i] = splitmix64(x);
+	}
+	this->haveNextGaussian = false;
+	this->nextGaussian = 0.0;
+	this->oldm = -1.0;
+	this->sq = this->alxm = this->g = 0.0;
+}
+
+double Util::RandomStream::closed(){
+	// xoshiro256** (Blackman and Vigna)
+	uint64_t result = rotl(this->s[1]*5,7)*9;
+	uint64_t t = this->s[1] << 17;
+	this->s[2] ^= this->s[0];
+	this->s[3] ^= this->s[1];
+	this->s[1] ^= this->s[2];
+	this->s[0] ^= this->s[3];
+	this->s[2] ^= t;
+	this->s[3] = rotl(this->s[3],45);
+	// Top 53 bits, centered in their interval so that neither 0 nor 1 can be returned
+	return ((double)(result >> 11) + 0.5)*(1.0/9007199254740992.0);
+}
+
+double Util::RandomStream::gaussian(){
+	// Polar method, as in Util::RANDOM_GAUSSIAN()
+	if (this->haveNextGaussian){
+		this->haveNextGaussian = false;
+		return this->nextGaussian;
+	}
+	double v1,v2,s;
+	do{
+		v1 = 2.0*this->closed()-1.0;
+		v2 = 2.0*this->closed()-1.0;
+		s = v1*v1 + v2*v2;
+	} while (s >= 1.0 || s == 0.0);
+	double multiplier = sqrt(-2.0*log(s)/s);
+	this->nextGaussian = v2*multiplier;
+	this->haveNextGaussian = true;
+	return v1*multiplier;
+}
+
+double Util::RandomStream::poisson(double xm){
+	return poidev(xm,StreamUniform(*this),this->oldm,this->sq,this->alxm,this->g);
+}
+
+void Util::RandomStream::closed(double* u, unsigned int n){
+	for (unsigned int i=0;i < n;i++){
+		u[i] = this->closed();
+	}
+}
+
+// Number of steps at which inversion stops being cheaper than transformed rejection
+#define INVERSION_MAX 10.0
+
+// Poisson deviate of mean xm < INVERSION_MAX from the uniform u, by sequential search of the CDF
+static inline double poisson_inversion(double xm, double u){
+	double x = 0.0;
+	double p = exp(-xm);
+	double F = p;
+	while (u > F){
+		x += 1.0;
+		p *= xm/x;
+		double F_old = F;
+		F += p;
+		if (F == F_old) break; // u is within roundoff of 1
+	}
+	return x;
+}
+
+// Poisson deviate of mean xm >= INVERSION_MAX by PTRS (Hormann, Insurance Math. Econom. 12:39-45, 1993).
+// U is the first uniform to try; later tries draw their own.
+static double poisson_ptrs(double xm, double U, Util::RandomStream& stream){
+	double slam = sqrt(xm);
+	double loglam = log(xm);
+	double b = 0.931 + 2.53*slam;
+	double a = -0.059 + 0.02483*b;
+	double invalpha = 1.1239 + 1.1328/(b-3.4);
+	double vr = 0.9277 - 3.6224/(b-2.0);
+	while (true){
+		U -= 0.5;
+		double V = stream.closed();
+		double us = 0.5 - fabs(U);
+		double k = floor((2.0*a/us + b)*U + xm + 0.43);
+		if (us >= 0.07 && V <= vr) return k; // Squeeze
+		if (k >= 0.0 && (us >= 0.013 || V <= us)){
+			if (log(V*invalpha/(a/(us*us) + b)) <= -xm + k*loglam - gammln(k+1.0)) return k;
+		}
+		U = stream.closed();
+	}
+}
+
+void Util::RandomStream::poisson(const double* xm, double* k, unsigned int n){
+	if (this->u.size() < n) this->u.resize(n);
+	this->closed(&this->u[0],n);
+	for (unsigned int i=0;i < n;i++){
+		if (xm[i] <= 0.0) k[i] = 0.0;
+		else if (xm[i] < INVERSION_MAX) k[i] = poisson_inversion(xm[i],this->u[i]);
+		else k[i] = poisson_ptrs(xm[i],this->u[i],*this);
+	}
+}
+
+// Binomial deviate for n trials of probability p <= 0.5, n*p < INVERSION_MAX, by sequential search of the CDF
+static inline double binomial_inversion(double p, double n, double u){
+	double q = 1.0 - p;
+	double s = p/q;
+	double a = (n+1.0)*s;
+	double r = pow(q,n);
+	double x = 0.0;
+	double F = r;
+	while (u > F && x < n){
+		x += 1.0;
+		r *= a/x - s;
+		double F_old = F;
+		F += r;
+		if (F == F_old) break; // u is within roundoff of 1
+	}
+	return x;
+}
+
+// Binomial deviate for n trials of probability p <= 0.5, n*p >= INVERSION_MAX, by BTRS (Hormann, J. Stat. Comput.
+// Simul. 46:101-110, 1993). U is the first uniform to try; later tries draw their own.
+static double binomial_btrs(double p, double n, double U, Util::RandomStream& stream){
+	double q = 1.0 - p;
+	double spq = sqrt(n*p*q);
+	double b = 1.15 + 2.53*spq;
+	double a = -0.0873 + 0.0248*b + 0.01*p;
+	double c = n*p + 0.5;
+	double alpha = (2.83 + 5.1/b)*spq;
+	double vr = 0.92 - 4.2/b;
+	double m = floor((n+1.0)*p);
+	double lpq = log(p/q);
+	double h = gammln(m+1.0) + gammln(n-m+1.0);
+	while (true){
+		U -= 0.5;
+		double V = stream.closed();
+		double us = 0.5 - fabs(U);
+		double k = floor((2.0*a/us + b)*U + c);
+		if (k >= 0.0 && k <= n){
+			if (us >= 0.07 && V <= vr) return k; // Squeeze
+			if (log(V*alpha/(a/(us*us) + b)) <= h - gammln(k+1.0) - gammln(n-k+1.0) + (k-m)*lpq) return k;
+		}
+		U = stream.closed();
+	}
+}
+
+void Util::RandomStream::binomial(const double* pp, const double* nTrials, double* k, unsigned int n){
+	if (this->u.size() < n) this->u.resize(n);
+	this->closed(&this->u[0],n);
+	for (unsigned int i=0;i < n;i++){
+		double N = nTrials[i];
+		if (N <= 0.0 || pp[i] <= 0.0) k[i] = 0.0;
+		else if (pp[i] >= 1.0) k[i] = N;
+		else{
+			// Symmetric under p -> 1-p, k -> n-k
+			double p = (pp[i] <= 0.5 ? pp[i] : 1.0-pp[i]);
+			if (N*p < INVERSION_MAX) k[i] = binomial_inversion(p,N,this->u[i]);
+			else k[i] = binomial_btrs(p,N,this->u[i],*this);
+			if (p != pp[i]) k[i] = N - k[i];
+		}
+	}
+}
@@ -8,6 +8,8 @@
 #ifndef RAND2_HH_
 #define RAND2_HH_
 
+#include <stdint.h>
+#include <vector>
 #include "../rand.hh"
 
 namespace Util{
@@ -16,6 +18,35 @@ namespace Util{
 //	double RANDOM_BINOMIAL(double pp, int n);
 	double RANDOM_BINOMIAL(double pp, double n);
 
+	//! Independent stream of random numbers
+	/*!
+	 *  The functions above all draw from the one global generator, so they cannot be called from several
+	 *  threads. Each RandomStream has its own generator (xoshiro256**) and its own state for the Poisson and
+	 *  Gaussian deviates, so work that is split over threads can give each piece a stream of its own. The
+	 *  numbers drawn from a stream depend only on the seed and the stream index it was seeded with.
+	 *
+	 *  The array versions draw n deviates per call. The uniforms for the first try at every deviate are drawn
+	 *  in one pass, and each deviate then takes a fixed, short path: inversion by sequential search for small
+	 *  means, and Hormann's transformed rejection with squeeze (PTRS for Poisson, BTRS for binomial) for large
+	 *  ones, which accepts about nine times in ten on the first pair of uniforms.
+	 */
+	class RandomStream{
+	public:
+		RandomStream();
+		void seed(unsigned long seed, unsigned long index);
+		double closed();	// Uniform on (0,1)
+		double gaussian();	// Mean 0, variance 1
+		double poisson(double xm);
+		void closed(double* u, unsigned int n);
+		void poisson(const double* xm, double* k, unsigned int n);
+		void binomial(const double* pp, const double* nTrials, double* k, unsigned int n);
+	protected:
+		uint64_t s[4];
+		std::vector<double> u;	// Uniforms for the array versions
+		bool haveNextGaussian;
+		double nextGaussian;
+		double oldm, sq, alxm, g; // Cached by poisson() for the last mean
+	};
 }
 
 #endif /* RAND2_HH_ */
@@ -0,0 +1,269 @@
+/*
+ * sparseLU.cpp
+ *
+ *  Sparse direct solver for the Newton systems of the CVODE integrator.
+ */
+
+#include "sparseLU.hh"
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+
+Util::SparseLU::SparseLU() : n(0), incomplete(false){}
+
+Util::SparseLU::~SparseLU(){}
+
+void Util::SparseLU::analyze(int n, const int* row_start, const int* col_index, bool incomplete){
+	this->n = n;
+	this->incomplete = incomplete;
+	this->work.assign(n,0.0);
+
+	// ILU(0): the factors have the pattern of the matrix, in the original order
+	if (incomplete){
+		this->perm.resize(n);
+		this->lu_start.assign(row_start,row_start+n+1);
+		this->lu_index.assign(col_index,col_index+row_start[n]);
+		this->lu_diag.assign(n,0);
+		this->a_slot.resize(row_start[n]);
+		for (int i = 0; i < n; i++){
+			this->perm[i] = i;
+			this->lu_diag[i] = (int)(lower_bound(col_index+row_start[i],col_index+row_start[i+1],i) - col_index);
+		}
+		for (int e = 0; e < row_start[n]; e++) this->a_slot[e] = e;
+		this->lu_val.assign(row_start[n],0.0);
+		this->mark.assign(n,-1);
+		return;
+	}
+
+	// Symmetrized pattern, without the diagonal
+	vector<vector<int> > adj(n);
+	for (int i = 0; i < n; i++){
+		for (int e = row_start[i]; e < row_start[i+1]; e++){
+			int j = col_index[e];
+			if (j != i){
+				adj[i].push_back(j);
+				adj[j].push_back(i);
+			}
+		}
+	}
+	for (int i = 0; i < n; i++){
+		sort(adj[i].begin(),adj[i].end());
+		adj[i].erase(unique(adj[i].begin(),adj[i].end()),adj[i].end());
+	}
+
+	// Minimum degree ordering. Eliminating an unknown connects all of its remaining neighbours to each
+	// other, and those neighbours make up the off-diagonal pattern of its row of U and column of L.
+	// Ties are broken by index, so the ordering is reproducible.
+	set<pair<int,int> > queue;
+	for (int i = 0; i < n; i++) queue.insert(make_pair((int)adj[i].size(),i));
+	vector<vector<int> > eliminated_with(n);
+	vector<int> merged;
+	this->perm.assign(n,0);
+	for (int k = 0; k < n; k++){
+		int p = queue.begin()->second;
+		if (queue.begin()->first == n-k-1){
+			// The unknowns left are all connected to each other, so the rest of the factors is dense
+			vector<int> rest;
+			for (set<pair<int,int> >::iterator it = queue.begin(); it != queue.end(); it++) rest.push_back(it->second);
+			for (unsigned int a = 0; a < rest.size(); a++){
+				this->perm[k+a] = rest[a];
+				eliminated_with[rest[a]].assign(rest.begin()+a+1,rest.end());
+			}
+			break;
+		}
+		queue.erase(queue.begin());
+		this->perm[k] = p;
+		eliminated_with[p].swap(adj[p]);
+		const vector<int>& nbr = eliminated_with[p];
+		for (unsigned int a = 0; a < nbr.size(); a++){
+			int u = nbr[a];
+			queue.erase(make_pair((int)adj[u].size(),u));
+			merged.clear();
+			set_union(adj[u].begin(),adj[u].end(),nbr.begin(),nbr.end(),back_inserter(merged));
+			adj[u].clear();
+			for (unsigned int b = 0; b < merged.size(); b++){
+				if (merged[b] != u && merged[b] != p) adj[u].push_back(merged[b]);
+			}
+			queue.insert(make_pair((int)adj[u].size(),u));
+		}
+	}
+
+	// Pattern of the factors, with rows and columns numbered in elimination order
+	vector<int> iperm(n);
+	for (int k = 0; k < n; k++) iperm[this->perm[k]] = k;
+	vector<vector<int> > lower(n), upper(n);
+	for (int k = 0; k < n; k++){
+		const vector<int>& nbr = eliminated_with[this->perm[k]];
+		for (unsigned int a = 0; a < nbr.size(); a++){
+			int i = iperm[nbr[a]];
+			lower[i].push_back(k);
+			upper[k].push_back(i);
+		}
+	}
+	this->lu_start.assign(n+1,0);
+	this->lu_diag.assign(n,0);
+	this->lu_index.clear();
+	for (int i = 0; i < n; i++){
+		this->lu_start[i] = (int)this->lu_index.size();
+		this->lu_index.insert(this->lu_index.end(),lower[i].begin(),lower[i].end());
+		this->lu_diag[i] = (int)this->lu_index.size();
+		this->lu_index.push_back(i);
+		sort(upper[i].begin(),upper[i].end());
+		this->lu_index.insert(this->lu_index.end(),upper[i].begin(),upper[i].end());
+	}
+	this->lu_start[n] = (int)this->lu_index.size();
+	this->lu_val.assign(this->lu_index.size(),0.0);
+
+	// Where each entry of the matrix goes in the factors
+	this->a_slot.assign(row_start[n],0);
+	for (int i = 0; i < n; i++){
+		int row = iperm[i];
+		vector<int>::iterator begin = this->lu_index.begin() + this->lu_start[row];
+		vector<int>::iterator end = this->lu_index.begin() + this->lu_start[row+1];
+		for (int e = row_start[i]; e < row_start[i+1]; e++){
+			this->a_slot[e] = (int)(lower_bound(begin,end,iperm[col_index[e]]) - this->lu_index.begin());
+		}
+	}
+}
+
+int Util::SparseLU::factor(const double* values){
+	int* index = &this->lu_index[0];
+	double* val = &this->lu_val[0];
+	double* w = &this->work[0];
+
+	// Load the matrix into the pattern of the factors
+	fill(this->lu_val.begin(),this->lu_val.end(),0.0);
+	for (unsigned int e = 0; e < this->a_slot.size(); e++){
+		val[this->a_slot[e]] += values[e];
+	}
+
+	// Row-by-row elimination. The complete pattern is closed under fill, so every update lands on an
+	// entry of the row; in ILU(0) the updates that fall outside of the pattern are dropped.
+	int* mark = this->incomplete ? &this->mark[0] : NULL;
+	for (int i = 0; i < this->n; i++){
+		for (int s = this->lu_start[i]; s < this->lu_start[i+1]; s++){
+			w[index[s]] = val[s];
+			if (mark) mark[index[s]] = i;
+		}
+		for (int s = this->lu_start[i]; s < this->lu_diag[i]; s++){
+			int k = index[s];
+			double l = w[k] / val[this->lu_diag[k]];
+			w[k] = l;
+			if (l == 0.0) continue;
+			if (mark){
+				for (int t = this->lu_diag[k]+1; t < this->lu_start[k+1]; t++){
+					if (mark[index[t]] == i) w[index[t]] -= l*val[t];
+				}
+			}
+			else{
+				for (int t = this->lu_diag[k]+1; t < this->lu_start[k+1]; t++){
+					w[index[t]] -= l*val[t];
+				}
+			}
+		}
+		for (int s = this->lu_start[i]; s < this->lu_start[i+1]; s++) val[s] = w[index[s]];
+		if (val[this->lu_diag[i]] == 0.0) return this->perm[i] + 1;
+	}
+	return 0;
+}
+
+void Util::SparseLU::solve(double* b){
+	int* index = &this->lu_index[0];
+	double* val = &this->lu_val[0];
+	double* w = &this->work[0];
+	for (int k = 0; k < this->n; k++) w[k] = b[this->perm[k]];
+	// L has a unit diagonal
+	for (int i = 0; i < this->n; i++){
+		double x = w[i];
+		for (int s = this->lu_start[i]; s < this->lu_diag[i]; s++) x -= val[s]*w[index[s]];
+		w[i] = x;
+	}
+	for (int i = this->n-1; i >= 0; i--){
+		double x = w[i];
+		for (int s = this->lu_diag[i]+1; s < this->lu_start[i+1]; s++) x -= val[s]*w[index[s]];
+		w[i] = x / val[this->lu_diag[i]];
+	}
+	for (int k = 0; k < this->n; k++) b[this->perm[k]] = w[k];
+}
+
+int Util::SparseLU::factorBatch(const double* values, int B){
+	int* index = &this->lu_index[0];
+	this->batch_val.assign(this->lu_index.size()*B,0.0);
+	this->batch_work.resize((size_t)this->n*B);
+	double* val = &this->batch_val[0];
+	double* w = &this->batch_work[0];
+	int b;
+
+	for (unsigned int e = 0; e < this->a_slot.size(); e++){
+		double* v = val + (size_t)this->a_slot[e]*B;
+		for (b = 0; b < B; b++) v[b] += values[e*B+b];
+	}
+
+	int* mark = this->incomplete ? &this->mark[0] : NULL;
+	int zero = 0;
+	for (int i = 0; i < this->n; i++){
+		for (int s = this->lu_start[i]; s < this->lu_start[i+1]; s++){
+			double* ws = w + (size_t)index[s]*B;
+			const double* vs = val + (size_t)s*B;
+			for (b = 0; b < B; b++) ws[b] = vs[b];
+			if (mark) mark[index[s]] = i;
+		}
+		for (int s = this->lu_start[i]; s < this->lu_diag[i]; s++){
+			int k = index[s];
+			double* l = w + (size_t)k*B;
+			const double* d = val + (size_t)this->lu_diag[k]*B;
+			for (b = 0; b < B; b++) l[b] /= d[b];
+			for (int t = this->lu_diag[k]+1; t < this->lu_start[k+1]; t++){
+				if (mark && mark[index[t]] != i) continue;
+				double* wt = w + (size_t)index[t]*B;
+				const double* vt = val + (size_t)t*B;
+				for (b = 0; b < B; b++) wt[b] -= l[b]*vt[b];
+			}
+		}
+		for (int s = this->lu_start[i]; s < this->lu_start[i+1]; s++){
+			const double* ws = w + (size_t)index[s]*B;
+			double* vs = val + (size_t)s*B;
+			for (b = 0; b < B; b++) vs[b] = ws[b];
+		}
+		const double* d = val + (size_t)this->lu_diag[i]*B;
+		for (b = 0; b < B && !zero; b++){
+			if (d[b] == 0.0) zero = this->perm[i] + 1;
+		}
+		if (zero) return zero;
+	}
+	return 0;
+}
+
+void Util::SparseLU::solveBatch(double* rhs, int B){
+	int* index = &this->lu_index[0];
+	double* val = &this->batch_val[0];
+	double* w = &this->batch_work[0];
+	int b;
+	for (int k = 0; k < this->n; k++){
+		const double* r = rhs + (size_t)this->perm[k]*B;
+		for (b = 0; b < B; b++) w[(size_t)k*B+b] = r[b];
+	}
+	for (int i = 0; i < this->n; i++){
+		double* x = w + (size_t)i*B;
+		for (int s = this->lu_start[i]; s < this->lu_diag[i]; s++){
+			const double* v = val + (size_t)s*B;
+			const double* y = w + (size_t)index[s]*B;
+			for (b = 0; b < B; b++) x[b] -= v[b]*y[b];
+		}
+	}
+	for (int i = this->n-1; i >= 0; i--){
+		double* x = w + (size_t)i*B;
+		for (int s = this->lu_diag[i]+1; s < this->lu_start[i+1]; s++){
+			const double* v = val + (size_t)s*B;
+			const double* y = w + (size_t)index[s]*B;
+			for (b = 0; b < B; b++) x[b] -= v[b]*y[b];
+		}
+		const double* d = val + (size_t)this->lu_diag[i]*B;
+		for (b = 0; b < B; b++) x[b] /= d[b];
+	}
+	for (int k = 0; k < this->n; k++){
+		double* r = rhs + (size_t)this->perm[k]*B;
+		for (b = 0; b < B; b++) r[b] = w[(size_t)k*B+b];
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ * sparseLU.hh
+ *
+ *  Sparse direct solver for the Newton systems of the CVODE integrator.
+ */
+
+#ifndef SPARSELU_HH_
+#define SPARSELU_HH_
+
+#include <vector>
+
+using namespace std;
+
+namespace Util {
+
+	//! Sparse LU factorization with a fill-reducing ordering
+	/*!
+	 *  analyze() takes the nonzero pattern of an n x n matrix in compressed row form, orders the
+	 *  unknowns by minimum degree on the symmetrized pattern and works out the pattern of the
+	 *  factors, which is the filled graph of that elimination. factor() then computes L and U for
+	 *  any matrix with the analyzed pattern, and solve() does the triangular solves. The pattern is
+	 *  analyzed once and factored many times, which is what a stiff integrator needs.
+	 *
+	 *  Pivots are taken from the diagonal in the chosen order, without row interchanges. That is
+	 *  safe for the iteration matrices I - gamma*J that CVODE factors, which approach the identity
+	 *  as the step size gets smaller; a zero pivot is reported so that the caller can retry with a
+	 *  smaller step.
+	 *
+	 *  With incomplete = true, analyze() skips the ordering and keeps the pattern of the matrix
+	 *  itself, so that factor() computes the ILU(0) factors, for use as a preconditioner.
+	 */
+	class SparseLU{
+	public:
+		SparseLU();
+		~SparseLU();
+
+		// Analyze the pattern given by row_start[0..n] and col_index[], which must be sorted within rows.
+		// Every row should contain its diagonal.
+		void analyze(int n, const int* row_start, const int* col_index, bool incomplete = false);
+
+		// Factor the matrix whose entries, in the order of the analyzed pattern, are in values[].
+		// Returns 0 on success or (1 + row) of the first zero pivot.
+		int factor(const double* values);
+
+		// Overwrite b with the solution of A*x = b, using the last factorization
+		void solve(double* b);
+
+		// The same for B matrices with the analyzed pattern at once, stored lane by lane: entry e of matrix j is
+		// values[e*B+j], and element i of right-hand side j is b[i*B+j]. The inner loops run over the B lanes,
+		// so they vectorize. factorBatch() returns (1 + row) of the first zero pivot in any of the matrices.
+		int factorBatch(const double* values, int B);
+		void solveBatch(double* b, int B);
+
+		int size() const { return this->n; }
+		int nonzeros() const { return (int)this->lu_index.size(); }
+
+	protected:
+		int n;
+		bool incomplete;
+		vector<int> perm;      // perm[k] is the unknown that is eliminated at step k
+		vector<int> lu_start;  // rows of the factors, in elimination order; L below and U on and above the diagonal
+		vector<int> lu_index;
+		vector<int> lu_diag;
+		vector<double> lu_val;
+		vector<int> a_slot;    // position in lu_val of each entry of the analyzed matrix
+		vector<double> work;
+		vector<double> batch_val;   // factors of factorBatch(), lane by lane
+		vector<double> batch_work;
+		vector<int> mark;      // mark[j] == i while row i is eliminated if j is in its pattern (ILU only)
+	};
+}
+
+#endif /* SPARSELU_HH_ */
@@ -0,0 +1,87 @@
+/*
+ * threadPool.cpp
+ *
+ *  Fixed set of worker threads for splitting loops into independent pieces.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include "threadPool.hh"
+
+Util::ThreadPool::ThreadPool(unsigned int nThreads) : task(NULL), arg(NULL), n(0), next(0), finished(0),
+	generation(0), quit(false){
+	pthread_mutex_init(&this->lock,NULL);
+	pthread_cond_init(&this->start,NULL);
+	pthread_cond_init(&this->done,NULL);
+	for (unsigned int i=1;i < nThreads;i++){
+		pthread_t thread;
+		if (pthread_create(&thread,NULL,ThreadPool::worker,this) != 0){
+			fprintf(stderr, "ERROR: Couldn't start thread %u of %u.\n", i+1, nThreads);
+			exit(1);
+		}
+		this->threads.push_back(thread);
+	}
+}
+
+Util::ThreadPool::~ThreadPool(){
+	pthread_mutex_lock(&this->lock);
+	this->quit = true;
+	pthread_cond_broadcast(&this->start);
+	pthread_mutex_unlock(&this->lock);
+	for (unsigned int i=0;i < this->threads.size();i++){
+		pthread_join(this->threads[i],NULL);
+	}
+	pthread_cond_destroy(&this->done);
+	pthread_cond_destroy(&this->start);
+	pthread_mutex_destroy(&this->lock);
+}
+
+void Util::ThreadPool::run(void (*task)(void*,unsigned int), void* arg, unsigned int n){
+	if (n == 0) return;
+	if (this->threads.empty()){
+		for (unsigned int i=0;i < n;i++) task(arg,i);
+		return;
+	}
+	pthread_mutex_lock(&this->lock);
+	this->task = task;
+	this->arg = arg;
+	this->n = n;
+	this->next = 0;
+	this->finished = 0;
+	this->generation++;
+	pthread_cond_broadcast(&this->start);
+	pthread_mutex_unlock(&this->lock);
+	this->work();
+	pthread_mutex_lock(&this->lock);
+	while (this->finished < this->n) pthread_cond_wait(&this->done,&this->lock);
+	pthread_mutex_unlock(&this->lock);
+}
+
+// Takes pieces of the current loop until there are none left
+void Util::ThreadPool::work(){
+	pthread_mutex_lock(&this->lock);
+	while (this->next < this->n){
+		unsigned int i = this->next++;
+		pthread_mutex_unlock(&this->lock);
+		this->task(this->arg,i);
+		pthread_mutex_lock(&this->lock);
+		if (++this->finished == this->n) pthread_cond_signal(&this->done);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+void* Util::ThreadPool::worker(void* pool){
+	ThreadPool* self = (ThreadPool*)pool;
+	unsigned long seen = 0;
+	pthread_mutex_lock(&self->lock);
+	while (true){
+		while (!self->quit && self->generation == seen) pthread_cond_wait(&self->start,&self->lock);
+		if (self->quit) break;
+		seen = self->generation;
+		pthread_mutex_unlock(&self->lock);
+		self->work();
+		pthread_mutex_lock(&self->lock);
+	}
+	pthread_mutex_unlock(&self->lock);
+	return NULL;
+}
@@ -0,0 +1,47 @@
+/*
+ * threadPool.hh
+ *
+ *  Fixed set of worker threads for splitting loops into independent pieces.
+ */
+
+#ifndef THREADPOOL_HH_
+#define THREADPOOL_HH_
+
+#include <pthread.h>
+#include <vector>
+
+using namespace std;
+
+namespace Util {
+
+	//! Runs the pieces of a loop on a fixed set of threads
+	/*!
+	 *  run(task,arg,n) calls task(arg,i) for i = 0..n-1 and returns when all calls have finished. The calling
+	 *  thread works on the pieces too, so a pool of size 1 starts no threads and runs everything in order.
+	 *  Pieces are handed out in order but may finish in any order, so each must write only to its own output.
+	 */
+	class ThreadPool{
+	public:
+		ThreadPool(unsigned int nThreads);
+		~ThreadPool();
+		void run(void (*task)(void*,unsigned int), void* arg, unsigned int n);
+		unsigned int size() const { return (unsigned int)this->threads.size() + 1; }
+	protected:
+		vector<pthread_t> threads;
+		pthread_mutex_t lock;
+		pthread_cond_t start;		// Signaled when a new loop is posted
+		pthread_cond_t done;		// Signaled when the last piece of a loop has finished
+		void (*task)(void*,unsigned int);
+		void* arg;
+		unsigned int n, next, finished;
+		unsigned long generation;	// Number of loops posted so far
+		bool quit;
+		static void* worker(void* pool);
+		void work();
+	private:
+		ThreadPool(const ThreadPool&);
+		void operator=(const ThreadPool&);
+	};
+}
+
+#endif /* THREADPOOL_HH_ */
@@ -0,0 +1,272 @@
+/*
+ * trajectoryFile.cpp
+ *
+ *  Binary trajectory output (.cdat.bin, .gdat.bin, .fdat.bin) and its conversion back to text.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include "trajectoryFile.hh"
+
+#define TRAJECTORY_MAGIC "N3TRAJ"
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_CHUNK_BYTES (1 << 20)
+#define TRAJECTORY_MAX_QUEUED 4
+
+Util::TrajectoryWriter::TrajectoryWriter(FILE* out, bool append, bool float32, int width, int precision, bool header)
+	: out(out), float32(float32), header(header), width(width), precision(precision), rowTime(0.0), current(NULL),
+	  rowsPerChunk(0), appendColumns(-1), headerDone(false), error(false), quit(false){
+	// A continuation adds chunks to the end of the file, unless there is nothing there yet
+	if (append){
+		fseek(this->out,0,SEEK_END);
+		if (ftell(this->out) > 0) this->readHeader();
+	}
+	pthread_mutex_init(&this->lock,NULL);
+	pthread_cond_init(&this->ready,NULL);
+	pthread_cond_init(&this->space,NULL);
+	if (pthread_create(&this->thread,NULL,TrajectoryWriter::writer,this) != 0){
+		fprintf(stderr, "ERROR: Couldn't start the trajectory writer thread.\n");
+		exit(1);
+	}
+}
+
+Util::TrajectoryWriter::~TrajectoryWriter(){
+	if (this->current && this->current->nRows > 0) this->push(this->current);
+	else delete this->current;
+	this->current = NULL;
+	pthread_mutex_lock(&this->lock);
+	this->quit = true;
+	pthread_cond_signal(&this->ready);
+	pthread_mutex_unlock(&this->lock);
+	pthread_join(this->thread,NULL);
+	pthread_cond_destroy(&this->space);
+	pthread_cond_destroy(&this->ready);
+	pthread_mutex_destroy(&this->lock);
+	if (!this->headerDone) this->writeHeader(); // No rows at all
+	if (fclose(this->out) != 0) this->error = true;
+	if (this->error) fprintf(stderr, "Warning: Couldn't write all of a binary trajectory file.\n");
+}
+
+void Util::TrajectoryWriter::beginRow(double t){
+	this->rowTime = t;
+	this->row.clear();
+}
+
+void Util::TrajectoryWriter::endRow(){
+	if (this->rowsPerChunk == 0 && this->appendColumns >= 0 && (int)this->row.size() != this->appendColumns){
+		fprintf(stderr, "ERROR: Can't append rows of %d columns to a binary trajectory of %d columns.\n",
+				(int)this->row.size(), this->appendColumns);
+		exit(1);
+	}
+	if (!this->headerDone){
+		if (!this->names.empty() && this->names.size() != this->row.size()){
+			fprintf(stderr, "ERROR: Trajectory has %d column names but %d columns.\n", (int)this->names.size(),
+					(int)this->row.size());
+			exit(1);
+		}
+		// The writer thread has nothing to do yet, so the header can't be overtaken by a chunk
+		this->writeHeader();
+	}
+	if (!this->current){
+		if (this->rowsPerChunk == 0){
+			this->rowsPerChunk = TRAJECTORY_CHUNK_BYTES / (int)(sizeof(double)*(this->row.size()+1));
+			if (this->rowsPerChunk < 1) this->rowsPerChunk = 1;
+		}
+		this->current = new Chunk;
+		this->current->nRows = 0;
+		this->current->t.reserve(this->rowsPerChunk);
+		this->current->rows.reserve(this->rowsPerChunk*this->row.size());
+	}
+	if (this->current->nRows > 0 && this->current->rows.size() != this->current->nRows*this->row.size()){
+		fprintf(stderr, "ERROR: Trajectory row at time %.12e has %d columns, expected %d.\n", this->rowTime,
+				(int)this->row.size(), (int)(this->current->rows.size()/this->current->nRows));
+		exit(1);
+	}
+	// Rows are stored as they come and turned into columns by the writer thread
+	this->current->t.push_back(this->rowTime);
+	this->current->rows.insert(this->current->rows.end(),this->row.begin(),this->row.end());
+	this->current->nRows++;
+	if (this->current->nRows >= this->rowsPerChunk){
+		this->push(this->current);
+		this->current = NULL;
+	}
+}
+
+void Util::TrajectoryWriter::push(Chunk* chunk){
+	pthread_mutex_lock(&this->lock);
+	while (this->queue.size() >= TRAJECTORY_MAX_QUEUED){
+		pthread_cond_wait(&this->space,&this->lock);
+	}
+	this->queue.push_back(chunk);
+	pthread_cond_signal(&this->ready);
+	pthread_mutex_unlock(&this->lock);
+}
+
+// Checks the header of the file appended to. Chunks are written at the end.
+void Util::TrajectoryWriter::readHeader(){
+	char magic[sizeof(TRAJECTORY_MAGIC)-1];
+	int field[7];
+	rewind(this->out);
+	if (fread(magic,1,sizeof(magic),this->out) != sizeof(magic) ||
+			memcmp(magic,TRAJECTORY_MAGIC,sizeof(magic)) != 0 || fread(field,sizeof(int),7,this->out) != 7 ||
+			field[0] != TRAJECTORY_VERSION || field[2] < 0){
+		fprintf(stderr, "ERROR: Can't append to a file that is not a binary trajectory of version %d.\n",
+				TRAJECTORY_VERSION);
+		exit(1);
+	}
+	int valueSize = this->float32 ? (int)sizeof(float) : (int)sizeof(double);
+	if (field[1] != valueSize){
+		fprintf(stderr, "ERROR: Can't append values of %d bytes to a binary trajectory of %d-byte values.\n",
+				valueSize, field[1]);
+		exit(1);
+	}
+	this->appendColumns = field[2];
+	this->headerDone = true;
+	fseek(this->out,0,SEEK_END); // Switching from reading to writing takes a seek
+}
+
+void Util::TrajectoryWriter::writeHeader(){
+	int nColumns = (int)(this->row.empty() ? this->names.size() : this->row.size());
+	string blob;
+	if ((int)this->names.size() == nColumns){
+		for (unsigned int i=0;i < this->names.size();i++){
+			blob += this->names[i];
+			blob += '\0';
+		}
+	}
+	int field[7];
+	field[0] = TRAJECTORY_VERSION;
+	field[1] = this->float32 ? (int)sizeof(float) : (int)sizeof(double);
+	field[2] = nColumns;
+	field[3] = this->width;
+	field[4] = this->precision;
+	field[5] = (this->header && (int)this->names.size() == nColumns) ? 1 : 0; // Print a text header?
+	field[6] = (int)blob.size();
+	if (fwrite(TRAJECTORY_MAGIC,1,strlen(TRAJECTORY_MAGIC),this->out) != strlen(TRAJECTORY_MAGIC) ||
+			fwrite(field,sizeof(int),7,this->out) != 7 ||
+			fwrite(blob.data(),1,blob.size(),this->out) != blob.size()){
+		this->error = true;
+	}
+	this->headerDone = true;
+}
+
+void Util::TrajectoryWriter::writeChunk(Chunk* chunk){
+	int n = chunk->nRows;
+	int nColumns = (int)(chunk->rows.size()/n);
+	const vector<double>& rows = chunk->rows;
+	bool ok = (fwrite(&n,sizeof(int),1,this->out) == 1 && fwrite(&chunk->t[0],sizeof(double),n,this->out) == (size_t)n);
+	if (this->float32){
+		vector<float> column(n);
+		for (int j=0;ok && j < nColumns;j++){
+			for (int i=0;i < n;i++) column[i] = (float)rows[i*nColumns+j];
+			ok = (fwrite(&column[0],sizeof(float),n,this->out) == (size_t)n);
+		}
+	}
+	else{
+		vector<double> column(n);
+		for (int j=0;ok && j < nColumns;j++){
+			for (int i=0;i < n;i++) column[i] = rows[i*nColumns+j];
+			ok = (fwrite(&column[0],sizeof(double),n,this->out) == (size_t)n);
+		}
+	}
+	if (!ok) this->error = true;
+}
+
+void* Util::TrajectoryWriter::writer(void* self){
+	TrajectoryWriter* w = static_cast<TrajectoryWriter*>(self);
+	pthread_mutex_lock(&w->lock);
+	while (true){
+		while (w->queue.empty() && !w->quit){
+			pthread_cond_wait(&w->ready,&w->lock);
+		}
+		if (w->queue.empty()) break; // Quit, and nothing left to write
+		Chunk* chunk = w->queue.front();
+		w->queue.pop_front();
+		pthread_cond_signal(&w->space);
+		pthread_mutex_unlock(&w->lock);
+		w->writeChunk(chunk);
+		delete chunk;
+		pthread_mutex_lock(&w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+int Util::trajectoryToText(const char* in_name, const char* out_name){
+	FILE* in = fopen(in_name,"rb");
+	if (!in){
+		fprintf(stderr, "Couldn't open file %s.\n", in_name);
+		return 1;
+	}
+	char magic[sizeof(TRAJECTORY_MAGIC)-1];
+	int field[7];
+	if (fread(magic,1,sizeof(magic),in) != sizeof(magic) || memcmp(magic,TRAJECTORY_MAGIC,sizeof(magic)) != 0 ||
+			fread(field,sizeof(int),7,in) != 7 || field[0] != TRAJECTORY_VERSION ||
+			(field[1] != (int)sizeof(float) && field[1] != (int)sizeof(double)) || field[2] < 0 || field[6] < 0){
+		fprintf(stderr, "ERROR: %s is not a binary trajectory file.\n", in_name);
+		fclose(in);
+		return 1;
+	}
+	int valueSize = field[1], nColumns = field[2], width = field[3], precision = field[4];
+	vector<char> blob(field[6]);
+	if (field[6] > 0 && fread(&blob[0],1,blob.size(),in) != blob.size()){
+		fprintf(stderr, "ERROR: %s is truncated.\n", in_name);
+		fclose(in);
+		return 1;
+	}
+	FILE* out = fopen(out_name,"w");
+	if (!out){
+		fprintf(stderr, "Couldn't open file %s.\n", out_name);
+		fclose(in);
+		return 1;
+	}
+	// Header
+	if (field[5]){
+		fprintf(out, "#%*s", width-1, "time");
+		for (unsigned int k=0;k < blob.size();k += strlen(&blob[k])+1){
+			fprintf(out, " %*s", width, &blob[k]);
+		}
+		fprintf(out, "\n");
+	}
+	// Chunks
+	int n, error = 0;
+	vector<double> t, x;
+	vector<float> xf;
+	while (fread(&n,sizeof(int),1,in) == 1){
+		if (n <= 0){
+			error = 1;
+			break;
+		}
+		t.resize(n);
+		x.resize((size_t)n*nColumns);
+		if (fread(&t[0],sizeof(double),n,in) != (size_t)n){
+			error = 1;
+			break;
+		}
+		if (nColumns > 0){
+			if (valueSize == (int)sizeof(float)){
+				xf.resize(x.size());
+				if (fread(&xf[0],sizeof(float),xf.size(),in) != xf.size()){
+					error = 1;
+					break;
+				}
+				for (unsigned int k=0;k < xf.size();k++) x[k] = xf[k];
+			}
+			else if (fread(&x[0],sizeof(double),x.size(),in) != x.size()){
+				error = 1;
+				break;
+			}
+		}
+		for (int i=0;i < n;i++){
+			fprintf(out, "%*.*e", width, precision, t[i]);
+			for (int j=0;j < nColumns;j++){
+				fprintf(out, " %*.*e", width, precision, x[(size_t)j*n+i]);
+			}
+			fprintf(out, "\n");
+		}
+	}
+	if (error) fprintf(stderr, "ERROR: %s is truncated.\n", in_name);
+	fclose(in);
+	if (fclose(out) != 0) error = 1;
+	return error;
+}
@@ -0,0 +1,75 @@
+/*
+ * trajectoryFile.hh
+ *
+ *  Binary trajectory output (.cdat.bin, .gdat.bin, .fdat.bin) and its conversion back to text.
+ */
+
+#ifndef TRAJECTORYFILE_HH_
+#define TRAJECTORYFILE_HH_
+
+#include <cstdio>
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Util {
+
+	//! Writes a trajectory as chunks of columns, on a background thread
+	/*!
+	 *  The file starts with a header (magic, version, value size, number of columns, the width and precision
+	 *  of the text format and the column names) followed by chunks. Each chunk holds a number of rows stored
+	 *  column by column: the times as doubles, then each column as doubles or, with float32, as floats. Rows are
+	 *  gathered into chunks of about a megabyte, and full chunks are written by a separate thread, so the
+	 *  simulation doesn't wait for the disk. Appending (continued simulations) adds chunks to an existing file,
+	 *  which must be open for reading too: its header is checked against the new rows (value size and number
+	 *  of columns), and a mismatch is an error.
+	 *
+	 *  A row is begun with beginRow(), filled with value() and finished with endRow(); the number of values in
+	 *  the first row fixes the number of columns, which must match the names given with addColumn().
+	 */
+	class TrajectoryWriter{
+	public:
+		TrajectoryWriter(FILE* out, bool append, bool float32, int width, int precision, bool header);
+		~TrajectoryWriter(); // Writes what is left and closes the file
+		void addColumn(const string& name){ this->names.push_back(name); }
+		void beginRow(double t);
+		void value(double x){ this->row.push_back(x); }
+		void endRow();
+		FILE* file(){ return this->out; }
+	protected:
+		struct Chunk{
+			int nRows;
+			vector<double> t;
+			vector<double> rows;	// Row after row
+		};
+		FILE* out;
+		bool float32, header;
+		int width, precision;
+		vector<string> names;
+		vector<double> row;
+		double rowTime;
+		Chunk* current;
+		int rowsPerChunk;
+		int appendColumns;	// Number of columns of the file appended to, -1 if the header is still to be written
+		bool headerDone, error;
+		deque<Chunk*> queue;	// Full chunks waiting for the writer thread
+		pthread_t thread;
+		pthread_mutex_t lock;
+		pthread_cond_t ready;	// Signaled when a chunk is queued or the writer should quit
+		pthread_cond_t space;	// Signaled when the writer has taken a chunk off the queue
+		bool quit;
+		void push(Chunk* chunk);
+		void readHeader();
+		void writeHeader();
+		void writeChunk(Chunk* chunk);
+		static void* writer(void* self);
+	};
+
+	// Writes the text version of the binary trajectory in_name to out_name. Returns 0 on success.
+	int trajectoryToText(const char* in_name, const char* out_name);
+}
+
+#endif /* TRAJECTORYFILE_HH_ */
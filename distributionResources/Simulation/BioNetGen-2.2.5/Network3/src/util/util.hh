@@ -21,6 +21,9 @@
 #include "rand2/rand2.hh"
 //#include "matrix/matrix.hh"
 #include "misc.hh"
+#include "sparseLU.hh"
+#include "threadPool.hh"
+#include "trajectoryFile.hh"
 
 //!  General utility function library.
 /*!
@@ -70,6 +70,10 @@ sub simulate
                    options=>{ seed=>1 }                                      },
         pla   => { binary=>'run_network', type=>'Network', input=>'net',
                    options=>{ seed=>1 }                                      },
+        hybrid => { binary=>'run_network', type=>'Network', input=>'net',
+                   options=>{ atol=>1, rtol=>1, seed=>1 }                    },
+        steady => { binary=>'run_network', type=>'Network', input=>'net',
+                   options=>{ atol=>1, rtol=>1 }                             },
         nf    => { binary=>'NFsim', type=>'NetworkFree', input=>'xml',
                    options=>{ seed=>1 }                                      }
     };
@@ -226,6 +230,15 @@ sub simulate
     	{   push @command, "--pla_output", $params->{pla_output};  }
     }
     
+    # hybrid-specific arguments
+    if ($method eq 'hybrid')
+    {
+        if (defined $params->{hybrid_lambda})
+        {   push @command, "--hybrid-lambda", $params->{hybrid_lambda};  }
+        if (defined $params->{hybrid_epsilon})
+        {   push @command, "--hybrid-epsilon", $params->{hybrid_epsilon};  }
+    }
+
     # add method options
     {
         my $opts = $METHODS->{$method}->{options};
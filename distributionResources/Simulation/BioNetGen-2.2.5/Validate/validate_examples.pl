@@ -31,6 +31,8 @@
 #   MODEL.cdat            : MODEL.cdat             : ODE species trajectory
 #   MODEL_ssa_equil.gdat  : MODEL_ssa_equil.stats  : SSA equilibrium samples   
 #   MODEL_nf_equil.gdat   : MODEL_nf_equil.stats   : NFsim equilibrium samples
+#   MODEL_hybrid_equil.gdat : MODEL_hybrid_equil.stats : hybrid SSA/ODE equilibrium samples
+#   MODEL_batch_NNNNN.gdat  : MODEL_batch_NNNNN.gdat   : batched ODE trajectories (MODEL.batch)
 #
 #
 # To add new validation MODEL:
@@ -49,6 +51,12 @@
 #    interest, bin widths and probabilities, and the Chi-square values
 #    corresponding to various significance levels.
 #
+#  ** a MODEL.batch file next to MODEL.bngl lists parameter sets (a line of
+#    names, then a line of values per set) that run_network integrates
+#    together with --batch from MODEL.net. Set NNNNN is compared to
+#    MODEL_batch_NNNNN.gdat; the time points are those of the first of these
+#    references, which must start at 0 and be evenly spaced.
+#
 #  ** It is the Modeler's responsibility to validate the reference trajectory.
 #    It's advisable to compare the reference to analytic results, simulations
 #    reported in the literature, or simulations generated from independent
@@ -439,6 +447,24 @@ foreach my $model (@models)
         }
     }
 
+    # check batched ODE trajectories (parameter sets in MODEL.batch)
+    {
+        my $batchfile = File::Spec->catfile( $modeldir, "${model}.batch" );
+        if ( -e $batchfile  and  -e "${outprefix}.net"  and  -e "${datprefix}_batch_00001.gdat" )
+        {
+            multi_print( " -> checking batched ODE trajectories\n", @allFH );
+            my $exit_status = validate_batch( $log, $batchfile, $outprefix, $datprefix );
+            if ( defined $exit_status )
+            {
+                multi_print( "..FAILED!! $exit_status\n", @allFH );
+                print "see $log_file form more details.\n";
+                close $log;
+                ++$fail_count;
+                next MODEL;
+            }
+        }
+    }
+
     # check SSA equilibrium distribution (observables)
     {
         my $datfile  = "${outprefix}_ssa_equil.gdat";
@@ -500,6 +526,26 @@ foreach my $model (@models)
         }
     }
 
+    # check hybrid SSA/ODE equilibrium distribution (observables)
+    {
+        my $datfile  = "${outprefix}_hybrid_equil.gdat";
+        my $statfile = "${datprefix}_hybrid_equil.stats";
+        if ( -e $datfile  and  -e $statfile )
+        {
+            multi_print( " -> checking hybrid SSA/ODE equilibrium distribution\n", @allFH );
+            my $exit_status = validate_equilibrium_data( $datfile, $statfile, $pvalue );
+            if ( defined $exit_status )
+            {
+                multi_print( "..FAILED!! $exit_status\n", @allFH ); 
+                print "see $log_file form more details.\n";
+                close $log;
+                ++$fail_count;
+                next MODEL;
+            }
+            print $log $SEPARATOR;
+        }
+    }
+
     if ($delete_working_files)
     {   delete_files($outprefix);   }
 
@@ -543,6 +589,9 @@ sub delete_files
     my @files = ();
     foreach my $suffix (@suffixes)
     {   push @files, ${outprefix}.${suffix};   }
+    # batched trajectories (see validate_batch)
+    for ( my $set = 1;  -e sprintf( "%s_batch_%05d.cdat", $outprefix, $set );  ++$set )
+    {   push @files, map { sprintf( "%s_batch_%05d%s", $outprefix, $set, $_ ) } qw( .cdat .gdat );   }
     unlink @files;
 }
 
@@ -938,6 +987,46 @@ sub run_command
 }
 
 
+# integrate the parameter sets of a batch file together with run_network --batch
+#  and compare each set to its reference trajectory. Returns undef if all match.
+sub validate_batch
+{
+    my ($log, $batchfile, $outprefix, $datprefix) = @_;
+
+    # find run_network, as BioNetGen does
+    my $base = File::Spec->catfile( $bngpath, "bin", "run_network" );
+    my $exe  = ($Config{myarchname} =~ /MSWin32/) ? ".exe" : "";
+    my $run_network = (-x "${base}${exe}") ? "${base}${exe}" : "${base}_$Config{myarchname}${exe}";
+    unless ( -x $run_network )
+    {   return "ERROR: cannot find run_network binary!";   }
+
+    # time points of the first reference
+    my $data = read_datfile( "${datprefix}_batch_00001.gdat" );
+    unless ( defined $data  and  @{$data->[0]->{elements}} > 1 )
+    {   return "ERROR: some problem reading ${datprefix}_batch_00001.gdat!";   }
+    my $times = $data->[0]->{elements};
+    my $n_steps = @$times - 1;
+    my $sample_time = $times->[-1] / $n_steps;
+
+    my @command = ( $run_network, "-o", "${outprefix}_batch", "-p", "cvode", "-a", "1e-10", "-r", "1e-10",
+                    "-g", "${outprefix}.net", "--batch", $batchfile, "${outprefix}.net", $sample_time, $n_steps );
+    my $exit_status = run_command( $log, \*STDOUT, @command );
+    unless ( $exit_status==0 )
+    {   return "run_network exit status = $exit_status";   }
+
+    for ( my $set = 1;  -e sprintf( "%s_batch_%05d.gdat", $datprefix, $set );  ++$set )
+    {
+        my $outfile = sprintf( "%s_batch_%05d.gdat", $outprefix, $set );
+        my $datfile = sprintf( "%s_batch_%05d.gdat", $datprefix, $set );
+        @command = ( $perlbin, $verifyexec, $outfile, $datfile );
+        $exit_status = run_command( $log, \*STDOUT, @command );
+        unless ( $exit_status==0 )
+        {   return "parameter set $set: exit_status = $exit_status";   }
+    }
+    return undef;
+}
+
+
 # print to multiple filehandles
 sub multi_print
 {
@@ -31,6 +31,7 @@ src/NFtest/tlbr \
 src/NFtest/simple_system \
 src/NFtest/agentcell/cell \
 src/NFtest/agentcell \
+src/NFsubvolume \
 src \
 src/NFscheduler \
 src/NFreactions/transformations \
@@ -45,5 +46,6 @@ src/NFfunction/muParser \
 src/NFfunction \
 src/NFcore \
 src/NFcore/reactionSelector \
+src/NFcore/tauLeaper \
 src/NFcore/moleculeLists \
 
@@ -5,15 +5,18 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
 ../src/NFcore/reactionSelector/directSelector.cpp \
-../src/NFcore/reactionSelector/logClassSelector.cpp 
+../src/NFcore/reactionSelector/logClassSelector.cpp \
+../src/NFcore/reactionSelector/rejectionSelector.cpp 
 
 OBJS += \
 ./src/NFcore/reactionSelector/directSelector.o \
-./src/NFcore/reactionSelector/logClassSelector.o 
+./src/NFcore/reactionSelector/logClassSelector.o \
+./src/NFcore/reactionSelector/rejectionSelector.o 
 
 CPP_DEPS += \
 ./src/NFcore/reactionSelector/directSelector.d \
-./src/NFcore/reactionSelector/logClassSelector.d 
+./src/NFcore/reactionSelector/logClassSelector.d \
+./src/NFcore/reactionSelector/rejectionSelector.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -0,0 +1,24 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../src/NFsubvolume/subvolume.cpp 
+
+OBJS += \
+./src/NFsubvolume/subvolume.o 
+
+CPP_DEPS += \
+./src/NFsubvolume/subvolume.d 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+src/NFsubvolume/%.o: ../src/NFsubvolume/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -O3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
@@ -0,0 +1,128 @@
+/*
+ * nfsim_api.cpp
+ *
+ *  C interface for running NFsim models inside another program.
+ */
+
+#include "nfsim_api.h"
+#include "../NFsim.hh"
+
+#include <pthread.h>
+
+using namespace std;
+using namespace NFcore;
+
+
+struct nf_engine {
+	System *s;
+	vector <string> names;       // observable names, as returned by nf_observable_name()
+	vector <double> observables; // counts as of the last run (nf_observables_data())
+};
+
+static pthread_mutex_t engine_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Holds the lock while the object exists
+class EngineLock {
+	public:
+		EngineLock() { pthread_mutex_lock(&engine_lock); };
+		~EngineLock() { pthread_mutex_unlock(&engine_lock); };
+};
+
+// Copies the observable counts of the system to the engine (with the lock held)
+static void updateObservables(nf_engine *engine)
+{
+	engine->s->updateObservableCounts();
+	for(int i=0; i<engine->s->getNumOfOutputObservables(); i++)
+		engine->observables.at(i) = engine->s->getOutputObservable(i)->getCount();
+}
+
+
+void nf_seed(unsigned long seed)
+{
+	EngineLock lock;
+	NFutil::SEED_RANDOM(seed);
+}
+
+nf_engine* nf_load(const char* xmlfile)
+{
+	EngineLock lock;
+	int suggestedTraversalLimit = ReactionClass::NO_LIMIT;
+	System *s = NFinput::initializeFromXML(xmlfile,false,200000,false,suggestedTraversalLimit,true);
+	if(s==NULL) return NULL;
+	s->setUniversalTraversalLimit(suggestedTraversalLimit);
+	s->prepareForSimulation();
+
+	nf_engine *engine = new nf_engine();
+	engine->s = s;
+	for(int i=0; i<s->getNumOfOutputObservables(); i++)
+		engine->names.push_back(s->getOutputObservable(i)->getName());
+	engine->observables.resize(engine->names.size());
+	updateObservables(engine);
+	return engine;
+}
+
+void nf_free(nf_engine* engine)
+{
+	if(engine==NULL) return;
+	EngineLock lock;
+	delete engine->s;
+	delete engine;
+}
+
+int nf_set_parameter(nf_engine* engine, const char* name, double value)
+{
+	EngineLock lock;
+	if(!engine->s->hasParameter(name)) return 1;
+	engine->s->setParameter(name,value);
+	engine->s->updateSystemWithNewParameters();
+	return 0;
+}
+
+int nf_get_parameter(nf_engine* engine, const char* name, double* value)
+{
+	EngineLock lock;
+	if(!engine->s->hasParameter(name)) return 1;
+	*value = engine->s->getParameter(name);
+	return 0;
+}
+
+int nf_run_to(nf_engine* engine, double t)
+{
+	EngineLock lock;
+	if(t<engine->s->getCurrentTime()) return 1;
+	engine->s->stepTo(t);
+	updateObservables(engine);
+	return 0;
+}
+
+double nf_time(nf_engine* engine)
+{
+	return engine->s->getCurrentTime();
+}
+
+int nf_n_observables(nf_engine* engine)
+{
+	return (int)engine->names.size();
+}
+
+const char* nf_observable_name(nf_engine* engine, int i)
+{
+	if(i<0 || i>=(int)engine->names.size()) return NULL;
+	return engine->names.at(i).c_str();
+}
+
+const double* nf_observables_data(nf_engine* engine)
+{
+	return engine->observables.empty() ? NULL : &engine->observables[0];
+}
+
+int nf_run_samples(nf_engine* engine, const double* times, int n_times, nf_sample_callback callback,
+		void* data)
+{
+	for(int i=0; i<n_times; i++) {
+		if(nf_run_to(engine,times[i])!=0) return 1;
+		// Outside the lock, so that the callback can call back into the API
+		if(callback!=NULL && callback(engine,nf_time(engine),nf_observables_data(engine),data)!=0) return 2;
+	}
+	return 0;
+}
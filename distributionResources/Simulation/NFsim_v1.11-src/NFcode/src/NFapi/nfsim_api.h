@@ -0,0 +1,61 @@
+/*
+ * nfsim_api.h
+ *
+ *  C interface for running NFsim models inside another program.
+ *
+ *  An engine holds one System read from a BNG .xml file, prepared for simulation. Any number of
+ *  engines can be loaded at the same time, and each is run forward with nf_run_to(). The random
+ *  number generator and several scratch lists of the simulation core are static, so calls are
+ *  serialized by a lock: engines can be used from several threads, but only one of them runs at a
+ *  time.  There is no way to go back to the starting state; load the model again instead.
+ *
+ *  Building the library: "make lib" in NFcode makes bin/libnfsim.so (see makefile.targets).
+ */
+
+#ifndef NFSIM_API_H_
+#define NFSIM_API_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nf_engine nf_engine;
+
+/* Seeds the random number generator shared by all engines */
+void nf_seed(unsigned long seed);
+
+/* Loads an .xml model and prepares it for simulation. Returns NULL if the model couldn't be read. */
+nf_engine* nf_load(const char* xmlfile);
+void nf_free(nf_engine* engine);
+
+/* Sets a parameter and updates the functions and rate constants that depend on it. Returns 1 if
+ * there is no such parameter. */
+int nf_set_parameter(nf_engine* engine, const char* name, double value);
+int nf_get_parameter(nf_engine* engine, const char* name, double* value);
+
+/* Simulates up to time t, which must not be before the current time. Returns 0 on success. */
+int nf_run_to(nf_engine* engine, double t);
+double nf_time(nf_engine* engine);
+
+/* Observables in the order of the .gdat columns. nf_observables_data() points at an array owned
+ * by the engine, which nf_load(), nf_run_to() and nf_run_samples() bring up to date; it stays at
+ * the same address until nf_free(). */
+int nf_n_observables(nf_engine* engine);
+const char* nf_observable_name(nf_engine* engine, int i);
+const double* nf_observables_data(nf_engine* engine);
+
+/* Called at each sample time with the observables at that time. Returning nonzero stops the run.
+ * The engine is not locked during the call, so the callback may use the API. */
+typedef int (*nf_sample_callback)(nf_engine* engine, double t, const double* observables, void* data);
+
+/* Simulates through the n_times sample times in ascending order, calling callback (if not NULL)
+ * at each. Returns 0 when all samples were taken, 1 for an out of order time and 2 if the callback
+ * stopped the run. */
+int nf_run_samples(nf_engine* engine, const double* times, int n_times, nf_sample_callback callback,
+		void* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NFSIM_API_H_ */
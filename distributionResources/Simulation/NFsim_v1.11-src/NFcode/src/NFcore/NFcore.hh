@@ -23,6 +23,7 @@
 #include "../NFfunction/NFfunction.hh"
 #include "../NFoutput/NFoutput.hh"
 #include "reactionSelector/reactionSelector.hh"
+#include "tauLeaper/tauLeaper.hh"
 
 
 #include "templateMolecule.hh"
@@ -97,6 +98,8 @@ namespace NFcore
 	class ReactantList;
 
 	class ReactionSelector;
+	class RejectionSelector;
+	class TauLeaper;
 
 
 
@@ -210,6 +213,7 @@ namespace NFcore
 			double getAverageGroupValue(string groupName, int valIndex);
 
 			ReactionClass *getReaction(int rIndex) { return allReactions.at(rIndex); };
+			int getNumOfReactions() const { return allReactions.size(); };
 
 			MoleculeType * getMoleculeType(int mtIndex) { return allMoleculeTypes.at(mtIndex); };
 			MoleculeType * getMoleculeTypeByName(string name);
@@ -280,6 +284,12 @@ namespace NFcore
 			int getNumOfSpeciesObs() const;
 			Observable * getSpeciesObs(int index) const;
 
+			/* the observables in the order they are output, and a way to bring their counts up
+			   to date without writing them anywhere (for programs that embed NFsim, see NFapi) */
+			int getNumOfOutputObservables() const { return (int)obsToOutput.size(); };
+			Observable * getOutputObservable(int index) const { return obsToOutput.at(index); };
+			void updateObservableCounts();
+
 			/* functions that print out other information to the console */
 			// NETGEN
 			//void printAllComplexes();
@@ -327,7 +337,8 @@ namespace NFcore
 
 			/* run the simulation up until the stopping time (but not exceding the stopping time. This
 			 * will not output anything to file (so must be done manually) and returns the current time
-			 * of the simulation, which will always be less than the stopping time */
+			 * of the simulation.  Because waiting times are memoryless, the clock is moved up to the
+			 * stopping time when the next event would fall past it, so repeated calls do not lose time */
 			double stepTo(double stoppingTime);
 
 			void singleStep();
@@ -348,6 +359,7 @@ namespace NFcore
 
 			void addParameter(string name,double value);
 			double getParameter(string name);
+			bool hasParameter(string name) const { return paramMap.find(name)!=paramMap.end(); };
 			void setParameter(string name, double value);
 			void updateSystemWithNewParameters();
 			void printAllParameters();
@@ -368,6 +380,23 @@ namespace NFcore
 			*/
 			void turnOnCSVformat() { this->csvFormat = true; };
 
+			/*!
+				turns on tau leaping of the rules that act only on population molecules.
+				epsilon bounds the relative change of a population during one leap, and
+				rules that are fewer than criticalThreshold firings away from exhausting
+				a reactant are always fired exactly.  Call before prepareForSimulation().
+			*/
+			void turnOnTauLeaping(double epsilon, int criticalThreshold);
+
+			/*!
+				turns on batched event selection.  Up to batchSize candidate events are
+				drawn against propensity bounds of boundFactor times the propensities at
+				the start of the batch and thinned back to the exact process; a batch
+				ends early as soon as an event pushes a propensity past its bound.  Call
+				before prepareForSimulation().
+			*/
+			void turnOnEventBatching(int batchSize, double boundFactor);
+
 		protected:
 
 			///////////////////////////////////////////////////////////////////////////
@@ -424,6 +453,7 @@ namespace NFcore
 			double get_A_tot() const { return a_tot; };
 			double recompute_A_tot();
 			double getNextRxn();
+			int leapStep(double maxTime);
 
 
 			///////////////////////////////////////////////////////////////////////////
@@ -451,6 +481,15 @@ namespace NFcore
 
 			//Data structure that performs the selection of the next reaction class
 			ReactionSelector * selector;
+			RejectionSelector * batchSelector;  /*!< same object as selector, if batching is on */
+			int eventBatchSize;
+			double eventBatchBoundFactor;
+
+			//Advances population-only rules by tau leaping, if turned on
+			TauLeaper * tauLeaper;
+			bool useTauLeaping;
+			double tauLeapEpsilon;
+			int tauLeapCriticalThreshold;
 
 
 		private:
@@ -1014,6 +1053,9 @@ namespace NFcore
 
 			void setBaseRate(double newBaseRate,string newBaseRateName);
 			void resetBaseRateFromSystemParamter();
+			/* multiplies the (already symmetry corrected) base rate, for instance to rescale
+			 * bimolecular rates when the reaction volume changes */
+			void scaleBaseRate(double factor) { baseRate*=factor; update_a(); };
 
 			void setTraversalLimit(int limit) { this->traversalLimit = limit; };
 
@@ -1041,6 +1083,20 @@ namespace NFcore
 
 			/* turn the tag of this guy on */
 			void tag() { tagged = true; };
+			bool isTagged() const { return tagged; };
+
+			/* used by the TauLeaper, which fires population-only rules in bulk */
+			TransformationSet * getTransformationSet() const { return transformationSet; };
+			void addToFireCounter(unsigned int n) { fireCounter+=n; };
+
+			/* returns the population molecule that is the single member of the given
+			 * reactant list, or NULL if the reactant is not a population or if this
+			 * reaction class does not keep simple reactant lists */
+			virtual Molecule * getPopulationReactant(unsigned int reactantIndex) const { return 0; };
+
+			/* true if the propensity is a mass action product of the reactant counts,
+			 * so that it depends on nothing but the reactants themselves */
+			virtual bool hasMassActionRateLaw() const { return false; };
 
 
 			virtual int getReactantCount(unsigned int reactantIndex) const = 0;
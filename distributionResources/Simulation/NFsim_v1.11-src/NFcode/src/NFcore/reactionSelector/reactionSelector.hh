@@ -65,6 +65,50 @@ namespace NFcore
 	};
 
 
+	// Direct method selector that can also hand out candidate events drawn
+	// against frozen upper bounds on the propensities.  A candidate for rule j
+	// is accepted with probability a_j/bound_j, which thins the bounded process
+	// back to the exact one, so batches of events can be drawn without touching
+	// the live propensities.  If a fired event pushes any propensity above its
+	// bound, the bounds are rebuilt before the next candidate is drawn.
+	class RejectionSelector : public DirectSelector {
+
+		public:
+			RejectionSelector(vector <ReactionClass *> &rxns, int batchSize, double boundFactor);
+			virtual ~RejectionSelector();
+
+			virtual double refactorPropensities();
+			virtual double update(ReactionClass *r,double oldA, double newA);
+
+			// rebuilds the bounds if they are no longer valid or if the current
+			// batch is used up, then returns the sum of the bounds
+			double prepareCandidate();
+
+			// draws a candidate, returns true and the random number for picking
+			// reactants if it was accepted
+			bool getNextCandidate(ReactionClass *&rc, double &randElement);
+
+			unsigned long getRejectionCount() const { return n_rejected; };
+			unsigned long getBatchCount() const { return n_batches; };
+
+		protected:
+			void rebuildBounds();
+			double getBound(ReactionClass *r) const;
+
+			int batchSize;
+			double boundFactor;
+
+			double *bound;
+			double *cumulativeBound;
+			double boundTotal;
+			bool boundsValid;
+			int candidatesLeft;
+
+			unsigned long n_rejected;
+			unsigned long n_batches;
+	};
+
+
 	class LogClassSelector : public ReactionSelector {
 
 		public:
@@ -0,0 +1,127 @@
+/*
+ * rejectionSelector.cpp
+ *
+ *  Batched event selection against frozen propensity bounds.
+ */
+
+
+
+#include "reactionSelector.hh"
+
+using namespace std;
+using namespace NFcore;
+
+
+
+
+RejectionSelector::RejectionSelector(vector <ReactionClass *> &rxns, int batchSize, double boundFactor) :
+	DirectSelector(rxns)
+{
+	//Note: bounds are looked up by rxnId, which the System sets to the position
+	//of the reaction in the vector when it prepares for simulation
+	this->batchSize = batchSize;
+	this->boundFactor = boundFactor;
+	if(this->boundFactor<1.0) this->boundFactor = 1.0;
+
+	this->bound = new double [n_reactions];
+	this->cumulativeBound = new double [n_reactions];
+	for(int r=0; r<n_reactions; r++) {
+		bound[r] = 0;
+		cumulativeBound[r] = 0;
+	}
+	this->boundTotal = 0;
+	this->boundsValid = false;
+	this->candidatesLeft = 0;
+
+	this->n_rejected = 0;
+	this->n_batches = 0;
+}
+
+
+RejectionSelector::~RejectionSelector()
+{
+	delete [] bound;
+	delete [] cumulativeBound;
+}
+
+
+double RejectionSelector::refactorPropensities()
+{
+	boundsValid = false;
+	return DirectSelector::refactorPropensities();
+}
+
+
+double RejectionSelector::update(ReactionClass *r,double oldA, double newA)
+{
+	//A propensity above its bound would make the thinning inexact, so the
+	//current batch has to end here
+	if(newA>bound[r->getRxnId()]) boundsValid = false;
+	return DirectSelector::update(r,oldA,newA);
+}
+
+
+void RejectionSelector::rebuildBounds()
+{
+	boundTotal = 0;
+	for(int r=0; r<n_reactions; r++) {
+		bound[r] = getBound(reactionClassList[r]);
+		boundTotal += bound[r];
+		cumulativeBound[r] = boundTotal;
+	}
+	boundsValid = true;
+	candidatesLeft = batchSize;
+	n_batches++;
+}
+
+
+double RejectionSelector::getBound(ReactionClass *r) const
+{
+	double b = boundFactor*r->get_a();
+
+	//For mass action rules, also leave room for one more of each reactant, so
+	//that rules hovering around a handful of reactants do not end every batch
+	if(r->hasMassActionRateLaw()) {
+		double massActionBound = r->getBaseRate();
+		for(int i=0; i<r->getNumOfReactants(); i++) {
+			double count = r->getCorrectedReactantCount(i);
+			massActionBound *= max(boundFactor*count, count+1.0);
+		}
+		if(massActionBound>b) b = massActionBound;
+	}
+	return b;
+}
+
+
+double RejectionSelector::prepareCandidate()
+{
+	if(!boundsValid || candidatesLeft<=0) rebuildBounds();
+	return boundTotal;
+}
+
+
+bool RejectionSelector::getNextCandidate(ReactionClass *&rc, double &randElement)
+{
+	candidatesLeft--;
+
+	//binary search for the first rule with cumulativeBound >= randNum
+	double randNum = NFutil::RANDOM(boundTotal);
+	int low = 0, high = n_reactions-1;
+	while(low<high) {
+		int mid = (low+high)/2;
+		if(cumulativeBound[mid]<randNum) low = mid+1;
+		else high = mid;
+	}
+	rc = reactionClassList[low];
+
+	//accept with probability a/bound.  Conditioned on acceptance, the position
+	//inside the bound is uniform on (0,a], which is what the rule needs to
+	//pick its reactants
+	double offset = randNum - (low>0 ? cumulativeBound[low-1] : 0);
+	if(offset<=0 || offset>rc->get_a()) {
+		n_rejected++;
+		return false;
+	}
+	randElement = offset;
+	return true;
+}
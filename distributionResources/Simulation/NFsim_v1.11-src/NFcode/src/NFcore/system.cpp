@@ -40,6 +40,13 @@ System::System(string name)
 	ds=0;
 	selector = 0;
 	csvFormat = false;
+	tauLeaper = 0;
+	useTauLeaping = false;
+	tauLeapEpsilon = 0.03;
+	tauLeapCriticalThreshold = 10;
+	batchSelector = 0;
+	eventBatchSize = 0;
+	eventBatchBoundFactor = 1.2;
 }
 
 
@@ -67,6 +74,13 @@ System::System(string name, bool useComplex)
 	ds=0;
 	selector = 0;
 	csvFormat = false;
+	tauLeaper = 0;
+	useTauLeaping = false;
+	tauLeapEpsilon = 0.03;
+	tauLeapCriticalThreshold = 10;
+	batchSelector = 0;
+	eventBatchSize = 0;
+	eventBatchBoundFactor = 1.2;
 }
 
 System::System(string name, bool useComplex, int globalMoleculeLimit)
@@ -92,6 +106,13 @@ System::System(string name, bool useComplex, int globalMoleculeLimit)
 	ds=0;
 	selector = 0;
 	csvFormat = false;
+	tauLeaper = 0;
+	useTauLeaping = false;
+	tauLeapEpsilon = 0.03;
+	tauLeapCriticalThreshold = 10;
+	batchSelector = 0;
+	eventBatchSize = 0;
+	eventBatchBoundFactor = 1.2;
 }
 
 
@@ -101,6 +122,7 @@ System::~System()
 	if(ds!=0) delete ds;
 
 	if(selector!=0) delete selector;
+	if(tauLeaper!=0) delete tauLeaper;
 
 	//Delete the rxnIndexMap array
 	if(rxnIndexMap!=NULL) {
@@ -420,7 +442,12 @@ int System::getMolObsCount(int moleculeTypeIndex, int observableIndex) const
 //observables.
 void System::prepareForSimulation()
 {
-	this->selector = new DirectSelector(allReactions);
+	if(eventBatchSize>0) {
+		batchSelector = new RejectionSelector(allReactions,eventBatchSize,eventBatchBoundFactor);
+		this->selector = batchSelector;
+	} else {
+		this->selector = new DirectSelector(allReactions);
+	}
 
 	cout<<"preparing simulation..."<<endl;
 	//Note!!  : the order of preparing the system matters!  You have to prepare
@@ -551,6 +578,17 @@ void System::prepareForSimulation()
 
   	recompute_A_tot();
 
+	//set up tau leaping last, once the reactant lists are filled
+	if(useTauLeaping) {
+		tauLeaper = new TauLeaper(this, allReactions, tauLeapEpsilon, tauLeapCriticalThreshold, onTheFlyObservables);
+		if(tauLeaper->getNumOfLeapRxns()>0) {
+			tauLeaper->printDetails();
+		} else {
+			cout<<"No population-only rules were found, so tau leaping is not used."<<endl;
+			delete tauLeaper;
+			tauLeaper = 0;
+		}
+	}
 
 }
 
@@ -587,6 +625,54 @@ double System::recompute_A_tot()
 
 
 
+void System::turnOnTauLeaping(double epsilon, int criticalThreshold)
+{
+	if(selector!=0) {
+		cout<<"Tau leaping must be turned on before the system is prepared for simulation."<<endl;
+		return;
+	}
+	useTauLeaping = true;
+	if(epsilon>0) tauLeapEpsilon = epsilon;
+	if(criticalThreshold>0) tauLeapCriticalThreshold = criticalThreshold;
+}
+
+
+void System::turnOnEventBatching(int batchSize, double boundFactor)
+{
+	if(selector!=0) {
+		cout<<"Event batching must be turned on before the system is prepared for simulation."<<endl;
+		return;
+	}
+	eventBatchSize = (batchSize>0) ? batchSize : 1;
+	if(boundFactor>=1.0) eventBatchBoundFactor = boundFactor;
+}
+
+
+/* leap the population-only rules forward, without passing maxTime.  Returns the
+ * number of events that were fired, or -1 if no leap was taken (in which case
+ * the caller should take a normal exact step) */
+int System::leapStep(double maxTime)
+{
+	ReactionClass *exactRxn = 0;
+	double exactRand = 0;
+	double tau = tauLeaper->leap(current_time, maxTime, a_tot, exactRxn, exactRand);
+	if(tau<0) return -1;
+
+	int events = tauLeaper->getLastLeapFireCount();
+	if(current_time+tau>=maxTime) current_time = maxTime;
+	else current_time += tau;
+	globalEventCounter += events;
+
+	//the exact event that ended the leap, if there was one
+	if(exactRxn!=0) {
+		events++;
+		globalEventCounter++;
+		exactRxn->fire(exactRand);
+	}
+	return events;
+}
+
+
 /* select the next reaction, given a_tot has been calculated */
 double System::getNextRxn()
 {
@@ -671,11 +757,27 @@ double System::sim(double duration, long int sampleTimes, bool verbose)
 		//recompute_A_tot();
 		//cout<<" a_tot (after recomputing) is : " << a_tot<<endl;
 
+		//2b: If tau leaping is on, try to advance the population-only rules by a leap
+		//    that stops at the next sample time.  If the leap is declined, fall
+		//    through and take an exact step
+		if(tauLeaper!=0 && a_tot>ATOT_TOLERANCE) {
+			int leapEvents = leapStep(curSampleTime<end_time ? curSampleTime : end_time);
+			if(leapEvents>=0) {
+				iteration+=leapEvents;
+				stepIteration+=leapEvents;
+				tryToDump();
+				continue;
+			}
+		}
+
 		//3: Select next reaction time (making sure we have something that can react)
 		//   dt = -ln(rand) / a_tot;
 		//Choose a random number on the OPEN interval (0,1) so that we never
 		//have a dt=0 or a dt=infinity
-		if(a_tot>ATOT_TOLERANCE) delta_t = -log(NFutil::RANDOM_OPEN()) / a_tot;
+		//In batch mode, the clock runs on the sum of the propensity bounds
+		double a_step = a_tot;
+		if(batchSelector!=0) a_step = batchSelector->prepareCandidate();
+		if(a_step>ATOT_TOLERANCE) delta_t = -log(NFutil::RANDOM_OPEN()) / a_step;
 		else { delta_t=0; current_time=end_time; }
 		if(DEBUG) cout<<"   Determine dt : " << delta_t << endl;
 
@@ -706,7 +808,13 @@ double System::sim(double duration, long int sampleTimes, bool verbose)
 
 		//4: Select next reaction class based on smallest j,
 		//   such that sum of a_j over all j >= r2*a_tot
-		double randElement = getNextRxn();
+		//   (in batch mode, a rejected candidate only moves the clock)
+		double randElement = 0;
+		if(batchSelector==0) randElement = getNextRxn();
+		else if(!batchSelector->getNextCandidate(nextReaction,randElement)) {
+			current_time+=delta_t;
+			continue;
+		}
 		//cout<<endl<<endl<<endl<<"-----------------------------------------------"<<endl;
 
 		//cout<<"Fire: "<<nextReaction->getName()<<" at time "<< current_time<<endl;
@@ -755,6 +863,10 @@ double System::sim(double duration, long int sampleTimes, bool verbose)
     cout<<(time/((double)iteration))<<" CPU seconds/event )"<< endl;
     cout<<"   Null events: "<< System::NULL_EVENT_COUNTER;
     cout<<"   ("<<(time)/((double)iteration-(double)System::NULL_EVENT_COUNTER)<<" CPU seconds/non-null event )"<< endl;
+    if(batchSelector!=0) {
+    	cout<<"   Rejected candidates: "<<batchSelector->getRejectionCount();
+    	cout<<"   (in "<<batchSelector->getBatchCount()<<" batches)"<<endl;
+    }
 
 	cout.unsetf(ios::scientific);
 	return current_time;
@@ -769,11 +881,18 @@ double System::stepTo(double stoppingTime)
 		//   be updated with the system as soon as a change to the propensity is made!
 		//recompute_A_tot();
 
+		//2b: Leap the population-only rules, if tau leaping is on
+		if(tauLeaper!=0 && a_tot>ATOT_TOLERANCE) {
+			if(leapStep(stoppingTime)>=0) continue;
+		}
+
 		//3: Select next reaction time (making sure we have something that can react)
 		//   dt = -ln(rand) / a_tot;
 		//Choose a random number on the closed interval (0,1) so that we never
 		//have a dt=0 or a dt=infinity
-		if(a_tot>ATOT_TOLERANCE) delta_t = -log(NFutil::RANDOM_CLOSED()) / a_tot;
+		double a_step = a_tot;
+		if(batchSelector!=0) a_step = batchSelector->prepareCandidate();
+		if(a_step>ATOT_TOLERANCE) delta_t = -log(NFutil::RANDOM_CLOSED()) / a_step;
 		else
 		{
 			//Otherwise, we can't react for the rest of this step
@@ -787,13 +906,19 @@ double System::stepTo(double stoppingTime)
 		//Report everything up until the next step if we have to
 		if((current_time+delta_t)>=stoppingTime)
 		{
-			//We are going to jump over the stopping time, so end the step
+			//We are going to jump over the stopping time, so end the step there
+			current_time=stoppingTime;
 			break;
 		}
 
 		//4: Select next reaction class based on smallest j,
 		//   such that sum of a_j over all j >= r2*a_tot
-		double randElement = getNextRxn();
+		double randElement = 0;
+		if(batchSelector==0) randElement = getNextRxn();
+		else if(!batchSelector->getNextCandidate(nextReaction,randElement)) {
+			current_time+=delta_t;
+			continue;
+		}
 
 
 		//Increment time
@@ -954,7 +1079,7 @@ void System::outputAllObservableCounts(double time)
 
 
 
-void System::outputAllObservableCounts(double cSampleTime, int eventCounter)
+void System::updateObservableCounts()
 {
 	if(!onTheFlyObservables)
 	{
@@ -991,6 +1116,12 @@ void System::outputAllObservableCounts(double cSampleTime, int eventCounter)
 		}
 		*/
 	}
+}
+
+
+void System::outputAllObservableCounts(double cSampleTime, int eventCounter)
+{
+	updateObservableCounts();
 
 
 	if(useBinaryOutput) {
@@ -0,0 +1,317 @@
+/*
+ * tauLeaper.cpp
+ *
+ *  Tau-leaping for reaction rules that act only on population molecules.
+ */
+
+
+
+#include "tauLeaper.hh"
+
+#include <math.h>
+#include <limits>
+
+using namespace std;
+using namespace NFcore;
+
+
+
+const double TauLeaper::MIN_EXACT_STEPS_PER_LEAP = 10.0;
+
+
+
+TauLeaper::TauLeaper(System *s, vector <ReactionClass *> &rxns, double epsilon, int criticalThreshold, bool onTheFlyObs)
+{
+	this->system = s;
+	this->epsilon = epsilon;
+	this->criticalThreshold = criticalThreshold;
+	this->onTheFlyObs = onTheFlyObs;
+	this->lastFireCount = 0;
+	this->n_leapRxns = 0;
+
+	this->n_reactions = rxns.size();
+	this->reactionClassList = new ReactionClass *[n_reactions];
+	this->isNonCritical = new bool [n_reactions];
+	for(int r=0; r<n_reactions; r++) {
+		reactionClassList[r] = rxns.at(r);
+		isNonCritical[r] = false;
+		if(r!=rxns.at(r)->getRxnId()) {
+			cerr<<"Internal Error in TauLeaper: RxnIDs do not match position in vector."<<endl;
+			exit(1);
+		}
+	}
+
+	//Species observables are matched on whole complexes, which a bulk population
+	//update does not revisit, so we cannot leap while they are around
+	if(s->getNumOfSpeciesObs()>0) {
+		cout<<"Tau leaping is turned off because the system has Species observables."<<endl;
+		return;
+	}
+
+	//Find the rules that act only on population molecules
+	vector <Molecule *> mols; vector <int> changes;
+	for(int r=0; r<n_reactions; r++)
+	{
+		ReactionClass *rxn = rxns.at(r);
+		if(rxn->getRxnType()!=ReactionClass::BASIC_RXN) continue;
+		if(!rxn->hasMassActionRateLaw() || rxn->isTagged()) continue;
+
+		TransformationSet *ts = rxn->getTransformationSet();
+		if(ts->getNumOfAddSpeciesTransforms()>0) continue;
+
+		bool leapable = true;
+		mols.clear(); changes.clear();
+		int n_reactants = rxn->getNumOfReactants();
+		for(int i=0; i<n_reactants && leapable; i++) {
+			Molecule *m = rxn->getPopulationReactant(i);
+			if(m==0) { leapable=false; break; }
+			int change = 0;
+			for(int t=0; t<ts->getNumOfTransformations(i); t++) {
+				unsigned int type = ts->getTransformation(i,t)->getType();
+				if(type==TransformationFactory::DECREMENT_POPULATION) change--;
+				else if(type!=TransformationFactory::EMPTY) { leapable=false; break; }
+			}
+			mols.push_back(m); changes.push_back(change);
+		}
+		for(int k=0; k<ts->getNumOfAddMoleculeTransforms() && leapable; k++) {
+			Molecule *m = ts->getPopulationPointer((unsigned int)k);
+			if(m==0) { leapable=false; break; }
+			mols.push_back(m); changes.push_back(1);
+		}
+		for(unsigned int k=0; k<mols.size() && leapable; k++) {
+			if(mols.at(k)->getMoleculeType()->getNumOfTypeIIFunctions()>0) leapable=false;
+		}
+		if(!leapable) continue;
+
+
+		//Register the rule, merging the changes on each population molecule
+		vector <int> species, change, reactants;
+		for(unsigned int k=0; k<mols.size(); k++) {
+			int index = -1;
+			for(unsigned int p=0; p<popMolecules.size(); p++)
+				if(popMolecules.at(p)==mols.at(k)) { index=p; break; }
+			if(index<0) {
+				index = popMolecules.size();
+				popMolecules.push_back(mols.at(k));
+				horOrder.push_back(0);
+				horMultiplicity.push_back(0);
+			}
+			if((int)k<n_reactants) reactants.push_back(index);
+
+			unsigned int s2=0;
+			for(; s2<species.size(); s2++) if(species.at(s2)==index) break;
+			if(s2==species.size()) { species.push_back(index); change.push_back(0); }
+			change.at(s2) += changes.at(k);
+		}
+
+		//Remember the highest order reaction each reactant takes part in
+		for(unsigned int k=0; k<reactants.size(); k++) {
+			int multiplicity = 0;
+			for(unsigned int k2=0; k2<reactants.size(); k2++)
+				if(reactants.at(k2)==reactants.at(k)) multiplicity++;
+			int p = reactants.at(k);
+			if(n_reactants>horOrder.at(p) || (n_reactants==horOrder.at(p) && multiplicity>horMultiplicity.at(p))) {
+				horOrder.at(p) = n_reactants;
+				horMultiplicity.at(p) = multiplicity;
+			}
+		}
+
+		leapRxns.push_back(rxn);
+		stoichSpecies.push_back(species);
+		stoichChange.push_back(change);
+		reactantSpecies.push_back(reactants);
+	}
+
+	n_leapRxns = leapRxns.size();
+	rxnA.resize(n_leapRxns,0);
+	fireCount.resize(n_leapRxns,0);
+	popChange.resize(popMolecules.size(),0);
+	mu.resize(popMolecules.size(),0);
+	sigma2.resize(popMolecules.size(),0);
+}
+
+
+TauLeaper::~TauLeaper()
+{
+	delete [] reactionClassList;
+	delete [] isNonCritical;
+	n_reactions = 0;
+	n_leapRxns = 0;
+}
+
+
+
+double TauLeaper::leap(double t, double maxTime, double a_tot, ReactionClass *&exactRxn, double &exactRand)
+{
+	exactRxn = 0;
+	exactRand = 0;
+	lastFireCount = 0;
+	if(n_leapRxns==0 || maxTime<=t) return -1;
+
+	double a_leap = classifyRxns();
+	if(a_leap<=0) return -1;
+
+	//Only leap if we cover a good number of exact steps, otherwise the exact
+	//algorithm is just as fast and has no error
+	double minTau = MIN_EXACT_STEPS_PER_LEAP / a_tot;
+	double tau = selectTau();
+	if(tau<minTau) return -1;
+
+	//The remaining rules fire exactly, so stop the leap at the next exact event
+	bool exactEvent = false;
+	double a_exact = a_tot - a_leap;
+	if(a_exact > 1e-9*a_tot) {
+		double dt = -log(NFutil::RANDOM_OPEN()) / a_exact;
+		if(dt<tau) { tau = dt; exactEvent = true; }
+	}
+	if(t+tau>=maxTime) { tau = maxTime-t; exactEvent = false; }
+
+	//If some population would go negative, shrink the leap and try again
+	while(!drawAndCheckCounts(tau)) {
+		tau *= 0.5;
+		exactEvent = false;
+		if(tau<minTau) return -1;
+	}
+
+	applyCounts();
+
+	if(exactEvent) exactRand = pickExactRxn(exactRxn);
+	return tau;
+}
+
+
+
+double TauLeaper::classifyRxns()
+{
+	double a_leap = 0;
+	for(int j=0; j<n_leapRxns; j++)
+	{
+		ReactionClass *rxn = leapRxns.at(j);
+		rxnA.at(j) = rxn->get_a();
+
+		//A rule is critical if it is within a few firings of using up a reactant
+		bool critical = false;
+		vector <int> &species = stoichSpecies.at(j);
+		vector <int> &change = stoichChange.at(j);
+		for(unsigned int k=0; k<species.size(); k++) {
+			if(change.at(k)>=0) continue;
+			int firingsLeft = popMolecules.at(species.at(k))->getPopulation() / (-change.at(k));
+			if(firingsLeft<criticalThreshold) { critical=true; break; }
+		}
+		isNonCritical[rxn->getRxnId()] = !critical;
+		if(!critical) a_leap += rxnA.at(j);
+	}
+	return a_leap;
+}
+
+
+double TauLeaper::selectTau()
+{
+	for(unsigned int p=0; p<popMolecules.size(); p++) { mu.at(p) = 0; sigma2.at(p) = 0; }
+
+	//mean and variance of the change in each population per unit time
+	for(int j=0; j<n_leapRxns; j++) {
+		if(!isNonCritical[leapRxns.at(j)->getRxnId()]) continue;
+		vector <int> &species = stoichSpecies.at(j);
+		vector <int> &change = stoichChange.at(j);
+		for(unsigned int k=0; k<species.size(); k++) {
+			mu.at(species.at(k)) += change.at(k)*rxnA.at(j);
+			sigma2.at(species.at(k)) += change.at(k)*change.at(k)*rxnA.at(j);
+		}
+	}
+
+	//bound the relative change in every reactant population by epsilon
+	double tau = numeric_limits<double>::max();
+	for(unsigned int p=0; p<popMolecules.size(); p++)
+	{
+		if(horOrder.at(p)==0) continue;
+		double x = popMolecules.at(p)->getPopulation();
+		double g = horOrder.at(p);
+		if(x>2) {
+			if(horOrder.at(p)==2 && horMultiplicity.at(p)==2) g = 2.0 + 1.0/(x-1.0);
+			else if(horOrder.at(p)==3 && horMultiplicity.at(p)==2) g = 1.5*(2.0 + 1.0/(x-1.0));
+			else if(horOrder.at(p)==3 && horMultiplicity.at(p)==3) g = 3.0 + 1.0/(x-1.0) + 2.0/(x-2.0);
+		}
+		double bound = epsilon*x/g;
+		if(bound<1.0) bound = 1.0;
+		if(mu.at(p)!=0)    tau = min(tau, bound/fabs(mu.at(p)));
+		if(sigma2.at(p)>0) tau = min(tau, bound*bound/sigma2.at(p));
+	}
+	return tau;
+}
+
+
+bool TauLeaper::drawAndCheckCounts(double tau)
+{
+	for(unsigned int p=0; p<popChange.size(); p++) popChange.at(p) = 0;
+
+	for(int j=0; j<n_leapRxns; j++) {
+		fireCount.at(j) = 0;
+		if(!isNonCritical[leapRxns.at(j)->getRxnId()]) continue;
+		fireCount.at(j) = NFutil::RANDOM_POISSON(rxnA.at(j)*tau);
+		if(fireCount.at(j)==0) continue;
+
+		vector <int> &species = stoichSpecies.at(j);
+		vector <int> &change = stoichChange.at(j);
+		for(unsigned int k=0; k<species.size(); k++)
+			popChange.at(species.at(k)) += fireCount.at(j)*change.at(k);
+	}
+
+	for(unsigned int p=0; p<popChange.size(); p++)
+		if(popMolecules.at(p)->getPopulation()+popChange.at(p) < 0) return false;
+	return true;
+}
+
+
+void TauLeaper::applyCounts()
+{
+	//Update each population once with the net change of all the leaped rules.
+	//This mirrors ReactionClass::fire: pull the molecule out of the observables,
+	//change it, put it back and let its reactions recompute their propensities
+	for(unsigned int p=0; p<popMolecules.size(); p++) {
+		if(popChange.at(p)==0) continue;
+		Molecule *m = popMolecules.at(p);
+		if(onTheFlyObs) m->removeFromObservables();
+		m->setPopulation(m->getPopulation()+popChange.at(p));
+		if(onTheFlyObs) m->addToObservables();
+		m->updateRxnMembership();
+	}
+
+	for(int j=0; j<n_leapRxns; j++) {
+		if(fireCount.at(j)==0) continue;
+		leapRxns.at(j)->addToFireCounter(fireCount.at(j));
+		lastFireCount += fireCount.at(j);
+	}
+}
+
+
+double TauLeaper::pickExactRxn(ReactionClass *&rc) const
+{
+	rc = 0;
+	double a_exact = 0;
+	for(int r=0; r<n_reactions; r++)
+		if(!isNonCritical[r]) a_exact += reactionClassList[r]->get_a();
+	if(a_exact<=0) return 0;
+
+	double randNum = NFutil::RANDOM(a_exact);
+	double a_sum=0, last_a_sum=0;
+	for(int r=0; r<n_reactions; r++) {
+		if(isNonCritical[r]) continue;
+		a_sum += reactionClassList[r]->get_a();
+		if(randNum <= a_sum)
+		{
+			rc = reactionClassList[r];
+			return (randNum-last_a_sum);
+		}
+		last_a_sum = a_sum;
+	}
+	return 0;
+}
+
+
+void TauLeaper::printDetails() const
+{
+	cout<<"Tau leaping (epsilon="<<epsilon<<", critical threshold="<<criticalThreshold<<") over "<<n_leapRxns<<" population-only rule(s):"<<endl;
+	for(int j=0; j<n_leapRxns; j++)
+		cout<<"\t"<<leapRxns.at(j)->getName()<<endl;
+}
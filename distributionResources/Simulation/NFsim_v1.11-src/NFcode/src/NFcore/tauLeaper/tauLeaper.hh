@@ -0,0 +1,107 @@
+/*
+ * tauLeaper.hh
+ *
+ *  Tau-leaping for reaction rules that act only on population molecules.
+ */
+
+#ifndef TAULEAPER_HH_
+#define TAULEAPER_HH_
+
+
+
+#include "../NFcore.hh"
+
+
+using namespace std;
+
+
+namespace NFcore
+{
+	//Forward Declarations
+	class ReactionClass;
+	class Molecule;
+	class System;
+
+
+	//!  Advances population-only reaction rules with Poisson firing counts
+	/*!
+	    Rules whose reactants and products are all population molecules (synthesis,
+	    degradation, conversion between unstructured species) have propensities that
+	    depend on nothing but a few population counts, so a whole batch of them can be
+	    fired at once without looking at individual particles.  The TauLeaper picks
+	    those rules out of the system, chooses a leap time with the error control of
+	    Cao, Gillespie and Petzold (J Chem Phys 124, 044109, 2006), draws a Poisson
+	    number of firings for each rule and applies the net population change in one
+	    update.  Rules that could drive a population negative within a few firings are
+	    marked critical and are left to the exact algorithm, as are all other rules.
+	    When a leap would not cover at least a handful of exact steps, the leaper
+	    declines and the System takes an ordinary exact step instead.
+	*/
+	class TauLeaper {
+
+		public:
+			TauLeaper(System *s, vector <ReactionClass *> &rxns, double epsilon, int criticalThreshold, bool onTheFlyObs);
+			~TauLeaper();
+
+			/* number of rules that can be leaped */
+			int getNumOfLeapRxns() const { return n_leapRxns; };
+
+			/* Try to leap from time t, without going past maxTime.  Returns the length
+			 * of the leap, or -1 if leaping was not worthwhile (and nothing was changed).
+			 * If an exact event falls inside the leap, exactRxn is set to the rule that
+			 * must be fired at the end of the leap along with the random number that
+			 * the rule uses to pick its reactants. */
+			double leap(double t, double maxTime, double a_tot, ReactionClass *&exactRxn, double &exactRand);
+
+			/* number of rule firings applied by the last successful leap */
+			unsigned long getLastLeapFireCount() const { return lastFireCount; };
+
+			void printDetails() const;
+
+			/* a leap must cover at least this many expected exact steps to be taken */
+			static const double MIN_EXACT_STEPS_PER_LEAP;
+
+
+		protected:
+
+			/* propensities of the non-critical leap rules, returns their sum */
+			double classifyRxns();
+			double selectTau();
+			bool drawAndCheckCounts(double tau);
+			void applyCounts();
+			double pickExactRxn(ReactionClass *&rc) const;
+
+			System *system;
+			double epsilon;
+			int criticalThreshold;
+			bool onTheFlyObs;
+
+			int n_reactions;
+			ReactionClass ** reactionClassList;
+
+			// the leap rules and their stoichiometry on the population molecules
+			int n_leapRxns;
+			vector <ReactionClass *> leapRxns;
+			vector < vector <int> > stoichSpecies;    // index into popMolecules
+			vector < vector <int> > stoichChange;     // net change per firing
+			vector < vector <int> > reactantSpecies;  // one entry per reactant
+
+			// the population molecules touched by the leap rules
+			vector <Molecule *> popMolecules;
+			vector <int> horOrder;         // order of the highest order rule consuming it
+			vector <int> horMultiplicity;  // and how many copies that rule consumes
+
+			// per step work space
+			bool *isNonCritical;   // indexed by rxnId
+			vector <double> rxnA;
+			vector <long> fireCount;
+			vector <long> popChange;
+			vector <double> mu;
+			vector <double> sigma2;
+			unsigned long lastFireCount;
+	};
+
+}
+
+
+#endif /* TAULEAPER_HH_ */
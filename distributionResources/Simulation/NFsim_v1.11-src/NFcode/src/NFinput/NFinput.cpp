@@ -49,7 +49,9 @@ System * NFinput::initializeFromXML(
 		int globalMoleculeLimit,
 		bool verbose,
 		int &suggestedTraversalLimit,
-		bool evaluateComplexScopedLocalFunctions )
+		bool evaluateComplexScopedLocalFunctions,
+		int partitionIndex,
+		int n_partitions )
 {
 	if(!verbose) cout<<"reading xml file ("+filename+")  \n\t[";
 	if(verbose) cout<<"\tTrying to read xml model specification file: \t\n'"<<filename<<"'"<<endl;
@@ -127,7 +129,7 @@ System * NFinput::initializeFromXML(
 
 		if(!verbose) cout<<"-";
 		else cout<<"\n\tReading list of Species..."<<endl;
-		if(!initStartSpecies(pListOfSpecies, s, parameter, allowedStates, verbose))
+		if(!initStartSpecies(pListOfSpecies, s, parameter, allowedStates, verbose, partitionIndex, n_partitions))
 		{
 			cout<<"\n\nI failed at parsing your species.  Check standard error for a report."<<endl;
 			if(s!=NULL) delete s;
@@ -595,7 +597,9 @@ bool NFinput::initStartSpecies(
 		System * s,
 		map <string,double> &parameter,
 		map<string,int> &allowedStates,
-		bool verbose)
+		bool verbose,
+		int partitionIndex,
+		int n_partitions)
 {
 	////map<string,int>::iterator iter;
 	////  for( iter = allowedStates.begin(); iter != allowedStates.end(); iter++ ) {
@@ -677,6 +681,14 @@ bool NFinput::initStartSpecies(
 				return false;
 			}
 
+			//If the system is split into subvolumes, only make this subvolume's share.  The
+			//leftover molecules go to the first subvolumes, so the shares add up to the total
+			if(n_partitions>1) {
+				int share = specCountInteger/n_partitions;
+				if(partitionIndex < specCountInteger%n_partitions) share++;
+				specCountInteger = share;
+			}
+
 			// Removed this next check!!
 			// We need to instantiate a population species, even if it does not
 			// currently have a positive species count.  --Justin.
@@ -65,7 +65,9 @@ namespace NFinput {
 			int globalMoleculeLimit,
 			bool verbose,
 			int &suggestedTraversalLimit,
-			bool evaluateComplexScopedLocalFunctions=false );
+			bool evaluateComplexScopedLocalFunctions=false,
+			int partitionIndex=0,
+			int n_partitions=1 );
 
 	//! Reads the parameter XML block and puts them in the parameter map.
 	/*!
@@ -146,6 +148,8 @@ namespace NFinput {
 
 	//! Reads a Species XML block, creates the molecules and adds them to the system.
 	/*!
+		If the model is split over n_partitions subvolumes, only the share of each
+		species that belongs to subvolume partitionIndex is created.
     	@author Michael Sneddon
 	 */
 	bool initStartSpecies(
@@ -153,7 +157,9 @@ namespace NFinput {
 			System * system,
 			map <string,double> &parameter,
 			map<string,int> &allowedStates,
-			bool verbose);
+			bool verbose,
+			int partitionIndex=0,
+			int n_partitions=1);
 
 	//! Reads a reactionRule XML block and adds the rules to the system.
 	/*!
@@ -377,6 +377,17 @@ int BasicRxnClass::getCorrectedReactantCount(unsigned int reactantIndex) const
 			 : reactantLists[reactantIndex]->size();
 }
 
+Molecule * BasicRxnClass::getPopulationReactant(unsigned int reactantIndex) const
+{
+	// population reactant lists hold (at most) the one population molecule
+	if ( !isPopulationType[reactantIndex] || reactantLists[reactantIndex]->size()!=1 )
+		return 0;
+
+	MappingSet *popMs = 0;
+	reactantLists[reactantIndex]->pickRandomFromPopulation(popMs);
+	return popMs->get(0)->getMolecule();
+}
+
 void BasicRxnClass::printFullDetails() const
 {
 	cout<<"BasicRxnClass: "<<name<<endl;
@@ -26,6 +26,9 @@ namespace NFcore
 			virtual int getReactantCount(unsigned int reactantIndex) const;
 			virtual int getCorrectedReactantCount(unsigned int reactantIndex) const;
 
+			virtual Molecule * getPopulationReactant(unsigned int reactantIndex) const;
+			virtual bool hasMassActionRateLaw() const { return true; };
+
 			virtual void printFullDetails() const;
 
 		protected:
@@ -47,6 +50,7 @@ namespace NFcore
 			virtual ~FunctionalRxnClass();
 
 			virtual double update_a();
+			virtual bool hasMassActionRateLaw() const { return false; };
 			virtual void printDetails() const;
 
 		protected:
@@ -61,6 +65,7 @@ namespace NFcore
 			virtual ~MMRxnClass();
 
 			virtual double update_a();
+			virtual bool hasMassActionRateLaw() const { return false; };
 			virtual void printDetails() const;
 
 		protected:
@@ -286,6 +286,11 @@ namespace NFcore
 			 */
 			int getNumOfAddMoleculeTransforms() const { return addMoleculeTransformations.size(); };
 
+			/*
+			 * Query the number of addSpeciesTransforms in this set
+			 */
+			int getNumOfAddSpeciesTransforms() const { return addSpeciesTransformations.size(); };
+
 			/*
 			 * If AddMolecule is a population, returns a pointer to the population object,
 			 *  otherwise returns null.  --Justin
@@ -84,6 +84,24 @@
  *                     This list is not guaranteed to be canonical. Filename argument is
  *                     optional (defaults to [model]_nf.species).
  *
+ *  -tauleap [epsilon] = tau leap the rules that act only on population molecules, see manual
+ *
+ *  -tlcrit [integer] = rules this many firings from exhausting a reactant are not leaped
+ *
+ *  -batch [integer] = draw events in batches against frozen propensity bounds, see manual
+ *                     (only selection is batched, events are still committed one by one)
+ *
+ *  -batchbound [factor] = with -batch, bounds are this factor times the propensities
+ *
+ *  -subvol [integer] = split the volume into this many well-mixed subvolumes that are
+ *                      simulated in parallel processes, see manual
+ *
+ *  -syncdt [time] = with -subvol, time between exchanges of molecules between subvolumes
+ *
+ *  -hop [rate] = with -subvol, rate at which a free molecule hops to each neighbouring subvolume
+ *
+ *  -rng [mt|xoshiro] = random number generator; mt reproduces the streams of earlier versions
+ *
  *  \section devel_sec Developers
  * To begin developing and extending NFsim, the best place to start looking is in
  * the src/NFtest/simple_system directory. Here you'll find two files, simple_system.hh
@@ -98,7 +116,7 @@
  * of the simulation engine while the NFreactions directory contains the classes associated with
  * actually executing rules and transforming molecules.  NFinput contains what's needed for
  * the xml parser (built using the TinyXML package) and the command line parser.  NFutil also
- * contains a nice implementation of the Mersenne Twister random number generator which should
+ * contains the random number generators (xoshiro256++ and the Mersenne Twister) which should
  * be used for all random number generation in NFsim.  NFoutput is more sparse as it deals only
  * with handling the more complicated output required of groups and complexes.  (Basic outputting
  * is handled easily with the System and Observable classes in the NFcore namespace).
@@ -174,7 +192,7 @@ bool runRNFscript(map<string,string> argMap, bool verbose);
 /*!
   @author Michael Sneddon
 */
-System *initSystemFromFlags(map<string,string> argMap, bool verbose);
+System *initSystemFromFlags(map<string,string> argMap, bool verbose, int partitionIndex, int n_partitions);
 
 
 
@@ -207,6 +225,17 @@ int main(int argc, char *argv[])
 		if(argMap.find("v")!=argMap.end()) {
 			verbose = true;
 		}
+		//The generator has to be chosen before it is seeded
+		if(argMap.find("rng")!=argMap.end()) {
+			string rng = argMap.find("rng")->second;
+			if(rng=="mt") {
+				NFutil::USE_LEGACY_RANDOM(true);
+			} else if(rng!="xoshiro") {
+				cerr<<"Unknown random number generator given with -rng: '"<<rng<<"'"<<endl;
+				cerr<<"Use either 'xoshiro' (the default) or 'mt'."<<endl;
+				exit(1);
+			}
+		}
 		if(argMap.find("seed")!= argMap.end()) {
 			int seed = abs(NFinput::parseAsInt(argMap,"seed",0));
 			NFutil::SEED_RANDOM(seed);
@@ -243,6 +272,13 @@ int main(int argc, char *argv[])
 			parsed = true;
 		}
 
+		//  An XML file split into subvolumes that run in separate processes
+		else if (argMap.find("xml")!=argMap.end() && argMap.find("subvol")!=argMap.end())
+		{
+			runSubvolumes(argMap,verbose);
+			parsed = true;
+		}
+
 		//  Main entry point for a basic XML file...
 		else if (argMap.find("xml")!=argMap.end())
 		{
@@ -345,7 +381,7 @@ bool runRNFscript(map<string,string> argMap, bool verbose)
 }
 
 
-System *initSystemFromFlags(map<string,string> argMap, bool verbose)
+System *initSystemFromFlags(map<string,string> argMap, bool verbose, int partitionIndex, int n_partitions)
 {
 	//Find the xml file that defines the system
 	if (argMap.find("xml")!=argMap.end())
@@ -383,7 +419,8 @@ System *initSystemFromFlags(map<string,string> argMap, bool verbose)
 			if(turnOnComplexBookkeeping || blockSameComplexBinding) cb=true;
 			int suggestedTraveralLimit = ReactionClass::NO_LIMIT;
 			System *s = NFinput::initializeFromXML(filename,cb,globalMoleculeLimit,verbose,
-													suggestedTraveralLimit,evaluateComplexScopedLocalFunctions);
+													suggestedTraveralLimit,evaluateComplexScopedLocalFunctions,
+													partitionIndex,n_partitions);
 
 
 			if(s!=NULL)
@@ -484,6 +521,26 @@ System *initSystemFromFlags(map<string,string> argMap, bool verbose)
 					if(verbose) cout<<"\tOn-the-fly observables is turned on (detected -notf flag)."<<endl<<endl;
 				}
 
+				//turn on tau leaping of population-only rules
+				if(argMap.find("tauleap")!=argMap.end()) {
+					double epsilon = 0.03;
+					if(!argMap.find("tauleap")->second.empty())
+						epsilon = NFinput::parseAsDouble(argMap,"tauleap",epsilon);
+					int criticalThreshold = NFinput::parseAsInt(argMap,"tlcrit",10);
+					s->turnOnTauLeaping(epsilon,criticalThreshold);
+					if(verbose) cout<<"\tTau leaping of population-only rules is turned on (epsilon="<<epsilon<<")."<<endl<<endl;
+				}
+
+				//turn on batched event selection
+				if(argMap.find("batch")!=argMap.end()) {
+					int batchSize = 100;
+					if(!argMap.find("batch")->second.empty())
+						batchSize = NFinput::parseAsInt(argMap,"batch",batchSize);
+					double boundFactor = NFinput::parseAsDouble(argMap,"batchbound",1.2);
+					s->turnOnEventBatching(batchSize,boundFactor);
+					if(verbose) cout<<"\tBatched event selection is turned on (batch size="<<batchSize<<")."<<endl<<endl;
+				}
+
 
 
 
@@ -645,6 +702,38 @@ void printHelp(string version)
 	cout<<"                    to erroneous results if complex-scoped local functions"<<endl;
 	cout<<"                    are required."<<endl;
 	cout<<""<<endl;
+	cout<<"  -tauleap [eps]    tau leap the rules whose reactants and products are all"<<endl;
+	cout<<"                    population molecules.  Each leap fires a Poisson number"<<endl;
+	cout<<"                    of events per rule while keeping the relative change of"<<endl;
+	cout<<"                    any population below eps (default 0.03).  Everything"<<endl;
+	cout<<"                    else is still simulated exactly."<<endl;
+	cout<<""<<endl;
+	cout<<"  -tlcrit [integer] with -tauleap, rules fewer than this many firings away"<<endl;
+	cout<<"                    from exhausting a reactant are fired exactly (default 10)."<<endl;
+	cout<<""<<endl;
+	cout<<"  -batch [integer]  experimental: draw up to this many candidate events"<<endl;
+	cout<<"                    (default 100) against propensity bounds that are frozen"<<endl;
+	cout<<"                    at the start of the batch, and accept each one with"<<endl;
+	cout<<"                    probability a/bound.  Results are exact; the batch ends"<<endl;
+	cout<<"                    early when an event raises a propensity past its bound."<<endl;
+	cout<<"                    Only the selection is batched: each accepted event"<<endl;
+	cout<<"                    still updates propensities and observables as it fires."<<endl;
+	cout<<""<<endl;
+	cout<<"  -batchbound [x]   with -batch, the bounds are x times the propensities at"<<endl;
+	cout<<"                    the start of each batch (default 1.2)."<<endl;
+	cout<<""<<endl;
+	cout<<"  -subvol [integer] split the volume into this many well-mixed subvolumes"<<endl;
+	cout<<"                    on a ring, each simulated in its own process.  Starting"<<endl;
+	cout<<"                    species are divided evenly and mass action rates are"<<endl;
+	cout<<"                    rescaled to the smaller volume.  Observables are summed"<<endl;
+	cout<<"                    over the subvolumes in the output file."<<endl;
+	cout<<""<<endl;
+	cout<<"  -syncdt [time]    with -subvol, time between molecule exchanges between"<<endl;
+	cout<<"                    neighbouring subvolumes (default: the output interval)."<<endl;
+	cout<<""<<endl;
+	cout<<"  -hop [rate]       with -subvol, rate per second at which a molecule without"<<endl;
+	cout<<"                    bonds hops to each neighbouring subvolume (default 1)."<<endl;
+	cout<<""<<endl;
 	cout<<"  -test             used to specify a given preprogrammed test. Some tests"<<endl;
 	cout<<"                    include \"tlbr\" and \"simple_system\".  Tests do not read"<<endl;
 	cout<<"                    in other command line flags"<<endl;
@@ -653,6 +742,11 @@ void printHelp(string version)
 	cout<<"                    This allows you to run the same simulation and get the"<<endl;
 	cout<<"                    exact same results perhaps to compare performance"<<endl;
 	cout<<""<<endl;
+	cout<<"  -rng [mt|xoshiro] selects the random number generator.  The default is"<<endl;
+	cout<<"                    xoshiro256++; mt selects the Mersenne Twister used by"<<endl;
+	cout<<"                    earlier versions, which reproduces their results for a"<<endl;
+	cout<<"                    given seed."<<endl;
+	cout<<""<<endl;
 	cout<<"  -logo             prints out the ascii NFsim logo, for your viewing pleasure."<<endl;
 	cout<<""<<endl;
 	cout<<""<<endl;
@@ -48,6 +48,9 @@
 #include  "NFtest/tlbr/tlbr.hh"
 #include  "NFtest/agentcell/agentcell.hh"
 
+//Include the driver for simulations split into subvolumes
+#include "NFsubvolume/subvolume.hh"
+
 
 
 //! Runs a given System with the specified arguments
@@ -59,9 +62,11 @@ bool runFromArgs(System *s, map<string,string> argMap, bool verbose);
 
 //! Initialize a system from command line flags
 /*!
+  When the model is split into subvolumes, partitionIndex and n_partitions
+  select the share of the starting species that goes into this System.
   @author Michael Sneddon
 */
-System *initSystemFromFlags(map<string,string> argMap, bool verbose);
+System *initSystemFromFlags(map<string,string> argMap, bool verbose, int partitionIndex=0, int n_partitions=1);
 
 
 
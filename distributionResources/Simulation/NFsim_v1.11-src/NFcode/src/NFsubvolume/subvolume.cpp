@@ -0,0 +1,502 @@
+/*
+ * subvolume.cpp
+ *
+ *  Runs a model that is split into well-mixed subvolumes, one process
+ *  per subvolume, which exchange free molecules at fixed sync times.
+ */
+
+#include "subvolume.hh"
+#include "../NFsim.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cstdio>
+#include <math.h>
+#include <time.h>
+
+using namespace std;
+using namespace NFcore;
+
+
+//The subvolumes are forked processes, which native Windows builds cannot make
+#if defined(_WIN32) && !defined(__CYGWIN__)
+
+bool runSubvolumes(map<string,string> argMap, bool verbose)
+{
+	cout<<"Splitting a model into subvolumes (-subvol) is not supported on this platform."<<endl;
+	return false;
+}
+
+#else
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+
+
+//Each hopping molecule is sent as one line of text through the pipes:
+//    "P typeIndex moleculeIndex count"   for a population molecule
+//    "M typeIndex n s_1 ... s_n"         for a particle and its component states
+//Lines written by a subvolume are prefixed with the index of the destination.
+
+
+/* Returns a binomially distributed count, in time proportional to n*p */
+static long drawBinomial(long n, double p)
+{
+	if(n<=0 || p<=0) return 0;
+	if(p>=1) return n;
+	if(p>0.5) return n-drawBinomial(n,1.0-p);
+
+	//skip over the failures with geometrically distributed gaps
+	double logq = log(1.0-p);
+	double position = 0;
+	long k = 0;
+	while(true) {
+		position += floor(log(NFutil::RANDOM_OPEN())/logq) + 1.0;
+		if(position>n) break;
+		k++;
+	}
+	return k;
+}
+
+
+static bool readLine(FILE *in, string &line)
+{
+	line.clear();
+	int c;
+	while((c=fgetc(in))!=EOF) {
+		if(c=='\n') return true;
+		line.push_back((char)c);
+	}
+	return !line.empty();
+}
+
+
+static bool readBlock(FILE *in, vector <string> &lines)
+{
+	lines.clear();
+	string line;
+	if(!readLine(in,line)) return false;
+	int n = atoi(line.c_str());
+	for(int i=0; i<n; i++) {
+		if(!readLine(in,line)) return false;
+		lines.push_back(line);
+	}
+	return true;
+}
+
+
+static void writeBlock(FILE *out, vector <string> &lines)
+{
+	fprintf(out,"%d\n",(int)lines.size());
+	for(unsigned int i=0; i<lines.size(); i++)
+		fprintf(out,"%s\n",lines.at(i).c_str());
+	fflush(out);
+}
+
+
+static void getNeighbours(int subvolume, int n_subvolumes, vector <int> &neighbours)
+{
+	neighbours.clear();
+	if(n_subvolumes<2) return;
+	neighbours.push_back((subvolume+n_subvolumes-1)%n_subvolumes);
+	if(n_subvolumes>2) neighbours.push_back((subvolume+1)%n_subvolumes);
+}
+
+
+/* Rescales the rates of the system to a volume n_subvolumes times smaller */
+static void scaleRatesToSubvolume(System *s, int n_subvolumes, bool report)
+{
+	for(int r=0; r<s->getNumOfReactions(); r++)
+	{
+		ReactionClass *rxn = s->getReaction(r);
+		if(rxn->hasMassActionRateLaw()) {
+			rxn->scaleBaseRate(pow((double)n_subvolumes,rxn->getNumOfReactants()-1));
+		} else if(report && rxn->getNumOfReactants()!=1) {
+			cerr<<"Warning: rule "<<rxn->getName()<<" does not have a mass action rate law,"<<endl;
+			cerr<<"         so its rate is not rescaled to the volume of a subvolume."<<endl;
+		}
+	}
+}
+
+
+/* Removes the hopping molecules from the system and lists them with their destinations */
+static void collectHops(System *s, double pLeave, vector <int> &neighbours, vector <string> &outgoing)
+{
+	outgoing.clear();
+	if(pLeave<=0 || neighbours.empty()) return;
+
+	vector <Molecule *> leaving;
+	for(int t=0; t<s->getNumOfMoleculeTypes(); t++)
+	{
+		MoleculeType *mt = s->getMoleculeType(t);
+		if(mt->isPopulationType())
+		{
+			for(int m=0; m<mt->getMoleculeCount(); m++) {
+				Molecule *mol = mt->getMolecule(m);
+				long moved = drawBinomial(mol->getPopulation(),pLeave);
+				if(moved==0) continue;
+
+				long toFirst = moved;
+				if(neighbours.size()>1) toFirst = drawBinomial(moved,0.5);
+				for(unsigned int n=0; n<neighbours.size(); n++) {
+					long count = (n==0) ? toFirst : moved-toFirst;
+					if(count==0) continue;
+					ostringstream line;
+					line<<neighbours.at(n)<<" P "<<t<<" "<<m<<" "<<count;
+					outgoing.push_back(line.str());
+				}
+
+				mol->removeFromObservables();
+				mol->setPopulation(mol->getPopulation()-moved);
+				mol->addToObservables();
+				mol->updateRxnMembership();
+			}
+		}
+		else
+		{
+			//only molecules without bonds move, complexes stay where they are
+			leaving.clear();
+			for(int m=0; m<mt->getMoleculeCount(); m++) {
+				Molecule *mol = mt->getMolecule(m);
+				if(mol->getDegree()>0) continue;
+				if(NFutil::RANDOM_CLOSED()<pLeave) leaving.push_back(mol);
+			}
+			for(unsigned int i=0; i<leaving.size(); i++) {
+				Molecule *mol = leaving.at(i);
+				ostringstream line;
+				line<<neighbours.at(NFutil::RANDOM_INT(0,neighbours.size()))<<" M "<<t<<" "<<mt->getNumOfComponents();
+				for(int c=0; c<mt->getNumOfComponents(); c++)
+					line<<" "<<mol->getComponentState(c);
+				outgoing.push_back(line.str());
+				mt->removeMoleculeFromRunningSystem(mol);
+			}
+		}
+	}
+}
+
+
+/* Puts the molecules that hopped in from other subvolumes into the system */
+static bool placeHops(System *s, vector <string> &incoming)
+{
+	for(unsigned int i=0; i<incoming.size(); i++)
+	{
+		istringstream line(incoming.at(i));
+		string kind; int t=-1;
+		line>>kind>>t;
+		if(t<0 || t>=s->getNumOfMoleculeTypes()) return false;
+		MoleculeType *mt = s->getMoleculeType(t);
+
+		if(kind=="P") {
+			int m=-1; long count=0;
+			line>>m>>count;
+			if(m<0 || m>=mt->getMoleculeCount()) return false;
+			Molecule *mol = mt->getMolecule(m);
+			mol->removeFromObservables();
+			mol->setPopulation(mol->getPopulation()+count);
+			mol->addToObservables();
+			mol->updateRxnMembership();
+		}
+		else if(kind=="M") {
+			int n_comp=0;
+			line>>n_comp;
+			if(n_comp!=mt->getNumOfComponents()) return false;
+			Molecule *mol = mt->genDefaultMolecule();
+			for(int c=0; c<n_comp; c++) {
+				int state=0; line>>state;
+				mol->setComponentState(c,state);
+			}
+			mt->addMoleculeToRunningSystem(mol);
+		}
+		else return false;
+	}
+	return true;
+}
+
+
+/* The work done by each forked subvolume process */
+static int runSubvolumeProcess(map<string,string> argMap, bool verbose,
+		int subvolume, int n_subvolumes, unsigned long seed,
+		int n_syncs, double syncDt, double hopRate,
+		FILE *fromCoordinator, FILE *toCoordinator)
+{
+	//the subvolumes all run the same model, so keep only the first one talking
+	if(subvolume>0 && !verbose) freopen("/dev/null","w",stdout);
+	//each subvolume draws from its own stream of the generator
+	NFutil::SEED_RANDOM_STREAM(seed,subvolume);
+
+	System *s = initSystemFromFlags(argMap,verbose,subvolume,n_subvolumes);
+	if(s==0) return 1;
+
+	//molecules that hop are added and removed outside of reactions, which only
+	//keeps molecule observables up to date, so count species observables at output
+	if(s->getNumOfSpeciesObs()>0) s->turnOff_OnTheFlyObs();
+
+	//let the coordinator know we are up, and what the model is called
+	vector <string> name(1,s->getName());
+	writeBlock(toCoordinator,name);
+
+	scaleRatesToSubvolume(s,n_subvolumes,subvolume==0);
+	s->prepareForSimulation();
+
+	double eqTime = NFinput::parseAsDouble(argMap,"eq",0);
+	double sTime = NFinput::parseAsDouble(argMap,"sim",10);
+	int oSteps = NFinput::parseAsInt(argMap,"oSteps",10);
+	if(eqTime>0) s->equilibrate(eqTime);
+
+	vector <int> neighbours;
+	getNeighbours(subvolume,n_subvolumes,neighbours);
+	double pLeave = 1.0-exp(-hopRate*syncDt*neighbours.size());
+
+	//step to whichever comes first, the next output or the next exchange
+	double dOutputTime = sTime/oSteps;
+	double never = numeric_limits<double>::max();
+	int nextOutput=1, nextSync=1;
+	vector <string> outgoing, incoming;
+	s->outputAllObservableCounts(0.0);
+	while(nextOutput<=oSteps || nextSync<=n_syncs)
+	{
+		double outputTime = (nextOutput<=oSteps) ? nextOutput*dOutputTime : never;
+		double syncTime = (nextSync<=n_syncs) ? nextSync*syncDt : never;
+		double stepTime = min(outputTime,syncTime);
+		s->stepTo(stepTime);
+
+		if(outputTime<=stepTime) {
+			s->outputAllObservableCounts(outputTime);
+			nextOutput++;
+		}
+		if(syncTime<=stepTime) {
+			collectHops(s,pLeave,neighbours,outgoing);
+			writeBlock(toCoordinator,outgoing);
+			if(!readBlock(fromCoordinator,incoming) || !placeHops(s,incoming)) {
+				cerr<<"Subvolume "<<subvolume<<" could not read the molecules sent to it.  Quitting."<<endl;
+				delete s;
+				return 1;
+			}
+			nextSync++;
+		}
+	}
+
+	delete s;
+	return 0;
+}
+
+
+/* Sums the observable files of the subvolumes, line by line, into one file */
+static bool mergeSubvolumeOutput(vector <string> &files, string outputFileName, bool csv)
+{
+	int n = files.size();
+	vector <ifstream *> in;
+	for(int k=0; k<n; k++) {
+		in.push_back(new ifstream(files.at(k).c_str()));
+		if(!in.back()->is_open()) {
+			cout<<"Could not open the output of subvolume "<<k<<": "<<files.at(k)<<endl;
+			for(int j=0; j<=k; j++) delete in.at(j);
+			return false;
+		}
+	}
+	ofstream out(outputFileName.c_str());
+	out.setf(ios::scientific);
+	out.precision(8);
+
+	//the header is the same in every file
+	string line;
+	bool ok = true;
+	for(int k=0; k<n; k++) {
+		if(!getline(*in.at(k),line)) ok=false;
+		else if(k==0) out<<line<<endl;
+	}
+
+	while(ok && getline(*in.at(0),line))
+	{
+		vector <string> lines(1,line);
+		for(int k=1; k<n; k++) {
+			if(!getline(*in.at(k),line)) { ok=false; break; }
+			lines.push_back(line);
+		}
+		if(!ok) break;
+
+		vector <double> sum;
+		for(int k=0; k<n; k++) {
+			string values = lines.at(k);
+			if(csv) for(unsigned int c=0; c<values.size(); c++) if(values[c]==',') values[c]=' ';
+			istringstream parse(values);
+			double v; unsigned int col=0;
+			while(parse>>v) {
+				if(col==sum.size()) sum.push_back(0);
+				if(col==0) sum.at(0) = v;  //time is not summed
+				else sum.at(col) += v;
+				col++;
+			}
+		}
+		if(sum.empty()) continue;
+		if(csv) {
+			out<<sum.at(0);
+			for(unsigned int col=1; col<sum.size(); col++) out<<", "<<sum.at(col);
+		} else {
+			out<<" "<<sum.at(0);
+			for(unsigned int col=1; col<sum.size(); col++) out<<"  "<<sum.at(col);
+		}
+		out<<endl;
+	}
+	out.close();
+
+	for(int k=0; k<n; k++) {
+		in.at(k)->close();
+		delete in.at(k);
+	}
+	if(!ok) cout<<"The subvolume output files have different lengths, so the output is incomplete."<<endl;
+	return ok;
+}
+
+
+
+bool runSubvolumes(map<string,string> argMap, bool verbose)
+{
+	int n_subvolumes = NFinput::parseAsInt(argMap,"subvol",1);
+	if(n_subvolumes<1) {
+		cout<<"The number of subvolumes (-subvol) must be positive."<<endl;
+		return false;
+	}
+	if(argMap.find("b")!=argMap.end()) {
+		cout<<"Binary output (-b) cannot be combined with subvolumes (-subvol)."<<endl;
+		return false;
+	}
+	if(argMap.find("walk")!=argMap.end() || argMap.find("ss")!=argMap.end()) {
+		cout<<"Warning: -walk and -ss are ignored when the model is split into subvolumes."<<endl;
+	}
+
+	double sTime = NFinput::parseAsDouble(argMap,"sim",10);
+	int oSteps = NFinput::parseAsInt(argMap,"oSteps",10);
+	double syncDt = NFinput::parseAsDouble(argMap,"syncdt",sTime/oSteps);
+	double hopRate = NFinput::parseAsDouble(argMap,"hop",1.0);
+	if(syncDt<=0 || hopRate<0) {
+		cout<<"The sync interval (-syncdt) must be positive and the hop rate (-hop) must not be negative."<<endl;
+		return false;
+	}
+
+	//exchanges happen strictly inside the simulation time
+	int n_syncs = 0;
+	while((n_syncs+1)*syncDt < sTime*(1.0-1e-12)) n_syncs++;
+
+	unsigned long baseSeed = (unsigned long) time(NULL);
+	if(argMap.find("seed")!=argMap.end())
+		baseSeed = abs(NFinput::parseAsInt(argMap,"seed",0));
+
+	bool csv = (argMap.find("csv")!=argMap.end());
+	string xmlFile = argMap.find("xml")->second;
+
+	cout<<"Splitting the model into "<<n_subvolumes<<" subvolume(s), exchanging molecules every "<<syncDt<<"s"<<endl;
+	cout<<"with a hop rate of "<<hopRate<<"/s to each neighbour ("<<n_syncs<<" exchanges)."<<endl<<endl;
+	cout.flush();
+
+	struct timeval start, finish;
+	gettimeofday(&start,NULL);
+
+
+	//Start the subvolume processes, each writing to its own output file
+	vector <string> files;
+	vector <pid_t> pids;
+	vector <FILE *> toSubvolume, fromSubvolume;
+	for(int k=0; k<n_subvolumes; k++)
+	{
+		ostringstream file;
+		file<<xmlFile<<"_subvol"<<k<<(csv ? ".csv" : ".gdat");
+		files.push_back(file.str());
+
+		int down[2], up[2];
+		if(pipe(down)!=0 || pipe(up)!=0) {
+			cout<<"Could not open the pipes to subvolume "<<k<<".  Quitting."<<endl;
+			return false;
+		}
+		fflush(stdout); cout.flush();
+		pid_t pid = fork();
+		if(pid<0) {
+			cout<<"Could not start the process for subvolume "<<k<<".  Quitting."<<endl;
+			return false;
+		}
+		if(pid==0)
+		{
+			//a subvolume only talks to the coordinator through its own pipes
+			close(down[1]); close(up[0]);
+			for(int j=0; j<k; j++) { fclose(toSubvolume.at(j)); fclose(fromSubvolume.at(j)); }
+			FILE *fromCoordinator = fdopen(down[0],"r");
+			FILE *toCoordinator = fdopen(up[1],"w");
+
+			map<string,string> subvolumeArgs = argMap;
+			subvolumeArgs["o"] = files.at(k);
+			int status = runSubvolumeProcess(subvolumeArgs,verbose,k,n_subvolumes,baseSeed,
+					n_syncs,syncDt,hopRate,fromCoordinator,toCoordinator);
+			fclose(fromCoordinator);
+			fclose(toCoordinator);
+			cout.flush();
+			exit(status);
+		}
+		close(down[0]); close(up[1]);
+		toSubvolume.push_back(fdopen(down[1],"w"));
+		fromSubvolume.push_back(fdopen(up[0],"r"));
+		pids.push_back(pid);
+	}
+
+
+	//Wait until every subvolume has read the model
+	bool ok = true;
+	vector <string> block;
+	string modelName;
+	for(int k=0; k<n_subvolumes && ok; k++) {
+		if(!readBlock(fromSubvolume.at(k),block) || block.size()!=1) ok=false;
+		else if(k==0) modelName = block.at(0);
+	}
+
+	//Route the hopping molecules between the subvolumes at every sync time
+	vector < vector <string> > incoming(n_subvolumes);
+	for(int sync=1; sync<=n_syncs && ok; sync++)
+	{
+		for(int k=0; k<n_subvolumes; k++) incoming.at(k).clear();
+		for(int k=0; k<n_subvolumes && ok; k++) {
+			if(!readBlock(fromSubvolume.at(k),block)) { ok=false; break; }
+			for(unsigned int i=0; i<block.size(); i++) {
+				string::size_type split = block.at(i).find(' ');
+				int dest = atoi(block.at(i).substr(0,split).c_str());
+				if(dest<0 || dest>=n_subvolumes) { ok=false; break; }
+				incoming.at(dest).push_back(block.at(i).substr(split+1));
+			}
+		}
+		if(!ok) break;
+		for(int k=0; k<n_subvolumes; k++) writeBlock(toSubvolume.at(k),incoming.at(k));
+	}
+	for(int k=0; k<n_subvolumes; k++) {
+		fclose(toSubvolume.at(k));
+		fclose(fromSubvolume.at(k));
+	}
+
+	for(int k=0; k<n_subvolumes; k++) {
+		int status = 0;
+		waitpid(pids.at(k),&status,0);
+		if(!WIFEXITED(status) || WEXITSTATUS(status)!=0) ok=false;
+	}
+	if(!ok) {
+		cout<<"A subvolume process did not finish properly, so no output was merged."<<endl;
+		return false;
+	}
+
+	gettimeofday(&finish,NULL);
+	double wallTime = (finish.tv_sec-start.tv_sec) + 1e-6*(finish.tv_usec-start.tv_usec);
+	cout<<"   Simulated "<<n_subvolumes<<" subvolume(s) in "<<wallTime<<"s (wall clock)."<<endl;
+
+
+	//Sum the subvolumes into the output file that a normal run would have written
+	string outputFileName = modelName+"_nf.gdat";
+	if(argMap.find("o")!=argMap.end()) outputFileName = argMap.find("o")->second;
+	if(!mergeSubvolumeOutput(files,outputFileName,csv)) return false;
+	if(!verbose) for(int k=0; k<n_subvolumes; k++) remove(files.at(k).c_str());
+	if(verbose) cout<<"\tSubvolume output was summed into: "<<outputFileName<<endl;
+
+	return true;
+}
+
+#endif
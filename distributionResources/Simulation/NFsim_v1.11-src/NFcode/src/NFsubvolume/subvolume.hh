@@ -0,0 +1,41 @@
+/*
+ * subvolume.hh
+ *
+ *  Runs a model that is split into well-mixed subvolumes, one process
+ *  per subvolume, which exchange free molecules at fixed sync times.
+ */
+
+#ifndef SUBVOLUME_HH_
+#define SUBVOLUME_HH_
+
+#include <string>
+#include <map>
+
+using namespace std;
+
+
+//! Simulates an XML model split into well-mixed subvolumes
+/*!
+    The volume is divided into n (-subvol) subvolumes that sit on a ring.  Each
+    subvolume is a complete System in its own forked process, holding an even share
+    of the starting species, with mass action rates rescaled to its smaller volume
+    (rules of order m are sped up by n^(m-1)).  The subvolumes are simulated
+    independently between sync times that are -syncdt apart.  At each sync time
+    every molecule without bonds hops to a neighbouring subvolume with rate -hop
+    per neighbour (population molecules hop as binomially drawn counts), and the
+    coordinating process routes the hopping molecules to their destinations.
+    This is first order operator splitting between reaction and diffusion, so it
+    is exact only in the limit of short sync times.
+
+    Each subvolume writes its observables to its own file, and at the end the
+    files are summed column by column into the usual output file.  Columns that
+    are not additive (global function values from -ogf) are summed as well, so
+    they should not be trusted in this mode.
+
+    Processes are used instead of threads because the random number generator and
+    several scratch lists in the simulation core are static.
+*/
+bool runSubvolumes(map<string,string> argMap, bool verbose);
+
+
+#endif /* SUBVOLUME_HH_ */
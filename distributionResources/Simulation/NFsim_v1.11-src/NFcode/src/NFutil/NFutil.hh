@@ -40,6 +40,28 @@ namespace NFutil {
 	void SEED_RANDOM( unsigned long  seed );
 
 
+	//!  Seeds one of many independent random number streams
+	/*!
+	   Seeds the generator as SEED_RANDOM does, then moves it to stream number
+	   'stream'.  With the default xoshiro256++ generator the streams are 2^192
+	   numbers apart (by jumping ahead), so they can never overlap.  The legacy
+	   Mersenne Twister cannot jump ahead, so there the stream is seeded with
+	   seed+stream instead.  Use this to give parallel runs their own numbers.
+	 */
+	void SEED_RANDOM_STREAM( unsigned long seed, unsigned int stream );
+
+
+	//!  Switches between the xoshiro256++ and the legacy Mersenne Twister generator
+	/*!
+	   By default, random numbers come from xoshiro256++ (D. Blackman and S. Vigna,
+	   ACM Trans. Math. Softw. 47, 36, 2021), which runs four interleaved generators
+	   and fills a buffer with a batch of numbers at a time.  With useLegacy set,
+	   the Mersenne Twister of earlier versions is used instead, which reproduces
+	   their output bit for bit for a given seed.  Call this before seeding.
+	 */
+	void USE_LEGACY_RANDOM( bool useLegacy );
+
+
 	//!  Uniform random number on the interval (0,max]
 	/*!
 		This function returns a random double on the half open interval
@@ -91,6 +113,16 @@ namespace NFutil {
 	*/
 	double RANDOM_GAUSSIAN();
 
+	//!  Poisson distributed random integer with the given mean.
+	/*!
+		Returns the number of events of a Poisson process with the given mean.
+		Small means use Knuth's multiplication method; larger means use the
+		transformed rejection method (PTRS) of W. Hormann, Insurance: Mathematics
+		and Economics 12, 39-45 (1993), which is exact and runs in constant time.
+		Used by the TauLeaper to draw firing counts.
+	*/
+	long RANDOM_POISSON(double mean);
+
 
 
 	//!  Parses and converts std::string objects to double values.
@@ -20,6 +20,7 @@
 #include <time.h>
 #include <cstdlib>
 #include <math.h>
+#include <stdint.h>
 
 
 
@@ -37,15 +38,138 @@ static MTRand dRand;
 static MTRand_closed dRandClosed;
 static MTRand_open dRandOpen;
 
+static bool useLegacyMT = false;
+
+
+
+//////////////////////////////////////////////////////////////////////////////
+// xoshiro256++ (http://prng.di.unimi.it/), run as four interleaved generators
+// that are 2^128 numbers apart.  Refilling a whole batch at a time keeps the
+// four lanes independent of each other, so the compiler can vectorize the
+// update, and each draw is just a read from the buffer.
+
+static const int XOSHIRO_LANES = 4;
+static const int XOSHIRO_BATCH = 256;
+
+static uint64_t xoState[4][XOSHIRO_LANES];
+static uint64_t xoBuffer[XOSHIRO_BATCH];
+static int xoPosition = XOSHIRO_BATCH;
+
+static const uint64_t XOSHIRO_JUMP[4] = {
+	0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+static const uint64_t XOSHIRO_LONG_JUMP[4] = {
+	0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+
+
+static inline uint64_t rotl(const uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* advances a single xoshiro256 state by one step */
+static inline void xoshiroStep(uint64_t *s) {
+	const uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+}
+
+/* jumps a single xoshiro256 state ahead with the given jump polynomial */
+static void xoshiroJump(uint64_t *s, const uint64_t *jump) {
+	uint64_t j[4] = { 0, 0, 0, 0 };
+	for(int i=0; i<4; i++) {
+		for(int b=0; b<64; b++) {
+			if(jump[i] & (((uint64_t)1) << b)) {
+				j[0] ^= s[0]; j[1] ^= s[1]; j[2] ^= s[2]; j[3] ^= s[3];
+			}
+			xoshiroStep(s);
+		}
+	}
+	s[0]=j[0]; s[1]=j[1]; s[2]=j[2]; s[3]=j[3];
+}
+
+/* seeds lane 0 from the seed, after jumping 'stream' long jumps, and the
+ * other lanes one jump further each */
+static void xoshiroSeed(unsigned long seed, unsigned int stream) {
+	uint64_t s[4];
+	uint64_t x = seed;
+	for(int i=0; i<4; i++) s[i] = splitmix64(x);
+	for(unsigned int k=0; k<stream; k++) xoshiroJump(s,XOSHIRO_LONG_JUMP);
+	for(int lane=0; lane<XOSHIRO_LANES; lane++) {
+		for(int i=0; i<4; i++) xoState[i][lane] = s[i];
+		xoshiroJump(s,XOSHIRO_JUMP);
+	}
+	xoPosition = XOSHIRO_BATCH;
+}
+
+static void xoshiroRefill() {
+	uint64_t *s0 = xoState[0], *s1 = xoState[1], *s2 = xoState[2], *s3 = xoState[3];
+	for(int i=0; i<XOSHIRO_BATCH; i+=XOSHIRO_LANES) {
+		for(int lane=0; lane<XOSHIRO_LANES; lane++) {
+			xoBuffer[i+lane] = rotl(s0[lane] + s3[lane], 23) + s0[lane];
+			const uint64_t t = s1[lane] << 17;
+			s2[lane] ^= s0[lane];
+			s3[lane] ^= s1[lane];
+			s1[lane] ^= s2[lane];
+			s0[lane] ^= s3[lane];
+			s2[lane] ^= t;
+			s3[lane] = rotl(s3[lane], 45);
+		}
+	}
+	xoPosition = 0;
+}
+
+static inline uint64_t xoshiroNext() {
+	if(xoPosition==XOSHIRO_BATCH) xoshiroRefill();
+	return xoBuffer[xoPosition++];
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// The uniform variates that everything else is built from.  In legacy mode
+// these are exactly the Mersenne Twister calls of earlier versions.
+
+static inline void checkSeeded() {
+	if (initflag) {
+		if(useLegacyMT) iRand.seed( (int) time(NULL));
+		else xoshiroSeed( (unsigned long) time(NULL), 0);
+		initflag=0;
+	}
+}
+
+/* uniform on [0,1) */
+static inline double uniformHalfOpen() {
+	if(useLegacyMT) return dRand();
+	return (xoshiroNext() >> 11) * (1.0/9007199254740992.0);
+}
+
+/* uniform on (0,1) */
+static inline double uniformOpen() {
+	if(useLegacyMT) return dRandOpen();
+	return ((xoshiroNext() >> 12) + 0.5) * (1.0/4503599627370496.0);
+}
+
+/* uniform on [0,1] */
+static inline double uniformClosed() {
+	if(useLegacyMT) return dRandClosed();
+	return (xoshiroNext() >> 11) * (1.0/9007199254740991.0);
+}
+
 
 
 /* Return a random double on the range (0,max] */
 double NFutil::RANDOM( double max )
 {
-	if (initflag) {
-		iRand.seed( (int) time(NULL));
-		initflag=0;
-    }
+	checkSeeded();
 
 	/* dRand() gives a uniform double on the interval [0,1).  But
 	 * for our purposes, we want a double value (0,1] so that if a reaction class
@@ -54,37 +178,28 @@ double NFutil::RANDOM( double max )
 	 * it can equal 1.  This then is just 1-dRand().  To get the correct range,
 	 * we multiply by the max value.  This is what I do here: */
 
-	return ( (1-dRand()) * max );
+	return ( (1-uniformHalfOpen()) * max );
 }
 
 /* Return a random double on the closed interval [0,1] */
 double NFutil::RANDOM_CLOSED()
 {
-	if (initflag) {
-		iRand.seed( (int) time(NULL));
-		initflag=0;
-    }
-	return dRandClosed();
+	checkSeeded();
+	return uniformClosed();
 }
 
 /* Return a random double on the open interval (0,1) */
 double NFutil::RANDOM_OPEN()
 {
-	if (initflag) {
-		iRand.seed( (int) time(NULL));
-		initflag=0;
-    }
-	return dRandOpen();
+	checkSeeded();
+	return uniformOpen();
 }
 
 
 /* Returns a random normally distributed number */
 double NFutil::RANDOM_GAUSSIAN()
 {
-	if (initflag) {
-		iRand.seed( (int) time(NULL));
-		initflag=0;
-    }
+	checkSeeded();
     if(haveNextGaussian)
     {
     	haveNextGaussian = false;
@@ -93,8 +208,8 @@ double NFutil::RANDOM_GAUSSIAN()
     
 	double v1=0, v2=0, s=0;
 	do {
-		v1 = 2 * dRandOpen()-1;
-		v2 = 2 * dRandOpen()-1;
+		v1 = 2 * uniformOpen()-1;
+		v2 = 2 * uniformOpen()-1;
 		s=v1*v1 + v2*v2;
 	} while (s>=1 || s==0);
 	
@@ -105,21 +220,71 @@ double NFutil::RANDOM_GAUSSIAN()
 }
 
 
+/* Returns a Poisson distributed integer with the given mean */
+long NFutil::RANDOM_POISSON(double mean)
+{
+	checkSeeded();
+	if(mean<=0) return 0;
+
+	// multiplication method, fine while exp(-mean) is not too small
+	if(mean<10) {
+		double limit = exp(-mean);
+		double prod = uniformOpen();
+		long k = 0;
+		while(prod>limit) {
+			prod *= uniformOpen();
+			k++;
+		}
+		return k;
+	}
+
+	// transformed rejection with squeeze (PTRS)
+	double slam = sqrt(mean);
+	double loglam = log(mean);
+	double b = 0.931 + 2.53*slam;
+	double a = -0.059 + 0.02483*b;
+	double invalpha = 1.1239 + 1.1328/(b-3.4);
+	double vr = 0.9277 - 3.6224/(b-2);
+	while(true) {
+		double U = uniformHalfOpen() - 0.5;
+		double V = uniformOpen();
+		double us = 0.5 - fabs(U);
+		long k = (long) floor((2*a/us + b)*U + mean + 0.43);
+		if(us>=0.07 && V<=vr) return k;
+		if(k<0 || (us<0.013 && V>us)) continue;
+		if( (log(V) + log(invalpha) - log(a/(us*us)+b)) <= (-mean + k*loglam - lgamma((double)k+1)) )
+			return k;
+	}
+}
+
+
 /* Returns a random positive integer on the range [min, max) */
 int NFutil::RANDOM_INT(unsigned long min, unsigned long max)
 {
-	if (initflag) {
-		iRand.seed( (int) time(NULL));
-		initflag=0;
-    }
-	return ( min+int((max-min)*dRand()) );
+	checkSeeded();
+	return ( min+int((max-min)*uniformHalfOpen()) );
 }
 
 
 /* Seed the number generator with a positive 32 bit integer */
 void NFutil::SEED_RANDOM( unsigned long seedInt ){
-    iRand.seed(seedInt);
-    initflag = 0;
+	SEED_RANDOM_STREAM(seedInt,0);
+}
+
+
+/* Seed an independent stream of the number generator */
+void NFutil::SEED_RANDOM_STREAM( unsigned long seedInt, unsigned int stream ){
+	if(useLegacyMT) iRand.seed(seedInt+stream);
+	else xoshiroSeed(seedInt,stream);
+	haveNextGaussian = false;
+	initflag = 0;
+}
+
+
+/* Choose between xoshiro256++ and the legacy Mersenne Twister */
+void NFutil::USE_LEGACY_RANDOM( bool useLegacy ){
+	useLegacyMT = useLegacy;
+	initflag = 1;
 }
 
 
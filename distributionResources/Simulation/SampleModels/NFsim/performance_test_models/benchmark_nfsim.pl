@@ -0,0 +1,586 @@
+#!/usr/bin/perl
+# Benchmark and regression script for NFsim.
+#
+# SYNOPSIS:
+#   benchmark_nfsim.pl [OPTIONS]              : benchmark all models
+#   benchmark_nfsim.pl [OPTIONS] MODEL...     : benchmark MODEL
+#   benchmark_nfsim.pl --help                 : display help menu
+#
+# Runs each performance test model in this directory with NFsim, using the
+# command line arguments from the README and fixed seeds (replicate r is run
+# with -seed r, or -seed 1000+r for reference runs), and reports for each model:
+#
+#   wall_time           : wall clock time of the whole NFsim run (s)
+#   time_to_first_step  : wall clock time until the simulation starts, that is,
+#                         reading the XML file and preparing the system (s)
+#   events              : number of events (reactions) fired
+#   events_per_sec      : events per CPU second of the simulation loop, as
+#                         reported by NFsim
+#   peak_rss_kb         : peak resident memory, sampled from /proc while NFsim
+#                         runs (Linux only, otherwise null)
+#
+# The observables at the end of every replicate are compared to a reference
+# distribution in $datdir/MODEL.stats with a two sample z-test on the means,
+# Bonferroni corrected over the observables.  Keep in mind that the test will
+# fail (100*p) percent of the time, even if the simulator is exact!!
+#
+# All results are written as JSON (default: benchmark.json in the output
+# directory) so they can be tracked over commits.  Exits with the number of
+# models that failed, or -1 (=255) if there was some problem running the
+# benchmark.
+#
+# To regenerate the reference distributions after a deliberate change in the
+# models or their arguments, run with --update-reference and plenty of
+# replicates (say, --replicates 30).
+
+use strict;
+use warnings;
+# Perl Modules
+use FindBin;
+use File::Spec;
+use Getopt::Long;
+use IO::Handle;
+use IO::Select;
+use Time::HiRes qw( time sleep );
+use POSIX qw( strftime );
+use JSON::PP;
+
+
+### PARAMETERS ###
+
+# perl binary
+my $perlbin = $^X;
+
+# BNG root directory
+my $bngpath = (exists $ENV{'BNGPATH'} ? $ENV{'BNGPATH'} :
+                    File::Spec->catdir( $FindBin::RealBin, File::Spec->updir(), File::Spec->updir(),
+                                        File::Spec->updir(), 'BioNetGen-2.2.5' ) );
+# NFsim binary
+my $nfsim = File::Spec->catfile( $FindBin::RealBin, File::Spec->updir(), File::Spec->updir(),
+                                 File::Spec->updir(), 'NFsim_v1.11-src', 'NFcode', 'bin', 'NFsim' );
+# directory containing models
+my $modeldir = $FindBin::RealBin;
+# directory containing reference distributions
+my $datdir   = File::Spec->catdir( $modeldir, 'DAT_benchmark' );
+# output directory
+my $outdir   = File::Spec->curdir();
+# JSON results file (default is benchmark.json in the output directory)
+my $jsonfile;
+# number of replicates of every model
+my $replicates = 10;
+# p-value for the comparison to the reference distributions
+my $pvalue = 0.01;
+# extra arguments for NFsim, to benchmark an engine option
+my $nfsim_args = '';
+# if true, write new reference distributions instead of checking them
+my $update_reference = 0;
+# if true, delete output files after the benchmark
+my $delete_working_files = 1;
+# how often to sample the memory use of NFsim (s)
+my $poll_interval = 0.005;
+# reference runs use seeds above this, so they are independent of the checked runs
+my $reference_seed_offset = 1000;
+
+# NFsim arguments of each model, as given in the README
+my %model_args = (
+    'push_pull'        => '-oSteps 100 -sim 100 -notf',
+    'egfr_net'         => '-oSteps 120 -sim 120 -notf -utl 2',
+    'poly'             => '-oSteps 100 -sim 100 -utl 2',
+    'tlbr_performance' => '-oSteps 300 -sim 300 -bscb -cb -utl 3',
+    'ANx_noActivity'   => '-oSteps 100 -sim 100 -utl 2',
+);
+
+
+
+###                                                          ###
+###  BEGIN MAIN SCRIPT, no user options beyond this point!!  ###
+###                                                          ###
+
+# Greet the User
+print "\n---[ NFsim Benchmark Utility ]---\n\n";
+
+# parse command line arguments
+GetOptions( 'help|h'            => sub { display_help(); exit(0); },
+            'bngpath=s'         => \$bngpath,
+            'nfsim=s'           => \$nfsim,
+            'datpath=s'         => \$datdir,
+            'outpath=s'         => \$outdir,
+            'json=s'            => \$jsonfile,
+            'replicates=i'      => \$replicates,
+            'pvalue=f'          => \$pvalue,
+            'nfsim-args=s'      => \$nfsim_args,
+            'update-reference!' => \$update_reference,
+            'delete-files!'     => \$delete_working_files
+          )
+or die "Error in command line arguments (try: benchmark_nfsim.pl --help)";
+
+$jsonfile = File::Spec->catfile( $outdir, 'benchmark.json' ) unless (defined $jsonfile);
+
+# get models to benchmark
+my @models = (@ARGV) ? @ARGV : sort {$a cmp $b} keys %model_args;
+foreach my $model (@models)
+{
+    $model =~ s/\.bngl$//;
+    unless ( exists $model_args{$model} )
+    {   exit_error("$model is not one of the performance test models");   }
+}
+
+# check that we can find everything
+my $bngexec = File::Spec->catfile( $bngpath, 'BNG2.pl' );
+unless ( -e $bngexec )
+{   exit_error("Cannot find BNG2.pl script (looked in $bngpath, set --bngpath)");   }
+unless ( -x $nfsim )
+{   exit_error("Cannot find the NFsim binary $nfsim (set --nfsim, or build it first)");   }
+unless ( $replicates > 0 )
+{   exit_error("Need at least one replicate");   }
+if ( $update_reference  and  !(-d $datdir) )
+{   mkdir $datdir  or  exit_error("Can't create directory $datdir ($!)");   }
+
+
+# count number of models and failures
+my $fail_count = 0;
+my $test_count = 0;
+my @results = ();
+
+
+## Benchmark Models
+MODEL:
+foreach my $model (@models)
+{
+    ++$test_count;
+    print "\n[benchmark ${model}]\n";
+
+    my $model_file = File::Spec->catfile( $modeldir, "${model}.bngl" );
+    my $xml_file   = File::Spec->catfile( $outdir, "${model}.xml" );
+    my $log_file   = File::Spec->catfile( $outdir, "${model}.log" );
+    my $stats_file = File::Spec->catfile( $datdir, "${model}.stats" );
+    my $result = { 'model' => $model, 'nfsim_args' => "$model_args{$model} $nfsim_args",
+                   'replicates' => $replicates };
+    push @results, $result;
+
+    # open logfile
+    open( my $log, '>', $log_file )  or  exit_error("Can't open logfile $log_file ($!)");
+    $log->autoflush(1);
+
+    # translate the model to XML
+    print " -> writing XML with BioNetGen\n";
+    my $exit_status = system( "\"$perlbin\" \"$bngexec\" --outdir \"$outdir\" \"$model_file\" >> \"$log_file\" 2>&1" );
+    unless ( $exit_status==0  and  -e $xml_file )
+    {
+        print "!! BioNetGen failed to process $model (see $log_file) !!\n";
+        $result->{error} = 'BioNetGen failed';
+        ++$fail_count;
+        close $log;
+        next MODEL;
+    }
+
+    # run the replicates
+    print " -> running $replicates replicate(s) of NFsim $model_args{$model} $nfsim_args\n";
+    my @runs = ();
+    my @final = ();
+    my $observables;
+    foreach my $rep (1..$replicates)
+    {
+        my $gdat_file = File::Spec->catfile( $outdir, "${model}_bench${rep}.gdat" );
+        my $seed = $update_reference ? $reference_seed_offset+$rep : $rep;
+        my @command = ( $nfsim, '-xml', $xml_file, '-o', $gdat_file, '-seed', $seed,
+                        split(' ', $model_args{$model}), split(' ', $nfsim_args) );
+        print $log join(' ', @command), "\n";
+        my $run = run_nfsim( $log, @command );
+        unless ( defined $run )
+        {
+            print "!! NFsim failed on replicate $rep (see $log_file) !!\n";
+            $result->{error} = "NFsim failed on replicate $rep";
+            ++$fail_count;
+            close $log;
+            next MODEL;
+        }
+        push @runs, $run;
+
+        my ($names, $values) = read_last_sample( $gdat_file );
+        unless ( defined $names )
+        {
+            print "!! could not read $gdat_file !!\n";
+            $result->{error} = "could not read output of replicate $rep";
+            ++$fail_count;
+            close $log;
+            next MODEL;
+        }
+        $observables = $names;
+        push @final, $values;
+        unlink $gdat_file  if ($delete_working_files);
+    }
+
+    # summarize the performance measures over the replicates
+    foreach my $measure ( qw( wall_time time_to_first_step events events_per_sec peak_rss_kb ) )
+    {
+        my @values = grep { defined $_ } map { $_->{$measure} } @runs;
+        $result->{$measure} = (@values==@runs) ? summarize(\@values) : undef;
+    }
+    printf "    wall time %.3fs, first step after %.3fs, %.4g events/s, peak RSS %s\n",
+           $result->{wall_time}->{mean}, $result->{time_to_first_step}->{mean},
+           $result->{events_per_sec}->{mean},
+           (defined $result->{peak_rss_kb} ? sprintf('%d kB', $result->{peak_rss_kb}->{max}) : 'n/a');
+
+    # distribution of the observables at the end of the simulation
+    my $sample = {};
+    foreach my $i ( 0..$#$observables )
+    {
+        my @values = map { $_->[$i] } @final;
+        $sample->{ $observables->[$i] } = summarize(\@values);
+    }
+    $result->{observables} = $sample;
+
+    if ($update_reference)
+    {
+        print " -> writing reference distribution\n";
+        unless ( write_stats( $stats_file, $model, "$model_args{$model} $nfsim_args", $replicates, $observables, $sample ) )
+        {   exit_error("Can't write $stats_file ($!)");   }
+    }
+    elsif ( -e $stats_file )
+    {
+        print " -> checking observables against reference distribution\n";
+        my $error = check_reference( $stats_file, $sample, $replicates, $pvalue, $result );
+        if ( defined $error )
+        {
+            print "..FAILED!! $error\n";
+            print $log "FAILED: $error\n";
+            ++$fail_count;
+        }
+    }
+    else
+    {   print "    (no reference distribution in $datdir, skipping the check)\n";   }
+
+    close $log;
+    unlink $xml_file, $log_file  if ($delete_working_files);
+}
+
+
+## Write the JSON report
+my $report = {
+    'date'       => strftime( '%Y-%m-%dT%H:%M:%S', localtime ),
+    'commit'     => git_commit(),
+    'nfsim'      => $nfsim,
+    'nfsim_args' => $nfsim_args,
+    'pvalue'     => $pvalue,
+    'models'     => \@results,
+};
+{
+    open( my $fh, '>', $jsonfile )  or  exit_error("Can't write $jsonfile ($!)");
+    print $fh JSON::PP->new->pretty->canonical->encode($report);
+    close $fh;
+    print "\nresults were written to $jsonfile\n";
+}
+
+
+## Print summary results and exit
+if ($fail_count)
+{   print "\n!! benchmark_nfsim failed on $fail_count of $test_count model(s) !!\n\n";   }
+else
+{   print "\nbenchmark_nfsim ran all $test_count model(s) successfully.\n\n";   }
+exit($fail_count);
+
+
+
+
+
+###                                                      ###
+### END OF MAIN SCRIPT. Accessory subroutines are below. ###
+###                                                      ###
+
+# run NFsim once, timing it and sampling its memory use
+sub run_nfsim
+{
+    my $log = shift @_;
+    my @command = @_;
+
+    my $start = time();
+    my $pid = open( my $out, '-|' );
+    unless ( defined $pid )
+    {   print $log "can't fork: $!\n";  return undef;   }
+    if ( $pid==0 )
+    {   # child: run NFsim with stderr on stdout
+        open( STDERR, '>&', \*STDOUT );
+        exec { $command[0] } @command;
+        exit(-1);
+    }
+
+    my $run = { 'peak_rss_kb' => undef };
+    my $status_file = "/proc/$pid/status";
+    my $select = IO::Select->new($out);
+    my $buffer = '';
+    while (1)
+    {
+        sample_memory( $status_file, $run );
+        next unless ( $select->can_read($poll_interval) );
+        my $n = sysread( $out, my $chunk, 65536 );
+        last unless ($n);
+        $buffer .= $chunk;
+        while ( $buffer =~ s/^(.*)\n// )
+        {
+            my $line = $1;
+            print $log "$line\n";
+            if ( $line =~ /^simulating system for:/  and  !exists $run->{time_to_first_step} )
+            {   $run->{time_to_first_step} = time() - $start;   }
+            if ( $line =~ /You just simulated (\d+) reactions in (\S+)s/ )
+            {
+                $run->{events} = $1;
+                $run->{events_per_sec} = ($2 > 0) ? $1/$2 : undef;
+            }
+        }
+    }
+    close $out;
+    my $exit_status = $?>>8;
+    $run->{wall_time} = time() - $start;
+
+    unless ( $exit_status==0  and  exists $run->{events} )
+    {   print $log "NFsim exited with status $exit_status\n";  return undef;   }
+    $run->{time_to_first_step} = $run->{wall_time}  unless ( exists $run->{time_to_first_step} );
+    return $run;
+}
+
+
+# keep the largest resident set size that the kernel reports for a process
+sub sample_memory
+{
+    my $status_file = shift;
+    my $run = shift;
+
+    open( my $fh, '<', $status_file )  or  return;
+    while ( my $line = <$fh> )
+    {
+        if ( $line =~ /^VmHWM:\s*(\d+)\s*kB/ )
+        {
+            $run->{peak_rss_kb} = $1  if ( !defined $run->{peak_rss_kb}  or  $1 > $run->{peak_rss_kb} );
+            last;
+        }
+    }
+    close $fh;
+}
+
+
+# read the observable names and their values at the last sample time of a gdat file
+sub read_last_sample
+{
+    my $file = shift;
+    open( my $fh, '<', $file )  or  return undef;
+
+    my $header = <$fh>;
+    return undef unless (defined $header);
+    $header =~ s/^#\s*//;
+    $header =~ s/\s*$//;
+    my @names = split /\s+/, $header;
+    shift @names;   # time
+
+    my $last;
+    while ( my $line = <$fh> )
+    {
+        next unless ( $line =~ /\S/ );
+        $last = $line;
+    }
+    close $fh;
+    return undef unless (defined $last);
+
+    $last =~ s/^\s*//;
+    $last =~ s/\s*$//;
+    my @values = split /\s+/, $last;
+    shift @values;   # time
+    return undef unless ( @values==@names );
+    return ( \@names, \@values );
+}
+
+
+# mean, standard deviation, min and max of a list of numbers
+sub summarize
+{
+    my $values = shift;
+    my $n = @$values;
+    my ($sum, $min, $max) = (0, $values->[0], $values->[0]);
+    foreach my $v (@$values)
+    {
+        $sum += $v;
+        $min = $v  if ($v < $min);
+        $max = $v  if ($v > $max);
+    }
+    my $mean = $sum/$n;
+    my $ss = 0;
+    foreach my $v (@$values) {  $ss += ($v-$mean)**2;  }
+    my $std_dev = ($n > 1) ? sqrt($ss/($n-1)) : 0;
+    return { 'mean' => $mean+0, 'std_dev' => $std_dev+0, 'min' => $min+0, 'max' => $max+0 };
+}
+
+
+# write a reference distribution file
+sub write_stats
+{
+    my ($file, $model, $args, $n, $names, $sample) = @_;
+    open( my $fh, '>', $file )  or  return 0;
+    print $fh "# Reference distribution of the observables of $model at the end of the\n";
+    print $fh "# simulation, from $n replicate(s) of: NFsim $args\n";
+    print $fh "# Written by benchmark_nfsim.pl on ", strftime('%Y-%m-%d', localtime), "\n";
+    print $fh "statistic = two_sample_z\n";
+    print $fh "replicates = $n\n";
+    print $fh "observables = ", join(', ', @$names), "\n";
+    print $fh "mean = ", join(', ', map { sprintf('%.6g', $sample->{$_}->{mean}) } @$names), "\n";
+    print $fh "std_dev = ", join(', ', map { sprintf('%.6g', $sample->{$_}->{std_dev}) } @$names), "\n";
+    close $fh;
+    return 1;
+}
+
+
+# read a stats file into a hash of lists
+sub read_stats
+{
+    my $file = shift;
+    open( my $fh, '<', $file )  or  return undef;
+
+    my $stats = {};
+    while ( my $line = <$fh> )
+    {
+        # trim comments and leading and trailing white space
+        $line =~ s/#.*$//;
+        $line =~ s/^\s+//;
+        $line =~ s/\s+$//;
+        # find key
+        $line =~ s/(\w+)\s*=\s*//;  my $key = $1;
+        next unless (defined $key);
+        $stats->{$key} = [ split /,\s*/, $line ];
+    }
+    close $fh;
+    return $stats;
+}
+
+
+# compare the sampled observables to the reference distribution, returns
+# undef if the sample agrees
+sub check_reference
+{
+    my ($file, $sample, $n, $pvalue, $result) = @_;
+
+    my $stats = read_stats( $file );
+    unless ( defined $stats )
+    {   return "ERROR: some problem reading $file!";   }
+    foreach my $key ( qw( replicates observables mean std_dev ) )
+    {
+        unless ( exists $stats->{$key} )
+        {   return "ERROR: '$key' not defined in $file!";   }
+    }
+    my $ref_n = $stats->{replicates}->[0];
+    my @names = @{ $stats->{observables} };
+
+    # Bonferroni correction over the observables
+    my $zcrit = normal_quantile( 1 - $pvalue/(2*@names) );
+
+    my @failed = ();
+    my $checks = {};
+    foreach my $i ( 0..$#names )
+    {
+        my $name = $names[$i];
+        unless ( exists $sample->{$name} )
+        {   return "ERROR: observable $name is missing from the output!";   }
+        my $ref_mean = $stats->{mean}->[$i];
+        my $ref_sd   = $stats->{std_dev}->[$i];
+        my $mean     = $sample->{$name}->{mean};
+        my $sd       = $sample->{$name}->{std_dev};
+
+        my $se = sqrt( $ref_sd**2/$ref_n + $sd**2/$n );
+        my $z;
+        if ( $se > 0 )
+        {   $z = ($mean - $ref_mean)/$se;   }
+        else
+        {   # both distributions are a single value, they had better agree
+            $z = ( abs($mean-$ref_mean) <= 1e-6*(abs($ref_mean)+1) ) ? 0 : 1e300;
+        }
+        $checks->{$name} = { 'reference_mean' => $ref_mean+0, 'z' => $z+0 };
+        push @failed, sprintf('%s (mean %.4g, reference %.4g, z=%.2f)', $name, $mean, $ref_mean, $z)
+            if ( abs($z) > $zcrit );
+    }
+    $result->{reference_check} = { 'z_critical' => $zcrit, 'passed' => (@failed ? JSON::PP::false : JSON::PP::true),
+                                   'observables' => $checks };
+
+    return undef unless (@failed);
+    return "observables differ from the reference: " . join(', ', @failed);
+}
+
+
+# inverse of the standard normal distribution function (Acklam's algorithm,
+# relative error below 1.2e-9)
+sub normal_quantile
+{
+    my $p = shift;
+    my @a = ( -3.969683028665376e+01,  2.209460984245205e+02, -2.759285104469687e+02,
+               1.383577518672690e+02, -3.066479806614716e+01,  2.506628277459239e+00 );
+    my @b = ( -5.447609879822406e+01,  1.615858368580409e+02, -1.556989798598866e+02,
+               6.680131188771972e+01, -1.328068155288572e+01 );
+    my @c = ( -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+              -2.549732539343734e+00,  4.374664141464968e+00,  2.938163982698783e+00 );
+    my @d = (  7.784695709041462e-03,  3.224671290700398e-01,  2.445134137142996e+00,
+               3.754408661907416e+00 );
+    my $plow = 0.02425;
+
+    if ( $p < $plow )
+    {
+        my $q = sqrt(-2*log($p));
+        return ((((($c[0]*$q+$c[1])*$q+$c[2])*$q+$c[3])*$q+$c[4])*$q+$c[5]) /
+                (((($d[0]*$q+$d[1])*$q+$d[2])*$q+$d[3])*$q+1);
+    }
+    if ( $p > 1-$plow )
+    {
+        my $q = sqrt(-2*log(1-$p));
+        return -((((($c[0]*$q+$c[1])*$q+$c[2])*$q+$c[3])*$q+$c[4])*$q+$c[5]) /
+                 (((($d[0]*$q+$d[1])*$q+$d[2])*$q+$d[3])*$q+1);
+    }
+    my $q = $p - 0.5;
+    my $r = $q*$q;
+    return ((((($a[0]*$r+$a[1])*$r+$a[2])*$r+$a[3])*$r+$a[4])*$r+$a[5])*$q /
+           ((((($b[0]*$r+$b[1])*$r+$b[2])*$r+$b[3])*$r+$b[4])*$r+1);
+}
+
+
+# the commit being benchmarked, if we are in a git checkout
+sub git_commit
+{
+    my $commit = `git -C "$FindBin::RealBin" rev-parse HEAD 2>/dev/null`;
+    return undef unless ( defined $commit  and  $? == 0 );
+    chomp $commit;
+    return $commit;
+}
+
+
+# display help menu
+sub display_help
+{
+    print <<END_HELP
+benchmark_nfsim.pl: runs the NFsim performance test models with fixed seeds,
+  measures their performance and checks their observables against reference
+  distributions.  Results are written as JSON.
+
+SYNOPSIS:
+  benchmark_nfsim.pl [OPTS]          : benchmark all models
+  benchmark_nfsim.pl [OPTS] MODEL... : benchmark MODEL
+
+OPTIONS:
+  --nfsim PATH       : NFsim binary (default: NFcode/bin/NFsim)
+  --bngpath PATH     : BioNetGen root directory, used to write the XML files
+  --datpath PATH     : directory with the reference distributions
+  --outpath PATH     : directory for working files
+  --json FILE        : JSON results file (default: benchmark.json in outpath)
+  --replicates N     : replicates per model, with seeds 1..N (default: 10)
+  --pvalue P         : significance level of the reference check (default: 0.01)
+  --nfsim-args ARGS  : extra NFsim arguments, for example "-tauleap"
+  --update-reference : write new reference distributions instead of checking
+  --no-delete-files  : keep the working files
+  --help             : display this help menu
+
+Exits with the number of models that failed.
+END_HELP
+}
+
+
+# exit with error message
+sub exit_error
+{
+    my $err = shift @_;
+    print "ABORT: $err\n";
+    exit -1;
+}